@@ -0,0 +1,297 @@
+#include "L4/HashTable/ReadWrite/Builder.h"
+#include "L4/HashTable/ReadWrite/Serializer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+
+// L4.Builder builds a hash table from TSV or binary key/value files and writes a snapshot
+// that can be loaded with HashTableConfig::Serializer.
+
+using Allocator = std::allocator<char>;
+using Builder = L4::HashTable::ReadWrite::Builder<Allocator>;
+using HashTable = Builder::HashTable;
+
+
+struct CommandLineOptions
+{
+    static constexpr std::uint32_t c_defaultNumBuckets = 1000000U;
+    static constexpr std::uint32_t c_defaultNumBucketsPerMutex = 1U;
+    static constexpr std::uint16_t c_defaultNumThreads = 0U;
+    static constexpr std::uint32_t c_defaultBatchSizeInMB = 256U;
+
+    std::vector<std::string> m_inputs;
+    std::string m_output;
+    Builder::Format m_format = Builder::Format::Tsv;
+    Builder::DuplicatePolicy m_duplicatePolicy = Builder::DuplicatePolicy::Overwrite;
+    std::uint32_t m_numBuckets = c_defaultNumBuckets;
+    std::uint32_t m_numBucketsPerMutex = c_defaultNumBucketsPerMutex;
+    std::uint16_t m_fixedKeySize = 0U;
+    std::uint32_t m_fixedValueSize = 0U;
+    std::uint16_t m_numThreads = c_defaultNumThreads;
+    std::uint32_t m_batchSizeInMB = c_defaultBatchSizeInMB;
+    bool m_useImage = false;
+};
+
+constexpr std::uint32_t CommandLineOptions::c_defaultNumBuckets;
+constexpr std::uint32_t CommandLineOptions::c_defaultNumBucketsPerMutex;
+constexpr std::uint16_t CommandLineOptions::c_defaultNumThreads;
+constexpr std::uint32_t CommandLineOptions::c_defaultBatchSizeInMB;
+
+
+class Timer
+{
+public:
+    Timer()
+        : m_start{ std::chrono::steady_clock::now() }
+    {}
+
+    double GetElapsedSeconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+
+// Reads the given file in batches that end at a record boundary and adds them to the builder.
+// Returns the number of bytes read.
+std::uint64_t AddFile(Builder& builder, const std::string& input, const CommandLineOptions& options)
+{
+    std::ifstream stream(input, std::ios::binary);
+    if (!stream)
+    {
+        throw L4::RuntimeException("Failed to open the input file: " + input);
+    }
+
+    std::vector<char> buffer(static_cast<std::size_t>(options.m_batchSizeInMB) * 1024U * 1024U);
+    std::size_t bufferedSize = 0U;
+    std::uint64_t totalSize = 0U;
+    bool isEnd = false;
+
+    while (!isEnd)
+    {
+        stream.read(buffer.data() + bufferedSize, buffer.size() - bufferedSize);
+        const auto readSize = static_cast<std::size_t>(stream.gcount());
+
+        bufferedSize += readSize;
+        totalSize += readSize;
+        isEnd = stream.eof();
+
+        const auto completeSize = Builder::GetCompleteSize(buffer.data(), bufferedSize, options.m_format, isEnd);
+
+        if (completeSize == 0U && !isEnd)
+        {
+            // A single record is larger than the batch.
+            buffer.resize(buffer.size() * 2U);
+            continue;
+        }
+
+        builder.Add(buffer.data(), completeSize, options.m_format);
+
+        std::copy(buffer.begin() + completeSize, buffer.begin() + bufferedSize, buffer.begin());
+        bufferedSize -= completeSize;
+    }
+
+    return totalSize;
+}
+
+
+void PrintReport(
+    const Builder::Report& report,
+    std::uint64_t inputSize,
+    std::uint64_t snapshotSize,
+    double buildTime,
+    double serializeTime)
+{
+    const auto numNonEmptyBuckets = report.m_numBuckets - report.m_numEmptyBuckets;
+
+    printf("------------------------------------------------------\n");
+    printf("%30s | %20llu |\n", "Input bytes", static_cast<unsigned long long>(inputSize));
+    printf("%30s | %20llu |\n", "Records", static_cast<unsigned long long>(report.m_numRecords));
+    printf("%30s | %20llu |\n", "Duplicate keys", static_cast<unsigned long long>(report.m_numDuplicates));
+    printf("%30s | %20llu |\n", "Total key bytes", static_cast<unsigned long long>(report.m_totalKeySize));
+    printf("%30s | %20llu |\n", "Total value bytes", static_cast<unsigned long long>(report.m_totalValueSize));
+    printf("%30s | %20llu |\n", "Total index bytes", static_cast<unsigned long long>(report.m_totalIndexSize));
+    printf("%30s | %20llu |\n", "Buckets", static_cast<unsigned long long>(report.m_numBuckets));
+    printf("%30s | %20llu |\n", "Empty buckets", static_cast<unsigned long long>(report.m_numEmptyBuckets));
+    printf("%30s | %20llu |\n", "Chaining entries", static_cast<unsigned long long>(report.m_numChainingEntries));
+    printf("%30s | %20llu |\n", "Max chain length", static_cast<unsigned long long>(report.m_maxChainLength));
+    printf("%30s | %20.3f |\n", "Records per non-empty bucket",
+        (numNonEmptyBuckets != 0U) ? static_cast<double>(report.m_numRecords) / numNonEmptyBuckets : 0.0);
+    printf("%30s | %20llu |\n", "Snapshot bytes", static_cast<unsigned long long>(snapshotSize));
+    printf("%30s | %20.3f |\n", "Build time (s)", buildTime);
+    printf("%30s | %20.3f |\n", "Serialize time (s)", serializeTime);
+    printf("------------------------------------------------------\n");
+}
+
+
+int Build(const CommandLineOptions& options)
+{
+    // The builder doesn't have concurrent readers, thus the memory can be released immediately.
+    L4::ImmediateEpochActionManager epochManager;
+
+    HashTable hashTable{
+        HashTable::Setting{
+            options.m_numBuckets,
+            options.m_numBucketsPerMutex,
+            options.m_fixedKeySize,
+            options.m_fixedValueSize },
+        Allocator() };
+
+    Builder builder{ hashTable, epochManager, options.m_duplicatePolicy, options.m_numThreads };
+
+    Timer buildTimer;
+
+    std::uint64_t inputSize = 0U;
+    for (const auto& input : options.m_inputs)
+    {
+        inputSize += AddFile(builder, input, options);
+    }
+
+    const auto buildTime = buildTimer.GetElapsedSeconds();
+
+    Timer serializeTimer;
+
+    std::ofstream stream(options.m_output, std::ios::binary);
+    if (!stream)
+    {
+        throw L4::RuntimeException("Failed to open the output file: " + options.m_output);
+    }
+
+    L4::Utils::Properties properties;
+    if (options.m_useImage)
+    {
+        properties.emplace(
+            L4::HashTable::ReadWrite::Image::c_formatPropertyName,
+            L4::HashTable::ReadWrite::Image::c_formatPropertyValue);
+    }
+
+    builder.GetHashTable().GetSerializer()->Serialize(stream, properties);
+    stream.flush();
+
+    const auto snapshotSize = static_cast<std::uint64_t>(stream.tellp());
+
+    PrintReport(builder.GetReport(), inputSize, snapshotSize, buildTime, serializeTimer.GetElapsedSeconds());
+
+    return 0;
+}
+
+
+bool Parse(int argc, char** argv, CommandLineOptions& options)
+{
+    namespace po = boost::program_options;
+
+    po::options_description general("General options");
+    general.add_options()
+        ("help", "produce a help message")
+        ("input", po::value<std::vector<std::string>>()->multitoken(), "input files")
+        ("output", po::value<std::string>(), "snapshot file to write")
+        ("format", po::value<std::string>()->default_value("tsv"),
+            "input format:\n"
+            "  tsv: <key>\\t<value>\\n per line\n"
+            "  binary: <uint32 key size><key><uint32 value size><value> per record")
+        ("duplicates", po::value<std::string>()->default_value("overwrite"),
+            "duplicate key policy:\n"
+            "  overwrite: the last record wins\n"
+            "  keep: the first record wins\n"
+            "  fail: stop building");
+
+    po::options_description builderOptions("Builder options");
+    builderOptions.add_options()
+        ("numBuckets", po::value<std::uint32_t>()->default_value(CommandLineOptions::c_defaultNumBuckets), "number of buckets")
+        ("numBucketsPerMutex", po::value<std::uint32_t>()->default_value(CommandLineOptions::c_defaultNumBucketsPerMutex), "number of buckets per mutex")
+        ("fixedKeySize", po::value<std::uint16_t>()->default_value(0U), "fixed key size in bytes (0 if not fixed)")
+        ("fixedValueSize", po::value<std::uint32_t>()->default_value(0U), "fixed value size in bytes (0 if not fixed)")
+        ("numThreads", po::value<std::uint16_t>()->default_value(CommandLineOptions::c_defaultNumThreads), "number of threads (0 for all cores)")
+        ("batchSize", po::value<std::uint32_t>()->default_value(CommandLineOptions::c_defaultBatchSizeInMB), "batch size in MB")
+        ("image", "write the snapshot in the memory image format");
+
+    po::options_description all("Allowed options");
+    all.add(general).add(builderOptions);
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, all), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || !vm.count("input") || !vm.count("output"))
+    {
+        std::cout << all;
+        return false;
+    }
+
+    options.m_inputs = vm["input"].as<std::vector<std::string>>();
+    options.m_output = vm["output"].as<std::string>();
+
+    const auto& format = vm["format"].as<std::string>();
+    if (format == "tsv")
+    {
+        options.m_format = Builder::Format::Tsv;
+    }
+    else if (format == "binary")
+    {
+        options.m_format = Builder::Format::Binary;
+    }
+    else
+    {
+        std::cout << "Unknown format: " << format << std::endl;
+        return false;
+    }
+
+    const auto& duplicates = vm["duplicates"].as<std::string>();
+    if (duplicates == "overwrite")
+    {
+        options.m_duplicatePolicy = Builder::DuplicatePolicy::Overwrite;
+    }
+    else if (duplicates == "keep")
+    {
+        options.m_duplicatePolicy = Builder::DuplicatePolicy::Keep;
+    }
+    else if (duplicates == "fail")
+    {
+        options.m_duplicatePolicy = Builder::DuplicatePolicy::Fail;
+    }
+    else
+    {
+        std::cout << "Unknown duplicate key policy: " << duplicates << std::endl;
+        return false;
+    }
+
+    options.m_numBuckets = vm["numBuckets"].as<std::uint32_t>();
+    options.m_numBucketsPerMutex = vm["numBucketsPerMutex"].as<std::uint32_t>();
+    options.m_fixedKeySize = vm["fixedKeySize"].as<std::uint16_t>();
+    options.m_fixedValueSize = vm["fixedValueSize"].as<std::uint32_t>();
+    options.m_numThreads = vm["numThreads"].as<std::uint16_t>();
+    options.m_batchSizeInMB = (std::max)(vm["batchSize"].as<std::uint32_t>(), 1U);
+    options.m_useImage = (vm.count("image") != 0U);
+
+    return true;
+}
+
+
+int main(int argc, char** argv)
+{
+    CommandLineOptions options;
+
+    if (!Parse(argc, argv, options))
+    {
+        return 1;
+    }
+
+    try
+    {
+        return Build(options);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to build: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,198 @@
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "Utils.h"
+#include "Mocks.h"
+#include "L4/HashTable/ReadWrite/Builder.h"
+#include "L4/LocalMemory/HashTableService.h"
+
+namespace L4
+{
+namespace UnitTests
+{
+
+using namespace HashTable::ReadWrite;
+
+class BuilderTestFixture
+{
+protected:
+    // Builder runs multiple threads, and CheckedAllocator is not thread-safe.
+    using Allocator = std::allocator<char>;
+    using TableBuilder = Builder<Allocator>;
+    using HashTable = TableBuilder::HashTable;
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    BuilderTestFixture()
+        : m_epochManager{}
+    {}
+
+    static void Add(TableBuilder& builder, const std::string& input, TableBuilder::Format format)
+    {
+        builder.Add(input.data(), input.size(), format);
+    }
+
+    static std::string GetBinaryRecord(const std::string& key, const std::string& value)
+    {
+        std::string record;
+
+        for (const auto* blob : { &key, &value })
+        {
+            const auto size = static_cast<std::uint32_t>(blob->size());
+            record.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            record.append(*blob);
+        }
+
+        return record;
+    }
+
+    static bool Get(IReadOnlyHashTable& hashTable, const std::string& key, std::string& value)
+    {
+        Value valueFound;
+        if (!hashTable.Get(Utils::ConvertFromString<Key>(key.c_str()), valueFound))
+        {
+            return false;
+        }
+
+        value = Utils::ConvertToString(valueFound);
+        return true;
+    }
+
+    MockEpochManager m_epochManager;
+};
+
+
+BOOST_FIXTURE_TEST_SUITE(BuilderTests, BuilderTestFixture)
+
+
+BOOST_AUTO_TEST_CASE(TsvTest)
+{
+    const std::uint32_t numRecords = 10000U;
+
+    std::string input;
+    for (std::uint32_t i = 0U; i < numRecords; ++i)
+    {
+        input += "key" + std::to_string(i) + "\tvalue" + std::to_string(i) + ((i % 2U == 0U) ? "\n" : "\r\n");
+    }
+
+    // Duplicates of the first 100 keys and an empty line.
+    input += "\n";
+    for (std::uint32_t i = 0U; i < 100U; ++i)
+    {
+        input += "key" + std::to_string(i) + "\tlast" + std::to_string(i) + "\n";
+    }
+
+    for (const auto policy : { TableBuilder::DuplicatePolicy::Overwrite, TableBuilder::DuplicatePolicy::Keep })
+    {
+        HashTable hashTable{ HashTable::Setting{ 1000U }, Allocator() };
+        TableBuilder builder{ hashTable, m_epochManager, policy, 4U };
+
+        Add(builder, input, TableBuilder::Format::Tsv);
+
+        const auto report = builder.GetReport();
+        BOOST_CHECK_EQUAL(report.m_numRecords, numRecords);
+        BOOST_CHECK_EQUAL(report.m_numDuplicates, 100U);
+        BOOST_CHECK_EQUAL(report.m_numBuckets, 1000U);
+        BOOST_CHECK(report.m_maxChainLength >= 1U);
+
+        std::string value;
+        for (std::uint32_t i = 0U; i < numRecords; ++i)
+        {
+            BOOST_REQUIRE(Get(builder.GetHashTable(), "key" + std::to_string(i), value));
+
+            const bool isOverwritten = (i < 100U) && (policy == TableBuilder::DuplicatePolicy::Overwrite);
+            BOOST_CHECK(value == (isOverwritten ? "last" : "value") + std::to_string(i));
+        }
+    }
+
+    HashTable hashTable{ HashTable::Setting{ 1000U }, Allocator() };
+    TableBuilder builder{ hashTable, m_epochManager, TableBuilder::DuplicatePolicy::Fail, 4U };
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        Add(builder, input, TableBuilder::Format::Tsv),
+        "The input has a duplicate key.");
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        Add(builder, "no tab\n", TableBuilder::Format::Tsv),
+        "The TSV input has a line without a tab.");
+}
+
+
+BOOST_AUTO_TEST_CASE(BinaryTest)
+{
+    const std::uint32_t numRecords = 10000U;
+
+    std::string input;
+    for (std::uint32_t i = 0U; i < numRecords; ++i)
+    {
+        // Keys and values can have any bytes in the binary format.
+        input += GetBinaryRecord("key\t" + std::to_string(i), "value\n" + std::to_string(i));
+    }
+
+    HashTable hashTable{ HashTable::Setting{ 1000U }, Allocator() };
+    TableBuilder builder{ hashTable, m_epochManager, TableBuilder::DuplicatePolicy::Fail, 3U };
+
+    // Add in two batches split by GetCompleteSize().
+    const auto firstBatchSize = TableBuilder::GetCompleteSize(input.data(), input.size() / 2U, TableBuilder::Format::Binary, false);
+    BOOST_CHECK(firstBatchSize > 0U && firstBatchSize <= input.size() / 2U);
+
+    builder.Add(input.data(), firstBatchSize, TableBuilder::Format::Binary);
+    builder.Add(input.data() + firstBatchSize, input.size() - firstBatchSize, TableBuilder::Format::Binary);
+
+    BOOST_CHECK_EQUAL(builder.GetReport().m_numRecords, numRecords);
+
+    std::string value;
+    for (std::uint32_t i = 0U; i < numRecords; ++i)
+    {
+        BOOST_REQUIRE(Get(builder.GetHashTable(), "key\t" + std::to_string(i), value));
+        BOOST_CHECK(value == "value\n" + std::to_string(i));
+    }
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        TableBuilder::GetCompleteSize(input.data(), input.size() - 1U, TableBuilder::Format::Binary, true),
+        "The input ends with an incomplete record.");
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        builder.Add(input.data(), input.size() - 1U, TableBuilder::Format::Binary),
+        "The input has an incomplete record.");
+
+    BOOST_CHECK_EQUAL(TableBuilder::GetCompleteSize("a\tb\nc\t", 6U, TableBuilder::Format::Tsv, false), 4U);
+    BOOST_CHECK_EQUAL(TableBuilder::GetCompleteSize("a\tb\nc\t", 6U, TableBuilder::Format::Tsv, true), 6U);
+}
+
+
+BOOST_AUTO_TEST_CASE(SnapshotTest)
+{
+    HashTable hashTable{ HashTable::Setting{ 100U }, Allocator() };
+    TableBuilder builder{ hashTable, m_epochManager };
+
+    Add(builder, "key1\tvalue1\nkey2\tvalue2\nkey3\t\n", TableBuilder::Format::Tsv);
+
+    auto stream = std::make_shared<std::stringstream>();
+    builder.GetHashTable().GetSerializer()->Serialize(*stream, {});
+
+    // The snapshot is loaded by HashTableService.
+    LocalMemory::HashTableService htService;
+    htService.AddHashTable(
+        HashTableConfig("Table1", HashTableConfig::Setting{ 0U }, {}, HashTableConfig::Serializer{ stream }));
+
+    auto context = htService.GetContext();
+
+    std::string value;
+    BOOST_REQUIRE(Get(context["Table1"], "key2", value));
+    BOOST_CHECK(value == "value2");
+    BOOST_REQUIRE(Get(context["Table1"], "key3", value));
+    BOOST_CHECK(value.empty());
+
+    Utils::ValidateCounters(
+        context["Table1"].GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, 3 }
+        });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace UnitTests
+} // namespace L4
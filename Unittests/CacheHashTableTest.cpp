@@ -1,11 +1,15 @@
 #include <boost/test/unit_test.hpp>
 #include <algorithm>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include "Utils.h"
 #include "Mocks.h"
 #include "CheckedAllocator.h"
 #include "L4/HashTable/Common/Record.h"
 #include "L4/HashTable/Cache/Metadata.h"
+#include "L4/HashTable/Cache/MetadataArray.h"
 #include "L4/HashTable/Cache/HashTable.h"
 
 namespace L4
@@ -146,10 +150,66 @@ BOOST_AUTO_TEST_CASE(MetadataTest)
 
         metadata.UpdateAccessStatus(false);
         BOOST_CHECK(!metadata.IsAccessed());
+
+        // Rewriting the epoch time also turns on the access status.
+        metadata.UpdateEpochTime(currentEpochTime + seconds{ 10U });
+        BOOST_CHECK(currentEpochTime + seconds{ 10U } == metadata.GetEpochTime());
+        BOOST_CHECK(metadata.IsAccessed());
+        BOOST_CHECK(!metadata.IsExpired(currentEpochTime, seconds{ 0U }));
     }
 }
 
 
+BOOST_AUTO_TEST_CASE(MetadataArrayTest)
+{
+    using Allocator = CheckedAllocator<>;
+
+    HashTablePerfData perfData;
+    auto metadataArray = std::make_unique<MetadataArray<Allocator>>(2U, Allocator{}, perfData);
+
+    // The epoch times of each bucket are in a cache line, and the memory is accounted as index.
+    Utils::ValidateCounters(
+        perfData,
+        {
+            { HashTablePerfCounter::TotalIndexSize, MetadataArray<Allocator>::CalculateBufferSize(2U) }
+        });
+
+    metadataArray->Set(1U, 0U, seconds{ 100U });
+    metadataArray->Set(1U, 3U, seconds{ 110U });
+    metadataArray->Set(1U, 15U, seconds{ 0U });
+
+    // The slots of the bucket are compared at once.
+    auto slots = metadataArray->GetOccupiedAndExpired(1U, seconds{ 115U }, seconds{ 10U });
+    BOOST_CHECK_EQUAL(slots.first, 0x8009);
+    BOOST_CHECK_EQUAL(slots.second, 0x8001);
+
+    slots = metadataArray->GetOccupiedAndExpired(0U, seconds{ 115U }, seconds{ 10U });
+    BOOST_CHECK_EQUAL(slots.first, 0U);
+    BOOST_CHECK_EQUAL(slots.second, 0U);
+
+    // The access bits are turned off when they are returned.
+    metadataArray->SetAccessed(1U, 3U);
+    metadataArray->SetAccessed(1U, 3U);
+    metadataArray->SetAccessed(1U, 15U);
+    BOOST_CHECK_EQUAL(metadataArray->ResetAccessBits(1U), 0x8008);
+    BOOST_CHECK_EQUAL(metadataArray->ResetAccessBits(1U), 0U);
+
+    metadataArray->UpdateEpochTime(1U, 0U, seconds{ 110U });
+
+    // Clearing a slot also turns off its access bit.
+    metadataArray->SetAccessed(1U, 15U);
+    metadataArray->Clear(1U, 15U);
+
+    slots = metadataArray->GetOccupiedAndExpired(1U, seconds{ 115U }, seconds{ 10U });
+    BOOST_CHECK_EQUAL(slots.first, 0x0009);
+    BOOST_CHECK_EQUAL(slots.second, 0U);
+    BOOST_CHECK_EQUAL(metadataArray->ResetAccessBits(1U), 0U);
+
+    metadataArray.reset();
+    Utils::ValidateCounters(perfData, { { HashTablePerfCounter::TotalIndexSize, 0 } });
+}
+
+
 BOOST_FIXTURE_TEST_CASE(ExpirationTest, CacheHashTableTestFixture)
 {
     // Don't care about evict in this test case, so make the cache size big.
@@ -239,6 +299,76 @@ BOOST_FIXTURE_TEST_CASE(ExpirationTest, CacheHashTableTestFixture)
 }
 
 
+BOOST_FIXTURE_TEST_CASE(TouchTest, CacheHashTableTestFixture)
+{
+    constexpr std::uint64_t c_maxCacheSizeInBytes = 0xFFFFFFFF;
+    constexpr seconds c_recordTimeToLive{ 20U };
+
+    CacheHashTable hashTable(
+        m_hashTable,
+        m_epochManager,
+        c_maxCacheSizeInBytes,
+        c_recordTimeToLive,
+        false);
+
+    MockClock::SetEpochTime(seconds{ 100U });
+
+    for (const auto& key : { "key1", "key2", "key3", "key4" })
+    {
+        Add(hashTable, key, "value");
+    }
+
+    const auto totalIndexSize = hashTable.GetPerfData().Get(HashTablePerfCounter::TotalIndexSize);
+
+    // Sliding expiration: touching at 115 extends the expiration of key1 to 135.
+    MockClock::IncrementEpochTime(seconds{ 15U });
+    BOOST_CHECK(hashTable.Touch(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1")));
+
+    // key2 expires in 100 seconds, and key3 in 5 seconds (shorter than the table's time-to-live).
+    BOOST_CHECK(hashTable.Touch(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key2"), seconds{ 100U }));
+    BOOST_CHECK(hashTable.Touch(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key3"), seconds{ 5U }));
+
+    BOOST_CHECK(!hashTable.Touch(Utils::ConvertFromString<IReadOnlyHashTable::Key>("non-existent")));
+
+    // Touch is done in place without replacing the records.
+    Utils::ValidateCounters(
+        hashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, 4 },
+            { HashTablePerfCounter::TotalIndexSize, totalIndexSize }
+        });
+
+    // At 125, key3 and key4 are expired.
+    MockClock::IncrementEpochTime(seconds{ 10U });
+    BOOST_CHECK(CheckRecord(hashTable, "key1", "value"));
+    BOOST_CHECK(CheckRecord(hashTable, "key2", "value"));
+    BOOST_CHECK(!CheckRecord(hashTable, "key3", "value"));
+    BOOST_CHECK(!CheckRecord(hashTable, "key4", "value"));
+
+    // An expired record cannot be touched.
+    const ICacheHashTable::Keys keys =
+    {
+        Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1"),
+        Utils::ConvertFromString<IReadOnlyHashTable::Key>("key3"),
+        Utils::ConvertFromString<IReadOnlyHashTable::Key>("key4")
+    };
+    BOOST_CHECK_EQUAL(hashTable.TouchMany(keys), 1U);
+
+    // At 150, only key1 (touched at 125) and key2 are alive.
+    MockClock::IncrementEpochTime(seconds{ 25U });
+    BOOST_CHECK(!CheckRecord(hashTable, "key1", "value"));
+    BOOST_CHECK(CheckRecord(hashTable, "key2", "value"));
+
+    MockClock::SetEpochTime(seconds{ 145U });
+    BOOST_CHECK(CheckRecord(hashTable, "key1", "value"));
+    BOOST_CHECK_EQUAL(hashTable.TouchMany(keys, seconds{ 1000U }), 1U);
+
+    MockClock::IncrementEpochTime(seconds{ 1000U });
+    BOOST_CHECK(CheckRecord(hashTable, "key1", "value"));
+    BOOST_CHECK(!CheckRecord(hashTable, "key2", "value"));
+}
+
+
 BOOST_FIXTURE_TEST_CASE(CacheHashTableIteratorTest, CacheHashTableTestFixture)
 {
     // Don't care about evict in this test case, so make the cache size big.
@@ -608,6 +738,376 @@ BOOST_FIXTURE_TEST_CASE(FixedKeyValueHashTableTest, CacheHashTableTestFixture)
     }
 }
 
+
+BOOST_FIXTURE_TEST_CASE(ConditionalWriteTest, CacheHashTableTestFixture)
+{
+    constexpr std::uint64_t c_maxCacheSizeInBytes = 0xFFFFFFFF;
+    constexpr seconds c_recordTimeToLive{ 20U };
+
+    CacheHashTable hashTable(
+        m_hashTable,
+        m_epochManager,
+        c_maxCacheSizeInBytes,
+        c_recordTimeToLive,
+        false);
+
+    const auto key1 = Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1");
+    const auto key2 = Utils::ConvertFromString<IReadOnlyHashTable::Key>("key2");
+    const auto value = Utils::ConvertFromString<IReadOnlyHashTable::Value>("value");
+    const auto newValue = Utils::ConvertFromString<IReadOnlyHashTable::Value>("newValue");
+
+    MockClock::SetEpochTime(seconds{ 100U });
+
+    BOOST_CHECK(hashTable.AddIfAbsent(key1, value));
+    BOOST_CHECK(!hashTable.AddIfAbsent(key1, newValue));
+    BOOST_CHECK(!hashTable.ReplaceIfPresent(key2, value));
+    BOOST_CHECK(CheckRecord(hashTable, "key1", "value"));
+    BOOST_CHECK(!CheckRecord(hashTable, "key2", "value"));
+
+    // The expected value is compared without the metadata.
+    BOOST_CHECK(!hashTable.ReplaceIfEqual(key1, newValue, value));
+    BOOST_CHECK(hashTable.ReplaceIfEqual(key1, value, newValue));
+    BOOST_CHECK(CheckRecord(hashTable, "key1", "newValue"));
+
+    BOOST_CHECK(hashTable.ReplaceIfPresent(key1, value));
+    BOOST_CHECK(CheckRecord(hashTable, "key1", "value"));
+
+    // An expired record is treated as absent.
+    MockClock::IncrementEpochTime(seconds{ 30U });
+    BOOST_CHECK(!hashTable.ReplaceIfPresent(key1, newValue));
+    BOOST_CHECK(!hashTable.ReplaceIfEqual(key1, value, newValue));
+    BOOST_CHECK(hashTable.AddIfAbsent(key1, newValue));
+    BOOST_CHECK(CheckRecord(hashTable, "key1", "newValue"));
+
+    Utils::ValidateCounters(
+        hashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, 1 }
+        });
+}
+
+
+BOOST_FIXTURE_TEST_CASE(RemoveIfTest, CacheHashTableTestFixture)
+{
+    constexpr std::uint64_t c_maxCacheSizeInBytes = 0xFFFFFFFF;
+    constexpr seconds c_recordTimeToLive{ 20U };
+
+    CacheHashTable hashTable(
+        m_hashTable,
+        m_epochManager,
+        c_maxCacheSizeInBytes,
+        c_recordTimeToLive,
+        false);
+
+    MockClock::SetEpochTime(seconds{ 100U });
+    Add(hashTable, "key1", "remove");
+    Add(hashTable, "key2", "keep");
+
+    MockClock::IncrementEpochTime(seconds{ 15U });
+    Add(hashTable, "key3", "keep");
+
+    // key1 and key2 are expired at 125, thus removed without calling the predicate.
+    MockClock::IncrementEpochTime(seconds{ 10U });
+
+    // The predicate sees the value without the metadata (one thread, so no synchronization).
+    std::vector<std::string> values;
+    const auto numRemoved = hashTable.RemoveIf(
+        IWritableHashTable::RemovePolicy{
+            [&values](const IReadOnlyHashTable::Key&, const IReadOnlyHashTable::Value& value)
+            {
+                values.emplace_back(Utils::ConvertToString(value));
+                return values.back() == "remove";
+            },
+            1U });
+
+    BOOST_CHECK_EQUAL(numRemoved, 2U);
+    BOOST_CHECK(values == std::vector<std::string>{ "keep" });
+    BOOST_CHECK(CheckRecord(hashTable, "key3", "keep"));
+
+    Utils::ValidateCounters(
+        hashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, 1 }
+        });
+}
+
+
+BOOST_FIXTURE_TEST_CASE(WriteBackTest, CacheHashTableTestFixture)
+{
+    using WriteBackPolicy = ICacheHashTable::WriteBackPolicy;
+
+    // A fake backing store that the dirty records are flushed to.
+    std::mutex backendMutex;
+    std::map<std::string, std::string> backend;
+    std::vector<std::size_t> batchSizes;
+    bool isBackendDown = false;
+
+    const auto flusher = [&](const WriteBackPolicy::Records& records)
+    {
+        std::lock_guard<std::mutex> lock{ backendMutex };
+
+        if (isBackendDown)
+        {
+            throw RuntimeException("Backend is down.");
+        }
+
+        batchSizes.push_back(records.size());
+
+        for (const auto& record : records)
+        {
+            backend[Utils::ConvertToString(record.first)] = Utils::ConvertToString(record.second);
+        }
+    };
+
+    {
+        CacheHashTable hashTable(
+            m_hashTable,
+            m_epochManager,
+            0xFFFFFFFF,
+            seconds{ 100U },
+            false,
+            WriteBackPolicy{ flusher, milliseconds{ 0U }, 2U });
+
+        Add(hashTable, "key1", "v1");
+        Add(hashTable, "key1", "v2");
+        Add(hashTable, "key2", "v1");
+        Add(hashTable, "key3", "v1");
+
+        BOOST_CHECK(CheckRecord(hashTable, "key1", "v2"));
+
+        // Each record holds a 4-byte key, a 2-byte value and the 8-byte metadata.
+        Utils::ValidateCounters(
+            hashTable.GetPerfData(),
+            {
+                { HashTablePerfCounter::RecordsCount, 3 },
+                { HashTablePerfCounter::DirtyBytes, 42 }
+            });
+
+        // The writes to "key1" are coalesced.
+        MockClock::IncrementEpochTime(seconds{ 5U });
+        BOOST_CHECK_EQUAL(hashTable.Flush(), 3U);
+        BOOST_CHECK((backend == std::map<std::string, std::string>{ { "key1", "v2" }, { "key2", "v1" }, { "key3", "v1" } }));
+        BOOST_CHECK(std::all_of(batchSizes.cbegin(), batchSizes.cend(), [](std::size_t size) { return size <= 2U; }));
+
+        Utils::ValidateCounters(
+            hashTable.GetPerfData(),
+            {
+                { HashTablePerfCounter::RecordsCount, 3 },
+                { HashTablePerfCounter::DirtyBytes, 0 },
+                { HashTablePerfCounter::FlushedRecordsCount, 3 },
+                { HashTablePerfCounter::FlushLagInSeconds, 5 }
+            });
+
+        BOOST_CHECK_EQUAL(hashTable.Flush(), 0U);
+        BOOST_CHECK(CheckRecord(hashTable, "key2", "v1"));
+
+        // A dirty record removed is not flushed.
+        Add(hashTable, "key2", "v2");
+        BOOST_CHECK_EQUAL(hashTable.GetPerfData().Get(HashTablePerfCounter::DirtyBytes), 14);
+        Remove(hashTable, "key2");
+        BOOST_CHECK_EQUAL(hashTable.GetPerfData().Get(HashTablePerfCounter::DirtyBytes), 0);
+        BOOST_CHECK_EQUAL(hashTable.Flush(), 0U);
+        BOOST_CHECK_EQUAL(backend["key2"], "v1");
+    }
+
+    {
+        // The cache is too small to hold more than one record.
+        HashTable internalHashTable{ HashTable::Setting{ 1 }, m_allocator };
+        CacheHashTable hashTable(
+            internalHashTable,
+            m_epochManager,
+            1U,
+            seconds{ 100U },
+            false,
+            WriteBackPolicy{ flusher, milliseconds{ 0U } });
+
+        backend.clear();
+
+        Add(hashTable, "key4", "v1");
+        Add(hashTable, "key5", "v1");
+
+        // The dirty record evicted is handed to the flusher instead of being dropped.
+        BOOST_CHECK((backend == std::map<std::string, std::string>{ { "key4", "v1" } }));
+
+        Utils::ValidateCounters(
+            hashTable.GetPerfData(),
+            {
+                { HashTablePerfCounter::RecordsCount, 1 },
+                { HashTablePerfCounter::EvictedRecordsCount, 1 },
+                { HashTablePerfCounter::FlushedRecordsCount, 1 },
+                { HashTablePerfCounter::DirtyBytes, 14 }
+            });
+
+        // The dirty record to evict stays in the hash table and dirty if the flusher fails.
+        isBackendDown = true;
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(Add(hashTable, "key6", "v1"), "Backend is down.");
+        isBackendDown = false;
+
+        BOOST_CHECK(CheckRecord(hashTable, "key5", "v1"));
+
+        Utils::ValidateCounters(
+            hashTable.GetPerfData(),
+            {
+                { HashTablePerfCounter::RecordsCount, 1 },
+                { HashTablePerfCounter::EvictedRecordsCount, 1 },
+                { HashTablePerfCounter::FlushedRecordsCount, 1 },
+                { HashTablePerfCounter::DirtyBytes, 14 }
+            });
+    }
+
+    // The dirty records are flushed when the hash table is destroyed.
+    BOOST_CHECK((backend == std::map<std::string, std::string>{ { "key4", "v1" }, { "key5", "v1" } }));
+
+    {
+        HashTable internalHashTable{ HashTable::Setting{ 10 }, m_allocator };
+        CacheHashTable hashTable(
+            internalHashTable,
+            m_epochManager,
+            0xFFFFFFFF,
+            seconds{ 100U },
+            false,
+            WriteBackPolicy{ flusher, milliseconds{ 10U } });
+
+        backend.clear();
+
+        Add(hashTable, "key6", "v1");
+
+        // The dirty record is flushed by the flushing thread.
+        bool isFlushed = false;
+        for (std::uint32_t i = 0U; i < 500U && !isFlushed; ++i)
+        {
+            std::this_thread::sleep_for(milliseconds{ 10 });
+
+            std::lock_guard<std::mutex> lock{ backendMutex };
+            isFlushed = (backend.count("key6") == 1U);
+        }
+
+        BOOST_CHECK(isFlushed);
+    }
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        CacheHashTable(
+            m_hashTable,
+            m_epochManager,
+            0xFFFFFFFF,
+            seconds{ 100U },
+            false,
+            WriteBackPolicy{ {} }),
+        "Flusher of the write-back cache is not set.");
+}
+
+
+BOOST_FIXTURE_TEST_CASE(SampleTest, CacheHashTableTestFixture)
+{
+    // One bucket so that the random probes don't keep hitting empty slots.
+    HashTable internalHashTable{ HashTable::Setting{ 1 }, m_allocator };
+    CacheHashTable hashTable(
+        internalHashTable,
+        m_epochManager,
+        0xFFFFFFFF,
+        seconds{ 20U },
+        false);
+
+    Add(hashTable, "key1", "value1");
+    Add(hashTable, "key2", "value2");
+
+    MockClock::IncrementEpochTime(seconds{ 15U });
+    Add(hashTable, "key3", "value3");
+
+    // key1 and key2 are expired.
+    MockClock::IncrementEpochTime(seconds{ 10U });
+
+    std::vector<std::string> values;
+    BOOST_CHECK_EQUAL(
+        hashTable.Sample(
+            10U,
+            [&values](const IReadOnlyHashTable::Key&, const IReadOnlyHashTable::Value& value)
+            {
+                values.emplace_back(Utils::ConvertToString(value));
+            }),
+        10U);
+
+    BOOST_CHECK(values == std::vector<std::string>(10U, "value3"));
+}
+
+
+BOOST_FIXTURE_TEST_CASE(MetadataArrayEvictionTest, CacheHashTableTestFixture)
+{
+    constexpr std::uint64_t c_maxCacheSizeInBytes = 0xFFFFFFFF;
+    constexpr seconds c_recordTimeToLive{ 10U };
+
+    // All the records are in the bucket entry of the only bucket.
+    HashTable internalHashTable{ HashTable::Setting{ 1 }, m_allocator };
+
+    // The records added before the metadata array is created are tracked as well.
+    {
+        CacheHashTable hashTable(
+            internalHashTable,
+            m_epochManager,
+            c_maxCacheSizeInBytes,
+            c_recordTimeToLive,
+            false);
+
+        Add(hashTable, "key1", "value1");
+    }
+
+    CacheHashTable hashTable(
+        internalHashTable,
+        m_epochManager,
+        c_maxCacheSizeInBytes,
+        c_recordTimeToLive,
+        true,
+        {},
+        true);
+
+    for (const auto& key : { "key2", "key3", "key4" })
+    {
+        Add(hashTable, key, "value");
+    }
+
+    // A read turns on the access bit in the metadata array instead of the one in the record.
+    IReadOnlyHashTable::Value value;
+    BOOST_CHECK(Get(hashTable, "key2", value));
+    BOOST_CHECK(!Metadata{
+        const_cast<std::uint32_t*>(
+            reinterpret_cast<const std::uint32_t*>(value.m_data - Metadata::c_metaDataSize)) }.IsAccessed());
+
+    // Touching key3 at 8 extends its expiration to 18.
+    MockClock::SetEpochTime(seconds{ 8U });
+    BOOST_CHECK(hashTable.Touch(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key3")));
+
+    // At 15, the time-based eviction evicts the expired records including the accessed key2.
+    MockClock::SetEpochTime(seconds{ 15U });
+    Add(hashTable, "key5", "value");
+
+    const auto& perfData = hashTable.GetPerfData();
+    Utils::ValidateCounters(
+        perfData,
+        {
+            { HashTablePerfCounter::RecordsCount, 2 },
+            { HashTablePerfCounter::EvictedRecordsCount, 3 },
+        });
+
+    BOOST_CHECK(CheckRecord(hashTable, "key3", "value"));
+
+    // Freeing a byte evicts key5, which is not accessed, while key3 gets the second chance.
+    hashTable.SetMaxCacheSizeInBytes(
+        perfData.Get(HashTablePerfCounter::TotalKeySize)
+        + perfData.Get(HashTablePerfCounter::TotalValueSize)
+        + perfData.Get(HashTablePerfCounter::TotalIndexSize)
+        - 1U);
+
+    Utils::ValidateCounters(
+        perfData,
+        {
+            { HashTablePerfCounter::RecordsCount, 1 },
+            { HashTablePerfCounter::EvictedRecordsCount, 4 },
+        });
+
+    BOOST_CHECK(CheckRecord(hashTable, "key3", "value"));
+    BOOST_CHECK(!CheckRecord(hashTable, "key5", "value"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace UnitTests
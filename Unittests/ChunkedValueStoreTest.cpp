@@ -0,0 +1,223 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include "Utils.h"
+#include "Mocks.h"
+#include "CheckedAllocator.h"
+#include "L4/HashTable/Common/ChunkedValueStore.h"
+#include "L4/HashTable/ReadWrite/HashTable.h"
+
+namespace L4
+{
+namespace UnitTests
+{
+
+using namespace HashTable;
+using namespace HashTable::ReadWrite;
+
+class ChunkedValueStoreTestFixture
+{
+protected:
+    using Allocator = CheckedAllocator<>;
+    using HashTable = WritableHashTable<Allocator>::HashTable;
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    ChunkedValueStoreTestFixture()
+        : m_allocator{}
+        , m_epochManager{}
+        , m_hashTable{ HashTable::Setting{ 100U }, m_allocator }
+        , m_writableHashTable{ m_hashTable, m_epochManager }
+        , m_store{ m_writableHashTable }
+    {}
+
+    static std::vector<std::uint8_t> CreateValue(std::size_t size, std::uint8_t seed)
+    {
+        std::vector<std::uint8_t> value(size);
+        for (std::size_t i = 0U; i < size; ++i)
+        {
+            value[i] = static_cast<std::uint8_t>((i * 31U) + seed);
+        }
+
+        return value;
+    }
+
+    std::vector<std::uint8_t> GetRange(const std::string& key, std::uint64_t offset, std::uint64_t length)
+    {
+        std::vector<std::uint8_t> range;
+        BOOST_CHECK(m_store.GetRange(Utils::ConvertFromString<Key>(key.c_str()), offset, length, range));
+        return range;
+    }
+
+    Allocator m_allocator;
+    MockEpochManager m_epochManager;
+    HashTable m_hashTable;
+    WritableHashTable<Allocator> m_writableHashTable;
+    ChunkedValueStore m_store;
+};
+
+
+BOOST_FIXTURE_TEST_SUITE(ChunkedValueStoreTests, ChunkedValueStoreTestFixture)
+
+
+BOOST_AUTO_TEST_CASE(StreamingAddAndGetRangeTest)
+{
+    const std::uint32_t c_chunkSize = 1000U;
+    const auto value = CreateValue(10500U, 1U);
+    const auto key = Utils::ConvertFromString<Key>("key");
+
+    {
+        auto writer = m_store.CreateWriter(key, c_chunkSize);
+
+        // Append in pieces that do not align with the chunk size.
+        for (std::size_t offset = 0U; offset < value.size(); offset += 777U)
+        {
+            const auto size = (std::min)(static_cast<std::size_t>(777U), value.size() - offset);
+            writer.Append(Value{ value.data() + offset, static_cast<Value::size_type>(size) });
+        }
+
+        // Not visible until committed.
+        std::uint64_t size = 0U;
+        BOOST_CHECK(!m_store.GetSize(key, size));
+
+        writer.Commit();
+    }
+
+    std::uint64_t size = 0U;
+    BOOST_CHECK(m_store.GetSize(key, size));
+    BOOST_CHECK_EQUAL(size, value.size());
+
+    // 11 chunks and the manifest.
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 12);
+
+    // No record is larger than the chunk size and the tag.
+    BOOST_CHECK(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::MaxValueSize) <= c_chunkSize + 1U);
+
+    const auto check = [this, &value](std::uint64_t offset, std::uint64_t length)
+    {
+        const auto end = (std::min)(static_cast<std::uint64_t>(value.size()), offset + length);
+        const auto range = GetRange("key", offset, length);
+        BOOST_CHECK(range == std::vector<std::uint8_t>(value.begin() + offset, value.begin() + end));
+    };
+
+    check(0U, 64U);
+    check(990U, 20U);
+    check(1000U, 1000U);
+    check(2500U, 5000U);
+    check(10400U, 1000U);
+    check(0U, value.size());
+
+    BOOST_CHECK(GetRange("key", value.size(), 10U).empty());
+
+    // The range spanning 3 chunks is visited in 3 pieces.
+    std::vector<std::uint32_t> pieceSizes;
+    BOOST_CHECK(m_store.GetRange(key, 500U, 2000U,
+        [&pieceSizes](const Value& piece)
+    {
+        pieceSizes.push_back(piece.m_size);
+    }));
+    BOOST_CHECK((pieceSizes == std::vector<std::uint32_t>{ 500U, 1000U, 500U }));
+
+    std::vector<std::uint8_t> range;
+    BOOST_CHECK(!m_store.GetRange(Utils::ConvertFromString<Key>("non-existent"), 0U, 10U, range));
+}
+
+
+BOOST_AUTO_TEST_CASE(ReplaceAndRemoveTest)
+{
+    const auto key = Utils::ConvertFromString<Key>("key");
+
+    const auto value1 = CreateValue(5000U, 1U);
+    m_store.Add(key, Value{ value1.data(), static_cast<Value::size_type>(value1.size()) }, 1000U);
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 6);
+
+    // Replacing the value removes the chunks of the previous value.
+    const auto value2 = CreateValue(2500U, 2U);
+    m_store.Add(key, Value{ value2.data(), static_cast<Value::size_type>(value2.size()) }, 1000U);
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 4);
+    BOOST_CHECK(GetRange("key", 0U, 10000U) == value2);
+
+    // An uncommitted writer removes the chunks it wrote.
+    {
+        auto writer = m_store.CreateWriter(key, 1000U);
+        writer.Append(Value{ value1.data(), static_cast<Value::size_type>(value1.size()) });
+    }
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 4);
+    BOOST_CHECK(GetRange("key", 0U, 10000U) == value2);
+
+    BOOST_CHECK(m_store.Remove(key));
+    BOOST_CHECK(!m_store.Remove(key));
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(InlineValueTest)
+{
+    const auto key = Utils::ConvertFromString<Key>("key");
+
+    // A value smaller than a chunk is stored inline in one record.
+    m_store.Add(key, Utils::ConvertFromString<Value>("0123456789"), 100U);
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 1);
+
+    std::uint64_t size = 0U;
+    BOOST_CHECK(m_store.GetSize(key, size));
+    BOOST_CHECK_EQUAL(size, 10U);
+
+    const auto range = GetRange("key", 3U, 4U);
+    BOOST_CHECK(std::string(range.begin(), range.end()) == "3456");
+    BOOST_CHECK(GetRange("key", 10U, 4U).empty());
+
+    // Replacing a chunked value with an inline value removes the chunks, and vice versa.
+    const auto value = CreateValue(250U, 1U);
+    m_store.Add(key, Value{ value.data(), static_cast<Value::size_type>(value.size()) }, 100U);
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 4);
+    BOOST_CHECK(GetRange("key", 0U, 1000U) == value);
+
+    m_store.Add(key, Value{}, 100U);
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 1);
+    BOOST_CHECK(m_store.GetSize(key, size));
+    BOOST_CHECK_EQUAL(size, 0U);
+
+    BOOST_CHECK(m_store.Remove(key));
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(ForeignValueTest)
+{
+    const auto key = Utils::ConvertFromString<Key>("key");
+
+    // A value that is not written by the store is rejected even if it looks like a manifest.
+    struct
+    {
+        std::uint32_t m_magic = 0x5643344CU;
+        std::uint32_t m_chunkSize = 1U;
+        std::uint64_t m_size = 1U;
+        std::uint64_t m_generation = 1U;
+    } manifest;
+
+    for (const auto& value : {
+        Utils::ConvertFromString<Value>("0123456789"),
+        Value{ reinterpret_cast<const std::uint8_t*>(&manifest), sizeof(manifest) } })
+    {
+        m_writableHashTable.Add(key, value);
+
+        std::uint64_t size = 0U;
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+            m_store.GetSize(key, size),
+            "The value is not written by ChunkedValueStore.");
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+            m_store.Remove(key),
+            "The value is not written by ChunkedValueStore.");
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+            m_store.Add(key, Utils::ConvertFromString<Value>("value")),
+            "The value is not written by ChunkedValueStore.");
+    }
+
+    BOOST_CHECK_EQUAL(m_writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace UnitTests
+} // namespace L4
@@ -0,0 +1,192 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include "Utils.h"
+#include "Mocks.h"
+#include "CheckedAllocator.h"
+#include "L4/HashTable/ReadWrite/ColumnHashTable.h"
+#include "L4/LocalMemory/HashTableService.h"
+
+namespace L4
+{
+namespace UnitTests
+{
+
+using namespace HashTable::ReadWrite;
+
+class ColumnHashTableTestFixture
+{
+protected:
+    using Allocator = CheckedAllocator<>;
+    using HashTable = ColumnWritableHashTable<Allocator>::HashTable;
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+    using ColumnMask = IColumnHashTable::ColumnMask;
+
+    ColumnHashTableTestFixture()
+        : m_allocator{}
+        , m_epochManager{}
+    {}
+
+    // Returns the selected columns joined by ",".
+    static std::string GetColumns(const IColumnHashTable& hashTable, const std::string& key, ColumnMask columnMask)
+    {
+        IColumnHashTable::Values values;
+        if (!hashTable.GetColumns(Utils::ConvertFromString<Key>(key.c_str()), columnMask, values))
+        {
+            return "<none>";
+        }
+
+        std::string result;
+        for (std::size_t i = 0U; i < values.size(); ++i)
+        {
+            result += ((i == 0U) ? "" : ",") + Utils::ConvertToString(values[i]);
+        }
+
+        return result;
+    }
+
+    static void UpdateColumn(IColumnHashTable& hashTable, const std::string& key, const char* columnName, const std::string& value)
+    {
+        hashTable.UpdateColumn(
+            Utils::ConvertFromString<Key>(key.c_str()),
+            hashTable.GetColumnIndex(columnName),
+            Utils::ConvertFromString<Value>(value.c_str()));
+    }
+
+    Allocator m_allocator;
+    MockEpochManager m_epochManager;
+};
+
+
+BOOST_FIXTURE_TEST_SUITE(ColumnHashTableTests, ColumnHashTableTestFixture)
+
+
+BOOST_AUTO_TEST_CASE(SchemaTest)
+{
+    L4::HashTable::ColumnSchema schema{ { "a", "b", "c" } };
+
+    BOOST_CHECK_EQUAL(schema.GetNumColumns(), 3U);
+    BOOST_CHECK_EQUAL(schema.GetColumnIndex("c"), 2U);
+
+    std::vector<std::uint8_t> buffer;
+    schema.Encode({ Utils::ConvertFromString<Value>("x"), Value{}, Utils::ConvertFromString<Value>("zz") }, buffer);
+
+    const Value value{ buffer.data(), static_cast<Value::size_type>(buffer.size()) };
+    BOOST_CHECK_EQUAL(value.m_size, schema.GetHeaderSize() + 3U);
+    BOOST_CHECK(schema.IsValid(value));
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(schema.GetColumn(value, 0U)), "x");
+    BOOST_CHECK_EQUAL(schema.GetColumn(value, 1U).m_size, 0U);
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(schema.GetColumn(value, 2U)), "zz");
+
+    std::vector<std::uint8_t> updatedBuffer;
+    schema.Encode(value, 1U, Utils::ConvertFromString<Value>("yyy"), updatedBuffer);
+
+    const Value updatedValue{ updatedBuffer.data(), static_cast<Value::size_type>(updatedBuffer.size()) };
+    BOOST_CHECK(schema.IsValid(updatedValue));
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(schema.GetColumn(updatedValue, 0U)), "x");
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(schema.GetColumn(updatedValue, 1U)), "yyy");
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(schema.GetColumn(updatedValue, 2U)), "zz");
+
+    BOOST_CHECK(!schema.IsValid(Utils::ConvertFromString<Value>("not encoded")));
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(schema.GetColumnIndex("d"), "Column does not exist.");
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        L4::HashTable::ColumnSchema({ "a", "a" }),
+        "Column names should be unique.");
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        L4::HashTable::ColumnSchema({}),
+        "The number of columns should be between 1 and 64.");
+}
+
+
+BOOST_AUTO_TEST_CASE(GetAndUpdateColumnsTest)
+{
+    HashTable hashTable{ HashTable::Setting{ 100U }, m_allocator };
+    ColumnWritableHashTable<Allocator> columnHashTable(
+        hashTable,
+        m_epochManager,
+        L4::HashTable::ColumnSchema{ { "name", "age", "city" } });
+
+    columnHashTable.AddColumns(
+        Utils::ConvertFromString<Key>("id1"),
+        { Utils::ConvertFromString<Value>("alice"), Utils::ConvertFromString<Value>("30") });
+
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id1", 0x7U), "alice,30,");
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id1", 0x5U), "alice,");
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id1", 0x0U), "");
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id2", 0x7U), "<none>");
+
+    // The other columns are kept.
+    UpdateColumn(columnHashTable, "id1", "city", "seattle");
+    UpdateColumn(columnHashTable, "id1", "age", "31");
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id1", 0x7U), "alice,31,seattle");
+
+    // A record is added with only the given column.
+    UpdateColumn(columnHashTable, "id2", "age", "40");
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id2", 0x7U), ",40,");
+
+    Utils::ValidateCounters(
+        columnHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, 2 }
+        });
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        columnHashTable.Add(Utils::ConvertFromString<Key>("id3"), Utils::ConvertFromString<Value>("value")),
+        "The value is not encoded with the column schema.");
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        columnHashTable.UpdateColumn(Utils::ConvertFromString<Key>("id1"), 3U, Value{}),
+        "Column does not exist.");
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        columnHashTable.AddColumns(Utils::ConvertFromString<Key>("id1"), IColumnHashTable::Values(4U)),
+        "The number of values exceeds the number of columns.");
+
+    // The updated record is admitted against the memory budget by its encoded size.
+    auto budget = std::make_shared<L4::HashTable::MemoryBudget>(
+        columnHashTable.GetPerfData().Get(HashTablePerfCounter::TotalKeySize)
+        + columnHashTable.GetPerfData().Get(HashTablePerfCounter::TotalValueSize)
+        + columnHashTable.GetPerfData().Get(HashTablePerfCounter::TotalIndexSize)
+        + 3U + columnHashTable.GetSchema().GetHeaderSize() + 1U);
+    columnHashTable.SetMemoryBudget(budget);
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        UpdateColumn(columnHashTable, "id3", "age", "50"),
+        "Memory budget of the hash table is exceeded.");
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id3", 0x7U), "<none>");
+
+    UpdateColumn(columnHashTable, "id3", "age", "5");
+    BOOST_CHECK_EQUAL(GetColumns(columnHashTable, "id3", 0x7U), ",5,");
+}
+
+
+BOOST_AUTO_TEST_CASE(HashTableServiceTest)
+{
+    LocalMemory::HashTableService htService;
+    htService.AddHashTable(
+        HashTableConfig("Table1", HashTableConfig::Setting{ 100U }).SetColumns({ "c1", "c2" }));
+
+    {
+        auto context = htService.GetContext();
+
+        auto* columnHashTable = dynamic_cast<IColumnHashTable*>(&context["Table1"]);
+        BOOST_REQUIRE(columnHashTable != nullptr);
+
+        UpdateColumn(*columnHashTable, "key1", "c2", "value2");
+        UpdateColumn(*columnHashTable, "key1", "c1", "value1");
+        BOOST_CHECK_EQUAL(GetColumns(*columnHashTable, "key1", 0x3U), "value1,value2");
+    }
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.AddHashTable(
+            HashTableConfig(
+                "Table2",
+                HashTableConfig::Setting{ 100U },
+                HashTableConfig::Cache{ 1024, std::chrono::seconds{ 1U }, false }).SetColumns({ "c1" })),
+        "Column hash table does not support cache, ordered index or hybrid log.");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace UnitTests
+} // namespace L4
@@ -143,6 +143,35 @@ BOOST_AUTO_TEST_CASE(EpochActionManagerTest)
 }
 
 
+BOOST_AUTO_TEST_CASE(EpochActionManagerNumActionQueuesTest)
+{
+    EpochActionManager actionManager(1U, 8U);
+
+    BOOST_CHECK_EQUAL(actionManager.GetNumActionQueues(), 1U);
+    BOOST_CHECK_EQUAL(actionManager.GetMaxNumActionQueues(), 8U);
+
+    // The number in use is rounded down to a power of two within the bounds.
+    actionManager.SetNumActionQueues(5U);
+    BOOST_CHECK_EQUAL(actionManager.GetNumActionQueues(), 4U);
+    actionManager.SetNumActionQueues(100U);
+    BOOST_CHECK_EQUAL(actionManager.GetNumActionQueues(), 8U);
+
+    std::uint32_t numActionsCalled = 0U;
+    for (std::uint32_t i = 0U; i < 8U; ++i)
+    {
+        // No other thread holds a queue.
+        BOOST_CHECK(!actionManager.RegisterAction(5U, [&numActionsCalled]() { ++numActionsCalled; }));
+    }
+
+    // The actions registered to the queues no longer in use are still performed.
+    actionManager.SetNumActionQueues(0U);
+    BOOST_CHECK_EQUAL(actionManager.GetNumActionQueues(), 1U);
+
+    BOOST_CHECK_EQUAL(actionManager.PerformActions(6U), 8U);
+    BOOST_CHECK_EQUAL(numActionsCalled, 8U);
+}
+
+
 BOOST_AUTO_TEST_CASE(EpochManagerTest)
 {
     ServerPerfData perfData;
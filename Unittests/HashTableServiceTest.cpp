@@ -1,9 +1,18 @@
 #include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include "Mocks.h"
 #include "Utils.h"
+#include "CheckedAllocator.h"
 #include "L4/LocalMemory/HashTableService.h"
+#include "L4/Utils/MurmurHash3.h"
 
 namespace L4
 {
@@ -48,5 +57,822 @@ BOOST_AUTO_TEST_CASE(HashTableServiceTest)
     }
 }
 
+
+BOOST_AUTO_TEST_CASE(SingleThreadedHashTableTest)
+{
+    using Allocator = HashTable::SingleThreadedAllocator<CheckedAllocator<>>;
+    using InternalHashTable = HashTable::ReadWrite::WritableHashTable<Allocator>::HashTable;
+
+    static_assert(
+        std::is_same<InternalHashTable::Mutex, L4::Utils::NullMutex>::value,
+        "Single-threaded hash table should not lock.");
+    static_assert(
+        std::is_same<HashTable::ReadWrite::WritableHashTable<CheckedAllocator<>>::HashTable::Mutex, L4::Utils::ReaderWriterLockSlim>::value,
+        "Hash table should lock by default.");
+
+    LocalMemory::HashTableService htService;
+    htService.AddSingleThreadedHashTable(
+        HashTableConfig("Table1", HashTableConfig::Setting{ 10U }));
+    htService.AddSingleThreadedHashTable(
+        HashTableConfig(
+            "Table2",
+            HashTableConfig::Setting{ 10U },
+            HashTableConfig::Cache{ 1024 * 1024, std::chrono::seconds{ 100U }, false }));
+
+    htService.AddSingleThreadedHashTable(
+        HashTableConfig("Table5", HashTableConfig::Setting{ 10U }));
+
+    // The memory is released as soon as a record is replaced or removed.
+    Allocator allocator;
+    htService.AddHashTable(HashTableConfig("Table3", HashTableConfig::Setting{ 10U }), allocator);
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.AddSingleThreadedHashTable(
+            HashTableConfig("Table4", HashTableConfig::Setting{ 10U }).SetHybridLog(HashTableConfig::HybridLog{ "Table4" })),
+        "Hybrid log hash table does not support the single-threaded policy.");
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.AddSingleThreadedHashTable(
+            HashTableConfig(
+                "Table4",
+                HashTableConfig::Setting{ 10U },
+                HashTableConfig::Cache{
+                    1024 * 1024,
+                    std::chrono::seconds{ 100U },
+                    false,
+                    ICacheHashTable::WriteBackPolicy{ [](const ICacheHashTable::WriteBackPolicy::Records&) {} } })),
+        "Write-back cache hash table does not support the single-threaded policy.");
+
+    auto context = htService.GetContext();
+
+    for (const auto* name : { "Table1", "Table2", "Table3" })
+    {
+        auto& hashTable = context[name];
+
+        for (std::uint32_t i = 0U; i < 100U; ++i)
+        {
+            hashTable.Add(
+                Utils::ConvertFromString<IReadOnlyHashTable::Key>(("key" + std::to_string(i % 50U)).c_str()),
+                Utils::ConvertFromString<IReadOnlyHashTable::Value>(("value" + std::to_string(i)).c_str()));
+        }
+
+        IReadOnlyHashTable::Value value;
+        BOOST_REQUIRE(hashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1"), value));
+        BOOST_CHECK(Utils::ConvertToString(value) == "value51");
+
+        BOOST_CHECK(hashTable.Remove(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1")));
+        BOOST_CHECK(!hashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1"), value));
+
+        Utils::ValidateCounters(
+            hashTable.GetPerfData(),
+            {
+                { HashTablePerfCounter::RecordsCount, 49 },
+                { HashTablePerfCounter::MinKeySize, 4 },
+                { HashTablePerfCounter::MaxKeySize, 5 }
+            });
+    }
+
+    // The bucket vector, the mutex vector and 49 records.
+    BOOST_CHECK_EQUAL(allocator.m_allocationAddresses->size(), 51U);
+
+    // The merge runs on one thread regardless of the requested number of threads.
+    context["Table5"].MergeFrom(
+        context["Table1"],
+        IWritableHashTable::MergePolicy{ IWritableHashTable::MergePolicy::Conflict::Overwrite, {}, false, 4U });
+    BOOST_CHECK_EQUAL(context["Table5"].GetPerfData().Get(HashTablePerfCounter::RecordsCount), 49);
+}
+
+
+BOOST_AUTO_TEST_CASE(EpochDomainTest)
+{
+    LocalMemory::HashTableService htService{ EpochManagerConfig{ 1000U, std::chrono::milliseconds{ 10 } } };
+    htService.AddHashTable(
+        HashTableConfig("Serving", HashTableConfig::Setting{ 100U }).SetEpochDomain("Serving"));
+    htService.AddHashTable(
+        HashTableConfig("Analytics", HashTableConfig::Setting{ 100U }).SetEpochDomain("Analytics"));
+
+    const auto key = Utils::ConvertFromString<IReadOnlyHashTable::Key>("key");
+    const auto value = Utils::ConvertFromString<IReadOnlyHashTable::Value>("value");
+
+    for (const auto* name : { "Serving", "Analytics" })
+    {
+        htService.GetContext()[name].Add(key, value);
+    }
+
+    const auto waitForPendingActions = [&htService](const char* epochDomain)
+    {
+        const auto& perfData = htService.GetServerPerfData(epochDomain);
+        for (std::uint32_t i = 0U; i < 500U && perfData.Get(ServerPerfCounter::PendingActionsCount) != 0; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+        }
+
+        return perfData.Get(ServerPerfCounter::PendingActionsCount);
+    };
+
+    {
+        // A long running reader on the "Analytics" table.
+        auto analyticsContext = htService.GetContext();
+        IReadOnlyHashTable::Value val;
+        BOOST_CHECK(analyticsContext["Analytics"].Get(key, val));
+
+        // Replacing the records registers an action to free the old record in each domain.
+        for (const auto* name : { "Serving", "Analytics" })
+        {
+            htService.GetContext()[name].Add(key, value);
+        }
+
+        // The reader on "Analytics" doesn't block the reclamation in the "Serving" domain.
+        BOOST_CHECK_EQUAL(waitForPendingActions("Serving"), 0);
+        BOOST_CHECK_EQUAL(htService.GetServerPerfData("Analytics").Get(ServerPerfCounter::PendingActionsCount), 1);
+    }
+
+    BOOST_CHECK_EQUAL(waitForPendingActions("Analytics"), 0);
+
+    BOOST_CHECK_EQUAL(htService.GetServerPerfData().Get(ServerPerfCounter::PendingActionsCount), 0);
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.GetServerPerfData("NonExistent"),
+        "Epoch domain does not exist.");
+}
+
+
+BOOST_AUTO_TEST_CASE(PinnedValueTest)
+{
+    LocalMemory::HashTableService htService{ EpochManagerConfig{ 1000U, std::chrono::milliseconds{ 10 } } };
+    htService.AddHashTable(HashTableConfig("Table1", HashTableConfig::Setting{ 100U }));
+
+    const auto key = Utils::ConvertFromString<IReadOnlyHashTable::Key>("key");
+    htService.GetContext()["Table1"].Add(key, Utils::ConvertFromString<IReadOnlyHashTable::Value>("value1"));
+
+    const auto& perfData = htService.GetServerPerfData();
+    const auto waitForPendingActions = [&perfData]()
+    {
+        for (std::uint32_t i = 0U; i < 500U && perfData.Get(ServerPerfCounter::PendingActionsCount) != 0; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+        }
+
+        return perfData.Get(ServerPerfCounter::PendingActionsCount);
+    };
+
+    static_assert(!std::is_copy_constructible<LocalMemory::PinnedValue>::value, "PinnedValue should be move-only.");
+
+    BOOST_CHECK(!htService.GetContext().GetPinned(
+        "Table1", Utils::ConvertFromString<IReadOnlyHashTable::Key>("unknown")));
+
+    LocalMemory::PinnedValue pinnedValue = htService.GetContext().GetPinned("Table1", key);
+    BOOST_REQUIRE(pinnedValue);
+
+    // The old record is not released while the handle is alive even though the context is gone.
+    htService.GetContext()["Table1"].Add(key, Utils::ConvertFromString<IReadOnlyHashTable::Value>("value2"));
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+    BOOST_CHECK_EQUAL(perfData.Get(ServerPerfCounter::PendingActionsCount), 1);
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(*pinnedValue), "value1");
+
+    // Moving the handle keeps the reference.
+    LocalMemory::PinnedValue movedPinnedValue{ std::move(pinnedValue) };
+    BOOST_CHECK(!pinnedValue);
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(movedPinnedValue.Get()), "value1");
+    BOOST_CHECK_EQUAL(perfData.Get(ServerPerfCounter::PendingActionsCount), 1);
+
+    movedPinnedValue.Reset();
+    BOOST_CHECK_EQUAL(waitForPendingActions(), 0);
+
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(*htService.GetContext().GetPinned("Table1", key)), "value2");
+}
+
+
+BOOST_AUTO_TEST_CASE(NearCacheTest)
+{
+    LocalMemory::HashTableService htService{ EpochManagerConfig{ 1000U, std::chrono::milliseconds{ 10 } } };
+    htService.AddHashTable(
+        HashTableConfig("Table1", HashTableConfig::Setting{ 100U }).SetNearCache());
+    htService.AddHashTable(
+        HashTableConfig(
+            "Table2",
+            HashTableConfig::Setting{ 100U },
+            HashTableConfig::Cache{ 1024 * 1024, std::chrono::seconds{ 100U }, false }).SetNearCache());
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.AddHashTable(
+            HashTableConfig("Table3", HashTableConfig::Setting{ 100U })
+                .SetHybridLog(HashTableConfig::HybridLog{ "NearCacheTest.log" })
+                .SetNearCache()),
+        "Hybrid log hash table does not support near cache.");
+
+    const auto key = Utils::ConvertFromString<IReadOnlyHashTable::Key>("hotKey");
+    constexpr std::uint32_t c_numUpdates = 10000U;
+
+    // A writer keeps replacing the value of a hot key with an increasing number while readers
+    // look it up repeatedly, thus the readers should never see a value older than the one seen.
+    for (const auto* name : { "Table1", "Table2" })
+    {
+        auto setValue = [&htService, &key, name](std::uint32_t number)
+        {
+            htService.GetContext()[name].Add(
+                key,
+                IReadOnlyHashTable::Value{ reinterpret_cast<const std::uint8_t*>(&number), sizeof(number) });
+        };
+
+        setValue(0U);
+
+        // Boost.Test assertions are not thread-safe, thus the readers only record the failures.
+        std::atomic<std::uint32_t> numFailures{ 0U };
+
+        std::vector<std::thread> readers;
+        for (std::uint32_t i = 0U; i < 4U; ++i)
+        {
+            readers.emplace_back([&htService, &key, &numFailures, name]()
+            {
+                std::uint32_t lastNumber = 0U;
+
+                while (lastNumber != c_numUpdates)
+                {
+                    auto context = htService.GetContext();
+
+                    IReadOnlyHashTable::Value value;
+                    if (!context[name].Get(key, value) || value.m_size != sizeof(std::uint32_t))
+                    {
+                        ++numFailures;
+                        return;
+                    }
+
+                    const auto number = *reinterpret_cast<const std::uint32_t*>(value.m_data);
+                    if (number < lastNumber)
+                    {
+                        ++numFailures;
+                        return;
+                    }
+
+                    lastNumber = number;
+                }
+            });
+        }
+
+        for (std::uint32_t number = 1U; number <= c_numUpdates; ++number)
+        {
+            setValue(number);
+        }
+
+        for (auto& reader : readers)
+        {
+            reader.join();
+        }
+
+        BOOST_CHECK_EQUAL(numFailures, 0U);
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(MemoryGovernorTest)
+{
+    constexpr std::uint64_t c_totalCacheSizeInBytes = 64U * 1024U;
+
+    LocalMemory::HashTableService htService;
+    for (const auto* name : { "Hot", "Cold" })
+    {
+        htService.AddHashTable(
+            HashTableConfig(
+                name,
+                HashTableConfig::Setting{ 10U },
+                HashTableConfig::Cache{ 1024U * 1024U, std::chrono::seconds{ 100U }, false }));
+    }
+
+    // The single-threaded hash table is not governed since the governor runs on its own thread.
+    htService.AddSingleThreadedHashTable(
+        HashTableConfig(
+            "Local",
+            HashTableConfig::Setting{ 10U },
+            HashTableConfig::Cache{ 1024U * 1024U, std::chrono::seconds{ 100U }, false }));
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        LocalMemory::HashTableService{}.EnableMemoryGovernor(LocalMemory::MemoryGovernorConfig{ c_totalCacheSizeInBytes }),
+        "There is no cache hash table to govern.");
+
+    // The tables are rebalanced only manually in this test.
+    auto& governor = htService.EnableMemoryGovernor(
+        LocalMemory::MemoryGovernorConfig{ c_totalCacheSizeInBytes, std::chrono::milliseconds{ 0U }, 0.1 });
+
+    auto context = htService.GetContext();
+    auto& hot = context["Hot"];
+    auto& cold = context["Cold"];
+    auto& hotCache = dynamic_cast<ICacheHashTable&>(hot);
+    auto& coldCache = dynamic_cast<ICacheHashTable&>(cold);
+
+    // The budget is split in proportion to the configured sizes.
+    BOOST_CHECK_EQUAL(hotCache.GetMaxCacheSizeInBytes(), c_totalCacheSizeInBytes / 2U);
+    BOOST_CHECK_EQUAL(coldCache.GetMaxCacheSizeInBytes(), c_totalCacheSizeInBytes / 2U);
+    BOOST_CHECK_EQUAL(dynamic_cast<ICacheHashTable&>(context["Local"]).GetMaxCacheSizeInBytes(), 1024U * 1024U);
+
+    const auto getTotalSize = [](const IReadOnlyHashTable& hashTable)
+    {
+        const auto& perfData = hashTable.GetPerfData();
+        return static_cast<std::uint64_t>(
+            perfData.Get(HashTablePerfCounter::TotalKeySize)
+            + perfData.Get(HashTablePerfCounter::TotalValueSize)
+            + perfData.Get(HashTablePerfCounter::TotalIndexSize));
+    };
+
+    const std::string value(100U, 'v');
+
+    // The working set of "Hot" doesn't fit, thus reading it back hits the keys evicted.
+    for (std::uint32_t i = 0U; i < 1000U; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        hot.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    }
+
+    for (std::uint32_t i = 0U; i < 1000U; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        IReadOnlyHashTable::Value val;
+        hot.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()), val);
+    }
+
+    BOOST_CHECK(hot.GetPerfData().Get(HashTablePerfCounter::GhostHitCount) > 0);
+
+    // "Cold" is nearly full but never misses.
+    for (std::uint32_t i = 0U; getTotalSize(cold) < c_totalCacheSizeInBytes / 2U - 1024U; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        cold.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    }
+
+    BOOST_CHECK(governor.Rebalance());
+
+    constexpr std::uint64_t c_step = static_cast<std::uint64_t>(0.1 * c_totalCacheSizeInBytes);
+    BOOST_CHECK_EQUAL(hotCache.GetMaxCacheSizeInBytes(), c_totalCacheSizeInBytes / 2U + c_step);
+    BOOST_CHECK_EQUAL(coldCache.GetMaxCacheSizeInBytes(), c_totalCacheSizeInBytes / 2U - c_step);
+
+    // "Cold" is shrunk to its new size right away.
+    BOOST_CHECK(getTotalSize(cold) <= coldCache.GetMaxCacheSizeInBytes());
+
+    // Nothing is moved without new ghost hits.
+    BOOST_CHECK(!governor.Rebalance());
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.EnableMemoryGovernor(LocalMemory::MemoryGovernorConfig{ c_totalCacheSizeInBytes }),
+        "Memory governor is already enabled.");
+}
+
+
+BOOST_AUTO_TEST_CASE(OperationRecorderTest)
+{
+    const std::string filePath = "HashTableServiceTest.OperationRecorderTest";
+
+    LocalMemory::HashTableService htService;
+    htService.AddHashTable(HashTableConfig("Table1", HashTableConfig::Setting{ 100U }));
+    htService.AddHashTable(
+        HashTableConfig(
+            "Cache1",
+            HashTableConfig::Setting{ 100U },
+            HashTableConfig::Cache{ 1024U * 1024U, std::chrono::seconds{ 100U }, false }));
+
+    const auto toKey = [](const std::string& key)
+    {
+        return Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str());
+    };
+
+    const auto toValue = [](const char* value)
+    {
+        return Utils::ConvertFromString<IReadOnlyHashTable::Value>(value);
+    };
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.EnableOperationRecorder(OperationRecorderConfig{ filePath, 0U }),
+        "Sampling rate of the operation recorder should be positive.");
+
+    // The records are flushed only manually in this test.
+    auto& recorder = htService.EnableOperationRecorder(
+        OperationRecorderConfig{ filePath, 1U, true, std::chrono::milliseconds{ 0U } });
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.EnableOperationRecorder(OperationRecorderConfig{ filePath }),
+        "Operation recorder is already enabled.");
+
+    {
+        auto context = htService.GetContext();
+        auto& table = context["Table1"];
+        auto& cache = context["Cache1"];
+
+        IReadOnlyHashTable::Value value;
+
+        table.Add(toKey("key1"), toValue("value1"));
+        BOOST_CHECK(table.Get(toKey("key1"), value));
+        BOOST_CHECK(!table.Get(toKey("key2"), value));
+        BOOST_CHECK(!table.AddIfAbsent(toKey("key1"), toValue("value")));
+        BOOST_CHECK(table.Remove(toKey("key1")));
+
+        // The values of the cache hash table are recorded without the metadata.
+        cache.Add(toKey("key3"), toValue("value3"));
+        BOOST_CHECK(cache.Get(toKey("key3"), value));
+    }
+
+    recorder.Flush();
+
+    struct ExpectedRecord
+    {
+        OperationType m_type;
+        std::uint16_t m_hashTableIndex;
+        const char* m_key;
+        std::uint32_t m_valueSize;
+        bool m_succeeded;
+    };
+
+    const std::vector<ExpectedRecord> expectedRecords = {
+        { OperationType::Add, 0U, "key1", 6U, true },
+        { OperationType::Get, 0U, "key1", 6U, true },
+        { OperationType::Get, 0U, "key2", 0U, false },
+        { OperationType::ConditionalAdd, 0U, "key1", 5U, false },
+        { OperationType::Remove, 0U, "key1", 0U, true },
+        { OperationType::Add, 1U, "key3", 6U, true },
+        { OperationType::Get, 1U, "key3", 6U, true } };
+
+    {
+        std::ifstream stream{ filePath, std::ios::binary };
+        OperationTraceReader reader{ stream };
+
+        BOOST_CHECK(reader.GetHashTableNames() == (std::vector<std::string>{ "Table1", "Cache1" }));
+
+        OperationRecord record;
+        std::string key;
+        std::uint64_t lastTimestamp = 0U;
+
+        for (const auto& expected : expectedRecords)
+        {
+            BOOST_REQUIRE(reader.Read(record, key));
+            BOOST_CHECK(record.m_type == expected.m_type);
+            BOOST_CHECK_EQUAL(record.m_hashTableIndex, expected.m_hashTableIndex);
+            BOOST_CHECK_EQUAL(key, expected.m_key);
+            BOOST_CHECK_EQUAL(record.m_keySize, key.size());
+
+            // The hash passed by the hash table is the same as the hash of the recorded key.
+            std::uint64_t keyHash[2];
+            MurmurHash3_x64_128(key.data(), static_cast<int>(key.size()), 0U, keyHash);
+            BOOST_CHECK_EQUAL(record.m_keyHash, keyHash[0]);
+
+            BOOST_CHECK_EQUAL(record.m_valueSize, expected.m_valueSize);
+            BOOST_CHECK_EQUAL((record.m_flags & OperationRecord::c_succeeded) != 0U, expected.m_succeeded);
+            BOOST_CHECK(record.m_timestamp >= lastTimestamp);
+            lastTimestamp = record.m_timestamp;
+        }
+
+        BOOST_CHECK(!reader.Read(record, key));
+    }
+
+    BOOST_CHECK_EQUAL(recorder.GetNumDroppedRecords(), 0U);
+
+    std::remove(filePath.c_str());
+}
+
+
+BOOST_AUTO_TEST_CASE(OperationRecorderSamplingTest)
+{
+    const std::string filePath = "HashTableServiceTest.OperationRecorderSamplingTest";
+
+    constexpr std::uint32_t c_numThreads = 2U;
+    constexpr std::uint32_t c_numKeysPerThread = 1000U;
+
+    {
+        LocalMemory::HashTableService htService;
+        htService.AddHashTable(HashTableConfig("Table1", HashTableConfig::Setting{ 1000U }));
+
+        // Only the key hashes are recorded, and the records are flushed by the background thread.
+        htService.EnableOperationRecorder(
+            OperationRecorderConfig{ filePath, 4U, false, std::chrono::milliseconds{ 10U } });
+
+        std::vector<std::thread> threads;
+        for (std::uint32_t i = 0U; i < c_numThreads; ++i)
+        {
+            threads.emplace_back([&htService, i]()
+            {
+                auto context = htService.GetContext();
+                auto& table = context["Table1"];
+
+                for (std::uint32_t j = 0U; j < c_numKeysPerThread; ++j)
+                {
+                    const auto key = "key" + std::to_string(i * c_numKeysPerThread + j);
+                    const auto keyBlob = Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str());
+
+                    table.Add(keyBlob, Utils::ConvertFromString<IReadOnlyHashTable::Value>("value"));
+
+                    IReadOnlyHashTable::Value value;
+                    table.Get(keyBlob, value);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        // The remaining records are flushed when the service is destroyed.
+    }
+
+    std::ifstream stream{ filePath, std::ios::binary };
+    OperationTraceReader reader{ stream };
+
+    OperationRecord record;
+    std::string key;
+    std::uint32_t numAdds = 0U;
+    std::uint32_t numGets = 0U;
+    std::vector<std::uint32_t> numRecordsPerThread(c_numThreads);
+
+    while (reader.Read(record, key))
+    {
+        BOOST_CHECK(key.empty());
+        BOOST_REQUIRE(record.m_threadIndex < c_numThreads);
+        ++numRecordsPerThread[record.m_threadIndex];
+        ++(record.m_type == OperationType::Add ? numAdds : numGets);
+    }
+
+    // All the operations on a sampled key are recorded.
+    BOOST_CHECK_EQUAL(numAdds, numGets);
+    BOOST_CHECK(numAdds > 0U);
+    BOOST_CHECK(numAdds < c_numThreads * c_numKeysPerThread / 2U);
+    BOOST_CHECK(numRecordsPerThread[0] > 0U);
+    BOOST_CHECK(numRecordsPerThread[1] > 0U);
+
+    stream.close();
+    std::remove(filePath.c_str());
+}
+
+
+BOOST_AUTO_TEST_CASE(MemoryBudgetTest)
+{
+    using MemoryBudget = HashTableConfig::MemoryBudget;
+
+    constexpr std::uint64_t c_maxSizeInBytes = 16U * 1024U;
+
+    const std::string value(100U, 'v');
+    const auto toKey = [](std::uint32_t i)
+    {
+        return "key" + std::to_string(i);
+    };
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        MemoryBudget(c_maxSizeInBytes, MemoryBudget::Action::Callback),
+        "Callback of the memory budget is not set.");
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        LocalMemory::HashTableService{}.AddHashTable(
+            HashTableConfig(
+                "Table1",
+                HashTableConfig::Setting{ 10U },
+                HashTableConfig::Cache{ 1024U, std::chrono::seconds{ 100U }, false })
+                .SetMemoryBudget(std::make_shared<MemoryBudget>(c_maxSizeInBytes))),
+        "Memory budget is not supported for cache or hybrid log hash tables.");
+
+    // The two hash tables share the budget.
+    auto sharedBudget = std::make_shared<MemoryBudget>(c_maxSizeInBytes);
+
+    LocalMemory::HashTableService htService;
+    for (const auto* name : { "Table1", "Table2" })
+    {
+        htService.AddHashTable(
+            HashTableConfig(name, HashTableConfig::Setting{ 10U }).SetMemoryBudget(sharedBudget));
+    }
+
+    auto context = htService.GetContext();
+    auto& table1 = context["Table1"];
+    auto& table2 = context["Table2"];
+
+    const auto add = [&value, &toKey](IWritableHashTable& table, std::uint32_t i)
+    {
+        const auto key = toKey(i);
+        table.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    };
+
+    std::uint32_t numRecords = 0U;
+    for (; sharedBudget->GetUsedSizeInBytes() + toKey(numRecords).size() + value.size() <= c_maxSizeInBytes; ++numRecords)
+    {
+        add(table1, numRecords);
+    }
+
+    BOOST_CHECK_EQUAL(
+        sharedBudget->GetUsedSizeInBytes(),
+        table1.GetPerfData().Get(HashTablePerfCounter::TotalKeySize)
+        + table1.GetPerfData().Get(HashTablePerfCounter::TotalValueSize)
+        + table1.GetPerfData().Get(HashTablePerfCounter::TotalIndexSize)
+        + table2.GetPerfData().Get(HashTablePerfCounter::TotalIndexSize));
+
+    // The budget is exceeded by either hash table.
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(add(table1, numRecords), "Memory budget of the hash table is exceeded.");
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(add(table2, numRecords), "Memory budget of the hash table is exceeded.");
+    BOOST_CHECK(sharedBudget->GetUsedSizeInBytes() <= c_maxSizeInBytes);
+
+    // A conditional write that is not needed is not checked against the budget.
+    BOOST_CHECK(!table1.AddIfAbsent(
+        Utils::ConvertFromString<IReadOnlyHashTable::Key>(toKey(0U).c_str()),
+        Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str())));
+
+    // Removing a record makes room for another.
+    BOOST_CHECK(table1.Remove(Utils::ConvertFromString<IReadOnlyHashTable::Key>(toKey(0U).c_str())));
+    add(table2, numRecords);
+}
+
+
+BOOST_AUTO_TEST_CASE(MemoryBudgetActionTest)
+{
+    using MemoryBudget = HashTableConfig::MemoryBudget;
+
+    const std::string value(100U, 'v');
+
+    const auto createService = [](std::shared_ptr<MemoryBudget> budget)
+    {
+        auto htService = std::make_unique<LocalMemory::HashTableService>();
+        htService->AddHashTable(
+            HashTableConfig("Table1", HashTableConfig::Setting{ 10U }).SetMemoryBudget(budget));
+        return htService;
+    };
+
+    const auto add = [&value](IWritableHashTable& table, const std::string& key)
+    {
+        table.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    };
+
+    // Each budget has room for one more record than what the empty hash table uses.
+    const auto maxSizeInBytes = 200U + static_cast<std::uint64_t>(
+        createService(nullptr)->GetContext()["Table1"].GetPerfData().Get(HashTablePerfCounter::TotalIndexSize));
+
+    {
+        auto budget = std::make_shared<MemoryBudget>(
+            maxSizeInBytes, MemoryBudget::Action::Block, std::chrono::milliseconds{ 10U });
+        auto htService = createService(budget);
+        auto& table = htService->GetContext()["Table1"];
+
+        add(table, "key1");
+
+        // Times out if nothing is removed.
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(add(table, "key2"), "Memory budget of the hash table is exceeded.");
+    }
+
+    {
+        auto budget = std::make_shared<MemoryBudget>(
+            maxSizeInBytes, MemoryBudget::Action::Block, std::chrono::seconds{ 10U });
+        auto htService = createService(budget);
+        auto& table = htService->GetContext()["Table1"];
+
+        add(table, "key1");
+
+        std::thread remover([&table]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 50U });
+            table.Remove(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1"));
+        });
+
+        // Blocks until the record is removed by the other thread.
+        add(table, "key2");
+        remover.join();
+
+        IReadOnlyHashTable::Value val;
+        BOOST_CHECK(table.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key2"), val));
+    }
+
+    {
+        IWritableHashTable* table = nullptr;
+        std::uint32_t numCallbacks = 0U;
+
+        // The callback makes room by removing the record added first.
+        auto budget = std::make_shared<MemoryBudget>(
+            maxSizeInBytes,
+            MemoryBudget::Action::Callback,
+            std::chrono::milliseconds{ 0U },
+            [&table, &numCallbacks, maxSizeInBytes](std::uint64_t recordSize, std::uint64_t usedSizeInBytes)
+            {
+                ++numCallbacks;
+                BOOST_CHECK(usedSizeInBytes + recordSize > maxSizeInBytes);
+                return table->Remove(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key1"));
+            });
+
+        auto htService = createService(budget);
+        table = &htService->GetContext()["Table1"];
+
+        add(*table, "key1");
+        add(*table, "key2");
+        BOOST_CHECK_EQUAL(numCallbacks, 1U);
+
+        // The callback has nothing to remove this time.
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(add(*table, "key3"), "Memory budget of the hash table is exceeded.");
+        BOOST_CHECK_EQUAL(numCallbacks, 2U);
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(SelfTunerTest)
+{
+    MockPerfLogger perfLogger;
+
+    // The epochs are processed rarely so that the actions stay pending.
+    LocalMemory::HashTableService htService{ EpochManagerConfig{ 1000U, std::chrono::milliseconds{ 1000U } } };
+    htService.AddHashTable(HashTableConfig("Table1", HashTableConfig::Setting{ 100U }));
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.EnableSelfTuner(
+            LocalMemory::SelfTunerConfig{ std::chrono::milliseconds{ 0U }, std::chrono::milliseconds{ 100U }, std::chrono::milliseconds{ 10U } },
+            perfLogger),
+        "Epoch processing interval bounds of the self-tuner are invalid.");
+
+    // The tunables are adjusted only manually in this test.
+    auto& tuner = htService.EnableSelfTuner(
+        LocalMemory::SelfTunerConfig{
+            std::chrono::milliseconds{ 0U },
+            std::chrono::milliseconds{ 250U },
+            std::chrono::milliseconds{ 1000U },
+            10U },
+        perfLogger);
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.EnableSelfTuner(LocalMemory::SelfTunerConfig{}, perfLogger),
+        "Self-tuner is already enabled.");
+
+    // Nothing is changed at the bounds.
+    BOOST_CHECK_EQUAL(tuner.Tune(), 0U);
+
+    // Each replaced record is released by a pending action.
+    {
+        auto context = htService.GetContext();
+        auto& table = context["Table1"];
+
+        const auto key = Utils::ConvertFromString<IReadOnlyHashTable::Key>("key");
+        for (std::uint32_t i = 0U; i < 20U; ++i)
+        {
+            table.Add(key, Utils::ConvertFromString<IReadOnlyHashTable::Value>("value"));
+        }
+    }
+
+    BOOST_CHECK(htService.GetServerPerfData().Get(ServerPerfCounter::PendingActionsCount) > 10);
+
+    BOOST_CHECK_EQUAL(tuner.Tune(), 1U);
+    BOOST_CHECK_EQUAL(tuner.Tune(), 1U);
+    BOOST_CHECK_EQUAL(tuner.Tune(), 0U);
+
+    const auto decisions = perfLogger.GetTuningDecisions();
+    BOOST_REQUIRE_EQUAL(decisions.size(), 2U);
+
+    for (const auto& decision : decisions)
+    {
+        BOOST_CHECK_EQUAL(decision.m_scope, "");
+        BOOST_CHECK_EQUAL(decision.m_tunable, "EpochProcessingIntervalInMilliseconds");
+        BOOST_CHECK(!decision.m_reason.empty());
+    }
+
+    BOOST_CHECK_EQUAL(decisions[0].m_oldValue, 1000);
+    BOOST_CHECK_EQUAL(decisions[0].m_newValue, 500);
+
+    // Bounded by the min.
+    BOOST_CHECK_EQUAL(decisions[1].m_oldValue, 500);
+    BOOST_CHECK_EQUAL(decisions[1].m_newValue, 250);
+}
+
+
+BOOST_AUTO_TEST_CASE(SelfTunerActionQueuesTest)
+{
+    MockPerfLogger perfLogger;
+
+    ServerPerfData perfData;
+    LocalMemory::EpochManager epochManager{
+        EpochManagerConfig{ 1000U, std::chrono::milliseconds{ 1000U }, 1U, 2U },
+        perfData };
+
+    LocalMemory::SelfTuner tuner{
+        LocalMemory::SelfTunerConfig{
+            std::chrono::milliseconds{ 0U },
+            std::chrono::milliseconds{ 1000U },
+            std::chrono::milliseconds{ 1000U },
+            10U,
+            2U,
+            100U },
+        { LocalMemory::SelfTuner::Domain{ "Domain1", &epochManager, &perfData } },
+        perfLogger };
+
+    // The contentions are counted per tuning.
+    perfData.Set(ServerPerfCounter::ActionQueueContentionCount, 100);
+    BOOST_CHECK_EQUAL(tuner.Tune(), 0U);
+
+    perfData.Set(ServerPerfCounter::ActionQueueContentionCount, 300);
+    BOOST_CHECK_EQUAL(tuner.Tune(), 1U);
+    BOOST_CHECK_EQUAL(epochManager.GetEpochActionManager().GetNumActionQueues(), 2U);
+
+    // Bounded by the max.
+    perfData.Set(ServerPerfCounter::ActionQueueContentionCount, 500);
+    BOOST_CHECK_EQUAL(tuner.Tune(), 0U);
+
+    const auto decisions = perfLogger.GetTuningDecisions();
+    BOOST_REQUIRE_EQUAL(decisions.size(), 1U);
+    BOOST_CHECK_EQUAL(decisions[0].m_scope, "Domain1");
+    BOOST_CHECK_EQUAL(decisions[0].m_tunable, "NumActionQueues");
+    BOOST_CHECK_EQUAL(decisions[0].m_oldValue, 1);
+    BOOST_CHECK_EQUAL(decisions[0].m_newValue, 2);
+}
+
 } // namespace UnitTests
 } // namespace L4
@@ -0,0 +1,423 @@
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Utils.h"
+#include "Mocks.h"
+#include "CheckedAllocator.h"
+#include "L4/HashTable/HybridLog/HashTable.h"
+#include "L4/LocalMemory/HashTableService.h"
+
+namespace L4
+{
+namespace UnitTests
+{
+
+using namespace HashTable::HybridLog;
+
+class HybridLogHashTableTestFixture
+{
+protected:
+    using Allocator = CheckedAllocator<>;
+    using HashTable = WritableHashTable<Allocator>::HashTable;
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    static constexpr std::uint32_t c_pageSize = 4096U;
+
+    HybridLogHashTableTestFixture()
+        : m_allocator{}
+        , m_epochManager{}
+    {}
+
+    static std::string GetValue(std::uint32_t i)
+    {
+        // Values of about 100 bytes so that the records span many pages.
+        return std::to_string(i) + std::string(90U + (i % 20U), 'v');
+    }
+
+    static void Add(IWritableHashTable& hashTable, const std::string& key, const std::string& value)
+    {
+        hashTable.Add(
+            Utils::ConvertFromString<Key>(key.c_str()),
+            Utils::ConvertFromString<Value>(value.c_str()));
+    }
+
+    static bool Get(const IReadOnlyHashTable& hashTable, const std::string& key, std::string& value)
+    {
+        Value valueFound;
+        if (!hashTable.Get(Utils::ConvertFromString<Key>(key.c_str()), valueFound))
+        {
+            return false;
+        }
+
+        value = Utils::ConvertToString(valueFound);
+        return true;
+    }
+
+    static bool FileExists(const std::string& filePath)
+    {
+        return std::ifstream(filePath).good();
+    }
+
+    Allocator m_allocator;
+    DeferredEpochManager m_epochManager;
+};
+
+
+BOOST_FIXTURE_TEST_SUITE(HybridLogHashTableTests, HybridLogHashTableTestFixture)
+
+
+BOOST_AUTO_TEST_CASE(LogTest)
+{
+    const std::string filePath = "HybridLogTest.LogTest";
+
+    {
+        // 2 pages in memory and 2 pages per segment.
+        Log log{ filePath, c_pageSize, 2U, 2U, m_epochManager };
+
+        std::vector<Log::Address> addresses;
+        for (std::uint32_t i = 0U; i < 200U; ++i)
+        {
+            addresses.emplace_back(log.Append(
+                Utils::ConvertFromString<Key>(("key" + std::to_string(i)).c_str()),
+                Utils::ConvertFromString<Value>(GetValue(i).c_str())));
+        }
+
+        BOOST_CHECK(log.GetTailAddress() > 4U * c_pageSize);
+        BOOST_CHECK_EQUAL(log.GetHeadAddress(), log.GetReadOnlyAddress() - c_pageSize);
+
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+            log.Append(
+                Utils::ConvertFromString<Key>("key"),
+                Value{ nullptr, c_pageSize }),
+            "Record is larger than the log page size.");
+
+        // Evicted records can be read only from the file.
+        std::vector<std::uint8_t> buffer;
+        Log::Record record;
+
+        BOOST_CHECK(!log.TryRead(addresses.front(), record));
+        BOOST_REQUIRE(log.Read(addresses.front(), buffer, record));
+        BOOST_CHECK(Utils::ConvertToString(record.m_key) == "key0");
+        BOOST_CHECK(Utils::ConvertToString(record.m_value) == GetValue(0U));
+
+        BOOST_REQUIRE(log.TryRead(addresses.back(), record));
+        BOOST_CHECK(Utils::ConvertToString(record.m_key) == "key199");
+
+        std::uint32_t numRecords = 0U;
+        log.ForEachRecord(
+            log.GetReadOnlyAddress(),
+            [&](Log::Address address, const Log::Record& record)
+        {
+            BOOST_REQUIRE(address == addresses[numRecords]);
+            BOOST_CHECK(Utils::ConvertToString(record.m_key) == "key" + std::to_string(numRecords));
+            ++numRecords;
+        });
+
+        BOOST_CHECK(numRecords > 0U);
+        BOOST_CHECK(addresses[numRecords] >= log.GetReadOnlyAddress());
+
+        // Truncation is rounded down to a segment boundary.
+        const auto segmentSize = log.GetSegmentSize();
+        BOOST_CHECK_EQUAL(log.GetTruncatableAddress(segmentSize + 8U), segmentSize);
+        BOOST_CHECK(FileExists(filePath + ".0"));
+
+        log.Truncate(segmentSize);
+
+        BOOST_CHECK_EQUAL(log.GetBeginAddress(), segmentSize);
+        BOOST_CHECK(!FileExists(filePath + ".0"));
+        BOOST_CHECK(FileExists(filePath + ".1"));
+        BOOST_CHECK(!log.Read(addresses.front(), buffer, record));
+
+        m_epochManager.PerformActions();
+    }
+
+    BOOST_CHECK(!FileExists(filePath + ".1"));
+}
+
+
+BOOST_AUTO_TEST_CASE(AddGetRemoveTest)
+{
+    const std::string filePath = "HybridLogTest.AddGetRemoveTest";
+    const std::uint32_t numRecords = 1000U;
+
+    HashTable hashTable{ HashTable::Setting{ 100U }, m_allocator };
+
+    {
+        WritableHashTable<Allocator> hybridLogHashTable(hashTable, m_epochManager, filePath, c_pageSize, 4U, 4U);
+
+        for (std::uint32_t i = 0U; i < numRecords; ++i)
+        {
+            Add(hybridLogHashTable, "key" + std::to_string(i), GetValue(i));
+        }
+
+        BOOST_CHECK(hybridLogHashTable.GetLog().GetHeadAddress() > 0U);
+
+        Utils::ValidateCounters(
+            hybridLogHashTable.GetPerfData(),
+            {
+                { HashTablePerfCounter::RecordsCount, numRecords }
+            });
+
+        // Records are read from either the memory or the file.
+        std::string value;
+        for (std::uint32_t i = 0U; i < numRecords; ++i)
+        {
+            BOOST_REQUIRE(Get(hybridLogHashTable, "key" + std::to_string(i), value));
+            BOOST_CHECK(value == GetValue(i));
+        }
+
+        BOOST_CHECK(!Get(hybridLogHashTable, "key" + std::to_string(numRecords), value));
+
+        // Updates are appended.
+        const auto tailAddress = hybridLogHashTable.GetLog().GetTailAddress();
+        Add(hybridLogHashTable, "key0", "updated");
+        BOOST_CHECK(hybridLogHashTable.GetLog().GetTailAddress() > tailAddress);
+        BOOST_REQUIRE(Get(hybridLogHashTable, "key0", value));
+        BOOST_CHECK(value == "updated");
+
+        BOOST_CHECK(hybridLogHashTable.Remove(Utils::ConvertFromString<Key>("key1")));
+        BOOST_CHECK(!hybridLogHashTable.Remove(Utils::ConvertFromString<Key>("key1")));
+        BOOST_CHECK(!Get(hybridLogHashTable, "key1", value));
+
+        std::uint32_t numIterated = 0U;
+        auto iterator = hybridLogHashTable.GetIterator();
+        while (iterator->MoveNext())
+        {
+            const auto key = Utils::ConvertToString(iterator->GetKey());
+            const auto expectedValue = (key == "key0") ? "updated" : GetValue(std::stoul(key.substr(3U)));
+            BOOST_CHECK(Utils::ConvertToString(iterator->GetValue()) == expectedValue);
+            ++numIterated;
+        }
+
+        BOOST_CHECK_EQUAL(numIterated, numRecords - 1U);
+
+        // The conditional writes that are not needed don't append to the log.
+        const auto key0 = Utils::ConvertFromString<Key>("key0");
+        const auto key1 = Utils::ConvertFromString<Key>("key1");
+        const auto key2 = Utils::ConvertFromString<Key>("key2");
+        const auto conditionalTailAddress = hybridLogHashTable.GetLog().GetTailAddress();
+
+        BOOST_CHECK(!hybridLogHashTable.AddIfAbsent(key0, Utils::ConvertFromString<Value>("conditional")));
+        BOOST_CHECK(!hybridLogHashTable.ReplaceIfPresent(key1, Utils::ConvertFromString<Value>("conditional")));
+        BOOST_CHECK(!hybridLogHashTable.ReplaceIfEqual(
+            key0, Utils::ConvertFromString<Value>("wrong"), Utils::ConvertFromString<Value>("conditional")));
+        BOOST_CHECK_EQUAL(hybridLogHashTable.GetLog().GetTailAddress(), conditionalTailAddress);
+
+        // key2 is read from the file to compare the value.
+        const auto value2 = GetValue(2U);
+        BOOST_CHECK(hybridLogHashTable.ReplaceIfEqual(
+            key2, Utils::ConvertFromString<Value>(value2.c_str()), Utils::ConvertFromString<Value>("updated2")));
+        BOOST_REQUIRE(Get(hybridLogHashTable, "key2", value));
+        BOOST_CHECK(value == "updated2");
+
+        BOOST_CHECK(hybridLogHashTable.AddIfAbsent(key1, Utils::ConvertFromString<Value>("updated1")));
+        BOOST_CHECK(hybridLogHashTable.ReplaceIfPresent(key1, Utils::ConvertFromString<Value>("updated1")));
+        BOOST_REQUIRE(Get(hybridLogHashTable, "key1", value));
+        BOOST_CHECK(value == "updated1");
+        BOOST_CHECK(hybridLogHashTable.Remove(key1));
+
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+            hybridLogHashTable.GetSerializer(),
+            "Serializing a hybrid log hash table is not supported.");
+
+        m_epochManager.PerformActions();
+    }
+
+    BOOST_CHECK(!FileExists(filePath + ".0"));
+}
+
+
+BOOST_AUTO_TEST_CASE(ReadFailureTest)
+{
+    const std::string filePath = "HybridLogTest.ReadFailureTest";
+    const std::uint32_t numRecords = 1000U;
+
+    HashTable hashTable{ HashTable::Setting{ 100U }, m_allocator };
+
+    {
+        WritableHashTable<Allocator> hybridLogHashTable(hashTable, m_epochManager, filePath, c_pageSize, 4U, 4U);
+
+        for (std::uint32_t i = 0U; i < numRecords; ++i)
+        {
+            Add(hybridLogHashTable, "key" + std::to_string(i), GetValue(i));
+        }
+
+        // The first segment file is emptied, thus the records in it cannot be read anymore.
+        std::ofstream(filePath + ".0", std::ios::binary | std::ios::trunc);
+
+        std::string value;
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+            Get(hybridLogHashTable, "key0", value),
+            "Failed to read the record from the hybrid log.");
+
+        // The records in memory are still read.
+        BOOST_REQUIRE(Get(hybridLogHashTable, "key" + std::to_string(numRecords - 1U), value));
+        BOOST_CHECK(value == GetValue(numRecords - 1U));
+
+        m_epochManager.PerformActions();
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(GetAsyncTest)
+{
+    const std::string filePath = "HybridLogTest.GetAsyncTest";
+    const std::uint32_t numRecords = 1000U;
+
+    HashTable hashTable{ HashTable::Setting{ 100U }, m_allocator };
+
+    std::atomic<std::uint32_t> numFound{ 0U };
+    std::atomic<std::uint32_t> numNotFound{ 0U };
+    std::atomic<std::uint32_t> numMismatched{ 0U };
+
+    {
+        WritableHashTable<Allocator> hybridLogHashTable(hashTable, m_epochManager, filePath, c_pageSize, 4U, 4U);
+
+        for (std::uint32_t i = 0U; i < numRecords; ++i)
+        {
+            Add(hybridLogHashTable, "key" + std::to_string(i), GetValue(i));
+        }
+
+        for (std::uint32_t i = 0U; i <= numRecords; ++i)
+        {
+            const auto expectedValue = GetValue(i);
+            hybridLogHashTable.GetAsync(
+                Utils::ConvertFromString<Key>(("key" + std::to_string(i)).c_str()),
+                [&, expectedValue](bool found, const Value& value)
+            {
+                if (!found)
+                {
+                    ++numNotFound;
+                }
+                else if (Utils::ConvertToString(value) == expectedValue)
+                {
+                    ++numFound;
+                }
+                else
+                {
+                    ++numMismatched;
+                }
+            });
+        }
+
+        // The pending reads are drained when the hash table is destroyed.
+        m_epochManager.PerformActions();
+    }
+
+    BOOST_CHECK_EQUAL(numFound, numRecords);
+    BOOST_CHECK_EQUAL(numNotFound, 1U);
+    BOOST_CHECK_EQUAL(numMismatched, 0U);
+}
+
+
+BOOST_AUTO_TEST_CASE(CompactTest)
+{
+    const std::string filePath = "HybridLogTest.CompactTest";
+    const std::uint32_t numRecords = 100U;
+
+    HashTable hashTable{ HashTable::Setting{ 100U }, m_allocator };
+
+    {
+        WritableHashTable<Allocator> hybridLogHashTable(hashTable, m_epochManager, filePath, c_pageSize, 2U, 1U);
+
+        // Most of the records become stale by the updates.
+        for (std::uint32_t round = 0U; round < 10U; ++round)
+        {
+            for (std::uint32_t i = 0U; i < numRecords; ++i)
+            {
+                Add(hybridLogHashTable, "key" + std::to_string(i), GetValue(i + round));
+            }
+        }
+
+        hybridLogHashTable.Remove(Utils::ConvertFromString<Key>("key0"));
+
+        const auto& log = hybridLogHashTable.GetLog();
+        const auto logSize = log.GetTailAddress() - log.GetBeginAddress();
+
+        hybridLogHashTable.Compact(log.GetReadOnlyAddress());
+
+        BOOST_CHECK_EQUAL(log.GetBeginAddress(), log.GetTruncatableAddress(log.GetBeginAddress()));
+        BOOST_CHECK(log.GetBeginAddress() > 0U);
+        BOOST_CHECK(log.GetTailAddress() - log.GetBeginAddress() < logSize);
+        BOOST_CHECK(!FileExists(filePath + ".0"));
+
+        std::string value;
+        BOOST_CHECK(!Get(hybridLogHashTable, "key0", value));
+        for (std::uint32_t i = 1U; i < numRecords; ++i)
+        {
+            BOOST_REQUIRE(Get(hybridLogHashTable, "key" + std::to_string(i), value));
+            BOOST_CHECK(value == GetValue(i + 9U));
+        }
+
+        m_epochManager.PerformActions();
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(AddressIndexTest)
+{
+    HashTable hashTable{ HashTable::Setting{ 10U }, m_allocator };
+    AddressIndex<Allocator> index(hashTable, m_epochManager);
+
+    const auto key = Utils::ConvertFromString<Key>("key");
+    index.Add(key, 1U);
+
+    // The address is replaced only if it is still the expected address.
+    BOOST_CHECK(!index.ReplaceAddressLocked(key, 2U, 3U));
+    BOOST_CHECK(index.ReplaceAddressLocked(key, 1U, 3U));
+    BOOST_CHECK(!index.ReplaceAddressLocked(Utils::ConvertFromString<Key>("absent"), 1U, 3U));
+
+    AddressIndex<Allocator>::Address address = 0U;
+    BOOST_REQUIRE(index.GetAddressLocked(key, address));
+    BOOST_CHECK_EQUAL(address, 3U);
+    BOOST_CHECK_EQUAL(index.GetPerfData().Get(HashTablePerfCounter::RecordsCount), 1);
+
+    m_epochManager.PerformActions();
+}
+
+
+BOOST_AUTO_TEST_CASE(HashTableServiceTest)
+{
+    const std::string filePath = "HybridLogTest.HashTableServiceTest";
+
+    LocalMemory::HashTableService htService;
+    htService.AddHashTable(
+        HashTableConfig("Table1", HashTableConfig::Setting{ 100U })
+            .SetHybridLog(HashTableConfig::HybridLog{ filePath, c_pageSize, 2U, 1U, 2U, std::chrono::milliseconds{ 10U } }));
+
+    for (std::uint32_t i = 0U; i < 1000U; ++i)
+    {
+        auto context = htService.GetContext();
+        Add(context["Table1"], "key" + std::to_string(i % 50U), GetValue(i));
+    }
+
+    {
+        auto context = htService.GetContext();
+        auto& hashTable = context["Table1"];
+        BOOST_REQUIRE(dynamic_cast<const IAsyncHashTable*>(&hashTable) != nullptr);
+
+        std::string value;
+        for (std::uint32_t i = 950U; i < 1000U; ++i)
+        {
+            BOOST_REQUIRE(Get(hashTable, "key" + std::to_string(i % 50U), value));
+            BOOST_CHECK(value == GetValue(i));
+        }
+    }
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.AddHashTable(
+            HashTableConfig(
+                "Table2",
+                HashTableConfig::Setting{ 100U },
+                HashTableConfig::Cache{ 1024, std::chrono::seconds{ 1U }, false })
+                .SetHybridLog(HashTableConfig::HybridLog{ filePath + "2" })),
+        "Hybrid log hash table does not support cache, serializer or ordered index.");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace UnitTests
+} // namespace L4
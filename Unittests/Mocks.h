@@ -1,5 +1,7 @@
 #pragma once
 
+#include <mutex>
+#include <vector>
 #include "L4/Epoch/IEpochActionManager.h"
 #include "L4/Log/PerfLogger.h"
 
@@ -10,10 +12,27 @@ namespace UnitTests
 
 class MockPerfLogger : public IPerfLogger
 {
+public:
     virtual void Log(const IData& data) override
     {
         (void)data;
     }
+
+    virtual void LogTuningDecision(const TuningDecision& decision) override
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_tuningDecisions.push_back(decision);
+    }
+
+    std::vector<TuningDecision> GetTuningDecisions()
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        return m_tuningDecisions;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<TuningDecision> m_tuningDecisions;
 };
 
 struct MockEpochManager : public IEpochActionManager
@@ -32,5 +51,39 @@ struct MockEpochManager : public IEpochActionManager
     std::uint16_t m_numRegisterActionsCalled;
 };
 
+// DeferredEpochManager keeps the registered actions until PerformActions() is called,
+// which simulates readers holding an epoch while memory is being released.
+struct DeferredEpochManager : public IEpochActionManager
+{
+    ~DeferredEpochManager()
+    {
+        PerformActions();
+    }
+
+    virtual void RegisterAction(Action&& action) override
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_actions.emplace_back(std::move(action));
+    }
+
+    void PerformActions()
+    {
+        std::vector<Action> actions;
+
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            actions.swap(m_actions);
+        }
+
+        for (auto& action : actions)
+        {
+            action();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::vector<Action> m_actions;
+};
+
 } // namespace UnitTests
 } // namespace L4
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utils.h"
+#include "Mocks.h"
+#include "CheckedAllocator.h"
+#include "L4/HashTable/ReadWrite/OrderedHashTable.h"
+#include "L4/LocalMemory/HashTableService.h"
+
+namespace L4
+{
+namespace UnitTests
+{
+
+using namespace HashTable::ReadWrite;
+
+class OrderedHashTableTestFixture
+{
+protected:
+    using Allocator = CheckedAllocator<>;
+    using HashTable = OrderedWritableHashTable<Allocator>::HashTable;
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    OrderedHashTableTestFixture()
+        : m_allocator{}
+        , m_epochManager{}
+    {}
+
+    static std::vector<std::string> Scan(
+        const IOrderedHashTable& hashTable,
+        const std::string& from,
+        const std::string& to,
+        std::size_t maxCount = (std::numeric_limits<std::size_t>::max)())
+    {
+        std::vector<std::string> result;
+        hashTable.Scan(
+            Utils::ConvertFromString<Key>(from.c_str()),
+            Utils::ConvertFromString<Key>(to.c_str()),
+            [&result, maxCount](const Key& key, const Value& value)
+        {
+            result.emplace_back(Utils::ConvertToString(key) + "=" + Utils::ConvertToString(value));
+            return result.size() < maxCount;
+        });
+
+        return result;
+    }
+
+    static std::vector<std::string> PrefixScan(
+        const IOrderedHashTable& hashTable,
+        const std::string& prefix)
+    {
+        std::vector<std::string> result;
+        hashTable.PrefixScan(
+            Utils::ConvertFromString<Key>(prefix.c_str()),
+            [&result](const Key& key, const Value& value)
+        {
+            result.emplace_back(Utils::ConvertToString(key) + "=" + Utils::ConvertToString(value));
+            return true;
+        });
+
+        return result;
+    }
+
+    static void Add(IWritableHashTable& hashTable, const std::string& key, const std::string& value)
+    {
+        hashTable.Add(
+            Utils::ConvertFromString<Key>(key.c_str()),
+            Utils::ConvertFromString<Value>(value.c_str()));
+    }
+
+    Allocator m_allocator;
+    MockEpochManager m_epochManager;
+};
+
+
+BOOST_FIXTURE_TEST_SUITE(OrderedHashTableTests, OrderedHashTableTestFixture)
+
+
+BOOST_AUTO_TEST_CASE(ScanTest)
+{
+    HashTable hashTable{ HashTable::Setting{ 10 }, m_allocator };
+    OrderedWritableHashTable<Allocator> orderedHashTable(hashTable, m_epochManager);
+
+    const auto initialTotalIndexSize = orderedHashTable.GetPerfData().Get(HashTablePerfCounter::TotalIndexSize);
+
+    // Add in a non-sorted order.
+    for (const auto& key : { "b2", "a", "c", "b1", "ab", "b", "b10" })
+    {
+        Add(orderedHashTable, key, std::string("v") + key);
+    }
+
+    BOOST_CHECK(orderedHashTable.GetPerfData().Get(HashTablePerfCounter::TotalIndexSize) > initialTotalIndexSize);
+
+    // Empty "from" and "to" scans everything.
+    BOOST_CHECK((Scan(orderedHashTable, "", "")
+        == std::vector<std::string>{ "a=va", "ab=vab", "b=vb", "b1=vb1", "b10=vb10", "b2=vb2", "c=vc" }));
+
+    // [from, to) range.
+    BOOST_CHECK((Scan(orderedHashTable, "ab", "b10")
+        == std::vector<std::string>{ "ab=vab", "b=vb", "b1=vb1" }));
+
+    // "from" doesn't need to exist.
+    BOOST_CHECK((Scan(orderedHashTable, "aa", "b0")
+        == std::vector<std::string>{ "ab=vab", "b=vb" }));
+
+    // Visitor stops the scan.
+    BOOST_CHECK((Scan(orderedHashTable, "b", "", 2U)
+        == std::vector<std::string>{ "b=vb", "b1=vb1" }));
+
+    BOOST_CHECK((PrefixScan(orderedHashTable, "b1")
+        == std::vector<std::string>{ "b1=vb1", "b10=vb10" }));
+    BOOST_CHECK(PrefixScan(orderedHashTable, "d").empty());
+
+    // The cursor based scan of the hash table is still available.
+    std::uint32_t numScanned = 0U;
+    const auto cursor = orderedHashTable.Scan(
+        IReadOnlyHashTable::ScanCursor{},
+        100U,
+        [&numScanned](const Key&, const Value&)
+    {
+        ++numScanned;
+    });
+    BOOST_CHECK(cursor.IsEnd());
+    BOOST_CHECK_EQUAL(numScanned, 7U);
+
+    // Updating the value replaces the record referenced by the index.
+    Add(orderedHashTable, "b1", "new");
+    BOOST_CHECK((PrefixScan(orderedHashTable, "b1")
+        == std::vector<std::string>{ "b1=new", "b10=vb10" }));
+
+    // Removing a key removes it from the index.
+    BOOST_CHECK(orderedHashTable.Remove(Utils::ConvertFromString<Key>("b1")));
+    BOOST_CHECK((PrefixScan(orderedHashTable, "b")
+        == std::vector<std::string>{ "b=vb", "b10=vb10", "b2=vb2" }));
+
+    for (const auto& key : { "b2", "a", "c", "ab", "b", "b10" })
+    {
+        BOOST_CHECK(orderedHashTable.Remove(Utils::ConvertFromString<Key>(key)));
+    }
+
+    BOOST_CHECK(Scan(orderedHashTable, "", "").empty());
+    Utils::ValidateCounters(
+        orderedHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, 0 },
+            { HashTablePerfCounter::TotalIndexSize, initialTotalIndexSize }
+        });
+}
+
+
+BOOST_AUTO_TEST_CASE(ExistingRecordsTest)
+{
+    HashTable hashTable{ HashTable::Setting{ 10 }, m_allocator };
+
+    {
+        WritableHashTable<Allocator> writableHashTable(hashTable, m_epochManager);
+        for (std::uint32_t i = 0U; i < 100U; ++i)
+        {
+            Add(writableHashTable, "key" + std::to_string(1000U + i), std::to_string(i));
+        }
+    }
+
+    // The records added before the ordered index is created should be indexed.
+    OrderedWritableHashTable<Allocator> orderedHashTable(hashTable, m_epochManager);
+
+    const auto records = Scan(orderedHashTable, "", "");
+    BOOST_REQUIRE(records.size() == 100U);
+    for (std::uint32_t i = 0U; i < 100U; ++i)
+    {
+        BOOST_CHECK(records[i] == "key" + std::to_string(1000U + i) + "=" + std::to_string(i));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(ConcurrentUpdateTest)
+{
+    using StdAllocator = std::allocator<void>;
+    using StdHashTable = OrderedWritableHashTable<StdAllocator>::HashTable;
+
+    constexpr std::uint32_t c_numThreads = 4U;
+    constexpr std::uint32_t c_numKeysPerThread = 2000U;
+
+    const auto toKey = [](std::uint32_t thread, std::uint32_t i)
+    {
+        return "key" + std::to_string(10000U + i) + "_" + std::to_string(thread);
+    };
+
+    // Nodes and records are released after all the threads are done, as if they held an epoch.
+    DeferredEpochManager epochManager;
+
+    StdHashTable hashTable{ StdHashTable::Setting{ 1000 }, StdAllocator() };
+    OrderedWritableHashTable<StdAllocator> orderedHashTable(hashTable, epochManager);
+
+    // Each thread adds its keys, interleaved with the keys of the other threads, and removes
+    // the even ones while the scanner checks that the keys are always in order.
+    std::atomic<bool> isDone{ false };
+    std::thread scanner([&orderedHashTable, &isDone]()
+    {
+        while (!isDone.load())
+        {
+            std::string prevKey;
+            orderedHashTable.Scan(Key{}, Key{}, [&prevKey](const Key& key, const Value&)
+            {
+                const auto curKey = Utils::ConvertToString(key);
+                BOOST_REQUIRE(prevKey < curKey);
+                prevKey = curKey;
+                return true;
+            });
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (std::uint32_t thread = 0U; thread < c_numThreads; ++thread)
+    {
+        writers.emplace_back([&orderedHashTable, &toKey, thread]()
+        {
+            for (std::uint32_t i = 0U; i < c_numKeysPerThread; ++i)
+            {
+                Add(orderedHashTable, toKey(thread, i), std::to_string(i));
+            }
+
+            for (std::uint32_t i = 0U; i < c_numKeysPerThread; i += 2U)
+            {
+                BOOST_REQUIRE(orderedHashTable.Remove(Utils::ConvertFromString<Key>(toKey(thread, i).c_str())));
+            }
+        });
+    }
+
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+
+    isDone = true;
+    scanner.join();
+
+    const auto records = Scan(orderedHashTable, "", "");
+    BOOST_REQUIRE_EQUAL(records.size(), c_numThreads * c_numKeysPerThread / 2U);
+
+    std::size_t index = 0U;
+    for (std::uint32_t i = 1U; i < c_numKeysPerThread; i += 2U)
+    {
+        for (std::uint32_t thread = 0U; thread < c_numThreads; ++thread)
+        {
+            BOOST_CHECK_EQUAL(records[index++], toKey(thread, i) + "=" + std::to_string(i));
+        }
+    }
+
+    for (const auto& record : records)
+    {
+        BOOST_CHECK(orderedHashTable.Remove(Utils::ConvertFromString<Key>(record.substr(0U, record.find('=')).c_str())));
+    }
+
+    BOOST_CHECK(Scan(orderedHashTable, "", "").empty());
+    Utils::ValidateCounters(orderedHashTable.GetPerfData(), { { HashTablePerfCounter::RecordsCount, 0 } });
+
+    epochManager.PerformActions();
+}
+
+
+BOOST_AUTO_TEST_CASE(HashTableServiceTest)
+{
+    LocalMemory::HashTableService htService;
+    htService.AddHashTable(
+        HashTableConfig("Table1", HashTableConfig::Setting{ 100U }).SetOrderedIndex());
+
+    {
+        auto context = htService.GetContext();
+        Add(context["Table1"], "key2", "value2");
+        Add(context["Table1"], "key1", "value1");
+
+        const auto* orderedHashTable = dynamic_cast<const IOrderedHashTable*>(&context["Table1"]);
+        BOOST_REQUIRE(orderedHashTable != nullptr);
+        BOOST_CHECK((PrefixScan(*orderedHashTable, "key")
+            == std::vector<std::string>{ "key1=value1", "key2=value2" }));
+    }
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        htService.AddHashTable(
+            HashTableConfig(
+                "Table2",
+                HashTableConfig::Setting{ 100U },
+                HashTableConfig::Cache{ 1024, std::chrono::seconds{ 1U }, false }).SetOrderedIndex()),
+        "Ordered index on cache hash table is not supported.");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace UnitTests
+} // namespace L4
@@ -15,15 +15,16 @@ void CheckMinCounters(const HashTablePerfData& htPerfData)
     BOOST_CHECK_EQUAL(htPerfData.Get(HashTablePerfCounter::MinKeySize), maxValue);
 }
 
-BOOST_AUTO_TEST_CASE(PerfCountersTest)
+enum class TestCounter
 {
-    enum class TestCounter
-    {
-        Counter = 0,
-        Count
-    };
+    Counter = 0,
+    Count
+};
 
-    PerfCounters<TestCounter> perfCounters;
+template <typename TPerfCounters>
+void CheckPerfCounters()
+{
+    TPerfCounters perfCounters;
 
     BOOST_CHECK_EQUAL(perfCounters.Get(TestCounter::Counter), 0);
     
@@ -55,6 +56,19 @@ BOOST_AUTO_TEST_CASE(PerfCountersTest)
     BOOST_CHECK_EQUAL(perfCounters.Get(TestCounter::Counter), 1);
 }
 
+BOOST_AUTO_TEST_CASE(PerfCountersTest)
+{
+    CheckPerfCounters<PerfCounters<TestCounter>>();
+}
+
+BOOST_AUTO_TEST_CASE(SingleThreadedPerfCountersTest)
+{
+    CheckPerfCounters<SingleThreadedPerfCounters<TestCounter>>();
+
+    // The min counters are initialized as HashTablePerfData does.
+    CheckMinCounters(SingleThreadedHashTablePerfData{});
+}
+
 
 BOOST_AUTO_TEST_CASE(PerfDataTest)
 {
@@ -1,9 +1,12 @@
 #include <boost/test/unit_test.hpp>
+#include <atomic>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include "Utils.h"
 #include "Mocks.h"
+#include "CheckedAllocator.h"
 #include "L4/HashTable/ReadWrite/HashTable.h"
 #include "L4/HashTable/ReadWrite/Serializer.h"
 #include "L4/Log/PerfCounter.h"
@@ -173,6 +176,226 @@ BOOST_AUTO_TEST_CASE(HashTableSerializeTest)
         });
 }
 
+
+BOOST_AUTO_TEST_CASE(ImageSerializerTest)
+{
+    ValidateSerializer(
+        Image::Serializer<HashTable>{},
+        Image::Deserializer<Memory, HashTable>{ L4::Utils::Properties{} },
+        Image::c_version,
+        {
+            { "hello1", " world1" },
+            { "hello2", " world2" },
+            { "hello3", " world3" }
+        },
+        {
+            { HashTablePerfCounter::RecordsCount, 3 },
+            { HashTablePerfCounter::BucketsCount, 5 },
+            { HashTablePerfCounter::TotalKeySize, 18 },
+            { HashTablePerfCounter::TotalValueSize, 21 },
+            { HashTablePerfCounter::RecordsCountLoadedFromSerializer, 0 },
+            { HashTablePerfCounter::RecordsCountSavedFromSerializer, 0 }
+        },
+        {
+            { HashTablePerfCounter::RecordsCount, 3 },
+            { HashTablePerfCounter::BucketsCount, 5 },
+            { HashTablePerfCounter::TotalKeySize, 18 },
+            { HashTablePerfCounter::TotalValueSize, 21 },
+            { HashTablePerfCounter::RecordsCountLoadedFromSerializer, 0 },
+            { HashTablePerfCounter::RecordsCountSavedFromSerializer, 3 }
+        },
+        {
+            { HashTablePerfCounter::RecordsCount, 3 },
+            { HashTablePerfCounter::BucketsCount, 5 },
+            { HashTablePerfCounter::TotalKeySize, 18 },
+            { HashTablePerfCounter::TotalValueSize, 21 },
+            { HashTablePerfCounter::RecordsCountLoadedFromSerializer, 3 },
+            { HashTablePerfCounter::RecordsCountSavedFromSerializer, 0 }
+        });
+}
+
+
+BOOST_AUTO_TEST_CASE(ImageSerializerConcurrentWriteTest)
+{
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    Memory memory;
+    MockEpochManager epochManager;
+
+    const std::uint32_t c_numRecords = 1000U;
+
+    const auto getKey = [](const char* prefix, std::uint32_t i)
+    {
+        return prefix + std::to_string(i);
+    };
+
+    std::ostringstream outStream;
+    {
+        // Few buckets so that the entries are chained.
+        HashTable hashTable{ HashTable::Setting{ 3 }, memory.GetAllocator() };
+        WritableHashTable<Allocator> writableHashTable(hashTable, epochManager);
+
+        for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+        {
+            writableHashTable.Add(
+                Utils::ConvertFromString<Key>(getKey("key", i).c_str()),
+                Utils::ConvertFromString<Value>(getKey("value", i).c_str()));
+        }
+
+        // The writer chains new entries and replaces the records while the image is written.
+        std::atomic<bool> isDone{ false };
+        std::thread writer(
+            [&]()
+        {
+            for (std::uint32_t i = 0U; !isDone; i = (i + 1U) % c_numRecords)
+            {
+                writableHashTable.Add(
+                    Utils::ConvertFromString<Key>(getKey("key", i).c_str()),
+                    Utils::ConvertFromString<Value>(getKey("value", i).c_str()));
+                writableHashTable.Add(
+                    Utils::ConvertFromString<Key>(getKey("new", i).c_str()),
+                    Utils::ConvertFromString<Value>(getKey("value", i).c_str()));
+            }
+        });
+
+        writableHashTable.GetSerializer()->Serialize(
+            outStream,
+            { { Image::c_formatPropertyName, Image::c_formatPropertyValue } });
+
+        isDone = true;
+        writer.join();
+    }
+
+    std::istringstream inStream(outStream.str());
+    auto hashTable = Deserializer<Memory, HashTable, WritableHashTable>{ L4::Utils::Properties{} }
+        .Deserialize(memory, inStream);
+
+    WritableHashTable<Allocator> writableHashTable(*hashTable, epochManager);
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        Value value;
+        BOOST_REQUIRE(writableHashTable.Get(Utils::ConvertFromString<Key>(getKey("key", i).c_str()), value));
+        BOOST_CHECK_EQUAL(Utils::ConvertToString(value), getKey("value", i));
+    }
+
+    // The counters restored match the records in the image, which were written while the counters changed.
+    HashTablePerfData::TValue numRecords = 0;
+    HashTablePerfData::TValue totalKeySize = 0;
+    HashTablePerfData::TValue totalValueSize = 0;
+
+    auto iterator = writableHashTable.GetIterator();
+    while (iterator->MoveNext())
+    {
+        ++numRecords;
+        totalKeySize += iterator->GetKey().m_size;
+        totalValueSize += iterator->GetValue().m_size;
+    }
+
+    Utils::ValidateCounters(
+        writableHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, numRecords },
+            { HashTablePerfCounter::TotalKeySize, totalKeySize },
+            { HashTablePerfCounter::TotalValueSize, totalValueSize },
+            { HashTablePerfCounter::RecordsCountLoadedFromSerializer, numRecords }
+        });
+}
+
+
+BOOST_AUTO_TEST_CASE(ImageSerializerChainedEntriesTest)
+{
+    // CheckedAllocator validates that the records and the entries in the image
+    // are never deallocated individually and the image itself is not leaked.
+    using CheckedMemory = LocalMemory::Memory<CheckedAllocator<>>;
+    using CheckedHashTable = WritableHashTable<CheckedAllocator<>>::HashTable;
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    CheckedMemory memory;
+    MockEpochManager epochManager;
+
+    const std::uint32_t c_numRecords = 1000U;
+
+    std::ostringstream outStream;
+    HashTablePerfData expectedPerfData;
+    {
+        // Few buckets so that the entries are chained.
+        CheckedHashTable hashTable{ CheckedHashTable::Setting{ 3 }, memory.GetAllocator() };
+        WritableHashTable<CheckedAllocator<>> writableHashTable(hashTable, epochManager);
+
+        for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+        {
+            writableHashTable.Add(
+                Utils::ConvertFromString<Key>(("key" + std::to_string(i)).c_str()),
+                Utils::ConvertFromString<Value>(std::string(i % 17 + 1U, 'v').c_str()));
+        }
+
+        writableHashTable.GetSerializer()->Serialize(
+            outStream,
+            { { Image::c_formatPropertyName, Image::c_formatPropertyValue } });
+
+        for (std::uint16_t i = 0U; i < static_cast<std::uint16_t>(HashTablePerfCounter::Count); ++i)
+        {
+            const auto counter = static_cast<HashTablePerfCounter>(i);
+            expectedPerfData.Set(counter, hashTable.m_perfData.Get(counter));
+        }
+    }
+
+    std::istringstream inStream(outStream.str());
+    auto hashTable = Deserializer<CheckedMemory, CheckedHashTable, WritableHashTable>{ L4::Utils::Properties{} }
+        .Deserialize(memory, inStream);
+
+    BOOST_CHECK(hashTable->m_image.m_buffer != nullptr);
+
+    WritableHashTable<CheckedAllocator<>> writableHashTable(*hashTable, epochManager);
+
+    Utils::ValidateCounters(
+        writableHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, c_numRecords },
+            { HashTablePerfCounter::TotalKeySize, expectedPerfData.Get(HashTablePerfCounter::TotalKeySize) },
+            { HashTablePerfCounter::TotalValueSize, expectedPerfData.Get(HashTablePerfCounter::TotalValueSize) },
+            { HashTablePerfCounter::TotalIndexSize, expectedPerfData.Get(HashTablePerfCounter::TotalIndexSize) },
+            { HashTablePerfCounter::ChainingEntriesCount, expectedPerfData.Get(HashTablePerfCounter::ChainingEntriesCount) },
+            { HashTablePerfCounter::RecordsCountLoadedFromSerializer, c_numRecords }
+        });
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        Value value;
+        BOOST_REQUIRE(writableHashTable.Get(Utils::ConvertFromString<Key>(("key" + std::to_string(i)).c_str()), value));
+        BOOST_CHECK(Utils::ConvertToString(value) == std::string(i % 17 + 1U, 'v'));
+    }
+
+    // The loaded hash table can be updated; the records in the image are replaced or removed.
+    for (std::uint32_t i = 0U; i < c_numRecords; i += 2U)
+    {
+        BOOST_CHECK(writableHashTable.Remove(Utils::ConvertFromString<Key>(("key" + std::to_string(i)).c_str())));
+        writableHashTable.Add(
+            Utils::ConvertFromString<Key>(("key" + std::to_string(i + 1U)).c_str()),
+            Utils::ConvertFromString<Value>("new"));
+    }
+
+    BOOST_CHECK_EQUAL(writableHashTable.GetPerfData().Get(HashTablePerfCounter::RecordsCount), c_numRecords / 2U);
+
+    Value value;
+    BOOST_CHECK(!writableHashTable.Get(Utils::ConvertFromString<Key>("key10"), value));
+    BOOST_CHECK(writableHashTable.Get(Utils::ConvertFromString<Key>("key11"), value));
+    BOOST_CHECK(Utils::ConvertToString(value) == "new");
+
+    // An image with a different layout cannot be loaded.
+    auto image = outStream.str();
+    image[1] ^= 0xFF;
+    std::istringstream badStream(image);
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        (Deserializer<CheckedMemory, CheckedHashTable, WritableHashTable>{ L4::Utils::Properties{} }
+            .Deserialize(memory, badStream)),
+        "The memory image layout is not compatible with the hash table.");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace UnitTests
@@ -1,4 +1,5 @@
 #include <boost/test/unit_test.hpp>
+#include <map>
 #include "Utils.h"
 #include "Mocks.h"
 #include "CheckedAllocator.h"
@@ -670,6 +671,728 @@ BOOST_AUTO_TEST_CASE(HashTableIteratorTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(MergeFromTest)
+{
+    using MergePolicy = IWritableHashTable::MergePolicy;
+
+    auto toKey = [](const std::string& str) { return Utils::ConvertFromString<IReadOnlyHashTable::Key>(str.c_str()); };
+    auto toValue = [](const std::string& str) { return Utils::ConvertFromString<IReadOnlyHashTable::Value>(str.c_str()); };
+
+    auto getValue = [&toKey](const IReadOnlyHashTable& hashTable, const std::string& key)
+    {
+        IReadOnlyHashTable::Value value;
+        return hashTable.Get(toKey(key), value) ? Utils::ConvertToString(value) : std::string("<none>");
+    };
+
+    // Each run merges { key0, key1, key2 } into { key1, key3 }.
+    auto runMerge = [&](const MergePolicy& policy, auto validate)
+    {
+        HashTable targetHashTable{ HashTable::Setting{ 7 }, m_allocator };
+        HashTable sourceHashTable{ HashTable::Setting{ 3 }, m_allocator };
+        WritableHashTable<Allocator> target(targetHashTable, m_epochManager);
+        WritableHashTable<Allocator> source(sourceHashTable, m_epochManager);
+
+        target.Add(toKey("key1"), toValue("target1"));
+        target.Add(toKey("key3"), toValue("target3"));
+
+        for (const auto& key : { "key0", "key1", "key2" })
+        {
+            source.Add(toKey(key), toValue(std::string("source") + key[3]));
+        }
+
+        target.MergeFrom(source, policy);
+
+        validate(target, source);
+
+        BOOST_CHECK_EQUAL(getValue(target, "key0"), "source0");
+        BOOST_CHECK_EQUAL(getValue(target, "key2"), "source2");
+        BOOST_CHECK_EQUAL(getValue(target, "key3"), "target3");
+        Utils::ValidateCounters(target.GetPerfData(), { { HashTablePerfCounter::RecordsCount, 4 } });
+    };
+
+    // Overwrite and copy.
+    runMerge(
+        MergePolicy{ MergePolicy::Conflict::Overwrite, {}, false, 1U },
+        [&](const IReadOnlyHashTable& target, const IReadOnlyHashTable& source)
+    {
+        BOOST_CHECK_EQUAL(getValue(target, "key1"), "source1");
+        BOOST_CHECK_EQUAL(getValue(source, "key1"), "source1");
+        Utils::ValidateCounters(source.GetPerfData(), { { HashTablePerfCounter::RecordsCount, 3 } });
+    });
+
+    // Overwrite and move: all the records are moved out of the source.
+    runMerge(
+        MergePolicy{ MergePolicy::Conflict::Overwrite, {}, true, 1U },
+        [&](const IReadOnlyHashTable& target, const IReadOnlyHashTable& source)
+    {
+        BOOST_CHECK_EQUAL(getValue(target, "key1"), "source1");
+        BOOST_CHECK(!source.GetIterator()->MoveNext());
+        Utils::ValidateCounters(
+            source.GetPerfData(),
+            {
+                { HashTablePerfCounter::RecordsCount, 0 },
+                { HashTablePerfCounter::TotalKeySize, 0 },
+                { HashTablePerfCounter::TotalValueSize, 0 }
+            });
+    });
+
+    // Keep and move: the record that is kept in the target remains in the source.
+    runMerge(
+        MergePolicy{ MergePolicy::Conflict::Keep, {}, true, 1U },
+        [&](const IReadOnlyHashTable& target, const IReadOnlyHashTable& source)
+    {
+        BOOST_CHECK_EQUAL(getValue(target, "key1"), "target1");
+        BOOST_CHECK_EQUAL(getValue(source, "key1"), "source1");
+        BOOST_CHECK_EQUAL(getValue(source, "key0"), "<none>");
+        Utils::ValidateCounters(source.GetPerfData(), { { HashTablePerfCounter::RecordsCount, 1 } });
+    });
+
+    // Merge callback.
+    runMerge(
+        MergePolicy{
+            MergePolicy::Conflict::Merge,
+            [](const IReadOnlyHashTable::Key&,
+                const IReadOnlyHashTable::Value& existingValue,
+                const IReadOnlyHashTable::Value& newValue,
+                std::vector<std::uint8_t>& mergedValue)
+            {
+                mergedValue.assign(existingValue.m_data, existingValue.m_data + existingValue.m_size);
+                mergedValue.push_back('+');
+                mergedValue.insert(mergedValue.end(), newValue.m_data, newValue.m_data + newValue.m_size);
+            },
+            true,
+            1U },
+        [&](const IReadOnlyHashTable& target, const IReadOnlyHashTable&)
+    {
+        BOOST_CHECK_EQUAL(getValue(target, "key1"), "target1+source1");
+    });
+
+    // The records are copied from a source in another epoch domain even if they can be moved.
+    {
+        MockEpochManager sourceEpochManager;
+
+        HashTable targetHashTable{ HashTable::Setting{ 7 }, m_allocator };
+        HashTable sourceHashTable{ HashTable::Setting{ 3 }, m_allocator };
+        WritableHashTable<Allocator> target(targetHashTable, m_epochManager);
+        WritableHashTable<Allocator> source(sourceHashTable, sourceEpochManager);
+
+        source.Add(toKey("key0"), toValue("source0"));
+
+        target.MergeFrom(source, MergePolicy{ MergePolicy::Conflict::Overwrite, {}, true, 1U });
+
+        BOOST_CHECK_EQUAL(getValue(target, "key0"), "source0");
+        BOOST_CHECK_EQUAL(getValue(source, "key0"), "source0");
+    }
+
+    // The records of a source bucket are admitted together against the memory budget of the target,
+    // except the ones that are kept.
+    {
+        HashTable targetHashTable{ HashTable::Setting{ 7 }, m_allocator };
+        HashTable sourceHashTable{ HashTable::Setting{ 1 }, m_allocator };
+        WritableHashTable<Allocator> target(targetHashTable, m_epochManager);
+        WritableHashTable<Allocator> source(sourceHashTable, m_epochManager);
+
+        target.Add(toKey("key1"), toValue("target1"));
+
+        for (const auto& key : { "key0", "key1", "key2" })
+        {
+            source.Add(toKey(key), toValue(std::string("source") + key[3]));
+        }
+
+        const auto usedSize =
+            target.GetPerfData().Get(HashTablePerfCounter::TotalKeySize)
+            + target.GetPerfData().Get(HashTablePerfCounter::TotalValueSize)
+            + target.GetPerfData().Get(HashTablePerfCounter::TotalIndexSize);
+
+        // Room for one more record, while "key0" and "key2" are in the same source bucket.
+        target.SetMemoryBudget(std::make_shared<L4::HashTable::MemoryBudget>(usedSize + 11U));
+
+        CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+            target.MergeFrom(source, MergePolicy{ MergePolicy::Conflict::Keep, {}, false, 1U }),
+            "Memory budget of the hash table is exceeded.");
+
+        BOOST_CHECK_EQUAL(getValue(target, "key0"), "<none>");
+        BOOST_CHECK_EQUAL(getValue(target, "key1"), "target1");
+        BOOST_CHECK_EQUAL(getValue(target, "key2"), "<none>");
+
+        // The callback is called without the source bucket locked, thus it can remove records from the source.
+        target.SetMemoryBudget(std::make_shared<L4::HashTable::MemoryBudget>(
+            usedSize + 11U,
+            L4::HashTable::MemoryBudget::Action::Callback,
+            std::chrono::milliseconds{ 0U },
+            [&source, &toKey](std::uint64_t recordSize, std::uint64_t)
+        {
+            BOOST_CHECK_EQUAL(recordSize, 22U);
+            return source.Remove(toKey("key2"));
+        }));
+
+        target.MergeFrom(source, MergePolicy{ MergePolicy::Conflict::Keep, {}, false, 1U });
+
+        BOOST_CHECK_EQUAL(getValue(target, "key0"), "source0");
+        BOOST_CHECK_EQUAL(getValue(target, "key1"), "target1");
+        BOOST_CHECK_EQUAL(getValue(target, "key2"), "<none>");
+    }
+
+    // Invalid arguments.
+    HashTable hashTable{ HashTable::Setting{ 5 }, m_allocator };
+    WritableHashTable<Allocator> writableHashTable(hashTable, m_epochManager);
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        writableHashTable.MergeFrom(writableHashTable, MergePolicy{}),
+        "Merging a hash table into itself is not allowed.");
+
+    HashTable fixedHashTable{ HashTable::Setting{ 5, 1, 4, 4 }, m_allocator };
+    WritableHashTable<Allocator> fixedWritableHashTable(fixedHashTable, m_epochManager);
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        writableHashTable.MergeFrom(fixedWritableHashTable, MergePolicy{}),
+        "Merging from a hash table with a different record layout is not supported.");
+}
+
+
+BOOST_AUTO_TEST_CASE(ParallelMergeFromTest)
+{
+    using StdAllocator = std::allocator<void>;
+    using StdHashTable = WritableHashTable<StdAllocator>::HashTable;
+    using MergePolicy = IWritableHashTable::MergePolicy;
+
+    constexpr std::uint32_t c_numRecords = 10000U;
+
+    StdHashTable targetHashTable{ StdHashTable::Setting{ 1000 }, StdAllocator() };
+    StdHashTable sourceHashTable{ StdHashTable::Setting{ 1000 }, StdAllocator() };
+    WritableHashTable<StdAllocator> target(targetHashTable, m_epochManager);
+    WritableHashTable<StdAllocator> source(sourceHashTable, m_epochManager);
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        const auto value = "value" + std::to_string(i);
+        source.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    }
+
+    target.MergeFrom(source, MergePolicy{ MergePolicy::Conflict::Overwrite, {}, true, 8U });
+
+    Utils::ValidateCounters(target.GetPerfData(), { { HashTablePerfCounter::RecordsCount, c_numRecords } });
+    Utils::ValidateCounters(source.GetPerfData(), { { HashTablePerfCounter::RecordsCount, 0 } });
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        IReadOnlyHashTable::Value value;
+        BOOST_REQUIRE(target.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()), value));
+        BOOST_CHECK_EQUAL(Utils::ConvertToString(value), "value" + std::to_string(i));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(NearCacheTest)
+{
+    HashTable hashTable{ HashTable::Setting{ 10, 2 }, m_allocator };
+    WritableHashTable<Allocator> writableHashTable(hashTable, m_epochManager);
+    ReadOnlyHashTable<Allocator> readOnlyHashTable(hashTable);
+
+    readOnlyHashTable.EnableNearCache();
+
+    auto get = [&readOnlyHashTable](const char* key, std::string& value)
+    {
+        IReadOnlyHashTable::Value valueFound;
+        if (!readOnlyHashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>(key), valueFound))
+        {
+            return false;
+        }
+
+        value = Utils::ConvertToString(valueFound);
+        return true;
+    };
+
+    auto add = [&writableHashTable](const std::string& key, const std::string& value)
+    {
+        writableHashTable.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    };
+
+    constexpr std::uint32_t c_numRecords = 100U;
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        add("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+
+    std::string value;
+
+    // The second look up of each key is served from the near cache.
+    for (std::uint32_t round = 0U; round < 2U; ++round)
+    {
+        for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+        {
+            BOOST_REQUIRE(get(("key" + std::to_string(i)).c_str(), value));
+            BOOST_CHECK_EQUAL(value, "value" + std::to_string(i));
+        }
+    }
+
+    // Updates invalidate the cached records.
+    add("key1", "newValue1");
+    BOOST_REQUIRE(get("key1", value));
+    BOOST_CHECK_EQUAL(value, "newValue1");
+
+    BOOST_CHECK(writableHashTable.Remove(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key2")));
+    BOOST_CHECK(!get("key2", value));
+
+    add("key2", "newValue2");
+    BOOST_REQUIRE(get("key2", value));
+    BOOST_CHECK_EQUAL(value, "newValue2");
+
+    // Another hash table with the same key doesn't hit the entries cached for this hash table.
+    HashTable otherHashTable{ HashTable::Setting{ 10 }, m_allocator };
+    WritableHashTable<Allocator> otherWritableHashTable(otherHashTable, m_epochManager);
+    otherWritableHashTable.EnableNearCache();
+
+    IReadOnlyHashTable::Value otherValue;
+    BOOST_CHECK(!otherWritableHashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>("key3"), otherValue));
+
+    BOOST_REQUIRE(get("key3", value));
+    BOOST_CHECK_EQUAL(value, "value3");
+
+    // The versions are allocated per mutex and accounted as the index size.
+    HashTable hashTableWithoutVersions{ HashTable::Setting{ 10, 2 }, m_allocator };
+    BOOST_CHECK(hashTable.HasVersions());
+    BOOST_CHECK(!hashTableWithoutVersions.HasVersions());
+    BOOST_CHECK_EQUAL(hashTable.m_versions.size(), 5U);
+
+    const auto indexSizeWithoutVersions =
+        hashTableWithoutVersions.m_perfData.Get(HashTablePerfCounter::TotalIndexSize);
+    hashTableWithoutVersions.EnableVersions();
+    BOOST_CHECK_EQUAL(
+        hashTableWithoutVersions.m_perfData.Get(HashTablePerfCounter::TotalIndexSize) - indexSizeWithoutVersions,
+        static_cast<HashTablePerfData::TValue>(5U * sizeof(HashTable::Version)));
+}
+
+
+BOOST_AUTO_TEST_CASE(ConditionalWriteTest)
+{
+    // One bucket with a single entry, so that the chain is full after 16 records.
+    HashTable hashTable{ HashTable::Setting{ 1 }, m_allocator };
+    WritableHashTable<Allocator> writableHashTable(hashTable, m_epochManager);
+
+    auto toKey = [](const std::string& key)
+    {
+        return Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str());
+    };
+
+    auto toValue = [](const std::string& value)
+    {
+        return Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str());
+    };
+
+    auto get = [&writableHashTable, &toKey](const std::string& key)
+    {
+        IReadOnlyHashTable::Value value;
+        return writableHashTable.Get(toKey(key), value) ? Utils::ConvertToString(value) : std::string{ "<none>" };
+    };
+
+    const auto& allocations = *m_allocator.m_allocationAddresses;
+
+    for (std::uint32_t i = 0U; i < HashTable::Entry::c_numDataPerEntry; ++i)
+    {
+        BOOST_CHECK(writableHashTable.AddIfAbsent(toKey("key" + std::to_string(i)), toValue("value" + std::to_string(i))));
+    }
+
+    const auto numAllocations = allocations.size();
+
+    // The writes that are not needed allocate neither a record nor a chained entry.
+    BOOST_CHECK(!writableHashTable.AddIfAbsent(toKey("key1"), toValue("newValue1")));
+    BOOST_CHECK(!writableHashTable.ReplaceIfPresent(toKey("key100"), toValue("value100")));
+    BOOST_CHECK(!writableHashTable.ReplaceIfEqual(toKey("key2"), toValue("wrongValue"), toValue("newValue2")));
+    BOOST_CHECK(!writableHashTable.ReplaceIfEqual(toKey("key100"), toValue("value100"), toValue("newValue100")));
+    BOOST_CHECK_EQUAL(allocations.size(), numAllocations);
+
+    BOOST_CHECK_EQUAL(get("key1"), "value1");
+    BOOST_CHECK_EQUAL(get("key2"), "value2");
+    BOOST_CHECK_EQUAL(get("key100"), "<none>");
+
+    BOOST_CHECK(writableHashTable.ReplaceIfPresent(toKey("key1"), toValue("newValue1")));
+    BOOST_CHECK(writableHashTable.ReplaceIfEqual(toKey("key2"), toValue("value2"), toValue("newValue2")));
+    BOOST_CHECK_EQUAL(get("key1"), "newValue1");
+    BOOST_CHECK_EQUAL(get("key2"), "newValue2");
+
+    // The chain is full, thus a new entry is chained.
+    BOOST_CHECK(writableHashTable.AddIfAbsent(toKey("key100"), toValue("value100")));
+    BOOST_CHECK_EQUAL(get("key100"), "value100");
+
+    Utils::ValidateCounters(
+        writableHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, HashTable::Entry::c_numDataPerEntry + 1 },
+            { HashTablePerfCounter::ChainingEntriesCount, 1 },
+            { HashTablePerfCounter::MaxBucketChainLength, 2 }
+        });
+
+    // A removed key can be added again.
+    BOOST_CHECK(writableHashTable.Remove(toKey("key3")));
+    BOOST_CHECK(!writableHashTable.ReplaceIfPresent(toKey("key3"), toValue("newValue3")));
+    BOOST_CHECK(writableHashTable.AddIfAbsent(toKey("key3"), toValue("newValue3")));
+    BOOST_CHECK_EQUAL(get("key3"), "newValue3");
+}
+
+
+BOOST_AUTO_TEST_CASE(RemoveIfTest)
+{
+    // The buckets are swept by multiple threads, and CheckedAllocator is not thread-safe.
+    using StdAllocator = std::allocator<void>;
+    using StdHashTable = WritableHashTable<StdAllocator>::HashTable;
+    using RemovePolicy = IWritableHashTable::RemovePolicy;
+
+    constexpr std::uint32_t c_numRecords = 10000U;
+    constexpr std::uint32_t c_numBuckets = 1000U;
+
+    StdHashTable hashTable{ StdHashTable::Setting{ c_numBuckets, 10 }, StdAllocator() };
+    WritableHashTable<StdAllocator> writableHashTable(hashTable, m_epochManager);
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        const auto key = ((i % 4U == 0U) ? "stale" : "key") + std::to_string(i);
+        const auto value = "value" + std::to_string(i);
+        writableHashTable.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    }
+
+    std::vector<RemovePolicy::Progress> progresses;
+
+    const auto numRemoved = writableHashTable.RemoveIf(
+        RemovePolicy{
+            [](const IReadOnlyHashTable::Key& key, const IReadOnlyHashTable::Value&)
+            {
+                return Utils::ConvertToString(key).compare(0U, 5U, "stale") == 0;
+            },
+            4U,
+            100U,
+            std::chrono::microseconds{ 10 },
+            [&progresses](const RemovePolicy::Progress& progress)
+            {
+                progresses.push_back(progress);
+            } });
+
+    BOOST_CHECK_EQUAL(numRemoved, c_numRecords / 4U);
+
+    Utils::ValidateCounters(
+        writableHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, c_numRecords - c_numRecords / 4U }
+        });
+
+    // 4 threads sweep 250 buckets each in batches of 100 buckets.
+    BOOST_REQUIRE_EQUAL(progresses.size(), 12U);
+    for (std::size_t i = 1U; i < progresses.size(); ++i)
+    {
+        BOOST_CHECK(progresses[i].m_numBucketsSwept > progresses[i - 1U].m_numBucketsSwept);
+        BOOST_CHECK(progresses[i].m_numRecordsRemoved >= progresses[i - 1U].m_numRecordsRemoved);
+    }
+
+    BOOST_CHECK_EQUAL(progresses.back().m_numBucketsSwept, c_numBuckets);
+    BOOST_CHECK_EQUAL(progresses.back().m_numBuckets, c_numBuckets);
+    BOOST_CHECK_EQUAL(progresses.back().m_numRecordsRemoved, numRemoved);
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        const auto key = ((i % 4U == 0U) ? "stale" : "key") + std::to_string(i);
+        IReadOnlyHashTable::Value value;
+        BOOST_CHECK_EQUAL(
+            writableHashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()), value),
+            i % 4U != 0U);
+    }
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        writableHashTable.RemoveIf(RemovePolicy{ {} }),
+        "Remove predicate is not set.");
+}
+
+
+BOOST_AUTO_TEST_CASE(ReserveTest)
+{
+    using StdAllocator = std::allocator<void>;
+    using StdHashTable = WritableHashTable<StdAllocator>::HashTable;
+
+    constexpr std::uint32_t c_numRecords = 4000U;
+    constexpr std::uint32_t c_numBuckets = 100U;
+
+    StdHashTable hashTable{ StdHashTable::Setting{ c_numBuckets }, StdAllocator() };
+    WritableHashTable<StdAllocator> writableHashTable(hashTable, m_epochManager);
+
+    const auto getKey = [](std::uint32_t i)
+    {
+        return "key" + std::to_string(i);
+    };
+
+    std::uint64_t numBytes = 0U;
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        numBytes += 2U * getKey(i).size();
+    }
+
+    writableHashTable.Reserve(c_numRecords, numBytes);
+
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        writableHashTable.Reserve(c_numRecords, numBytes),
+        "Capacity is already reserved for the hash table.");
+
+    // The keys are used as the values so that the records total the reserved bytes.
+    const auto add = [&writableHashTable](const std::string& key, const std::string& value)
+    {
+        writableHashTable.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    };
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        add(getKey(i), getKey(i));
+    }
+
+    // All the chained entries and records are carved out of the reservation.
+    std::uint32_t numRecords = 0U;
+    std::uint32_t numChainedEntries = 0U;
+
+    for (auto& bucket : hashTable.m_buckets)
+    {
+        for (auto* entry = &bucket; entry != nullptr; entry = entry->m_next.Load())
+        {
+            if (entry != &bucket)
+            {
+                BOOST_CHECK(hashTable.m_reservation.Contains(entry));
+                ++numChainedEntries;
+            }
+
+            for (auto& data : entry->m_dataList)
+            {
+                if (data.Load() != nullptr)
+                {
+                    BOOST_CHECK(hashTable.m_reservation.Contains(data.Load()));
+                    ++numRecords;
+                }
+            }
+        }
+    }
+
+    BOOST_CHECK_EQUAL(numRecords, c_numRecords);
+    BOOST_CHECK(numChainedEntries > 0U);
+
+    // The reserved records are already packed.
+    const auto result = writableHashTable.Relocate(IWritableHashTable::RelocationPolicy{ 0.0 });
+    BOOST_CHECK_EQUAL(result.m_numRecordsRelocated, 0U);
+
+    // The reserved records are replaced and removed without being deallocated individually,
+    // and the records beyond the reservation are allocated by the allocator.
+    const std::string newValue(c_numRecords * 8U, 'v');
+    add(getKey(0U), newValue);
+    BOOST_CHECK(writableHashTable.Remove(Utils::ConvertFromString<IReadOnlyHashTable::Key>(getKey(1U).c_str())));
+
+    IReadOnlyHashTable::Value value;
+    BOOST_REQUIRE(writableHashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>(getKey(0U).c_str()), value));
+    BOOST_CHECK(!hashTable.m_reservation.Contains(value.m_data));
+    BOOST_CHECK_EQUAL(Utils::ConvertToString(value), newValue);
+
+    Utils::ValidateCounters(
+        writableHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, c_numRecords - 1U }
+        });
+
+    for (std::uint32_t i = 2U; i < c_numRecords; ++i)
+    {
+        BOOST_REQUIRE(writableHashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>(getKey(i).c_str()), value));
+        BOOST_CHECK_EQUAL(Utils::ConvertToString(value), getKey(i));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(RelocateTest)
+{
+    // Fragmentation is estimated from the record addresses returned by the system allocator.
+    using StdAllocator = std::allocator<void>;
+    using StdHashTable = WritableHashTable<StdAllocator>::HashTable;
+    using RelocationPolicy = IWritableHashTable::RelocationPolicy;
+
+    constexpr std::uint32_t c_numRecords = 4000U;
+    constexpr std::uint32_t c_numBuckets = 1000U;
+
+    StdHashTable hashTable{ StdHashTable::Setting{ c_numBuckets, 10 }, StdAllocator() };
+    WritableHashTable<StdAllocator> writableHashTable(hashTable, m_epochManager);
+
+    const auto getValue = [](std::uint32_t i)
+    {
+        return std::string(100U, 'a' + static_cast<char>(i % 26U)) + std::to_string(i);
+    };
+
+    // The records are allocated in the insertion order, which is not the bucket order.
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        const auto value = getValue(i);
+        writableHashTable.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    }
+
+    // Nothing is relocated if the fragmentation is below the threshold.
+    auto result = writableHashTable.Relocate(RelocationPolicy{ 1000.0 });
+    BOOST_CHECK_EQUAL(result.m_numBucketsRelocated, 0U);
+    BOOST_CHECK_EQUAL(result.m_numRecordsRelocated, 0U);
+
+    const auto initialFragmentation = result.m_fragmentation;
+    BOOST_CHECK(initialFragmentation > 2.0);
+
+    result = writableHashTable.Relocate(RelocationPolicy{ 2.0 });
+    BOOST_CHECK_EQUAL(result.m_numBucketsRelocated, c_numBuckets);
+    BOOST_CHECK_EQUAL(result.m_numRecordsRelocated, c_numRecords);
+    BOOST_CHECK_EQUAL(result.m_fragmentation, initialFragmentation);
+
+    // The records are now mostly packed in the bucket order, where the exact placement
+    // depends on the free memory that the system allocator reuses.
+    result = writableHashTable.Relocate(RelocationPolicy{ 1000.0, 2U, 100U });
+    BOOST_CHECK_EQUAL(result.m_numRecordsRelocated, 0U);
+    BOOST_CHECK(result.m_fragmentation < initialFragmentation / 2.0);
+
+    Utils::ValidateCounters(
+        writableHashTable.GetPerfData(),
+        {
+            { HashTablePerfCounter::RecordsCount, c_numRecords }
+        });
+
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        IReadOnlyHashTable::Value value;
+        BOOST_REQUIRE(writableHashTable.Get(Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()), value));
+        BOOST_CHECK_EQUAL(Utils::ConvertToString(value), getValue(i));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(ScanTest)
+{
+    using ScanCursor = IReadOnlyHashTable::ScanCursor;
+
+    // A few buckets so that the pages end in the middle of the chains.
+    HashTable hashTable{ HashTable::Setting{ 5U }, m_allocator };
+    WritableHashTable<Allocator> writableHashTable(hashTable, m_epochManager);
+
+    const auto add = [&writableHashTable](const std::string& key, const std::string& value)
+    {
+        writableHashTable.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(value.c_str()));
+    };
+
+    constexpr std::uint32_t c_numRecords = 200U;
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        add("key" + std::to_string(i), "value");
+    }
+
+    std::map<std::string, std::uint32_t> numVisits;
+    std::uint32_t numPages = 0U;
+
+    ScanCursor cursor;
+    BOOST_CHECK(!cursor.IsEnd());
+
+    while (!cursor.IsEnd())
+    {
+        std::uint32_t numRecords = 0U;
+        cursor = writableHashTable.Scan(
+            cursor,
+            7U,
+            [&numVisits, &numRecords](const IReadOnlyHashTable::Key& key, const IReadOnlyHashTable::Value&)
+            {
+                ++numVisits[Utils::ConvertToString(key)];
+                ++numRecords;
+            });
+
+        BOOST_CHECK(numRecords <= 7U);
+
+        // The records are updated, added and removed between the pages.
+        add("key" + std::to_string(numPages), "updated");
+        add("new" + std::to_string(numPages), "value");
+        writableHashTable.Remove(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(("key" + std::to_string(c_numRecords - 1U - numPages)).c_str()));
+
+        ++numPages;
+    }
+
+    BOOST_CHECK(numPages > c_numRecords / 7U);
+    BOOST_CHECK_EQUAL(cursor.m_bucketIndex, 5U);
+
+    // The records that are not removed during the scan are visited exactly once.
+    for (std::uint32_t i = 0U; i < c_numRecords - numPages; ++i)
+    {
+        BOOST_CHECK_EQUAL(numVisits["key" + std::to_string(i)], 1U);
+    }
+
+    for (const auto& visit : numVisits)
+    {
+        BOOST_CHECK_EQUAL(visit.second, 1U);
+    }
+
+    // The scan at the end returns no record.
+    BOOST_CHECK(writableHashTable.Scan(cursor, 7U, [](const IReadOnlyHashTable::Key&, const IReadOnlyHashTable::Value&)
+    {
+        BOOST_FAIL("No record is expected.");
+    }).IsEnd());
+
+    HashTable otherHashTable{ HashTable::Setting{ 10U }, m_allocator };
+    WritableHashTable<Allocator> otherWritableHashTable(otherHashTable, m_epochManager);
+    CHECK_EXCEPTION_THROWN_WITH_MESSAGE(
+        otherWritableHashTable.Scan(cursor, 7U, [](const IReadOnlyHashTable::Key&, const IReadOnlyHashTable::Value&) {}),
+        "The scan cursor belongs to a hash table with a different number of buckets.");
+}
+
+
+BOOST_AUTO_TEST_CASE(SampleTest)
+{
+    // A few buckets so that the chains have different lengths.
+    HashTable hashTable{ HashTable::Setting{ 10U }, m_allocator };
+    WritableHashTable<Allocator> writableHashTable(hashTable, m_epochManager);
+
+    const auto ignore = [](const IReadOnlyHashTable::Key&, const IReadOnlyHashTable::Value&) {};
+    BOOST_CHECK_EQUAL(writableHashTable.Sample(10U, ignore), 0U);
+
+    constexpr std::uint32_t c_numRecords = 400U;
+    for (std::uint32_t i = 0U; i < c_numRecords; ++i)
+    {
+        const auto key = "key" + std::to_string(i);
+        writableHashTable.Add(
+            Utils::ConvertFromString<IReadOnlyHashTable::Key>(key.c_str()),
+            Utils::ConvertFromString<IReadOnlyHashTable::Value>(key.c_str()));
+    }
+
+    // Each record is expected to be sampled 100 times, with the standard deviation of 10.
+    constexpr std::uint32_t c_numSamples = c_numRecords * 100U;
+
+    std::map<std::string, std::uint32_t> numSamples;
+    bool areValuesValid = true;
+    BOOST_CHECK_EQUAL(
+        writableHashTable.Sample(
+            c_numSamples,
+            [&numSamples, &areValuesValid](const IReadOnlyHashTable::Key& key, const IReadOnlyHashTable::Value& value)
+            {
+                const auto keyString = Utils::ConvertToString(key);
+                areValuesValid = areValuesValid && (keyString == Utils::ConvertToString(value));
+                ++numSamples[keyString];
+            }),
+        c_numSamples);
+
+    BOOST_CHECK(areValuesValid);
+
+    BOOST_CHECK_EQUAL(numSamples.size(), c_numRecords);
+    for (const auto& sample : numSamples)
+    {
+        BOOST_CHECK(sample.second > 40U && sample.second < 160U);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace UnitTests
@@ -1,6 +1,10 @@
 #include <boost/test/unit_test.hpp>
 #include <array>
+#include <cstdint>
+#include <vector>
 #include "L4/Utils/Math.h"
+#include "L4/Utils/MurmurHash3.h"
+#include "L4/Utils/MurmurHash3Batch.h"
 
 namespace L4
 {
@@ -50,5 +54,74 @@ BOOST_AUTO_TEST_CASE(PointerArithmeticTest)
     BOOST_CHECK(Math::PointerArithmetic::Distance(&elements[0], &elements[2]) == sizeof(int) * 2U);
 }
 
+
+
+BOOST_AUTO_TEST_CASE(MurmurHash3BatchTest)
+{
+    // Keys are unaligned and cover the tail lengths, multiple blocks and the partial lanes.
+    std::vector<std::uint8_t> buffer(4096U);
+    for (std::size_t i = 0U; i < buffer.size(); ++i)
+    {
+        buffer[i] = static_cast<std::uint8_t>(i * 131U + 7U);
+    }
+
+    const std::uint32_t seed = 13U;
+
+    for (const auto kernel : { HashKernel::Scalar, HashKernel::Avx2, HashKernel::Avx512 })
+    {
+        if (!IsHashKernelSupported(kernel))
+        {
+            continue;
+        }
+
+        for (int len = 0; len <= 48; ++len)
+        {
+            for (const std::size_t numKeys : { 1U, 3U, 4U, 7U, 8U, 13U, 16U, 37U })
+            {
+                std::vector<const void*> keys;
+                for (std::size_t i = 0U; i < numKeys; ++i)
+                {
+                    keys.push_back(buffer.data() + (i * 53U + len) % 1024U);
+                }
+
+                std::vector<std::array<std::uint64_t, 2U>> hashes(numKeys);
+                MurmurHash3_x64_128_Batch(keys.data(), len, seed, numKeys, hashes.data(), kernel);
+
+                for (std::size_t i = 0U; i < numKeys; ++i)
+                {
+                    std::array<std::uint64_t, 2U> expected;
+                    MurmurHash3_x64_128(keys[i], len, seed, expected.data());
+
+                    BOOST_REQUIRE(hashes[i] == expected);
+                }
+            }
+        }
+
+        // Keys of different lengths are grouped by the lengths.
+        const std::size_t numKeys = 150U;
+
+        std::vector<const void*> keys;
+        std::vector<int> lens;
+        for (std::size_t i = 0U; i < numKeys; ++i)
+        {
+            keys.push_back(buffer.data() + i * 7U);
+            lens.push_back(static_cast<int>((i * i) % 41U));
+        }
+
+        std::vector<std::array<std::uint64_t, 2U>> hashes(numKeys);
+        MurmurHash3_x64_128_Batch(keys.data(), lens.data(), seed, numKeys, hashes.data(), kernel);
+
+        for (std::size_t i = 0U; i < numKeys; ++i)
+        {
+            std::array<std::uint64_t, 2U> expected;
+            MurmurHash3_x64_128(keys[i], lens[i], seed, expected.data());
+
+            BOOST_REQUIRE(hashes[i] == expected);
+        }
+    }
+
+    BOOST_CHECK(IsHashKernelSupported(GetBestHashKernel()));
+}
+
 } // namespace UnitTests
 } // namespace L4
@@ -15,18 +15,23 @@ struct EpochManagerConfig
     // the actions are performed in parallel.
     // "maxNumThreadsToPerformActions" indicates how many threads will be used when
     // performing an action in parallel.
+    // "maxNumActionQueues" indicates how many action queues can be used when the number is
+    // raised at runtime (see LocalMemory::SelfTuner), where 0 means "numActionQueues".
     explicit EpochManagerConfig(
         std::uint32_t epochQueueSize = 1000,
         std::chrono::milliseconds epochProcessingInterval = std::chrono::milliseconds{ 1000 },
-        std::uint8_t numActionQueues = 1)
+        std::uint8_t numActionQueues = 1,
+        std::uint8_t maxNumActionQueues = 0)
         : m_epochQueueSize{ epochQueueSize }
         , m_epochProcessingInterval{ epochProcessingInterval }
         , m_numActionQueues{ numActionQueues }
+        , m_maxNumActionQueues{ maxNumActionQueues }
     {}
 
     std::uint32_t m_epochQueueSize;
     std::chrono::milliseconds m_epochProcessingInterval;
     std::uint8_t m_numActionQueues;
+    std::uint8_t m_maxNumActionQueues;
 };
 
 } // namespace L4
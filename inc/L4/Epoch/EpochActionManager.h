@@ -24,16 +24,28 @@ public:
     // increase the throughput of registering an action. This will be re-calculated to
     // the next highest power of two so that the "&" operator can be used for accessing
     // the next queue.
-    explicit EpochActionManager(std::uint8_t numActionQueues);
+    // "maxNumActionQueues" is the number up to which the queues in use can be raised at runtime
+    // (see SetNumActionQueues()), where 0 means "numActionQueues". The queues are all allocated
+    // upfront so that changing the number in use never moves the registered actions.
+    explicit EpochActionManager(std::uint8_t numActionQueues, std::uint8_t maxNumActionQueues = 0U);
 
-    // Adds an action at a given epoch counter.
+    // Adds an action at a given epoch counter, and returns true if the queue was locked by
+    // another thread, which is how the contention on the queues is observed.
     // This function is thread-safe.
-    void RegisterAction(std::uint64_t epochCounter, IEpochActionManager::Action&& action);
+    bool RegisterAction(std::uint64_t epochCounter, IEpochActionManager::Action&& action);
 
     // Perform actions whose associated epoch counter value is less than
     // the given epoch counter value, and returns the number of actions performed.
     std::uint64_t PerformActions(std::uint64_t epochCounter);
 
+    std::uint32_t GetNumActionQueues() const;
+
+    std::uint32_t GetMaxNumActionQueues() const;
+
+    // Sets the number of queues in use to the highest power of two not greater than
+    // the given number, within [1, GetMaxNumActionQueues()]. This function is thread-safe.
+    void SetNumActionQueues(std::uint32_t numActionQueues);
+
     EpochActionManager(const EpochActionManager&) = delete;
     EpochActionManager& operator=(const EpochActionManager&) = delete;
 
@@ -57,6 +69,9 @@ private:
 
     // Used to point to the next EpochToActions to simulate round-robin access.
     std::atomic<std::uint32_t> m_counter;
+
+    // The number of queues in use - 1, which is a mask since the number is a power of two.
+    std::atomic<std::uint32_t> m_queueIndexMask;
 };
 
 
@@ -19,4 +19,15 @@ struct IEpochActionManager
 };
 
 
+// ImmediateEpochActionManager performs an action as soon as it is registered, which is
+// for the hash tables that are never read while being updated (e.g., confined to a thread).
+struct ImmediateEpochActionManager : public IEpochActionManager
+{
+    virtual void RegisterAction(Action&& action) override
+    {
+        action();
+    }
+};
+
+
 } // namespace L4
\ No newline at end of file
@@ -1,15 +1,24 @@
 #pragma once
 
+#include <boost/optional.hpp>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
+#include <vector>
 #include "detail/ToRawPointer.h"
 #include "Epoch/IEpochActionManager.h"
 #include "HashTable/IHashTable.h"
 #include "HashTable/ReadWrite/HashTable.h"
 #include "HashTable/Cache/Metadata.h"
+#include "HashTable/Cache/MetadataArray.h"
 #include "Utils/Clock.h"
+#include "Utils/Exception.h"
+#include "Utils/RunningThread.h"
 
 namespace L4
 {
@@ -32,24 +41,35 @@ public:
     using Key = typename Base::Key;
     using Value = typename Base::Value;
     using IIteratorPtr = typename Base::IIteratorPtr;
+    using ScanCursor = typename Base::ScanCursor;
+    using ScanVisitor = typename Base::ScanVisitor;
 
     class Iterator;
 
+    // "metadataSize" is the size of the prefix of the stored values,
+    // which is Metadata::c_writeBackMetaDataSize for a write-back cache.
+    // If "useMetadataArray" is true, the access bits and the epoch times of the records in
+    // the bucket entries are kept in a MetadataArray, which is built from the existing records.
     ReadOnlyHashTable(
         HashTable& hashTable,
-        std::chrono::seconds recordTimeToLive)
+        std::chrono::seconds recordTimeToLive,
+        std::uint16_t metadataSize = Metadata::c_metaDataSize,
+        bool useMetadataArray = false)
         : Base(
             hashTable,
             RecordSerializer{
                 hashTable.m_setting.m_fixedKeySize,
                 hashTable.m_setting.m_fixedValueSize,
-                Metadata::c_metaDataSize })
+                metadataSize })
         , m_recordTimeToLive{ recordTimeToLive }
+        , m_metadataSize{ metadataSize }
+        , m_metadataArray{ useMetadataArray ? CreateMetadataArray() : nullptr }
     {}
 
     virtual bool Get(const Key& key, Value& value) const override
     {
-        const auto status = GetInternal(key, value);
+        const auto hash = this->GetHash(key);
+        const auto status = GetInternal(key, hash, value);
 
         // Note that the following const_cast is safe and necessary to update cache hit information.
         const_cast<HashTablePerfData&>(this->GetPerfData()).Increment(
@@ -57,6 +77,8 @@ public:
             ? HashTablePerfCounter::CacheHitCount
             : HashTablePerfCounter::CacheMissCount);
 
+        this->RecordOperation(OperationType::Get, key, hash, status ? value.m_size : 0U, status);
+
         return status;
     }
 
@@ -66,21 +88,73 @@ public:
             this->m_hashTable,
             this->m_recordSerializer,
             m_recordTimeToLive,
-            this->GetCurrentEpochTime());
+            this->GetCurrentEpochTime(),
+            m_metadataSize);
+    }
+
+    // The expired records are skipped, and the visitor is called with the values without the metadata.
+    virtual ScanCursor Scan(const ScanCursor& cursor, std::uint32_t maxRecords, const ScanVisitor& visitor) const override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+
+        return this->ScanRecords(cursor, maxRecords, [this, &visitor, curEpochTime](const Record& record)
+        {
+            const Metadata metaData{ const_cast<std::uint32_t*>(reinterpret_cast<const std::uint32_t*>(record.m_value.m_data)) };
+            if (metaData.IsExpired(curEpochTime, m_recordTimeToLive))
+            {
+                return false;
+            }
+
+            visitor(
+                record.m_key,
+                Value{ record.m_value.m_data + m_metadataSize, record.m_value.m_size - m_metadataSize });
+
+            return true;
+        });
+    }
+
+    // The expired records are rejected as the empty slots are.
+    virtual std::uint32_t Sample(std::uint32_t numRecords, const ScanVisitor& visitor) const override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+
+        return this->SampleRecords(numRecords, [this, &visitor, curEpochTime](const Record& record)
+        {
+            const Metadata metaData{ const_cast<std::uint32_t*>(reinterpret_cast<const std::uint32_t*>(record.m_value.m_data)) };
+            if (metaData.IsExpired(curEpochTime, m_recordTimeToLive))
+            {
+                return false;
+            }
+
+            visitor(
+                record.m_key,
+                Value{ record.m_value.m_data + m_metadataSize, record.m_value.m_size - m_metadataSize });
+
+            return true;
+        });
     }
 
     ReadOnlyHashTable(const ReadOnlyHashTable&) = delete;
     ReadOnlyHashTable& operator=(const ReadOnlyHashTable&) = delete;
 
 protected:
-    bool GetInternal(const Key& key, Value& value) const
+    using typename Base::Hash;
+
+    static_assert(
+        MetadataArray<Allocator>::c_numSlotsPerBucket == HashTable::Entry::c_numDataPerEntry,
+        "MetadataArray should have a slot per data of the bucket entry.");
+
+    bool GetInternal(const Key& key, const Hash& hash, Value& value) const
     {
-        if (!Base::Get(key, value))
+        std::uint32_t bucketIndex;
+        std::uint8_t slotIndex;
+
+        if (!GetValueAndSlot(key, hash, value, bucketIndex, slotIndex))
         {
             return false;
         }
 
-        assert(value.m_size > Metadata::c_metaDataSize);
+        assert(value.m_size > m_metadataSize);
 
         // If the record with the given key is found, check if the record is expired or not.
         // Note that the following const_cast is safe and necessary to update the access status.
@@ -90,15 +164,85 @@ protected:
             return false;
         }
 
-        metaData.UpdateAccessStatus(true);
+        if (slotIndex < HashTable::Entry::c_numDataPerEntry)
+        {
+            m_metadataArray->SetAccessed(bucketIndex, slotIndex);
+        }
+        else
+        {
+            metaData.UpdateAccessStatus(true);
+        }
 
-        value.m_data += Metadata::c_metaDataSize;
-        value.m_size -= Metadata::c_metaDataSize;
+        value.m_data += m_metadataSize;
+        value.m_size -= m_metadataSize;
+
+        return true;
+    }
+
+    // Same as Base::GetValue(), but if the record is tracked by the metadata array, "slotIndex"
+    // is set to the index of the record in the bucket entry (Entry::c_numDataPerEntry otherwise).
+    // The near cache is bypassed with the metadata array, since it doesn't return the slot.
+    bool GetValueAndSlot(
+        const Key& key,
+        const Hash& hash,
+        Value& value,
+        std::uint32_t& bucketIndex,
+        std::uint8_t& slotIndex) const
+    {
+        slotIndex = HashTable::Entry::c_numDataPerEntry;
+
+        if (!m_metadataArray)
+        {
+            return Base::GetValue(key, hash, value);
+        }
+
+        const auto bucketInfo = this->GetBucketInfo(hash);
+        const auto* data = this->Find(key, bucketInfo, slotIndex);
+        if (data == nullptr)
+        {
+            return false;
+        }
+
+        bucketIndex = bucketInfo.first;
+        value = this->m_recordSerializer.Deserialize(*data).m_value;
 
         return true;
     }
 
     std::chrono::seconds m_recordTimeToLive;
+    const std::uint16_t m_metadataSize;
+
+    // Set if the metadata of the records in the bucket entries is kept out of the records.
+    const std::unique_ptr<MetadataArray<Allocator>> m_metadataArray;
+
+private:
+    std::unique_ptr<MetadataArray<Allocator>> CreateMetadataArray() const
+    {
+        const auto& buckets = this->m_hashTable.m_buckets;
+        auto metadataArray = std::make_unique<MetadataArray<Allocator>>(
+            buckets.size(),
+            this->m_hashTable.m_allocator,
+            this->m_hashTable.m_perfData);
+
+        for (std::uint32_t bucketIndex = 0U; bucketIndex < buckets.size(); ++bucketIndex)
+        {
+            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+            {
+                const auto data = buckets[bucketIndex].m_dataList[i].Load(std::memory_order_relaxed);
+                if (data != nullptr)
+                {
+                    const Metadata metadata{
+                        const_cast<std::uint32_t*>(
+                            reinterpret_cast<const std::uint32_t*>(
+                                this->m_recordSerializer.Deserialize(*data).m_value.m_data)) };
+
+                    metadataArray->Set(bucketIndex, i, metadata.GetEpochTime());
+                }
+            }
+        }
+
+        return metadataArray;
+    }
 };
 
 
@@ -112,16 +256,19 @@ public:
         const HashTable& hashTable,
         const RecordSerializer& recordDeserializer,
         std::chrono::seconds recordTimeToLive,
-        std::chrono::seconds currentEpochTime)
+        std::chrono::seconds currentEpochTime,
+        std::uint16_t metadataSize)
         : BaseIterator(hashTable, recordDeserializer)
         , m_recordTimeToLive{ recordTimeToLive }
         , m_currentEpochTime{ currentEpochTime }
+        , m_metadataSize{ metadataSize }
     {}
 
     Iterator(Iterator&& other)
         : BaseIterator(std::move(other))
         , m_recordTimeToLive{ std::move(other.m_recordTimeToLive) }
         , m_currentEpochTime{ std::move(other.m_currentEpochTime) }
+        , m_metadataSize{ other.m_metadataSize }
     {}
 
     bool MoveNext() override
@@ -150,8 +297,8 @@ public:
     Value GetValue() const override
     {
         auto value = BaseIterator::GetValue();
-        value.m_data += Metadata::c_metaDataSize;
-        value.m_size -= Metadata::c_metaDataSize;
+        value.m_data += m_metadataSize;
+        value.m_size -= m_metadataSize;
 
         return value;
     }
@@ -159,6 +306,7 @@ public:
 private:
     std::chrono::seconds m_recordTimeToLive;
     std::chrono::seconds m_currentEpochTime;
+    std::uint16_t m_metadataSize;
 };
 
 
@@ -169,10 +317,17 @@ private:
 
 // WritableHashTable class implements IWritableHashTable interface and also provides
 // the read only access (Get()) to the hash table.
+// If a WriteBackPolicy is given, the records are created with the dirty bit on and the dirty
+// records are handed to the flusher instead of being dropped (see ICacheHashTable::WriteBackPolicy).
+// The flushes and the evictions of dirty records are serialized by a mutex, so that the flusher
+// receives the records of a key in the order they were written.
+// If "useMetadataArray" is true, the evictions decide on the records in the bucket entries
+// from the MetadataArray, and dereference only the records that are evicted.
 template <typename Allocator, typename Clock = Utils::EpochClock>
 class WritableHashTable
     : public ReadOnlyHashTable<Allocator, Clock>
     , public ReadWrite::WritableHashTable<Allocator>
+    , public ICacheHashTable
 {
 public:
     using ReadOnlyBase = ReadOnlyHashTable<Allocator, Clock>;
@@ -182,29 +337,80 @@ public:
     using Key = typename ReadOnlyBase::Key;
     using Value = typename ReadOnlyBase::Value;
     using ISerializerPtr = typename WritableBase::ISerializerPtr;
+    using MergePolicy = typename WritableBase::MergePolicy;
+    using RemovePolicy = typename WritableBase::RemovePolicy;
+    using Keys = ICacheHashTable::Keys;
+    using WriteBackPolicy = ICacheHashTable::WriteBackPolicy;
 
     WritableHashTable(
         HashTable& hashTable,
         IEpochActionManager& epochManager,
         std::uint64_t maxCacheSizeInBytes,
         std::chrono::seconds recordTimeToLive,
-        bool forceTimeBasedEviction)
+        bool forceTimeBasedEviction,
+        boost::optional<WriteBackPolicy> writeBack = {},
+        bool useMetadataArray = false)
         : ReadOnlyBase::Base(
             hashTable,
             RecordSerializer{
                 hashTable.m_setting.m_fixedKeySize,
                 hashTable.m_setting.m_fixedValueSize,
-                Metadata::c_metaDataSize })
-        , ReadOnlyBase(hashTable, recordTimeToLive)
+                writeBack ? Metadata::c_writeBackMetaDataSize : Metadata::c_metaDataSize })
+        , ReadOnlyBase(
+            hashTable,
+            recordTimeToLive,
+            writeBack ? Metadata::c_writeBackMetaDataSize : Metadata::c_metaDataSize,
+            useMetadataArray)
         , WritableBase(hashTable, epochManager)
         , m_maxCacheSizeInBytes{ maxCacheSizeInBytes }
         , m_forceTimeBasedEviction{ forceTimeBasedEviction }
         , m_currentEvictBucketIndex{ 0U }
+        , m_writeBack{ Validate(std::move(writeBack)) }
+        , m_ghostKeyHashes{ nullptr }
+        , m_flushThread{
+            (m_writeBack && m_writeBack->m_flushInterval.count() != 0)
+            ? std::make_unique<FlushThread>(
+                m_writeBack->m_flushInterval,
+                [this]()
+                {
+                    FlushInternal();
+                })
+            : nullptr }
     {}
 
-    using ReadOnlyBase::Get;
+    // The dirty records are flushed after the flushing thread stops, so that the writes
+    // are not lost when the hash table is destroyed (e.g., by HashTableManager).
+    ~WritableHashTable()
+    {
+        m_flushThread.reset();
+
+        try
+        {
+            FlushInternal();
+        }
+        catch (...)
+        {
+            // The flusher failed; the records that are not flushed are dropped with the hash table.
+        }
+    }
+
     using ReadOnlyBase::GetPerfData;
 
+    virtual bool Get(const Key& key, Value& value) const override
+    {
+        if (ReadOnlyBase::Get(key, value))
+        {
+            return true;
+        }
+
+        if (m_ghostKeyHashes.load(std::memory_order_acquire) != nullptr)
+        {
+            CheckGhost(key);
+        }
+
+        return false;
+    }
+
     virtual void Add(const Key& key, const Value& value) override
     {
         if (m_forceTimeBasedEviction)
@@ -212,9 +418,76 @@ public:
             EvictBasedOnTime(key);
         }
 
-        Evict(key.m_size + value.m_size + Metadata::c_metaDataSize);
+        Evict(key.m_size + value.m_size + this->m_metadataSize);
+
+        const auto hash = this->GetHash(key);
+
+        WritableBase::Add(CreateRecordBuffer(key, value), hash);
+
+        this->RecordOperation(OperationType::Add, key, hash, value.m_size, true);
+    }
+
+    // The conditional writes treat an expired record as absent.
+    virtual bool AddIfAbsent(const Key& key, const Value& value) override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+
+        return AddIfInternal(key, value, [this, curEpochTime](const Value* existingValue)
+        {
+            return existingValue == nullptr || IsExpired(*existingValue, curEpochTime);
+        });
+    }
+
+    virtual bool ReplaceIfPresent(const Key& key, const Value& value) override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+
+        return AddIfInternal(key, value, [this, curEpochTime](const Value* existingValue)
+        {
+            return existingValue != nullptr && !IsExpired(*existingValue, curEpochTime);
+        });
+    }
+
+    virtual bool ReplaceIfEqual(const Key& key, const Value& expectedValue, const Value& value) override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
 
-        WritableBase::Add(CreateRecordBuffer(key, value));
+        return AddIfInternal(key, value, [this, curEpochTime, &expectedValue](const Value* existingValue)
+        {
+            return existingValue != nullptr
+                && !IsExpired(*existingValue, curEpochTime)
+                && Value{
+                    existingValue->m_data + this->m_metadataSize,
+                    existingValue->m_size - this->m_metadataSize } == expectedValue;
+        });
+    }
+
+    // Touch() rewrites the epoch time in the record's metadata in place instead of
+    // re-adding the record, thus there is no allocation or copy of the record. It doesn't
+    // take the bucket lock since the record is kept alive by the caller's epoch; touching
+    // a record that is being replaced concurrently only refreshes the old record.
+    virtual bool Touch(const Key& key) override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+        return TouchInternal(key, curEpochTime, curEpochTime);
+    }
+
+    virtual bool Touch(const Key& key, std::chrono::seconds timeToLive) override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+        return TouchInternal(key, curEpochTime, GetTouchedEpochTime(curEpochTime, timeToLive));
+    }
+
+    virtual std::size_t TouchMany(const Keys& keys) override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+        return TouchManyInternal(keys, curEpochTime, curEpochTime);
+    }
+
+    virtual std::size_t TouchMany(const Keys& keys, std::chrono::seconds timeToLive) override
+    {
+        const auto curEpochTime = this->GetCurrentEpochTime();
+        return TouchManyInternal(keys, curEpochTime, GetTouchedEpochTime(curEpochTime, timeToLive));
     }
 
     virtual ISerializerPtr GetSerializer() const override
@@ -222,9 +495,478 @@ public:
         throw std::runtime_error("Not implemented yet.");
     }
 
+    virtual void MergeFrom(IWritableHashTable& /* source */, const MergePolicy& /* policy */) override
+    {
+        throw std::runtime_error("Not implemented yet.");
+    }
+
+    // The predicate is called with the value without the metadata, and expired records are
+    // removed regardless of the predicate. In a write-back cache, the dirty records are flushed
+    // first so that the expired records are not lost; the records that the predicate selects are
+    // dropped as in Remove().
+    virtual std::uint64_t RemoveIf(const RemovePolicy& policy) override
+    {
+        FlushInternal();
+
+        const auto curEpochTime = this->GetCurrentEpochTime();
+
+        return this->RemoveRecordsIf(policy, [this, &policy, curEpochTime](const Record& record)
+        {
+            return IsExpired(record.m_value, curEpochTime)
+                || policy.m_predicate(
+                    record.m_key,
+                    Value{
+                        record.m_value.m_data + this->m_metadataSize,
+                        record.m_value.m_size - this->m_metadataSize });
+        });
+    }
+
+    virtual std::uint64_t Flush() override
+    {
+        return FlushInternal();
+    }
+
+    virtual std::uint64_t GetMaxCacheSizeInBytes() const override
+    {
+        return m_maxCacheSizeInBytes.load(std::memory_order_relaxed);
+    }
+
+    virtual void SetMaxCacheSizeInBytes(std::uint64_t maxCacheSizeInBytes) override
+    {
+        m_maxCacheSizeInBytes.store(maxCacheSizeInBytes, std::memory_order_relaxed);
+
+        // Evicts the records over the new size, if any.
+        Evict(0U);
+    }
+
+    virtual void EnableGhostTracking() override
+    {
+        Lock lock{ m_evictMutex };
+
+        if (m_ghostKeyHashes.load(std::memory_order_relaxed) == nullptr)
+        {
+            m_ghostKeyHashesHolder.reset(new std::atomic<std::uint64_t>[c_numGhostKeyHashes]);
+
+            for (std::uint32_t i = 0U; i < c_numGhostKeyHashes; ++i)
+            {
+                m_ghostKeyHashesHolder[i].store(0U, std::memory_order_relaxed);
+            }
+
+            m_ghostKeyHashes.store(m_ghostKeyHashesHolder.get(), std::memory_order_release);
+        }
+    }
+
+protected:
+    using typename ReadOnlyBase::Hash;
+
+    // Keeps the metadata array and DirtyBytes in sync with the records added, replaced,
+    // relocated or removed.
+    virtual void OnRecordUpdated(
+        std::uint32_t bucketIndex,
+        const typename HashTable::Entry& entry,
+        std::uint8_t index,
+        const RecordBuffer* oldRecord,
+        RecordBuffer* newRecord) override
+    {
+        if (UsesMetadataArray(bucketIndex, entry))
+        {
+            if (newRecord != nullptr)
+            {
+                this->m_metadataArray->Set(bucketIndex, index, GetMetadata(*newRecord).GetEpochTime());
+            }
+            else
+            {
+                this->m_metadataArray->Clear(bucketIndex, index);
+            }
+        }
+
+        if (!m_writeBack)
+        {
+            return;
+        }
+
+        auto& perfData = this->m_hashTable.m_perfData;
+
+        if (oldRecord != nullptr && IsDirty(*oldRecord))
+        {
+            perfData.Subtract(HashTablePerfCounter::DirtyBytes, GetRecordSize(*oldRecord));
+        }
+
+        if (newRecord != nullptr && IsDirty(*newRecord))
+        {
+            perfData.Add(HashTablePerfCounter::DirtyBytes, GetRecordSize(*newRecord));
+        }
+    }
+
 private:
     using Mutex = std::mutex;
     using Lock = std::lock_guard<Mutex>;
+    using FlushThread = Utils::RunningThread<std::function<void()>>;
+
+    // Location struct identifies the record in a slot, which is checked under the bucket lock
+    // since the record can be replaced or removed once the lock is released.
+    struct Location
+    {
+        bool Holds(const RecordBuffer* record) const
+        {
+            return m_entry->m_dataList[m_index].Load(std::memory_order_relaxed) == record;
+        }
+
+        std::uint32_t m_bucketIndex;
+        typename HashTable::Entry* m_entry;
+        std::uint8_t m_index;
+        const RecordBuffer* m_record;
+    };
+
+    using Locations = std::vector<Location>;
+
+    // FlushBatch class holds the copies of dirty records to be handed to the flusher,
+    // and the locations of the records so that they can be marked dirty again if the flusher fails.
+    class FlushBatch
+    {
+    public:
+        void Add(const Key& key, const Value& value, const Location& location)
+        {
+            m_records.emplace_back(
+                std::vector<std::uint8_t>(key.m_data, key.m_data + key.m_size),
+                std::vector<std::uint8_t>(value.m_data, value.m_data + value.m_size));
+            m_locations.push_back(location);
+        }
+
+        std::size_t GetSize() const
+        {
+            return m_records.size();
+        }
+
+        const Locations& GetLocations() const
+        {
+            return m_locations;
+        }
+
+        void Clear()
+        {
+            m_records.clear();
+            m_locations.clear();
+        }
+
+        void Flush(const WriteBackPolicy::Flusher& flusher)
+        {
+            if (m_records.empty())
+            {
+                return;
+            }
+
+            WriteBackPolicy::Records records;
+            records.reserve(m_records.size());
+
+            for (const auto& record : m_records)
+            {
+                records.emplace_back(
+                    WriteBackPolicy::Key{ record.first.data(), static_cast<WriteBackPolicy::Key::size_type>(record.first.size()) },
+                    WriteBackPolicy::Value{ record.second.data(), static_cast<WriteBackPolicy::Value::size_type>(record.second.size()) });
+            }
+
+            flusher(records);
+        }
+
+    private:
+        std::vector<std::pair<std::vector<std::uint8_t>, std::vector<std::uint8_t>>> m_records;
+        Locations m_locations;
+    };
+
+    static boost::optional<WriteBackPolicy> Validate(boost::optional<WriteBackPolicy> writeBack)
+    {
+        if (writeBack && !writeBack->m_flusher)
+        {
+            throw RuntimeException("Flusher of the write-back cache is not set.");
+        }
+
+        return writeBack;
+    }
+
+    // The ghost keys are kept in a direct-mapped table of key hashes, thus a ghost key
+    // can be overwritten by a later eviction; the count is an estimate.
+    static constexpr std::uint32_t c_numGhostKeyHashes = 4096U;
+
+    std::atomic<std::uint64_t>& GetGhostKeyHash(const typename ReadOnlyBase::Base::Hash& hash) const
+    {
+        return m_ghostKeyHashes.load(std::memory_order_acquire)[hash[0] % c_numGhostKeyHashes];
+    }
+
+    void CheckGhost(const Key& key) const
+    {
+        const auto hash = this->GetHash(key);
+        auto& ghostKeyHash = GetGhostKeyHash(hash);
+
+        auto expected = hash[1];
+        if (expected != 0U
+            && ghostKeyHash.load(std::memory_order_relaxed) == expected
+            && ghostKeyHash.compare_exchange_strong(expected, 0U, std::memory_order_relaxed))
+        {
+            // Note that the following const_cast is safe and necessary as in ReadOnlyBase::Get().
+            const_cast<HashTablePerfData&>(this->GetPerfData()).Increment(HashTablePerfCounter::GhostHitCount);
+        }
+    }
+
+    void AddGhost(const Key& key)
+    {
+        const auto hash = this->GetHash(key);
+        GetGhostKeyHash(hash).store(hash[1], std::memory_order_relaxed);
+    }
+
+    Metadata GetMetadata(const RecordBuffer& recordBuffer) const
+    {
+        const auto record = this->m_recordSerializer.Deserialize(recordBuffer);
+        return Metadata{ const_cast<std::uint32_t*>(reinterpret_cast<const std::uint32_t*>(record.m_value.m_data)) };
+    }
+
+    bool IsDirty(const RecordBuffer& recordBuffer) const
+    {
+        return GetMetadata(recordBuffer).IsDirty();
+    }
+
+    std::uint64_t GetRecordSize(const RecordBuffer& recordBuffer) const
+    {
+        const auto record = this->m_recordSerializer.Deserialize(recordBuffer);
+        return record.m_key.m_size + record.m_value.m_size;
+    }
+
+    // Turns off the dirty bit of the given record and adds its copy (without the metadata)
+    // to the given batch if the record is dirty. It is assumed that this function is called
+    // under the bucket lock.
+    void CollectIfDirty(
+        const Location& location,
+        std::chrono::seconds curEpochTime,
+        FlushBatch& batch,
+        std::chrono::seconds& maxFlushLag)
+    {
+        const auto record = this->m_recordSerializer.Deserialize(*location.m_record);
+
+        Metadata metadata{ const_cast<std::uint32_t*>(reinterpret_cast<const std::uint32_t*>(record.m_value.m_data)) };
+        if (!metadata.IsDirty())
+        {
+            return;
+        }
+
+        metadata.SetDirty(false);
+
+        this->m_hashTable.m_perfData.Subtract(
+            HashTablePerfCounter::DirtyBytes,
+            record.m_key.m_size + record.m_value.m_size);
+
+        const auto epochTime = metadata.GetEpochTime();
+        if (curEpochTime > epochTime)
+        {
+            maxFlushLag = (std::max)(maxFlushLag, curEpochTime - epochTime);
+        }
+
+        batch.Add(
+            record.m_key,
+            Value{ record.m_value.m_data + this->m_metadataSize, record.m_value.m_size - this->m_metadataSize },
+            location);
+    }
+
+    // Hands the given batch to the flusher. If the flusher throws, the records in the batch that
+    // are still in the hash table are marked dirty again before the exception is rethrown.
+    // It is assumed that this function is called under m_flushMutex, but not under any bucket
+    // lock or m_evictMutex, so that only the flushes wait for the backing store.
+    void FlushBatchOf(FlushBatch& batch, std::chrono::seconds maxFlushLag)
+    {
+        const auto numRecords = batch.GetSize();
+        if (numRecords == 0U)
+        {
+            return;
+        }
+
+        try
+        {
+            batch.Flush(m_writeBack->m_flusher);
+        }
+        catch (...)
+        {
+            for (const auto& location : batch.GetLocations())
+            {
+                typename HashTable::Lock lock{ this->m_hashTable.GetMutex(location.m_bucketIndex) };
+
+                if (location.Holds(location.m_record))
+                {
+                    GetMetadata(*location.m_record).SetDirty(true);
+                    this->m_hashTable.m_perfData.Add(HashTablePerfCounter::DirtyBytes, GetRecordSize(*location.m_record));
+                }
+            }
+
+            batch.Clear();
+            throw;
+        }
+
+        batch.Clear();
+
+        auto& perfData = this->m_hashTable.m_perfData;
+        perfData.Add(HashTablePerfCounter::FlushedRecordsCount, numRecords);
+        perfData.Set(HashTablePerfCounter::FlushLagInSeconds, maxFlushLag.count());
+    }
+
+    // Sweeps all the buckets and hands the dirty records to the flusher in batches.
+    // m_flushMutex is held per batch, so that the flushes of a record are not reordered
+    // while Evict() can flush between the batches.
+    std::uint64_t FlushInternal()
+    {
+        if (!m_writeBack)
+        {
+            return 0U;
+        }
+
+        const auto maxBatchSize = (std::max)(m_writeBack->m_maxBatchSize, 1U);
+        const auto numBuckets = static_cast<std::uint32_t>(this->m_hashTable.m_buckets.size());
+
+        std::uint64_t numFlushed = 0U;
+
+        for (std::uint32_t bucketIndex = 0U; bucketIndex < numBuckets; )
+        {
+            Lock flushLock{ m_flushMutex };
+
+            const auto curEpochTime = this->GetCurrentEpochTime();
+
+            FlushBatch batch;
+            std::chrono::seconds maxFlushLag{ 0 };
+
+            for (; bucketIndex < numBuckets && batch.GetSize() < maxBatchSize; ++bucketIndex)
+            {
+                typename HashTable::Lock lock{ this->m_hashTable.GetMutex(bucketIndex) };
+
+                for (auto* entry = &this->m_hashTable.m_buckets[bucketIndex];
+                    entry != nullptr;
+                    entry = entry->m_next.Load(std::memory_order_relaxed))
+                {
+                    for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+                    {
+                        const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+
+                        if (data != nullptr)
+                        {
+                            CollectIfDirty(Location{ bucketIndex, entry, i, data }, curEpochTime, batch, maxFlushLag);
+                        }
+                    }
+                }
+            }
+
+            numFlushed += batch.GetSize();
+            FlushBatchOf(batch, maxFlushLag);
+        }
+
+        return numFlushed;
+    }
+
+    // Returns the epoch time to store so that the record expires after
+    // the given time-to-live instead of the time-to-live of the hash table.
+    std::chrono::seconds GetTouchedEpochTime(
+        std::chrono::seconds curEpochTime,
+        std::chrono::seconds timeToLive) const
+    {
+        const auto epochTime = curEpochTime + timeToLive - this->m_recordTimeToLive;
+        return (std::max)(epochTime, std::chrono::seconds{ 0 });
+    }
+
+    // The given predicate is called with the stored value including the metadata.
+    template <typename Predicate>
+    bool AddIfInternal(const Key& key, const Value& value, Predicate predicate)
+    {
+        const auto hash = this->GetHash(key);
+        const auto isAdded = EvictAndAddIf(key, hash, value, predicate);
+
+        this->RecordOperation(OperationType::ConditionalAdd, key, hash, value.m_size, isAdded);
+
+        return isAdded;
+    }
+
+    template <typename Predicate>
+    bool EvictAndAddIf(const Key& key, const Hash& hash, const Value& value, Predicate predicate)
+    {
+        // Checked before evicting so that a write that is not needed doesn't evict any record.
+        Value existingValue;
+        if (!predicate(ReadOnlyBase::Base::GetValue(key, hash, existingValue) ? &existingValue : nullptr))
+        {
+            return false;
+        }
+
+        if (m_forceTimeBasedEviction)
+        {
+            EvictBasedOnTime(key);
+        }
+
+        Evict(key.m_size + value.m_size + this->m_metadataSize);
+
+        return this->AddRecordIf(key, hash, predicate, [this, &key, &value]()
+        {
+            return CreateRecordBuffer(key, value);
+        });
+    }
+
+    bool IsExpired(const Value& value, std::chrono::seconds curEpochTime) const
+    {
+        const Metadata metadata{ const_cast<std::uint32_t*>(reinterpret_cast<const std::uint32_t*>(value.m_data)) };
+        return metadata.IsExpired(curEpochTime, this->m_recordTimeToLive);
+    }
+
+    bool TouchInternal(
+        const Key& key,
+        std::chrono::seconds curEpochTime,
+        std::chrono::seconds epochTime)
+    {
+        Value value;
+        std::uint32_t bucketIndex;
+        std::uint8_t slotIndex;
+
+        if (!this->GetValueAndSlot(key, this->GetHash(key), value, bucketIndex, slotIndex))
+        {
+            return false;
+        }
+
+        Metadata metadata{ const_cast<std::uint32_t*>(reinterpret_cast<const std::uint32_t*>(value.m_data)) };
+        if (metadata.IsExpired(curEpochTime, this->m_recordTimeToLive))
+        {
+            return false;
+        }
+
+        if (slotIndex == HashTable::Entry::c_numDataPerEntry)
+        {
+            metadata.UpdateEpochTime(epochTime);
+            return true;
+        }
+
+        // The epoch time in the metadata array is written under the bucket lock, and only
+        // while the slot still holds the touched record.
+        typename HashTable::Lock lock{ this->m_hashTable.GetMutex(bucketIndex) };
+
+        metadata.UpdateEpochTime(epochTime);
+
+        const auto data = this->m_hashTable.m_buckets[bucketIndex].m_dataList[slotIndex].Load(std::memory_order_relaxed);
+        if (data != nullptr && this->m_recordSerializer.Deserialize(*data).m_value.m_data == value.m_data)
+        {
+            this->m_metadataArray->UpdateEpochTime(bucketIndex, slotIndex, epochTime);
+            this->m_metadataArray->SetAccessed(bucketIndex, slotIndex);
+        }
+
+        return true;
+    }
+
+    std::size_t TouchManyInternal(
+        const Keys& keys,
+        std::chrono::seconds curEpochTime,
+        std::chrono::seconds epochTime)
+    {
+        std::size_t numTouched = 0U;
+
+        for (const auto& key : keys)
+        {
+            if (TouchInternal(key, curEpochTime, epochTime))
+            {
+                ++numTouched;
+            }
+        }
+
+        return numTouched;
+    }
 
     void EvictBasedOnTime(const Key& key)
     {
@@ -238,9 +980,16 @@ private:
 
         while (entry != nullptr)
         {
+            // With the metadata array, only the expired records of the bucket entry are checked.
+            const auto slotsToCheck = UsesMetadataArray(bucketIndex, *entry)
+                ? this->m_metadataArray->GetOccupiedAndExpired(bucketIndex, curEpochTime, this->m_recordTimeToLive).second
+                : c_allSlots;
+
             for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
             {
-                const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+                const auto data = ((slotsToCheck >> i) & 1U)
+                    ? entry->m_dataList[i].Load(std::memory_order_relaxed)
+                    : nullptr;
 
                 if (data != nullptr)
                 {
@@ -249,9 +998,11 @@ private:
                             reinterpret_cast<const std::uint32_t*>(
                                 this->m_recordSerializer.Deserialize(*data).m_value.m_data)) };
 
-                    if (metadata.IsExpired(curEpochTime, this->m_recordTimeToLive))
+                    // The expired dirty records are left to the flusher and Evict().
+                    if (metadata.IsExpired(curEpochTime, this->m_recordTimeToLive)
+                        && !(m_writeBack && metadata.IsDirty()))
                     {
-                        WritableBase::Remove(*entry, i);
+                        WritableBase::Remove(bucketIndex, *entry, i);
                         this->m_hashTable.m_perfData.Increment(HashTablePerfCounter::EvictedRecordsCount);
                     }
                 }
@@ -263,6 +1014,8 @@ private:
 
     // Evict uses CLOCK algorithm to evict records based on expiration and access status
     // until the number of bytes freed match the given number of bytes needed.
+    // In a write-back cache, the dirty records to evict stay in the hash table until they are
+    // flushed after m_evictMutex is released (see EvictDirtyRecords()).
     void Evict(std::uint64_t bytesNeeded)
     {
         std::uint64_t numBytesToFree = CalculateNumBytesToFree(bytesNeeded);
@@ -271,71 +1024,160 @@ private:
             return;
         }
 
-        // Start evicting records with a lock.
-        Lock evictLock{ m_evictMutex };
+        Locations dirtyRecords;
+        std::chrono::seconds curEpochTime{ 0 };
 
-        // Recalculate the number of bytes to free since other thread may have already evicted.
-        numBytesToFree = CalculateNumBytesToFree(bytesNeeded);
-        if (numBytesToFree == 0U)
         {
-            return;
-        }
+            // Start evicting records with a lock.
+            Lock evictLock{ m_evictMutex };
 
-        const auto curEpochTime = this->GetCurrentEpochTime();
+            // Recalculate the number of bytes to free since other thread may have already evicted.
+            numBytesToFree = CalculateNumBytesToFree(bytesNeeded);
+            if (numBytesToFree == 0U)
+            {
+                return;
+            }
 
-        // The max number of iterations we are going through per eviction is twice the number
-        // of buckets so that it can clear the access status. Note that this is the worst
-        // case scenario and the eviction process should exit much quicker in a normal case.
-        auto& buckets = this->m_hashTable.m_buckets;
-        std::uint64_t numIterationsRemaining = buckets.size() * 2U;
-        
-        while (numBytesToFree > 0U && numIterationsRemaining-- > 0U)
-        {
-            const auto currentBucketIndex = m_currentEvictBucketIndex++ % buckets.size();
-            auto& bucket = buckets[currentBucketIndex];
-
-            // Lock the bucket since another thread can bypass Evict() since TotalDataSize can
-            // be updated before the lock on m_evictMutex is released.
-            typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(currentBucketIndex) };
-            typename HashTable::Entry* entry = &bucket;
-        
-            while (entry != nullptr)
+            curEpochTime = this->GetCurrentEpochTime();
+
+            // The max number of iterations we are going through per eviction is twice the number
+            // of buckets so that it can clear the access status. Note that this is the worst
+            // case scenario and the eviction process should exit much quicker in a normal case.
+            auto& buckets = this->m_hashTable.m_buckets;
+            std::uint64_t numIterationsRemaining = buckets.size() * 2U;
+
+            while (numBytesToFree > 0U && numIterationsRemaining-- > 0U)
             {
-                for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
-                {
-                    const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+                const auto currentBucketIndex = m_currentEvictBucketIndex++ % buckets.size();
+                auto& bucket = buckets[currentBucketIndex];
+
+                // Lock the bucket since another thread can bypass Evict() since TotalDataSize can
+                // be updated before the lock on m_evictMutex is released.
+                typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(currentBucketIndex) };
+                typename HashTable::Entry* entry = &bucket;
 
-                    if (data != nullptr)
+                while (entry != nullptr)
+                {
+                    const auto bucketIndex = static_cast<std::uint32_t>(currentBucketIndex);
+                    const bool usesMetadataArray = UsesMetadataArray(bucketIndex, *entry);
+
+                    // With the metadata array, the records to evict in the bucket entry are decided
+                    // by the same rule below without dereferencing the records, and the access bits
+                    // of the bucket are turned off at once.
+                    auto slotsToCheck = c_allSlots;
+                    if (usesMetadataArray)
                     {
-                        const auto record = this->m_recordSerializer.Deserialize(*data);
-                        const auto& value = record.m_value;
-
-                        Metadata metadata{
-                            const_cast<std::uint32_t*>(
-                                reinterpret_cast<const std::uint32_t*>(
-                                    value.m_data)) };
-
-                        // Evict this record if
-                        // 1: the record is expired, or
-                        // 2: the entry is not recently accessed (and unset the access bit if set).
-                        if (metadata.IsExpired(curEpochTime, this->m_recordTimeToLive)
-                            || !metadata.UpdateAccessStatus(false))
-                        {
-                            const auto numBytesFreed = record.m_key.m_size + value.m_size;
-                            numBytesToFree = (numBytesFreed >= numBytesToFree) ? 0U : numBytesToFree - numBytesFreed;
+                        const auto slots = this->m_metadataArray->GetOccupiedAndExpired(
+                            bucketIndex,
+                            curEpochTime,
+                            this->m_recordTimeToLive);
+                        const auto accessBits = this->m_metadataArray->ResetAccessBits(bucketIndex);
 
-                            WritableBase::Remove(*entry, i);
+                        slotsToCheck = slots.first & (slots.second | static_cast<typename MetadataArray<Allocator>::SlotMask>(~accessBits));
+                    }
 
-                            this->m_hashTable.m_perfData.Increment(HashTablePerfCounter::EvictedRecordsCount);
+                    for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+                    {
+                        const auto data = ((slotsToCheck >> i) & 1U)
+                            ? entry->m_dataList[i].Load(std::memory_order_relaxed)
+                            : nullptr;
+
+                        if (data != nullptr)
+                        {
+                            const auto record = this->m_recordSerializer.Deserialize(*data);
+                            auto metadata = GetMetadata(*data);
+
+                            // Evict this record if
+                            // 1: the record is expired, or
+                            // 2: the entry is not recently accessed (and unset the access bit if set).
+                            if (usesMetadataArray
+                                || metadata.IsExpired(curEpochTime, this->m_recordTimeToLive)
+                                || !metadata.UpdateAccessStatus(false))
+                            {
+                                const auto numBytesFreed = record.m_key.m_size + record.m_value.m_size;
+                                numBytesToFree = (numBytesFreed >= numBytesToFree) ? 0U : numBytesToFree - numBytesFreed;
+
+                                if (m_writeBack && metadata.IsDirty())
+                                {
+                                    dirtyRecords.push_back(Location{ bucketIndex, entry, i, data });
+                                }
+                                else
+                                {
+                                    EvictRecord(Location{ bucketIndex, entry, i, data }, curEpochTime);
+                                }
+                            }
                         }
                     }
+
+                    entry = entry->m_next.Load(std::memory_order_relaxed);
                 }
+            }
+        }
 
-                entry = entry->m_next.Load(std::memory_order_relaxed);
+        if (!dirtyRecords.empty())
+        {
+            EvictDirtyRecords(dirtyRecords, curEpochTime);
+        }
+    }
+
+    // Flushes the given dirty records and evicts them once the flusher succeeds, so that the
+    // records can be read from the hash table until the backing store has them. The records
+    // replaced or removed in the meantime are skipped. If the flusher throws, no record is
+    // evicted and the exception is rethrown.
+    void EvictDirtyRecords(const Locations& dirtyRecords, std::chrono::seconds curEpochTime)
+    {
+        Lock flushLock{ m_flushMutex };
+
+        FlushBatch batch;
+        std::chrono::seconds maxFlushLag{ 0 };
+
+        for (const auto& location : dirtyRecords)
+        {
+            typename HashTable::Lock lock{ this->m_hashTable.GetMutex(location.m_bucketIndex) };
+
+            if (location.Holds(location.m_record))
+            {
+                CollectIfDirty(location, curEpochTime, batch, maxFlushLag);
             }
         }
+
+        FlushBatchOf(batch, maxFlushLag);
+
+        for (const auto& location : dirtyRecords)
+        {
+            typename HashTable::Lock lock{ this->m_hashTable.GetMutex(location.m_bucketIndex) };
+
+            // A record in the slot is never marked dirty again unless the flusher fails.
+            if (location.Holds(location.m_record))
+            {
+                EvictRecord(location, curEpochTime);
+            }
+        }
+    }
+
+    // Removes the record at the given location, which is called under the bucket lock.
+    void EvictRecord(const Location& location, std::chrono::seconds curEpochTime)
+    {
+        if (m_ghostKeyHashes.load(std::memory_order_relaxed) != nullptr
+            && !GetMetadata(*location.m_record).IsExpired(curEpochTime, this->m_recordTimeToLive))
+        {
+            AddGhost(this->m_recordSerializer.Deserialize(*location.m_record).m_key);
+        }
+
+        WritableBase::Remove(location.m_bucketIndex, *location.m_entry, location.m_index);
+
+        this->m_hashTable.m_perfData.Increment(HashTablePerfCounter::EvictedRecordsCount);
     }
 
+    // Returns true if the metadata of the records in the given entry is kept in the metadata array.
+    bool UsesMetadataArray(std::uint32_t bucketIndex, const typename HashTable::Entry& entry) const
+    {
+        return this->m_metadataArray && &entry == &this->m_hashTable.m_buckets[bucketIndex];
+    }
+
+    static constexpr typename MetadataArray<Allocator>::SlotMask c_allSlots =
+        (std::numeric_limits<typename MetadataArray<Allocator>::SlotMask>::max)();
+
     // Given the number of bytes needed, it calculates the number of bytes
     // to free based on the max cache size.
     std::uint64_t CalculateNumBytesToFree(std::uint64_t bytesNeeded) const
@@ -347,8 +1189,10 @@ private:
             + perfData.Get(HashTablePerfCounter::TotalValueSize)
             + perfData.Get(HashTablePerfCounter::TotalIndexSize);
 
-        if ((bytesNeeded < m_maxCacheSizeInBytes)
-            && (totalDataSize + bytesNeeded <= m_maxCacheSizeInBytes))
+        const auto maxCacheSizeInBytes = GetMaxCacheSizeInBytes();
+
+        if ((bytesNeeded < maxCacheSizeInBytes)
+            && (totalDataSize + bytesNeeded <= maxCacheSizeInBytes))
         {
             // There are enough free bytes.
             return 0U;
@@ -359,33 +1203,51 @@ private:
         //    For example, if thread A was evicting and thread B could have
         //    used the evicted bytes before thread A consumed.
         // 2) If max cache size is set lower than expectation.
-        return (totalDataSize > m_maxCacheSizeInBytes)
-            ? (totalDataSize - m_maxCacheSizeInBytes + bytesNeeded)
+        return (totalDataSize > maxCacheSizeInBytes)
+            ? (totalDataSize - maxCacheSizeInBytes + bytesNeeded)
             : bytesNeeded;
     }
 
     RecordBuffer* CreateRecordBuffer(const Key& key, const Value& value)
     {
         const auto bufferSize = this->m_recordSerializer.CalculateBufferSize(key, value);
-        auto buffer = Detail::to_raw_pointer(
-            this->m_hashTable.template GetAllocator<std::uint8_t>().allocate(bufferSize));
+        auto buffer = this->m_hashTable.AllocateRecordBuffer(bufferSize);
+
+        // The flags following the metadata are used only by a write-back cache.
+        std::uint32_t metaDataBuffer[2] = { 0U, 0U };
+        Metadata metadata{ metaDataBuffer, this->GetCurrentEpochTime() };
 
-        std::uint32_t metaDataBuffer;
-        Metadata{ &metaDataBuffer, this->GetCurrentEpochTime() };
+        if (m_writeBack)
+        {
+            metadata.SetDirty(true);
+        }
 
-        // 4-byte Metadata is inserted between key and value buffer.
+        // Metadata is inserted between key and value buffer.
         return this->m_recordSerializer.Serialize(
             key,
             value,
-            Value{ reinterpret_cast<std::uint8_t*>(&metaDataBuffer), sizeof(metaDataBuffer) },
+            Value{ reinterpret_cast<std::uint8_t*>(metaDataBuffer), this->m_metadataSize },
             buffer,
             bufferSize);
     }
 
     Mutex m_evictMutex;
-    const std::uint64_t m_maxCacheSizeInBytes;
+    std::atomic<std::uint64_t> m_maxCacheSizeInBytes;
     const bool m_forceTimeBasedEviction;
     std::uint64_t m_currentEvictBucketIndex;
+
+    const boost::optional<WriteBackPolicy> m_writeBack;
+
+    // Set once by EnableGhostTracking().
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_ghostKeyHashesHolder;
+    std::atomic<std::atomic<std::uint64_t>*> m_ghostKeyHashes;
+
+    // Serializes the calls to the flusher, including the ones by Evict(), together with
+    // the collection of their batches so that the flushes of a record are not reordered.
+    Mutex m_flushMutex;
+
+    // Declared last so that the thread stops before the other members are destroyed.
+    std::unique_ptr<FlushThread> m_flushThread;
 };
 
 #pragma warning(pop)
@@ -43,12 +43,21 @@ public:
 
     // Returns true if the stored epoch time is expired based
     // on the given current epoch time and time-to-live value.
+    // Note that the stored epoch time can be ahead of the current epoch time
+    // if the record is touched with a time-to-live longer than the table's.
     bool IsExpired(
         std::chrono::seconds curEpochTime,
         std::chrono::seconds timeToLive) const
     {
-        assert(curEpochTime >= GetEpochTime());
-        return (curEpochTime - GetEpochTime()) > timeToLive;
+        const auto epochTime = GetEpochTime();
+        return (curEpochTime > epochTime) && ((curEpochTime - epochTime) > timeToLive);
+    }
+
+    // Rewrites the stored epoch time in place and turns on the access bit
+    // with a single 4-byte store.
+    void UpdateEpochTime(std::chrono::seconds epochTime)
+    {
+        *m_metadata = (epochTime.count() & s_epochTimeMask) | (static_cast<std::uint32_t>(s_accessSetMask) << (s_accessBitByte * 8U));
     }
 
     // Returns true if the access status is on.
@@ -80,8 +89,25 @@ public:
         return isAccessBitOn;
     }
 
+    // Returns true if the dirty bit is on. Note that the dirty bit is stored in the flags
+    // following the metadata, which exist only in the records of a write-back cache.
+    bool IsDirty() const
+    {
+        return !!(GetFlagsByte() & s_dirtySetMask);
+    }
+
+    void SetDirty(bool set)
+    {
+        GetFlagsByte() = set
+            ? (GetFlagsByte() | s_dirtySetMask)
+            : (GetFlagsByte() & ~s_dirtySetMask);
+    }
+
     static constexpr std::uint16_t c_metaDataSize = sizeof(std::uint32_t);
 
+    // The metadata of a write-back cache record is followed by 4-byte flags.
+    static constexpr std::uint16_t c_writeBackMetaDataSize = c_metaDataSize + sizeof(std::uint32_t);
+
 private:
     std::uint8_t GetAccessByte() const
     {
@@ -93,6 +119,16 @@ private:
         return reinterpret_cast<std::uint8_t*>(m_metadata)[s_accessBitByte];
     }
 
+    std::uint8_t GetFlagsByte() const
+    {
+        return reinterpret_cast<std::uint8_t*>(m_metadata)[c_metaDataSize];
+    }
+
+    std::uint8_t& GetFlagsByte()
+    {
+        return reinterpret_cast<std::uint8_t*>(m_metadata)[c_metaDataSize];
+    }
+
     // TODO: Create an endian test and assert it. (Works only on little endian).
     // The byte that contains the most significant bit.
     static constexpr std::uint8_t s_accessBitByte = 3U;
@@ -104,6 +140,9 @@ private:
     // The rest of bits other than the most significant bit are set.
     static constexpr std::uint32_t s_epochTimeMask = 0x7FFFFFFF;
 
+    // The least significant bit of the flags is the dirty bit.
+    static constexpr std::uint8_t s_dirtySetMask = 1U;
+
     // The most significant bit is a CLOCK bit. It is set to 1 upon access
     // and reset to 0 by the cache eviction.
     // The rest of the bits are used for storing the epoch time in seconds.
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <utility>
+#include "detail/ToRawPointer.h"
+#include "Log/PerfCounter.h"
+
+namespace L4
+{
+namespace HashTable
+{
+namespace Cache
+{
+
+
+// MetadataArray keeps the metadata of the records in the bucket entries (not in the chained
+// entries) outside of the records, in parallel to the slots of the buckets:
+// 1. A dense bitmap of access bits (2 bytes per bucket), which Get() sets lock-free instead
+//    of writing the access bit in the record.
+// 2. The epoch times (4 bytes per slot, i.e., one cache line per bucket), which are updated
+//    under the bucket lock. The most significant bit tells whether the slot is occupied.
+// Thus, an eviction sweep finds the records to evict in a bucket by comparing the 16 epoch
+// times at once, and dereferences only the records that are evicted.
+// Both are allocated in one buffer from the allocator of the hash table, where the epoch
+// times of each bucket are aligned to a cache line, and the buffer is accounted in
+// HashTablePerfCounter::TotalIndexSize.
+template <typename Allocator>
+class MetadataArray
+{
+public:
+    static constexpr std::uint8_t c_numSlotsPerBucket = 16U;
+
+    // One bit per slot of a bucket, where the bit i is for the slot i.
+    using SlotMask = std::uint16_t;
+
+    MetadataArray(std::size_t numBuckets, Allocator allocator, HashTablePerfData& perfData)
+        : m_allocator{ allocator }
+        , m_perfData{ perfData }
+        , m_bufferSize{ CalculateBufferSize(numBuckets) }
+        , m_buffer{ Detail::to_raw_pointer(ByteAllocator(m_allocator).allocate(m_bufferSize)) }
+        , m_epochTimes{ reinterpret_cast<EpochTimes*>(
+            (reinterpret_cast<std::uintptr_t>(m_buffer) + c_cacheLineSize - 1U) & ~(std::uintptr_t{ c_cacheLineSize } - 1U)) }
+        , m_accessBits{ reinterpret_cast<std::atomic<SlotMask>*>(m_epochTimes + numBuckets) }
+    {
+        for (std::size_t i = 0U; i < numBuckets; ++i)
+        {
+            new (&m_epochTimes[i]) EpochTimes{};
+            new (&m_accessBits[i]) std::atomic<SlotMask>(0U);
+        }
+
+        m_perfData.Add(HashTablePerfCounter::TotalIndexSize, m_bufferSize);
+    }
+
+    ~MetadataArray()
+    {
+        m_perfData.Subtract(HashTablePerfCounter::TotalIndexSize, m_bufferSize);
+
+        ByteAllocator(m_allocator).deallocate(m_buffer, m_bufferSize);
+    }
+
+    // Returns the number of bytes allocated for the given number of buckets.
+    static constexpr std::size_t CalculateBufferSize(std::size_t numBuckets)
+    {
+        return numBuckets * (sizeof(EpochTimes) + sizeof(std::atomic<SlotMask>)) + (c_cacheLineSize - 1U);
+    }
+
+    // Called under the bucket lock when a record with the given epoch time is stored
+    // in the slot. The access bit is turned off as the new record is not accessed yet.
+    void Set(std::uint32_t bucketIndex, std::uint8_t slotIndex, std::chrono::seconds epochTime)
+    {
+        GetEpochTimes(bucketIndex)[slotIndex] = ToWord(epochTime);
+        m_accessBits[bucketIndex].fetch_and(static_cast<SlotMask>(~GetMask(slotIndex)), std::memory_order_relaxed);
+    }
+
+    // Called under the bucket lock when the record in the slot is removed.
+    void Clear(std::uint32_t bucketIndex, std::uint8_t slotIndex)
+    {
+        GetEpochTimes(bucketIndex)[slotIndex] = 0U;
+        m_accessBits[bucketIndex].fetch_and(static_cast<SlotMask>(~GetMask(slotIndex)), std::memory_order_relaxed);
+    }
+
+    // Called under the bucket lock when the epoch time of the record in the slot is updated in place.
+    void UpdateEpochTime(std::uint32_t bucketIndex, std::uint8_t slotIndex, std::chrono::seconds epochTime)
+    {
+        GetEpochTimes(bucketIndex)[slotIndex] = ToWord(epochTime);
+    }
+
+    // Turns on the access bit without a lock. The bit is checked first so that
+    // the hot records don't keep writing the shared cache line.
+    void SetAccessed(std::uint32_t bucketIndex, std::uint8_t slotIndex)
+    {
+        auto& accessBits = m_accessBits[bucketIndex];
+        const auto mask = GetMask(slotIndex);
+
+        if ((accessBits.load(std::memory_order_relaxed) & mask) == 0U)
+        {
+            accessBits.fetch_or(mask, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns the access bits of the given bucket and turns them off, which gives the
+    // accessed records the second chance of CLOCK.
+    SlotMask ResetAccessBits(std::uint32_t bucketIndex)
+    {
+        return m_accessBits[bucketIndex].exchange(0U, std::memory_order_relaxed);
+    }
+
+    // Returns the occupied slots and the expired slots of the given bucket. It is assumed
+    // that this function is called under the bucket lock. The loop is branch-free over
+    // the contiguous epoch times, so that the compiler vectorizes it.
+    std::pair<SlotMask, SlotMask> GetOccupiedAndExpired(
+        std::uint32_t bucketIndex,
+        std::chrono::seconds curEpochTime,
+        std::chrono::seconds timeToLive) const
+    {
+        const auto* epochTimes = GetEpochTimes(bucketIndex);
+        const auto curTime = ToWord(curEpochTime) & c_epochTimeMask;
+        const auto ttl = static_cast<std::uint32_t>(
+            (std::min)(
+                timeToLive.count(),
+                static_cast<std::chrono::seconds::rep>((std::numeric_limits<std::uint32_t>::max)())));
+
+        std::uint32_t occupied = 0U;
+        std::uint32_t expired = 0U;
+
+        for (std::uint32_t i = 0U; i < c_numSlotsPerBucket; ++i)
+        {
+            const auto word = epochTimes[i];
+            const auto epochTime = word & c_epochTimeMask;
+            const auto isOccupied = word >> 31;
+
+            // Same as Metadata::IsExpired().
+            const auto isExpired = isOccupied
+                & static_cast<std::uint32_t>(curTime > epochTime)
+                & static_cast<std::uint32_t>(curTime - epochTime > ttl);
+
+            occupied |= isOccupied << i;
+            expired |= isExpired << i;
+        }
+
+        return { static_cast<SlotMask>(occupied), static_cast<SlotMask>(expired) };
+    }
+
+    MetadataArray(const MetadataArray&) = delete;
+    MetadataArray& operator=(const MetadataArray&) = delete;
+
+private:
+    using ByteAllocator = typename Allocator::template rebind<std::uint8_t>::other;
+
+    static constexpr std::size_t c_cacheLineSize = 64U;
+
+    struct alignas(c_cacheLineSize) EpochTimes
+    {
+        std::uint32_t m_values[c_numSlotsPerBucket];
+    };
+
+    static_assert(sizeof(EpochTimes) == c_cacheLineSize, "The epoch times of a bucket should fit in a cache line.");
+
+    // Same as the epoch time mask of Metadata.
+    static constexpr std::uint32_t c_epochTimeMask = 0x7FFFFFFF;
+    static constexpr std::uint32_t c_occupiedMask = 0x80000000;
+
+    static std::uint32_t ToWord(std::chrono::seconds epochTime)
+    {
+        return (static_cast<std::uint32_t>(epochTime.count()) & c_epochTimeMask) | c_occupiedMask;
+    }
+
+    static SlotMask GetMask(std::uint8_t slotIndex)
+    {
+        return static_cast<SlotMask>(1U << slotIndex);
+    }
+
+    std::uint32_t* GetEpochTimes(std::uint32_t bucketIndex)
+    {
+        return m_epochTimes[bucketIndex].m_values;
+    }
+
+    const std::uint32_t* GetEpochTimes(std::uint32_t bucketIndex) const
+    {
+        return m_epochTimes[bucketIndex].m_values;
+    }
+
+    Allocator m_allocator;
+
+    HashTablePerfData& m_perfData;
+
+    const std::size_t m_bufferSize;
+
+    std::uint8_t* const m_buffer;
+
+    EpochTimes* const m_epochTimes;
+
+    std::atomic<SlotMask>* const m_accessBits;
+};
+
+
+} // namespace Cache
+} // namespace HashTable
+} // namespace L4
@@ -0,0 +1,499 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "HashTable/IHashTable.h"
+#include "Utils/Exception.h"
+
+namespace L4
+{
+namespace HashTable
+{
+
+// ChunkedValueStore stores large values in a hash table as fixed-size chunks so that
+// writing a value never allocates a contiguous record of the whole value size, and
+// reading a range of the value only looks up the chunks that overlap the range.
+//
+// A chunked value is stored as a small manifest record under the key itself, and
+// each chunk is stored as a separate record under a key derived from the key,
+// the generation of the value and the chunk index. A new value is written with a new
+// generation and published by replacing the manifest, after which the chunks of the
+// previous generation are removed. Readers that observe a removed chunk re-read the
+// manifest and retry, thus GetRange() never mixes the chunks of two generations.
+// A value that fits in a chunk is stored inline under the key instead.
+//
+// Every value the store writes starts with a one-byte tag telling whether it is an
+// inline value, a manifest or a chunk, so a value is never mistaken for a manifest by
+// its content. Values without a valid tag (i.e., not written by the store) are rejected.
+//
+// Note that the chunks are visible to the iterator of the underlying hash table, that
+// the hash table should be written only through the store, that the writes of the same
+// key should be serialized by the caller, and that the hash table should not have
+// a fixed key or value size.
+class ChunkedValueStore
+{
+public:
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    // Called with consecutive pieces of the requested range in order. The pieces
+    // point to the hash table memory, which stays valid during the current context.
+    using RangeVisitor = std::function<void(const Value& piece)>;
+
+    static constexpr std::uint32_t c_defaultChunkSize = 64U * 1024U;
+
+    class Writer;
+
+    explicit ChunkedValueStore(IWritableHashTable& hashTable)
+        : m_hashTable{ hashTable }
+    {}
+
+    // Returns a writer that streams a new value for the given key.
+    // The value becomes visible only after Writer::Commit() is called.
+    Writer CreateWriter(const Key& key, std::uint32_t chunkSize = c_defaultChunkSize);
+
+    // Adds the given value as a chunked value.
+    void Add(const Key& key, const Value& value, std::uint32_t chunkSize = c_defaultChunkSize);
+
+    // Returns the size of the value for the given key.
+    bool GetSize(const Key& key, std::uint64_t& size) const
+    {
+        Value value;
+        if (!m_hashTable.Get(key, value))
+        {
+            return false;
+        }
+
+        Manifest manifest;
+        size = manifest.Read(value) ? manifest.m_size : value.m_size;
+        return true;
+    }
+
+    // Visits the bytes in [offset, offset + length) of the value for the given key,
+    // where the range is clipped to the size of the value. Returns false if the key
+    // does not exist or a chunk of the value is missing (e.g., evicted from a cache).
+    bool GetRange(
+        const Key& key,
+        std::uint64_t offset,
+        std::uint64_t length,
+        const RangeVisitor& visitor) const
+    {
+        Value value;
+        if (!m_hashTable.Get(key, value))
+        {
+            return false;
+        }
+
+        Manifest manifest;
+        if (!manifest.Read(value))
+        {
+            // An inline value, so the range is directly in the value.
+            if (offset < value.m_size)
+            {
+                visitor(Value{
+                    value.m_data + offset,
+                    static_cast<Value::size_type>((std::min)(length, static_cast<std::uint64_t>(value.m_size - offset))) });
+            }
+
+            return true;
+        }
+
+        std::vector<Value> pieces;
+
+        while (!GetPieces(key, manifest, offset, length, pieces))
+        {
+            // The value may have been replaced after the manifest was read.
+            const auto generation = manifest.m_generation;
+            if (!m_hashTable.Get(key, value)
+                || !manifest.Read(value)
+                || manifest.m_generation == generation)
+            {
+                return false;
+            }
+        }
+
+        for (const auto& piece : pieces)
+        {
+            visitor(piece);
+        }
+
+        return true;
+    }
+
+    // Copies the bytes in [offset, offset + length) of the value to the given buffer,
+    // where the range is clipped to the size of the value.
+    bool GetRange(
+        const Key& key,
+        std::uint64_t offset,
+        std::uint64_t length,
+        std::vector<std::uint8_t>& buffer) const
+    {
+        buffer.clear();
+
+        return GetRange(key, offset, length,
+            [&buffer](const Value& piece)
+        {
+            buffer.insert(buffer.end(), piece.m_data, piece.m_data + piece.m_size);
+        });
+    }
+
+    // Removes the value and its chunks for the given key.
+    bool Remove(const Key& key)
+    {
+        Value value;
+        if (!m_hashTable.Get(key, value))
+        {
+            return false;
+        }
+
+        Manifest manifest;
+        const bool isChunked = manifest.Read(value);
+
+        const bool isRemoved = m_hashTable.Remove(key);
+
+        if (isChunked)
+        {
+            RemoveChunks(key, manifest);
+        }
+
+        return isRemoved;
+    }
+
+    ChunkedValueStore(const ChunkedValueStore&) = delete;
+    ChunkedValueStore& operator=(const ChunkedValueStore&) = delete;
+
+private:
+    // Tag is the first byte of every value the store writes.
+    enum class Tag : std::uint8_t
+    {
+        Inline = 0x49, // 'I'
+        Manifest = 0x4D, // 'M'
+        Chunk = 0x43 // 'C'
+    };
+
+    // Returns the data of the given value written by the store with the given tag.
+    static bool Untag(const Value& value, Tag tag, Value& data)
+    {
+        if (value.m_size == 0U || value.m_data[0] != static_cast<std::uint8_t>(tag))
+        {
+            return false;
+        }
+
+        data = Value{ value.m_data + 1U, value.m_size - 1U };
+        return true;
+    }
+
+    // Manifest is the value stored under the key of a chunked value.
+    struct Manifest
+    {
+        static constexpr std::uint32_t c_magic = 0x5643344CU; // "L4CV"
+
+        Manifest() = default;
+
+        Manifest(std::uint32_t chunkSize, std::uint64_t generation)
+            : m_chunkSize{ chunkSize }
+            , m_generation{ generation }
+        {}
+
+        // Returns true if the given value stored under a key is a manifest, or false if it is
+        // an inline value, in which case the value is set to its data. Throws otherwise.
+        bool Read(Value& value)
+        {
+            Value data;
+            if (Untag(value, Tag::Inline, data))
+            {
+                value = data;
+                return false;
+            }
+
+            if (!Untag(value, Tag::Manifest, data) || data.m_size != sizeof(Manifest))
+            {
+                throw RuntimeException("The value is not written by ChunkedValueStore.");
+            }
+
+            memcpy(this, data.m_data, sizeof(Manifest));
+
+            if (m_magic != c_magic || m_chunkSize == 0U)
+            {
+                throw RuntimeException("The manifest of the chunked value is corrupted.");
+            }
+
+            return true;
+        }
+
+        std::uint64_t GetNumChunks() const
+        {
+            return (m_size + m_chunkSize - 1U) / m_chunkSize;
+        }
+
+        std::uint32_t m_magic = c_magic;
+        std::uint32_t m_chunkSize = 0U;
+        std::uint64_t m_size = 0U;
+        std::uint64_t m_generation = 0U;
+    };
+
+    static_assert(sizeof(Manifest) == 24U, "Manifest should not have a padding.");
+
+    // ChunkKey builds the key of a chunk: <Key> <Generation> <Chunk index>.
+    class ChunkKey
+    {
+    public:
+        ChunkKey(const Key& key, std::uint64_t generation)
+        {
+            if (key.m_size > (std::numeric_limits<Key::size_type>::max)() - c_suffixSize)
+            {
+                throw RuntimeException("Key is too long for a chunked value.");
+            }
+
+            m_buffer.resize(key.m_size + c_suffixSize);
+            memcpy(m_buffer.data(), key.m_data, key.m_size);
+            memcpy(m_buffer.data() + key.m_size, &generation, sizeof(generation));
+        }
+
+        Key Get(std::uint32_t chunkIndex)
+        {
+            memcpy(m_buffer.data() + m_buffer.size() - sizeof(chunkIndex), &chunkIndex, sizeof(chunkIndex));
+            return Key{ m_buffer.data(), static_cast<Key::size_type>(m_buffer.size()) };
+        }
+
+    private:
+        static constexpr std::size_t c_suffixSize = sizeof(std::uint64_t) + sizeof(std::uint32_t);
+
+        std::vector<std::uint8_t> m_buffer;
+    };
+
+    // Looks up the pieces of the chunks that overlap the range. Returns false if a chunk is missing.
+    bool GetPieces(
+        const Key& key,
+        const Manifest& manifest,
+        std::uint64_t offset,
+        std::uint64_t length,
+        std::vector<Value>& pieces) const
+    {
+        pieces.clear();
+
+        if (offset >= manifest.m_size)
+        {
+            return true;
+        }
+
+        const auto end = offset + (std::min)(length, manifest.m_size - offset);
+
+        ChunkKey chunkKey{ key, manifest.m_generation };
+
+        for (auto chunkIndex = offset / manifest.m_chunkSize; offset < end; ++chunkIndex)
+        {
+            Value chunk;
+            if (!m_hashTable.Get(chunkKey.Get(static_cast<std::uint32_t>(chunkIndex)), chunk))
+            {
+                return false;
+            }
+
+            if (!Untag(chunk, Tag::Chunk, chunk))
+            {
+                throw RuntimeException("The chunk of the value is not written by ChunkedValueStore.");
+            }
+
+            const auto offsetInChunk = offset - (chunkIndex * manifest.m_chunkSize);
+            const auto pieceSize = (std::min)(end - offset, static_cast<std::uint64_t>(chunk.m_size) - offsetInChunk);
+
+            pieces.emplace_back(chunk.m_data + offsetInChunk, static_cast<Value::size_type>(pieceSize));
+            offset += pieceSize;
+        }
+
+        return true;
+    }
+
+    void RemoveChunks(const Key& key, const Manifest& manifest)
+    {
+        ChunkKey chunkKey{ key, manifest.m_generation };
+
+        for (std::uint64_t chunkIndex = 0U; chunkIndex < manifest.GetNumChunks(); ++chunkIndex)
+        {
+            m_hashTable.Remove(chunkKey.Get(static_cast<std::uint32_t>(chunkIndex)));
+        }
+    }
+
+    // Returns a generation that is unique in the process, seeded by the clock
+    // so that the generations do not repeat after a value is removed and added again.
+    static std::uint64_t GetNextGeneration()
+    {
+        static std::atomic<std::uint64_t> s_generation{
+            static_cast<std::uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count()) };
+
+        return ++s_generation;
+    }
+
+    IWritableHashTable& m_hashTable;
+};
+
+
+// ChunkedValueStore::Writer class streams a value into fixed-size chunks.
+// If the writer is destroyed without Commit(), the chunks written so far are removed.
+class ChunkedValueStore::Writer
+{
+public:
+    Writer(ChunkedValueStore& store, const Key& key, std::uint32_t chunkSize)
+        : m_store{ store }
+        , m_key(key.m_data, key.m_data + key.m_size)
+        , m_manifest{ chunkSize, GetNextGeneration() }
+        , m_chunkKey{ key, m_manifest.m_generation }
+        , m_isCommitted{ false }
+    {
+        if (chunkSize == 0U)
+        {
+            throw RuntimeException("Chunk size should be greater than 0.");
+        }
+
+        // The chunk is written with its tag, which is replaced for an inline value.
+        m_chunk.reserve(chunkSize + 1U);
+        m_chunk.push_back(static_cast<std::uint8_t>(Tag::Chunk));
+    }
+
+    Writer(Writer&& other)
+        : m_store{ other.m_store }
+        , m_key(std::move(other.m_key))
+        , m_manifest{ other.m_manifest }
+        , m_chunkKey{ std::move(other.m_chunkKey) }
+        , m_chunk(std::move(other.m_chunk))
+        , m_isCommitted{ other.m_isCommitted }
+    {
+        // The moved-from writer should not remove the chunks.
+        other.m_isCommitted = true;
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer()
+    {
+        if (!m_isCommitted)
+        {
+            m_store.RemoveChunks(GetKey(), m_manifest);
+        }
+    }
+
+    // Appends the given data to the value. Full chunks are written to the hash table.
+    void Append(const Value& data)
+    {
+        const auto* source = data.m_data;
+        auto remaining = data.m_size;
+
+        while (remaining > 0U)
+        {
+            const auto size = (std::min)(
+                remaining,
+                static_cast<Value::size_type>(m_manifest.m_chunkSize - GetChunkSize()));
+
+            m_chunk.insert(m_chunk.end(), source, source + size);
+            source += size;
+            remaining -= size;
+            m_manifest.m_size += size;
+
+            if (GetChunkSize() == m_manifest.m_chunkSize)
+            {
+                FlushChunk();
+            }
+        }
+    }
+
+    // Writes the last chunk and publishes the value by replacing the manifest, or writes
+    // the value inline if it is smaller than a chunk. The chunks of the replaced value are
+    // removed afterwards.
+    void Commit()
+    {
+        if (m_isCommitted)
+        {
+            throw RuntimeException("Writer is already committed.");
+        }
+
+        auto& hashTable = m_store.m_hashTable;
+        const auto key = GetKey();
+
+        Value oldValue;
+        Manifest oldManifest;
+        const bool hasOldChunks = hashTable.Get(key, oldValue) && oldManifest.Read(oldValue);
+
+        if (m_manifest.m_size == GetChunkSize())
+        {
+            // No chunk is written yet.
+            m_chunk[0] = static_cast<std::uint8_t>(Tag::Inline);
+        }
+        else
+        {
+            if (GetChunkSize() != 0U)
+            {
+                FlushChunk();
+            }
+
+            m_chunk.resize(1U + sizeof(m_manifest));
+            m_chunk[0] = static_cast<std::uint8_t>(Tag::Manifest);
+            memcpy(m_chunk.data() + 1U, &m_manifest, sizeof(m_manifest));
+        }
+
+        hashTable.Add(key, Value{ m_chunk.data(), static_cast<Value::size_type>(m_chunk.size()) });
+
+        m_isCommitted = true;
+
+        if (hasOldChunks)
+        {
+            m_store.RemoveChunks(key, oldManifest);
+        }
+    }
+
+private:
+    Key GetKey() const
+    {
+        return Key{ m_key.data(), static_cast<Key::size_type>(m_key.size()) };
+    }
+
+    // Returns the size of the data in the current chunk.
+    std::size_t GetChunkSize() const
+    {
+        return m_chunk.size() - 1U;
+    }
+
+    void FlushChunk()
+    {
+        const auto chunkIndex = static_cast<std::uint32_t>((m_manifest.m_size - 1U) / m_manifest.m_chunkSize);
+
+        m_store.m_hashTable.Add(
+            m_chunkKey.Get(chunkIndex),
+            Value{ m_chunk.data(), static_cast<Value::size_type>(m_chunk.size()) });
+
+        m_chunk.resize(1U);
+    }
+
+    ChunkedValueStore& m_store;
+
+    std::vector<std::uint8_t> m_key;
+
+    Manifest m_manifest;
+
+    ChunkKey m_chunkKey;
+
+    std::vector<std::uint8_t> m_chunk;
+
+    bool m_isCommitted;
+};
+
+
+inline ChunkedValueStore::Writer ChunkedValueStore::CreateWriter(const Key& key, std::uint32_t chunkSize)
+{
+    return Writer{ *this, key, chunkSize };
+}
+
+
+inline void ChunkedValueStore::Add(const Key& key, const Value& value, std::uint32_t chunkSize)
+{
+    auto writer = CreateWriter(key, chunkSize);
+    writer.Append(value);
+    writer.Commit();
+}
+
+} // namespace HashTable
+} // namespace L4
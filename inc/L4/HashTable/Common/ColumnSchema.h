@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "HashTable/IHashTable.h"
+#include "Utils/Exception.h"
+
+namespace L4
+{
+namespace HashTable
+{
+
+// ColumnSchema class defines the named columns of the records in a column hash table
+// (see IColumnHashTable), and encodes/decodes a value that holds all the columns.
+// The encoded value is laid out as follows:
+//
+// | end offset of column 0 (4 bytes) | ... | end offset of column N-1 (4 bytes) | column 0 | ... | column N-1 |
+//
+// , where an end offset is relative to the start of the column data, so that column i spans
+// [end offset of column i-1, end offset of column i) with the end offset of column -1 being 0.
+// A column that is not set is empty.
+class ColumnSchema
+{
+public:
+    using Value = IReadOnlyHashTable::Value;
+    using Values = std::vector<Value>;
+    using ColumnIndex = std::uint8_t;
+    using Offset = std::uint32_t;
+
+    static constexpr std::uint32_t c_maxNumColumns = 64U;
+
+    explicit ColumnSchema(std::vector<std::string> columnNames)
+        : m_columnNames{ std::move(columnNames) }
+    {
+        if (m_columnNames.empty() || m_columnNames.size() > c_maxNumColumns)
+        {
+            throw RuntimeException("The number of columns should be between 1 and 64.");
+        }
+
+        for (std::size_t i = 0U; i < m_columnNames.size(); ++i)
+        {
+            for (std::size_t j = 0U; j < i; ++j)
+            {
+                if (m_columnNames[i] == m_columnNames[j])
+                {
+                    throw RuntimeException("Column names should be unique.");
+                }
+            }
+        }
+    }
+
+    std::uint32_t GetNumColumns() const
+    {
+        return static_cast<std::uint32_t>(m_columnNames.size());
+    }
+
+    const std::vector<std::string>& GetColumnNames() const
+    {
+        return m_columnNames;
+    }
+
+    ColumnIndex GetColumnIndex(const char* columnName) const
+    {
+        for (std::size_t i = 0U; i < m_columnNames.size(); ++i)
+        {
+            if (m_columnNames[i] == columnName)
+            {
+                return static_cast<ColumnIndex>(i);
+            }
+        }
+
+        throw RuntimeException("Column does not exist.");
+    }
+
+    std::size_t GetHeaderSize() const
+    {
+        return m_columnNames.size() * sizeof(Offset);
+    }
+
+    // Returns true if the given value is encoded with this schema.
+    bool IsValid(const Value& value) const
+    {
+        if (value.m_size < GetHeaderSize())
+        {
+            return false;
+        }
+
+        Offset prevEnd = 0U;
+        for (std::uint32_t i = 0U; i < GetNumColumns(); ++i)
+        {
+            const auto end = GetEnd(value, i);
+            if (end < prevEnd)
+            {
+                return false;
+            }
+
+            prevEnd = end;
+        }
+
+        return GetHeaderSize() + prevEnd == value.m_size;
+    }
+
+    // Returns the given column of the given encoded value, which points to the value.
+    Value GetColumn(const Value& value, ColumnIndex column) const
+    {
+        assert(column < GetNumColumns());
+
+        const auto begin = (column == 0U) ? 0U : GetEnd(value, column - 1U);
+        const auto end = GetEnd(value, column);
+
+        return Value{ value.m_data + GetHeaderSize() + begin, end - begin };
+    }
+
+    // Encodes the given columns into the given buffer, where missing trailing columns are empty.
+    void Encode(const Values& columns, std::vector<std::uint8_t>& buffer) const
+    {
+        if (columns.size() > GetNumColumns())
+        {
+            throw RuntimeException("The number of values exceeds the number of columns.");
+        }
+
+        EncodeColumns(
+            [&columns](ColumnIndex column)
+            {
+                return (column < columns.size()) ? columns[column] : Value{};
+            },
+            buffer);
+    }
+
+    // Encodes the given existing value (empty if the record doesn't exist) with the given
+    // column replaced into the given buffer.
+    void Encode(
+        const Value& existingValue,
+        ColumnIndex columnToUpdate,
+        const Value& columnValue,
+        std::vector<std::uint8_t>& buffer) const
+    {
+        if (columnToUpdate >= GetNumColumns())
+        {
+            throw RuntimeException("Column does not exist.");
+        }
+
+        EncodeColumns(
+            [this, &existingValue, columnToUpdate, &columnValue](ColumnIndex column)
+            {
+                return (column == columnToUpdate)
+                    ? columnValue
+                    : ((existingValue.m_size != 0U) ? GetColumn(existingValue, column) : Value{});
+            },
+            buffer);
+    }
+
+private:
+    Offset GetEnd(const Value& value, std::uint32_t column) const
+    {
+        Offset end;
+        memcpy(&end, value.m_data + column * sizeof(Offset), sizeof(end));
+        return end;
+    }
+
+    template <typename GetColumnFunc>
+    void EncodeColumns(GetColumnFunc getColumn, std::vector<std::uint8_t>& buffer) const
+    {
+        std::size_t dataSize = 0U;
+        for (std::uint32_t i = 0U; i < GetNumColumns(); ++i)
+        {
+            dataSize += getColumn(static_cast<ColumnIndex>(i)).m_size;
+        }
+
+        buffer.resize(GetHeaderSize() + dataSize);
+
+        Offset end = 0U;
+        for (std::uint32_t i = 0U; i < GetNumColumns(); ++i)
+        {
+            const auto column = getColumn(static_cast<ColumnIndex>(i));
+
+            if (column.m_size != 0U)
+            {
+                memcpy(buffer.data() + GetHeaderSize() + end, column.m_data, column.m_size);
+            }
+
+            end += column.m_size;
+            memcpy(buffer.data() + i * sizeof(Offset), &end, sizeof(end));
+        }
+    }
+
+    std::vector<std::string> m_columnNames;
+};
+
+} // namespace HashTable
+} // namespace L4
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Log/PerfCounter.h"
+#include "Utils/Lock.h"
+
+namespace L4
+{
+namespace HashTable
+{
+
+// ConcurrentPolicy is the default policy, where a hash table is read lock-free and
+// updated by multiple threads under the bucket locks.
+struct ConcurrentPolicy
+{
+    using Mutex = Utils::ReaderWriterLockSlim;
+    using PerfData = HashTablePerfData;
+
+    static constexpr bool c_isSynchronized = true;
+};
+
+// SingleThreadedPolicy is for a hash table that is confined to one thread at a time:
+// the bucket locks are no-ops and the perf counters are updated without atomic
+// read-modify-write operations.
+struct SingleThreadedPolicy
+{
+    using Mutex = Utils::NullMutex;
+    using PerfData = SingleThreadedHashTablePerfData;
+
+    static constexpr bool c_isSynchronized = false;
+};
+
+
+// SingleThreadedAllocator wraps an allocator to select SingleThreadedPolicy for the hash
+// tables allocating from it. Since the allocator is the template parameter shared by all
+// the hash table types, this selects the policy at compile time without another parameter.
+// For example, LocalMemory::HashTableService::AddHashTable<SingleThreadedAllocator<std::allocator<void>>>().
+template <typename Allocator>
+class SingleThreadedAllocator : public Allocator
+{
+public:
+    template <typename T>
+    struct rebind
+    {
+        using other = SingleThreadedAllocator<typename Allocator::template rebind<T>::other>;
+    };
+
+    SingleThreadedAllocator() = default;
+
+    SingleThreadedAllocator(const Allocator& allocator)
+        : Allocator(allocator)
+    {}
+
+    template <typename OtherAllocator>
+    SingleThreadedAllocator(const SingleThreadedAllocator<OtherAllocator>& other)
+        : Allocator(static_cast<const OtherAllocator&>(other))
+    {}
+};
+
+
+// ConcurrencyPolicyOf selects the policy for the given allocator.
+template <typename Allocator>
+struct ConcurrencyPolicyOf
+{
+    using Type = ConcurrentPolicy;
+};
+
+template <typename Allocator>
+struct ConcurrencyPolicyOf<SingleThreadedAllocator<Allocator>>
+{
+    using Type = SingleThreadedPolicy;
+};
+
+} // namespace HashTable
+} // namespace L4
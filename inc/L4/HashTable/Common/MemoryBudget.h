@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "Log/PerfCounter.h"
+#include "Utils/Exception.h"
+
+namespace L4
+{
+namespace HashTable
+{
+
+// MemoryBudget class caps the memory of the hash tables that share it, which is the sum of
+// their TotalKeySize, TotalValueSize and TotalIndexSize perf counters. A budget given to one
+// hash table caps that table, and a budget given to several (e.g., all the hash tables of a
+// service) caps them together. Since the usage is read from the counters that the hash tables
+// maintain anyway, a write only loads a few counters and never updates any shared state.
+// A new record is admitted if the usage plus its key and value sizes is within the budget;
+// the record that it may replace is not credited. When a record is not admitted, the budget
+// either rejects it, blocks until other writers free enough memory, or calls the callback.
+// A rejected record makes the write throw RuntimeException.
+class MemoryBudget
+{
+public:
+    enum class Action
+    {
+        Reject,
+        Block,
+        Callback
+    };
+
+    // Called with the key and value size of a record that is not admitted, and the current usage.
+    // Returns true to admit the record anyway (e.g., after removing records to make room).
+    using Callback = std::function<bool(std::uint64_t recordSize, std::uint64_t usedSizeInBytes)>;
+
+    static constexpr std::uint32_t c_maxNumHashTables = 64U;
+
+    // "blockTimeout" applies only to Action::Block, after which the record is rejected.
+    explicit MemoryBudget(
+        std::uint64_t maxSizeInBytes,
+        Action action = Action::Reject,
+        std::chrono::milliseconds blockTimeout = std::chrono::milliseconds{ 0U },
+        Callback callback = {})
+        : m_maxSizeInBytes{ maxSizeInBytes }
+        , m_action{ action }
+        , m_blockTimeout{ blockTimeout }
+        , m_callback{ std::move(callback) }
+    {
+        if (m_action == Action::Callback && !m_callback)
+        {
+            throw RuntimeException("Callback of the memory budget is not set.");
+        }
+    }
+
+    // Adds the memory of the hash table with the given perf data to this budget.
+    void Register(const HashTablePerfData& perfData)
+    {
+        std::lock_guard<std::mutex> lock{ m_registerMutex };
+
+        const auto numHashTables = m_numHashTables.load(std::memory_order_relaxed);
+        if (numHashTables == c_maxNumHashTables)
+        {
+            throw RuntimeException("Too many hash tables share the memory budget.");
+        }
+
+        m_perfData[numHashTables].store(&perfData, std::memory_order_relaxed);
+        m_numHashTables.store(numHashTables + 1U, std::memory_order_release);
+    }
+
+    // Called when the hash table is destroyed. The slot is not reused.
+    void Unregister(const HashTablePerfData& perfData)
+    {
+        std::lock_guard<std::mutex> lock{ m_registerMutex };
+
+        for (std::uint32_t i = 0U; i < m_numHashTables.load(std::memory_order_relaxed); ++i)
+        {
+            if (m_perfData[i].load(std::memory_order_relaxed) == &perfData)
+            {
+                m_perfData[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Throws if the record of the given key and value size is not admitted.
+    void Admit(std::uint64_t recordSize) const
+    {
+        if (IsWithinBudget(recordSize))
+        {
+            return;
+        }
+
+        switch (m_action)
+        {
+        case Action::Block:
+            if (WaitUntilWithinBudget(recordSize))
+            {
+                return;
+            }
+            break;
+
+        case Action::Callback:
+            if (m_callback(recordSize, GetUsedSizeInBytes()))
+            {
+                return;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        throw RuntimeException("Memory budget of the hash table is exceeded.");
+    }
+
+    std::uint64_t GetUsedSizeInBytes() const
+    {
+        HashTablePerfData::TValue usedSize = 0;
+
+        const auto numHashTables = m_numHashTables.load(std::memory_order_acquire);
+        for (std::uint32_t i = 0U; i < numHashTables; ++i)
+        {
+            if (const auto* perfData = m_perfData[i].load(std::memory_order_relaxed))
+            {
+                usedSize += perfData->Get(HashTablePerfCounter::TotalKeySize)
+                    + perfData->Get(HashTablePerfCounter::TotalValueSize)
+                    + perfData->Get(HashTablePerfCounter::TotalIndexSize);
+            }
+        }
+
+        return static_cast<std::uint64_t>((std::max)(usedSize, HashTablePerfData::TValue{ 0 }));
+    }
+
+    std::uint64_t GetMaxSizeInBytes() const
+    {
+        return m_maxSizeInBytes;
+    }
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+private:
+    bool IsWithinBudget(std::uint64_t recordSize) const
+    {
+        return GetUsedSizeInBytes() + recordSize <= m_maxSizeInBytes;
+    }
+
+    // Polls the usage since the memory is freed by the writers of any hash table sharing the budget.
+    bool WaitUntilWithinBudget(std::uint64_t recordSize) const
+    {
+        const auto deadline = std::chrono::steady_clock::now() + m_blockTimeout;
+        auto backoff = std::chrono::microseconds{ 10U };
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(backoff);
+
+            if (IsWithinBudget(recordSize))
+            {
+                return true;
+            }
+
+            backoff = (std::min)(backoff * 2, std::chrono::microseconds{ 1000U });
+        }
+
+        return false;
+    }
+
+    const std::uint64_t m_maxSizeInBytes;
+    const Action m_action;
+    const std::chrono::milliseconds m_blockTimeout;
+    const Callback m_callback;
+
+    std::mutex m_registerMutex;
+    std::array<std::atomic<const HashTablePerfData*>, c_maxNumHashTables> m_perfData{};
+    std::atomic<std::uint32_t> m_numHashTables{ 0U };
+};
+
+} // namespace HashTable
+} // namespace L4
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace L4
+{
+namespace HashTable
+{
+
+// NearCache is a per-thread, direct-mapped cache of the records looked up recently,
+// shared by all the hash tables with the near cache enabled. Each entry remembers the
+// key hash, the record and the version of the bucket (see SharedHashTable::GetVersion())
+// when the record was looked up. An entry is valid only if the bucket version is unchanged,
+// thus writers invalidate the entries of a bucket by bumping its version.
+// Since a record is released only after the epoch in which it is replaced, the record of a valid
+// entry can be accessed safely while the caller's epoch is pinned.
+template <typename Data>
+class NearCache
+{
+public:
+    struct Entry
+    {
+        // Zero means an empty entry since the table ids start from 1.
+        std::uint64_t m_tableId = 0U;
+        std::uint64_t m_hash = 0U;
+        std::uint64_t m_version = 0U;
+        const Data* m_data = nullptr;
+    };
+
+    static constexpr std::uint32_t c_numEntries = 1024U;
+
+    static_assert((c_numEntries & (c_numEntries - 1U)) == 0U, "c_numEntries should be a power of 2.");
+
+    // Returns a new id that is unique in the process so that an entry cached for a destroyed
+    // hash table is never matched by another hash table created at the same address.
+    static std::uint64_t GetNewTableId()
+    {
+        static std::atomic<std::uint64_t> s_lastTableId{ 0U };
+        return ++s_lastTableId;
+    }
+
+    // Returns the entry of the calling thread that the given key hash maps to.
+    static Entry& GetEntry(std::uint64_t tableId, std::uint64_t hash)
+    {
+        thread_local std::array<Entry, c_numEntries> s_entries;
+
+        // Mix in the table id so that hot keys of different hash tables map to different entries.
+        return s_entries[(hash ^ (tableId * 0x9E3779B97F4A7C15ULL)) & (c_numEntries - 1U)];
+    }
+};
+
+template <typename Data>
+constexpr std::uint32_t NearCache<Data>::c_numEntries;
+
+} // namespace HashTable
+} // namespace L4
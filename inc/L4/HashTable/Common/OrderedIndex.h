@@ -0,0 +1,462 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include "detail/ToRawPointer.h"
+#include "Epoch/IEpochActionManager.h"
+#include "HashTable/Common/Record.h"
+#include "HashTable/IHashTable.h"
+#include "Log/PerfCounter.h"
+#include "Utils/AtomicOffsetPtr.h"
+
+namespace L4
+{
+namespace HashTable
+{
+
+// OrderedIndex is a skip list that keeps the records of a hash table sorted by key.
+// It does not own or copy any record; each node references the same RecordBuffer that
+// is stored in the hash table, so the only overhead is the node itself.
+//
+// Both look ups and updates are lock free and rely on the caller's epoch to keep nodes
+// and records alive. A node is linked with compare-and-swap from the bottom level up, and
+// removed by marking its next pointers from the top level down (the mark at level 0 removes
+// it logically) before it is unlinked; writers unlink any marked node they pass by, so
+// writers of different keys never wait for each other. Upsert()/Remove() must be called
+// while holding the bucket lock of the key so that the index observes the same order of
+// updates as the hash table, which also means that a node is never linked and removed
+// concurrently. Unlinked nodes are released through IEpochActionManager, and the memory
+// used by the nodes is accounted in HashTablePerfCounter::TotalIndexSize.
+//
+// Keys are ordered lexicographically by bytes (shorter key first on a common prefix).
+template <typename Allocator>
+class OrderedIndex
+{
+public:
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    using Visitor = IOrderedHashTable::Visitor;
+
+    // Same values as LevelDB's skip list: at most 12 levels with a 1/4 branching factor.
+    static constexpr std::uint8_t c_maxHeight = 12U;
+    static constexpr std::uint32_t c_branchingFactor = 4U;
+
+    OrderedIndex(
+        const RecordSerializer& recordSerializer,
+        IEpochActionManager& epochManager,
+        HashTablePerfData& perfData,
+        Allocator allocator)
+        : m_recordSerializer{ recordSerializer }
+        , m_epochManager{ epochManager }
+        , m_perfData{ perfData }
+        , m_allocator{ allocator }
+        , m_head{ CreateNode(nullptr, c_maxHeight) }
+    {}
+
+    ~OrderedIndex()
+    {
+        auto* node = m_head;
+        while (node != nullptr)
+        {
+            auto* next = LoadNext(*node, 0U, std::memory_order_relaxed);
+            DestroyNode(m_allocator, node);
+            node = next;
+        }
+    }
+
+    // Inserts the given record or, if a record with the same key already exists,
+    // replaces the record the node references. Returns true if a new node is added.
+    bool Upsert(RecordBuffer* record)
+    {
+        assert(record != nullptr);
+
+        const auto key = m_recordSerializer.Deserialize(*record).m_key;
+
+        Nodes prev;
+        Nodes next;
+        auto* node = Find(key, prev, next);
+
+        if (node != nullptr && Compare(GetKey(*node), key) == 0)
+        {
+            node->m_record.Store(record, std::memory_order_release);
+            return false;
+        }
+
+        const auto height = GetRandomHeight();
+        node = CreateNode(record, height);
+
+        // The node is reachable once it is linked at level 0.
+        while (true)
+        {
+            for (std::uint8_t i = 0U; i < height; ++i)
+            {
+                node->Next(i).Store(next[i], std::memory_order_relaxed);
+            }
+
+            if (CompareExchangeNext(*prev[0], 0U, next[0], node))
+            {
+                break;
+            }
+
+            Find(key, prev, next);
+        }
+
+        // Since the node cannot be removed until this returns, its next pointers are not
+        // marked and can be updated with a store before it is linked at each level.
+        for (std::uint8_t i = 1U; i < height; ++i)
+        {
+            while (!CompareExchangeNext(*prev[i], i, next[i], node))
+            {
+                Find(key, prev, next);
+                node->Next(i).Store(next[i], std::memory_order_relaxed);
+            }
+        }
+
+        m_perfData.Add(HashTablePerfCounter::TotalIndexSize, CalculateNodeSize(height));
+
+        return true;
+    }
+
+    // Removes the node for the given key. Returns true if the node is found.
+    bool Remove(const Key& key)
+    {
+        Nodes prev;
+        Nodes next;
+        auto* node = Find(key, prev, next);
+
+        if (node == nullptr || Compare(GetKey(*node), key) != 0)
+        {
+            return false;
+        }
+
+        // Mark from the top so that the node is never linked at a higher level after it
+        // is removed at a lower one. Note that the node keeps its next pointers so that
+        // readers currently on it can still move forward.
+        for (std::int32_t i = node->m_height - 1; i >= 0; --i)
+        {
+            node->Next(static_cast<std::uint8_t>(i)).FetchOrOffset(c_markBit, std::memory_order_acq_rel);
+        }
+
+        // Find() unlinks every marked node on its path, which includes this node at each level.
+        Find(key, prev, next);
+
+        m_perfData.Subtract(HashTablePerfCounter::TotalIndexSize, CalculateNodeSize(node->m_height));
+
+        auto allocator = m_allocator;
+        m_epochManager.RegisterAction(
+            [allocator, node]()
+        {
+            DestroyNode(allocator, node);
+        });
+
+        return true;
+    }
+
+    // Visits the records whose keys are in [from, to) in order.
+    // An empty "to" key means there is no upper bound.
+    void Scan(const Key& from, const Key& to, const Visitor& visitor) const
+    {
+        const bool hasUpperBound = (to.m_size != 0U);
+
+        for (auto* node = FindGreaterOrEqual(from);
+            node != nullptr;
+            node = NextPresent(*node))
+        {
+            const auto record = m_recordSerializer.Deserialize(
+                *node->m_record.Load(std::memory_order_acquire));
+
+            if ((hasUpperBound && Compare(record.m_key, to) >= 0)
+                || !visitor(record.m_key, record.m_value))
+            {
+                return;
+            }
+        }
+    }
+
+    // Visits the records whose keys start with the given prefix in order.
+    void PrefixScan(const Key& prefix, const Visitor& visitor) const
+    {
+        for (auto* node = FindGreaterOrEqual(prefix);
+            node != nullptr;
+            node = NextPresent(*node))
+        {
+            const auto record = m_recordSerializer.Deserialize(
+                *node->m_record.Load(std::memory_order_acquire));
+
+            if (record.m_key.m_size < prefix.m_size
+                || memcmp(record.m_key.m_data, prefix.m_data, prefix.m_size) != 0
+                || !visitor(record.m_key, record.m_value))
+            {
+                return;
+            }
+        }
+    }
+
+    // Returns the number of bytes used by a node of the given height.
+    static constexpr std::size_t CalculateNodeSize(std::uint8_t height)
+    {
+        return sizeof(Node) + ((height - 1U) * sizeof(Utils::AtomicOffsetPtr<Node>));
+    }
+
+    OrderedIndex(const OrderedIndex&) = delete;
+    OrderedIndex& operator=(const OrderedIndex&) = delete;
+
+private:
+    struct Node;
+
+    using Nodes = std::array<Node*, c_maxHeight>;
+
+    // Set in the offset of a next pointer when the node is removed at that level. Nodes are
+    // at least 8-byte aligned, so the bit is never set in the offset of a node or nullptr.
+    static constexpr std::uint64_t c_markBit = 2U;
+
+    // Node layout is a record pointer and the height followed by "height" next pointers,
+    // thus the node is allocated with CalculateNodeSize(height) bytes.
+    struct Node
+    {
+        explicit Node(RecordBuffer* record, std::uint8_t height)
+            : m_height{ height }
+        {
+            m_record.Store(record, std::memory_order_relaxed);
+
+            for (std::uint8_t i = 1U; i < height; ++i)
+            {
+                new (&m_next[i]) Utils::AtomicOffsetPtr<Node>();
+            }
+        }
+
+        Utils::AtomicOffsetPtr<Node>& Next(std::uint8_t level)
+        {
+            assert(level < m_height);
+            return m_next[level];
+        }
+
+        const Utils::AtomicOffsetPtr<Node>& Next(std::uint8_t level) const
+        {
+            assert(level < m_height);
+            return m_next[level];
+        }
+
+        Utils::AtomicOffsetPtr<RecordBuffer> m_record;
+        std::uint8_t m_height;
+        Utils::AtomicOffsetPtr<Node> m_next[1];
+    };
+
+    Node* CreateNode(RecordBuffer* record, std::uint8_t height)
+    {
+        auto* buffer = Detail::to_raw_pointer(
+            typename Allocator::template rebind<std::uint8_t>::other(m_allocator).allocate(CalculateNodeSize(height)));
+
+        assert((reinterpret_cast<std::uintptr_t>(buffer) % alignof(std::uint64_t)) == 0U);
+
+        return new (buffer) Node(record, height);
+    }
+
+    static void DestroyNode(Allocator allocator, Node* node)
+    {
+        const auto size = CalculateNodeSize(node->m_height);
+        node->~Node();
+        typename Allocator::template rebind<std::uint8_t>::other(allocator).deallocate(
+            reinterpret_cast<std::uint8_t*>(node), size);
+    }
+
+    Key GetKey(const Node& node) const
+    {
+        return m_recordSerializer.Deserialize(*node.m_record.Load(std::memory_order_acquire)).m_key;
+    }
+
+    static int Compare(const Key& lhs, const Key& rhs)
+    {
+        const auto result = memcmp(lhs.m_data, rhs.m_data, (std::min)(lhs.m_size, rhs.m_size));
+        if (result != 0)
+        {
+            return result;
+        }
+
+        return (lhs.m_size < rhs.m_size) ? -1 : ((lhs.m_size > rhs.m_size) ? 1 : 0);
+    }
+
+    // Returns the next node at the given level, ignoring the mark.
+    static Node* LoadNext(
+        const Node& node,
+        std::uint8_t level,
+        std::memory_order memoryOrder = std::memory_order_acquire)
+    {
+        bool isMarked;
+        return LoadNext(node, level, isMarked, memoryOrder);
+    }
+
+    // Returns the next node at the given level and whether the given node is removed at that level.
+    static Node* LoadNext(
+        const Node& node,
+        std::uint8_t level,
+        bool& isMarked,
+        std::memory_order memoryOrder = std::memory_order_acquire)
+    {
+        const auto& next = node.Next(level);
+        const auto offset = next.GetOffset(memoryOrder);
+
+        isMarked = (offset & c_markBit) != 0U;
+
+        return next.ToPointer(offset & ~c_markBit);
+    }
+
+    // Replaces the next node at the given level only if it is "expected" and the given node
+    // is not removed at that level.
+    static bool CompareExchangeNext(Node& node, std::uint8_t level, Node* expected, Node* desired)
+    {
+        auto& next = node.Next(level);
+        auto expectedOffset = next.ToOffset(expected);
+
+        return next.CompareExchangeOffset(expectedOffset, next.ToOffset(desired), std::memory_order_acq_rel);
+    }
+
+    // Returns the first node whose key is greater than or equal to the given key, and fills
+    // "prev" and "next" with the nodes around the key at each level. Marked nodes on the way
+    // are unlinked, and the search restarts if another writer changes a node on its path.
+    Node* Find(const Key& key, Nodes& prev, Nodes& next)
+    {
+        while (!TryFind(key, prev, next))
+        {
+        }
+
+        return next[0];
+    }
+
+    bool TryFind(const Key& key, Nodes& prev, Nodes& next)
+    {
+        auto* node = m_head;
+
+        for (std::int32_t i = c_maxHeight - 1; i >= 0; --i)
+        {
+            const auto level = static_cast<std::uint8_t>(i);
+
+            bool isMarked;
+            auto* cur = LoadNext(*node, level, isMarked);
+
+            if (isMarked)
+            {
+                return false;
+            }
+
+            while (cur != nullptr)
+            {
+                auto* curNext = LoadNext(*cur, level, isMarked);
+
+                if (isMarked)
+                {
+                    if (!CompareExchangeNext(*node, level, cur, curNext))
+                    {
+                        return false;
+                    }
+
+                    cur = curNext;
+                }
+                else if (Compare(GetKey(*cur), key) < 0)
+                {
+                    node = cur;
+                    cur = curNext;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            prev[level] = node;
+            next[level] = cur;
+        }
+
+        return true;
+    }
+
+    // Returns the first node that is not removed and whose key is greater than or equal to
+    // the given key. Unlike Find(), this never writes, so it is used by the readers.
+    Node* FindGreaterOrEqual(const Key& key) const
+    {
+        auto* node = m_head;
+
+        for (std::int32_t i = c_maxHeight - 1; i > 0; --i)
+        {
+            const auto level = static_cast<std::uint8_t>(i);
+
+            for (auto* next = LoadNext(*node, level);
+                next != nullptr && Compare(GetKey(*next), key) < 0;
+                next = LoadNext(*node, level))
+            {
+                node = next;
+            }
+        }
+
+        for (auto* next = NextPresent(*node); next != nullptr; next = NextPresent(*next))
+        {
+            if (Compare(GetKey(*next), key) >= 0)
+            {
+                return next;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Returns the next node at level 0 that is not removed.
+    static Node* NextPresent(const Node& node)
+    {
+        auto* next = LoadNext(node, 0U);
+
+        bool isMarked = true;
+        while (next != nullptr)
+        {
+            auto* nextNext = LoadNext(*next, 0U, isMarked);
+            if (!isMarked)
+            {
+                break;
+            }
+
+            next = nextNext;
+        }
+
+        return next;
+    }
+
+    static std::uint8_t GetRandomHeight()
+    {
+        std::uint8_t height = 1U;
+        while (height < c_maxHeight && (NextRandom() % c_branchingFactor) == 0U)
+        {
+            ++height;
+        }
+
+        return height;
+    }
+
+    // xorshift32 with a per thread state since writers run concurrently.
+    static std::uint32_t NextRandom()
+    {
+        static thread_local std::uint32_t s_randomState =
+            static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1U;
+
+        s_randomState ^= s_randomState << 13;
+        s_randomState ^= s_randomState >> 17;
+        s_randomState ^= s_randomState << 5;
+        return s_randomState;
+    }
+
+    const RecordSerializer& m_recordSerializer;
+
+    IEpochActionManager& m_epochManager;
+
+    HashTablePerfData& m_perfData;
+
+    Allocator m_allocator;
+
+    Node* const m_head;
+};
+
+} // namespace HashTable
+} // namespace L4
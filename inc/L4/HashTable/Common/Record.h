@@ -69,6 +69,15 @@ public:
                 : (value.m_size + sizeof(ValueSize) + m_metadataSize));
     }
 
+    // Returns true if the records serialized by the given serializer have the same layout,
+    // thus can be deserialized by this serializer.
+    bool IsCompatible(const RecordSerializer& other) const
+    {
+        return (m_fixedKeySize == other.m_fixedKeySize)
+            && (m_fixedValueSize == other.m_fixedValueSize)
+            && (m_metadataSize == other.m_metadataSize);
+    }
+
     // Returns the number bytes used for key and value sizes.
     std::size_t CalculateRecordOverhead() const
     {
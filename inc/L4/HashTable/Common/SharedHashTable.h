@@ -1,8 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <mutex>
 
+#include "detail/ToRawPointer.h"
+#include "HashTable/Common/ConcurrencyPolicy.h"
 #include "HashTable/IHashTable.h"
 #include "Interprocess/Container/Vector.h"
 #include "Log/PerfCounter.h"
@@ -16,11 +19,61 @@ namespace HashTable
 {
 
 // SharedHashTable struct represents the hash table structure.
+// The concurrency policy is selected by the allocator type (see ConcurrencyPolicyOf).
 template <typename TData, typename TAllocator>
 struct SharedHashTable
 {
     using Data = TData;
     using Allocator = TAllocator;
+    using Policy = typename ConcurrencyPolicyOf<Allocator>::Type;
+
+    // Image struct represents a single memory region that holds chained entries and records
+    // loaded from a memory image (see ReadWrite::Image::Deserializer). Entries and records
+    // in the region are never deallocated individually; the region is released as a whole
+    // when the hash table is destroyed.
+    struct Image
+    {
+        bool Contains(const void* ptr) const
+        {
+            return (ptr >= m_buffer) && (ptr < m_buffer + m_size);
+        }
+
+        std::uint8_t* m_buffer = nullptr;
+        std::size_t m_size = 0U;
+    };
+
+    // Reservation struct represents a single memory region allocated up front (see
+    // ReadWrite::WritableHashTable::Reserve), which is split into a pool of chained entries
+    // and a pool of records. Like the image, the memories in the region are never deallocated
+    // individually, thus the memories of the removed records are not reused.
+    struct Reservation : Image
+    {
+        // Pool struct hands out the memories of a range in the region lock-free.
+        struct Pool
+        {
+            // Returns nullptr if the pool doesn't have "size" bytes left.
+            std::uint8_t* Allocate(std::size_t size)
+            {
+                auto* next = m_next.load(std::memory_order_relaxed);
+
+                do
+                {
+                    if (static_cast<std::size_t>(m_end - next) < size)
+                    {
+                        return nullptr;
+                    }
+                } while (!m_next.compare_exchange_weak(next, next + size, std::memory_order_relaxed));
+
+                return next;
+            }
+
+            std::atomic<std::uint8_t*> m_next{ nullptr };
+            std::uint8_t* m_end = nullptr;
+        };
+
+        Pool m_entries;
+        Pool m_records;
+    };
 
     // HashTable::Entry struct represents an entry in the chained bucket list.
     // Entry layout is as follows:
@@ -67,16 +120,24 @@ struct SharedHashTable
         Entry() = default;
 
         // Releases deallocates all the memories of the chained entries including
-        // the data list in the current Entry.
-        void Release(Allocator allocator)
+        // the data list in the current Entry. Note that the memories in the image or
+        // the reservation of the given hash table are not deallocated since they are
+        // released as a whole.
+        void Release(const SharedHashTable& hashTable)
         {
-            auto dataDeleter = [allocator](auto& data)
+            const auto& allocator = hashTable.m_allocator;
+
+            auto dataDeleter = [&allocator, &hashTable](auto& data)
             {
                 auto dataToDelete = data.Load();
                 if (dataToDelete != nullptr)
                 {
                     dataToDelete->~Data();
-                    typename Allocator::template rebind<Data>::other(allocator).deallocate(dataToDelete, 1U);
+
+                    if (!hashTable.IsInRegion(dataToDelete))
+                    {
+                        typename Allocator::template rebind<Data>::other(allocator).deallocate(dataToDelete, 1U);
+                    }
                 }
             };
         
@@ -98,7 +159,11 @@ struct SharedHashTable
         
                 // Clean the current entry itself.
                 entryToDelete->~Entry();
-                typename Allocator::template rebind<Entry>::other(allocator).deallocate(entryToDelete, 1U);
+
+                if (!hashTable.IsInRegion(entryToDelete))
+                {
+                    typename Allocator::template rebind<Entry>::other(allocator).deallocate(entryToDelete, 1U);
+                }
             }
         
             // Delete all the data from the head of chained entries.
@@ -152,7 +217,7 @@ struct SharedHashTable
         , m_mutexes{
             (std::max)(setting.m_numBuckets / (std::max)(setting.m_numBucketsPerMutex, 1U), 1U),
             typename Allocator::template rebind<Mutex>::other(m_allocator) }
-        , m_perfData{}
+        , m_versions{ typename Allocator::template rebind<Version>::other(m_allocator) }
     {
         m_perfData.Set(HashTablePerfCounter::BucketsCount, m_buckets.size());
         m_perfData.Set(
@@ -166,16 +231,46 @@ struct SharedHashTable
     {
         for (auto& bucket : m_buckets)
         {
-            bucket.Release(m_allocator);
+            bucket.Release(*this);
         }
+
+        const auto deallocateRegion = [this](const Image& region)
+        {
+            if (region.m_buffer != nullptr)
+            {
+                GetAllocator<std::uint8_t>().deallocate(region.m_buffer, region.m_size);
+            }
+        };
+
+        deallocateRegion(m_image);
+        deallocateRegion(m_reservation);
     }
 
-    using Mutex = Utils::ReaderWriterLockSlim;
+    using Mutex = typename Policy::Mutex;
     using Lock = std::lock_guard<Mutex>;
     using UniqueLock = std::unique_lock<Mutex>;
 
+    // Version is copyable so that the versions can be allocated after the construction.
+    struct Version : std::atomic<std::uint64_t>
+    {
+        Version()
+            : std::atomic<std::uint64_t>{ 0U }
+        {}
+
+        Version(const Version& other)
+            : std::atomic<std::uint64_t>{ other.load() }
+        {}
+
+        Version& operator=(const Version& other)
+        {
+            this->store(other.load());
+            return *this;
+        }
+    };
+
     using Buckets = Interprocess::Container::Vector<Entry, typename Allocator::template rebind<Entry>::other>;
     using Mutexes = Interprocess::Container::Vector<Mutex, typename Allocator::template rebind<Mutex>::other>;
+    using Versions = Interprocess::Container::Vector<Version, typename Allocator::template rebind<Version>::other>;
 
     template <typename T>
     auto GetAllocator() const
@@ -183,11 +278,94 @@ struct SharedHashTable
         return typename Allocator::template rebind<T>::other(m_allocator);
     }
 
+    // Returns true if the given memory is in the image or the reservation, i.e., it is
+    // released with the hash table instead of being deallocated individually.
+    bool IsInRegion(const void* ptr) const
+    {
+        return m_image.Contains(ptr) || m_reservation.Contains(ptr);
+    }
+
+    // Allocates the reservation of the given sizes, which should be done before the hash
+    // table is written concurrently. Records are aligned to c_recordAlignment in the reservation.
+    Reservation& Reserve(std::size_t entriesSize, std::size_t recordsSize)
+    {
+        if (m_reservation.m_buffer != nullptr)
+        {
+            throw RuntimeException("Capacity is already reserved for the hash table.");
+        }
+
+        const auto size = entriesSize + recordsSize;
+        if (size == 0U)
+        {
+            return m_reservation;
+        }
+
+        auto* buffer = Detail::to_raw_pointer(GetAllocator<std::uint8_t>().allocate(size));
+
+        m_reservation.m_entries.m_next.store(buffer, std::memory_order_relaxed);
+        m_reservation.m_entries.m_end = buffer + entriesSize;
+        m_reservation.m_records.m_next.store(buffer + entriesSize, std::memory_order_relaxed);
+        m_reservation.m_records.m_end = buffer + size;
+
+        m_reservation.m_size = size;
+        m_reservation.m_buffer = buffer;
+
+        return m_reservation;
+    }
+
+    // Allocates a chained entry from the reservation while it lasts, otherwise from the allocator.
+    Entry* AllocateEntry()
+    {
+        auto* entry = m_reservation.m_entries.Allocate(sizeof(Entry));
+
+        return new (entry != nullptr
+            ? static_cast<void*>(entry)
+            : Detail::to_raw_pointer(GetAllocator<Entry>().allocate(1U))) Entry();
+    }
+
+    // Allocates the buffer of a record from the reservation while it lasts, otherwise from the allocator.
+    std::uint8_t* AllocateRecordBuffer(std::size_t size)
+    {
+        auto* buffer = m_reservation.m_records.Allocate(
+            (size + c_recordAlignment - 1U) & ~(c_recordAlignment - 1U));
+
+        return (buffer != nullptr)
+            ? buffer
+            : Detail::to_raw_pointer(GetAllocator<std::uint8_t>().allocate(size));
+    }
+
+    static constexpr std::size_t c_recordAlignment = 8U;
+
     Mutex& GetMutex(std::size_t index)
     {
         return m_mutexes[index % m_mutexes.size()];
     }
 
+    // Allocates a version per mutex, which is bumped whenever a record in the buckets guarded
+    // by the mutex is updated (see NearCache). This should be called before the hash table is
+    // accessed concurrently.
+    void EnableVersions()
+    {
+        if (!m_versions.empty())
+        {
+            return;
+        }
+
+        m_versions.resize(m_mutexes.size());
+
+        m_perfData.Add(HashTablePerfCounter::TotalIndexSize, m_versions.size() * sizeof(Version));
+    }
+
+    bool HasVersions() const
+    {
+        return !m_versions.empty();
+    }
+
+    Version& GetVersion(std::size_t index)
+    {
+        return m_versions[index % m_versions.size()];
+    }
+
     Allocator m_allocator;
 
     const Setting m_setting;
@@ -196,7 +374,14 @@ struct SharedHashTable
 
     Mutexes m_mutexes;
 
-    HashTablePerfData m_perfData;
+    // Empty unless EnableVersions() is called.
+    Versions m_versions;
+
+    typename Policy::PerfData m_perfData;
+
+    Image m_image;
+
+    Reservation m_reservation;
 
     SharedHashTable(const SharedHashTable&) = delete;
     SharedHashTable& operator=(const SharedHashTable&) = delete;
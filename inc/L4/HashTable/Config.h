@@ -5,6 +5,9 @@
 #include <cstdint>
 #include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
+#include "HashTable/Common/MemoryBudget.h"
 #include "HashTable/IHashTable.h"
 #include "Utils/Properties.h"
 
@@ -14,6 +17,8 @@ namespace L4
 // HashTableConfig struct.
 struct HashTableConfig
 {
+    using MemoryBudget = HashTable::MemoryBudget;
+
     struct Setting
     {
         using KeySize = IReadOnlyHashTable::Key::size_type;
@@ -38,18 +43,33 @@ struct HashTableConfig
 
     struct Cache
     {
+        using WriteBackPolicy = ICacheHashTable::WriteBackPolicy;
+
         Cache(
             std::uint64_t maxCacheSizeInBytes,
             std::chrono::seconds recordTimeToLive,
-            bool forceTimeBasedEviction)
+            bool forceTimeBasedEviction,
+            boost::optional<WriteBackPolicy> writeBack = {},
+            bool useMetadataArray = false)
             : m_maxCacheSizeInBytes{ maxCacheSizeInBytes }
             , m_recordTimeToLive{ recordTimeToLive }
             , m_forceTimeBasedEviction{ forceTimeBasedEviction }
+            , m_writeBack{ std::move(writeBack) }
+            , m_useMetadataArray{ useMetadataArray }
         {}
 
         std::uint64_t m_maxCacheSizeInBytes;
         std::chrono::seconds m_recordTimeToLive;
         bool m_forceTimeBasedEviction;
+
+        // If set, the cache is a write-back cache instead of a look-aside cache.
+        boost::optional<WriteBackPolicy> m_writeBack;
+
+        // If true, the access bits and the epoch times of the records in the bucket entries
+        // are kept out of the records (see HashTable::Cache::MetadataArray), which costs
+        // 66 bytes per bucket, counted in the cache size. The near cache is not used for
+        // the reads in this case.
+        bool m_useMetadataArray;
     };
 
     struct Serializer
@@ -67,6 +87,36 @@ struct HashTableConfig
         boost::optional<Properties> m_properties;
     };
 
+    // HybridLog struct configures a hash table whose values are stored in a log that
+    // spills to files (see HashTable::HybridLog::WritableHashTable).
+    struct HybridLog
+    {
+        explicit HybridLog(
+            std::string filePath,
+            std::uint32_t pageSize = 4U * 1024U * 1024U,
+            std::uint32_t numMemoryPages = 16U,
+            std::uint32_t numPagesPerSegment = 16U,
+            std::uint32_t maxNumSegments = 0U,
+            std::chrono::milliseconds compactionInterval = std::chrono::milliseconds{ 1000U })
+            : m_filePath{ std::move(filePath) }
+            , m_pageSize{ pageSize }
+            , m_numMemoryPages{ numMemoryPages }
+            , m_numPagesPerSegment{ numPagesPerSegment }
+            , m_maxNumSegments{ maxNumSegments }
+            , m_compactionInterval{ compactionInterval }
+        {}
+
+        // Segment files are named "<m_filePath>.<segment index>".
+        std::string m_filePath;
+        std::uint32_t m_pageSize;
+        std::uint32_t m_numMemoryPages;
+        std::uint32_t m_numPagesPerSegment;
+
+        // If not zero, the log is compacted in the background to span at most this many segments.
+        std::uint32_t m_maxNumSegments;
+        std::chrono::milliseconds m_compactionInterval;
+    };
+
     HashTableConfig(
         std::string name,
         Setting setting,
@@ -81,10 +131,72 @@ struct HashTableConfig
             || (m_serializer && (serializer->m_stream != nullptr)));
     }
 
+    // The following set the optional features by name so that a config reads as, e.g.,
+    // HashTableConfig{ "Table1", HashTableConfig::Setting{ 100U } }.SetOrderedIndex().
+    HashTableConfig& SetOrderedIndex(bool hasOrderedIndex = true)
+    {
+        m_hasOrderedIndex = hasOrderedIndex;
+        return *this;
+    }
+
+    HashTableConfig& SetEpochDomain(std::string epochDomain)
+    {
+        m_epochDomain = std::move(epochDomain);
+        return *this;
+    }
+
+    HashTableConfig& SetHybridLog(HybridLog hybridLog)
+    {
+        m_hybridLog = std::move(hybridLog);
+        return *this;
+    }
+
+    HashTableConfig& SetNearCache(bool hasNearCache = true)
+    {
+        m_hasNearCache = hasNearCache;
+        return *this;
+    }
+
+    HashTableConfig& SetColumns(std::vector<std::string> columns)
+    {
+        m_columns = std::move(columns);
+        return *this;
+    }
+
+    HashTableConfig& SetMemoryBudget(std::shared_ptr<MemoryBudget> memoryBudget)
+    {
+        m_memoryBudget = std::move(memoryBudget);
+        return *this;
+    }
+
     std::string m_name;
     Setting m_setting;
     boost::optional<Cache> m_cache;
     boost::optional<Serializer> m_serializer;
+
+    // If true, the hash table maintains an ordered index over its keys
+    // and implements IOrderedHashTable.
+    bool m_hasOrderedIndex = false;
+
+    // Name of the epoch domain that the hash table belongs to. Hash tables in different
+    // domains reclaim their memory independently. Empty name means the default domain.
+    std::string m_epochDomain;
+
+    // If set, the values are stored in a hybrid log so that the hash table can be larger than the memory.
+    boost::optional<HybridLog> m_hybridLog;
+
+    // If true, Get() is served from a per-thread near cache for the keys looked up repeatedly
+    // (see HashTable::NearCache), at the cost of a version update per write.
+    bool m_hasNearCache = false;
+
+    // If not empty, the records hold these named columns and the hash table
+    // implements IColumnHashTable.
+    std::vector<std::string> m_columns;
+
+    // If set, the writes that would exceed the budget are rejected, blocked or handed to a callback
+    // (see HashTable::MemoryBudget). The same budget can be given to several hash tables to cap
+    // them together. Not supported for the cache and hybrid log hash tables.
+    std::shared_ptr<MemoryBudget> m_memoryBudget;
 };
 
 } // namespace L4
@@ -0,0 +1,626 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Epoch/IEpochActionManager.h"
+#include "HashTable/Common/Record.h"
+#include "HashTable/HybridLog/Log.h"
+#include "HashTable/IHashTable.h"
+#include "HashTable/ReadWrite/HashTable.h"
+#include "Utils/Exception.h"
+#include "Utils/RunningThread.h"
+
+namespace L4
+{
+namespace HashTable
+{
+namespace HybridLog
+{
+
+// The following warning is from the virtual inheritance and safe to disable in this case.
+// https://msdn.microsoft.com/en-us/library/6b3sy7ae.aspx
+#pragma warning(push)
+#pragma warning(disable:4250)
+
+// AddressIndex is a ReadWrite::WritableHashTable that maps a key to the address
+// of its latest record in the Log.
+template <typename Allocator>
+class AddressIndex : public ReadWrite::WritableHashTable<Allocator>
+{
+public:
+    using Base = ReadWrite::WritableHashTable<Allocator>;
+    using HashTable = typename Base::HashTable;
+    using Address = Log::Address;
+
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    AddressIndex(
+        HashTable& hashTable,
+        IEpochActionManager& epochManager)
+        : ReadWrite::ReadOnlyHashTable<Allocator>(
+            hashTable,
+            RecordSerializer{ hashTable.m_setting.m_fixedKeySize, sizeof(Address) })
+        , Base(hashTable, epochManager)
+    {}
+
+    void Add(const Key& key, Address address)
+    {
+        Base::Add(key, ToValue(address));
+    }
+
+    bool AddIfAbsent(const Key& key, Address address)
+    {
+        return Base::AddIfAbsent(key, ToValue(address));
+    }
+
+    bool ReplaceIfPresent(const Key& key, Address address)
+    {
+        return Base::ReplaceIfPresent(key, ToValue(address));
+    }
+
+    // Lock-free look up, thus the caller should hold an epoch.
+    bool GetAddress(const Key& key, Address& address) const
+    {
+        Value value;
+        if (!this->Get(key, value))
+        {
+            return false;
+        }
+
+        address = FromValue(value);
+        return true;
+    }
+
+    // Look up under the bucket lock, which can be called without an epoch.
+    bool GetAddressLocked(const Key& key, Address& address) const
+    {
+        typename HashTable::Lock lock{ this->m_hashTable.GetMutex(this->GetBucketInfo(key).first) };
+        return GetAddress(key, address);
+    }
+
+    // Replaces the address of the given key only if it is still the expected address.
+    bool ReplaceAddress(const Key& key, Address expected, Address desired)
+    {
+        return this->ReplaceIf(
+            key,
+            ToValue(desired),
+            [expected](const Value& value)
+        {
+            return FromValue(value) == expected;
+        });
+    }
+
+    // Same as ReplaceAddress(), but the address is checked only under the bucket lock,
+    // which can be called without an epoch.
+    bool ReplaceAddressLocked(const Key& key, Address expected, Address desired)
+    {
+        const auto isExpected = [expected](const Value* value)
+        {
+            return value != nullptr && FromValue(*value) == expected;
+        };
+
+        return this->AddRecordIfLocked(key, this->GetHash(key), isExpected, [this, &key, &desired]()
+        {
+            return this->CreateRecordBuffer(key, ToValue(desired));
+        });
+    }
+
+    static Address FromValue(const Value& value)
+    {
+        assert(value.m_size == sizeof(Address));
+
+        Address address;
+        memcpy(&address, value.m_data, sizeof(address));
+        return address;
+    }
+
+private:
+    // Note that the returned value points to the given address.
+    static Value ToValue(const Address& address)
+    {
+        return Value{ reinterpret_cast<const std::uint8_t*>(&address), sizeof(address) };
+    }
+};
+
+
+// WritableHashTable implements IWritableHashTable over a hybrid log (see Log), so that the hash
+// table can hold more values than the memory: the keys are kept in an in-memory index, while the
+// values live in the log whose recent pages are in memory and the rest are in segment files.
+//
+// Records in the log are never updated in place since the lock-free readers may hold a pointer
+// into the log; instead, every Add() appends a new record and moves the index to it. The space
+// used by the stale records is reclaimed by Compact(), which relocates the live records in the
+// oldest segments to the tail and truncates the segments.
+//
+// Get() is served from memory if the record is in an in-memory page. Otherwise, the record is
+// read synchronously from the file into a buffer that is released through IEpochActionManager.
+// GetAsync() (IAsyncHashTable) instead hands such look ups to an I/O thread. A look up that
+// fails to read the file throws, except that GetAsync() reports it as not found.
+//
+// Note that the writes are globally serialized by the log (see Log::Append()).
+//
+// Note that the perf data reflect the index, where each value is the 8-byte log address.
+template <typename Allocator>
+class WritableHashTable
+    : public IWritableHashTable
+    , public IAsyncHashTable
+{
+public:
+    using Index = AddressIndex<Allocator>;
+    using HashTable = typename Index::HashTable;
+    using Address = Log::Address;
+
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+    using Callback = IAsyncHashTable::Callback;
+
+    class Iterator;
+
+    // If "maxNumSegments" is not zero, the log is compacted in the background every
+    // "compactionInterval" so that it spans at most "maxNumSegments" segments.
+    WritableHashTable(
+        HashTable& hashTable,
+        IEpochActionManager& epochManager,
+        std::string filePath,
+        std::uint32_t pageSize,
+        std::uint32_t numMemoryPages,
+        std::uint32_t numPagesPerSegment,
+        std::uint32_t maxNumSegments = 0U,
+        std::chrono::milliseconds compactionInterval = std::chrono::milliseconds{ 1000U })
+        : m_epochManager{ epochManager }
+        , m_log{ std::move(filePath), pageSize, numMemoryPages, numPagesPerSegment, epochManager }
+        , m_index{ hashTable, epochManager }
+        , m_maxNumSegments{ maxNumSegments }
+        , m_isStopping{ false }
+        , m_ioThread{ &WritableHashTable::ProcessReads, this }
+        , m_compactionThread{
+            (maxNumSegments != 0U)
+            ? std::make_unique<CompactionThread>(
+                compactionInterval,
+                [this]()
+                {
+                    CompactToMaxNumSegments();
+                })
+            : nullptr }
+    {}
+
+    ~WritableHashTable()
+    {
+        m_compactionThread.reset();
+
+        {
+            std::lock_guard<std::mutex> lock{ m_readsMutex };
+            m_isStopping = true;
+        }
+
+        m_readsCondition.notify_one();
+        m_ioThread.join();
+    }
+
+    virtual bool Get(const Key& key, Value& value) const override
+    {
+        Address address;
+        bool isFound = m_index.GetAddress(key, address);
+
+        while (isFound)
+        {
+            Log::Record record;
+            if (m_log.TryRead(address, record))
+            {
+                value = record.m_value;
+                return true;
+            }
+
+            std::unique_ptr<std::vector<std::uint8_t>> buffer{ new std::vector<std::uint8_t>() };
+            if (m_log.ReadFromFile(address, *buffer, record))
+            {
+                value = record.m_value;
+
+                auto* bufferToRelease = buffer.release();
+                m_epochManager.RegisterAction(
+                    [bufferToRelease]()
+                {
+                    delete bufferToRelease;
+                });
+
+                return true;
+            }
+
+            isFound = GetAddressToRetry(key, address, false);
+        }
+
+        return false;
+    }
+
+    virtual void GetAsync(const Key& key, Callback callback) const override
+    {
+        Address address;
+        Log::Record record;
+
+        if (!m_index.GetAddress(key, address))
+        {
+            callback(false, Value{});
+        }
+        else if (m_log.TryRead(address, record))
+        {
+            callback(true, record.m_value);
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock{ m_readsMutex };
+                m_reads.emplace_back(
+                    PendingRead{ std::vector<std::uint8_t>(key.m_data, key.m_data + key.m_size), std::move(callback) });
+            }
+
+            m_readsCondition.notify_one();
+        }
+    }
+
+    virtual IIteratorPtr GetIterator() const override
+    {
+        return std::make_unique<Iterator>(*this);
+    }
+
+    // The index is scanned, and the values are read from the log. Note that a record removed
+    // after its key is scanned is skipped, thus a page can have fewer records than "maxRecords".
+    virtual ScanCursor Scan(const ScanCursor& cursor, std::uint32_t maxRecords, const ScanVisitor& visitor) const override
+    {
+        std::vector<std::uint8_t> buffer;
+        Log::Record record;
+
+        return m_index.Scan(cursor, maxRecords, [this, &visitor, &buffer, &record](const Key& key, const Value&)
+        {
+            if (Read(key, buffer, record))
+            {
+                visitor(key, record.m_value);
+            }
+        });
+    }
+
+    // The index is sampled, and the values are read from the log.
+    virtual std::uint32_t Sample(std::uint32_t numRecords, const ScanVisitor& visitor) const override
+    {
+        std::vector<std::uint8_t> buffer;
+        Log::Record record;
+        std::uint32_t numSampled = 0U;
+
+        m_index.Sample(numRecords, [this, &visitor, &buffer, &record, &numSampled](const Key& key, const Value&)
+        {
+            if (Read(key, buffer, record))
+            {
+                visitor(key, record.m_value);
+                ++numSampled;
+            }
+        });
+
+        return numSampled;
+    }
+
+    virtual const HashTablePerfData& GetPerfData() const override
+    {
+        return m_index.GetPerfData();
+    }
+
+    virtual void Add(const Key& key, const Value& value) override
+    {
+        m_index.Add(key, m_log.Append(key, value));
+    }
+
+    // The conditional writes check the index before appending to the log. If the index changes
+    // in the meantime, the appended record is simply stale and reclaimed by the compaction.
+    virtual bool AddIfAbsent(const Key& key, const Value& value) override
+    {
+        Address address;
+        return !m_index.GetAddress(key, address)
+            && m_index.AddIfAbsent(key, m_log.Append(key, value));
+    }
+
+    virtual bool ReplaceIfPresent(const Key& key, const Value& value) override
+    {
+        Address address;
+        return m_index.GetAddress(key, address)
+            && m_index.ReplaceIfPresent(key, m_log.Append(key, value));
+    }
+
+    virtual bool ReplaceIfEqual(const Key& key, const Value& expectedValue, const Value& value) override
+    {
+        std::vector<std::uint8_t> buffer;
+        Address address;
+        bool isFound = m_index.GetAddress(key, address);
+
+        while (isFound)
+        {
+            Log::Record record;
+            if (!m_log.Read(address, buffer, record))
+            {
+                isFound = GetAddressToRetry(key, address, false);
+                continue;
+            }
+
+            if (record.m_value != expectedValue)
+            {
+                return false;
+            }
+
+            if (m_index.ReplaceAddress(key, address, m_log.Append(key, value)))
+            {
+                return true;
+            }
+
+            // The key has been updated since it was read.
+            isFound = m_index.GetAddress(key, address);
+        }
+
+        return false;
+    }
+
+    virtual bool Remove(const Key& key) override
+    {
+        return m_index.Remove(key);
+    }
+
+    virtual ISerializerPtr GetSerializer() const override
+    {
+        throw RuntimeException("Serializing a hybrid log hash table is not supported.");
+    }
+
+    virtual void MergeFrom(IWritableHashTable& /* source */, const MergePolicy& /* policy */) override
+    {
+        throw RuntimeException("Merging into a hybrid log hash table is not supported.");
+    }
+
+    virtual std::uint64_t RemoveIf(const RemovePolicy& /* policy */) override
+    {
+        throw RuntimeException("Removing by a predicate from a hybrid log hash table is not supported.");
+    }
+
+    virtual RelocationResult Relocate(const RelocationPolicy& /* policy */) override
+    {
+        throw RuntimeException("Relocating a hybrid log hash table is not supported; use Compact().");
+    }
+
+    virtual void Reserve(std::uint64_t /* numRecords */, std::uint64_t /* numBytes */) override
+    {
+        throw RuntimeException("Reserving capacity for a hybrid log hash table is not supported.");
+    }
+
+    // Relocates the live records below the given address to the tail and truncates the log.
+    // The address is rounded down to a segment boundary that is flushed.
+    void Compact(Address untilAddress)
+    {
+        std::lock_guard<std::mutex> lock{ m_compactionMutex };
+
+        const auto truncateAddress = m_log.GetTruncatableAddress(untilAddress);
+        if (truncateAddress <= m_log.GetBeginAddress())
+        {
+            return;
+        }
+
+        m_log.ForEachRecord(
+            truncateAddress,
+            [this](Address address, const Log::Record& record)
+        {
+            Address currentAddress;
+            if (m_index.GetAddressLocked(record.m_key, currentAddress) && currentAddress == address)
+            {
+                // If the record is updated in the meantime, the relocated record is simply stale.
+                // The compaction thread holds no epoch, thus the index is checked only under the lock.
+                m_index.ReplaceAddressLocked(record.m_key, address, m_log.Append(record.m_key, record.m_value));
+            }
+        });
+
+        m_log.Truncate(truncateAddress);
+    }
+
+    const Log& GetLog() const
+    {
+        return m_log;
+    }
+
+    WritableHashTable(const WritableHashTable&) = delete;
+    WritableHashTable& operator=(const WritableHashTable&) = delete;
+
+private:
+    using CompactionThread = Utils::RunningThread<std::function<void()>>;
+
+    struct PendingRead
+    {
+        std::vector<std::uint8_t> m_key;
+        Callback m_callback;
+    };
+
+    // Reads the latest record for the given key into the given buffer without an epoch.
+    bool Read(const Key& key, std::vector<std::uint8_t>& buffer, Log::Record& record) const
+    {
+        Address address;
+        bool isFound = m_index.GetAddressLocked(key, address);
+
+        while (isFound)
+        {
+            if (m_log.Read(address, buffer, record))
+            {
+                return true;
+            }
+
+            isFound = GetAddressToRetry(key, address, true);
+        }
+
+        return false;
+    }
+
+    // Called after the record at the given address failed to be read, and looks up the address
+    // to retry. Returns false if the key has been removed. The read is retried only if the record
+    // has been relocated by the compaction (the log is truncated past the address) or the key has
+    // been updated; otherwise, the log failed to read the record, thus it throws.
+    bool GetAddressToRetry(const Key& key, Address& address, bool isLocked) const
+    {
+        const auto failedAddress = address;
+
+        if (!(isLocked ? m_index.GetAddressLocked(key, address) : m_index.GetAddress(key, address)))
+        {
+            return false;
+        }
+
+        if (address == failedAddress && failedAddress >= m_log.GetBeginAddress())
+        {
+            throw RuntimeException("Failed to read the record from the hybrid log.");
+        }
+
+        return true;
+    }
+
+    // Runs on the I/O thread until the hash table is destroyed, where the pending reads
+    // are drained before the thread stops.
+    void ProcessReads()
+    {
+        std::vector<std::uint8_t> buffer;
+
+        while (true)
+        {
+            PendingRead read;
+
+            {
+                std::unique_lock<std::mutex> lock{ m_readsMutex };
+                m_readsCondition.wait(lock, [this]() { return m_isStopping || !m_reads.empty(); });
+
+                if (m_reads.empty())
+                {
+                    return;
+                }
+
+                read = std::move(m_reads.front());
+                m_reads.pop_front();
+            }
+
+            // The callback has no way to report an I/O error, thus a read that fails is reported as not found.
+            Log::Record record;
+            bool found = false;
+
+            try
+            {
+                found = Read(
+                    Key{ read.m_key.data(), static_cast<Key::size_type>(read.m_key.size()) },
+                    buffer,
+                    record);
+            }
+            catch (const RuntimeException&)
+            {
+            }
+
+            read.m_callback(found, found ? record.m_value : Value{});
+        }
+    }
+
+    void CompactToMaxNumSegments()
+    {
+        const auto maxLogSize = m_log.GetSegmentSize() * m_maxNumSegments;
+        const auto tailAddress = m_log.GetTailAddress();
+
+        if (tailAddress - m_log.GetBeginAddress() > maxLogSize)
+        {
+            Compact(tailAddress - maxLogSize);
+        }
+    }
+
+    IEpochActionManager& m_epochManager;
+
+    // Reading from the file is not logically a mutation of the hash table.
+    mutable Log m_log;
+
+    Index m_index;
+
+    const std::uint32_t m_maxNumSegments;
+
+    std::mutex m_compactionMutex;
+
+    mutable std::mutex m_readsMutex;
+
+    mutable std::condition_variable m_readsCondition;
+
+    mutable std::deque<PendingRead> m_reads;
+
+    bool m_isStopping;
+
+    std::thread m_ioThread;
+
+    // Declared last so that the compaction stops before the other members are destroyed.
+    std::unique_ptr<CompactionThread> m_compactionThread;
+};
+
+#pragma warning(pop)
+
+
+// WritableHashTable::Iterator class implements IIterator interface by iterating the index,
+// where the values are read from the log into a buffer that is valid until the iterator moves.
+template <typename Allocator>
+class WritableHashTable<Allocator>::Iterator : public IIterator
+{
+public:
+    explicit Iterator(const WritableHashTable& hashTable)
+        : m_hashTable{ hashTable }
+        , m_indexIterator{ hashTable.m_index.GetIterator() }
+        , m_isValueRead{ false }
+    {}
+
+    void Reset() override
+    {
+        m_indexIterator->Reset();
+        m_isValueRead = false;
+    }
+
+    bool MoveNext() override
+    {
+        m_isValueRead = false;
+        return m_indexIterator->MoveNext();
+    }
+
+    Key GetKey() const override
+    {
+        return m_indexIterator->GetKey();
+    }
+
+    Value GetValue() const override
+    {
+        if (!m_isValueRead)
+        {
+            // The record could have been removed after the iterator has moved to it.
+            if (!m_hashTable.Read(GetKey(), m_buffer, m_record))
+            {
+                m_record = Log::Record{ Key{}, Value{} };
+            }
+
+            m_isValueRead = true;
+        }
+
+        return m_record.m_value;
+    }
+
+    Iterator(const Iterator&) = delete;
+    Iterator& operator=(const Iterator&) = delete;
+
+private:
+    const WritableHashTable& m_hashTable;
+
+    IIteratorPtr m_indexIterator;
+
+    mutable std::vector<std::uint8_t> m_buffer;
+
+    mutable Log::Record m_record;
+
+    mutable bool m_isValueRead;
+};
+
+} // namespace HybridLog
+} // namespace HashTable
+} // namespace L4
@@ -0,0 +1,541 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Epoch/IEpochActionManager.h"
+#include "HashTable/IHashTable.h"
+#include "Utils/Exception.h"
+
+namespace L4
+{
+namespace HashTable
+{
+namespace HybridLog
+{
+
+// Log is an append-only record log addressed by logical addresses, which is split into
+// fixed-size pages. Following FASTER's hybrid log, the address space is divided into:
+//
+//     | on file | read-only in memory | tail page |
+//     ^begin    ^head                 ^read-only  ^tail
+//
+// Records are always appended to the tail page. When the tail page is full, it becomes
+// read-only and is flushed to the file, and the oldest in-memory page is evicted once more
+// than "numMemoryPages" pages are in memory. Evicted pages are released through
+// IEpochActionManager, so a reader holding an epoch can keep using a page it has found.
+//
+// Unlike FASTER, whose writers reserve the tail space with an atomic fetch-add and hand the
+// full pages to the flushing threads, the appends here are globally serialized by a mutex,
+// and the append that fills a page writes and flushes the page to the file under the mutex.
+// Thus, all the writers of a hash table wait for one page write every page of appends, and
+// the write throughput is bounded by one writer copying records plus the file writes.
+//
+// The file is split into segments of "numPagesPerSegment" pages so that truncating
+// the beginning of the log (see Truncate()) removes whole segment files.
+// Note that the log is not recoverable: the segment files are removed on destruction.
+class Log
+{
+public:
+    using Address = std::uint64_t;
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    // Record in the log, where the key and the value point to either an in-memory page
+    // or the buffer passed in.
+    struct Record
+    {
+        Key m_key;
+        Value m_value;
+    };
+
+    // The number of slots in the page table, thus the max number of in-memory pages.
+    static constexpr std::uint32_t c_pageTableSize = 1U << 16;
+
+    Log(
+        std::string filePath,
+        std::uint32_t pageSize,
+        std::uint32_t numMemoryPages,
+        std::uint32_t numPagesPerSegment,
+        IEpochActionManager& epochManager)
+        : m_filePath{ std::move(filePath) }
+        , m_pageSize{ pageSize }
+        , m_numMemoryPages{ numMemoryPages }
+        , m_numPagesPerSegment{ numPagesPerSegment }
+        , m_epochManager{ epochManager }
+        , m_pageTable{ new std::atomic<Page*>[c_pageTableSize] }
+        , m_beginAddress{ 0U }
+        , m_headAddress{ 0U }
+        , m_tailAddress{ 0U }
+    {
+        if (m_pageSize < sizeof(RecordHeader) || (m_pageSize % c_alignment) != 0U)
+        {
+            throw RuntimeException("Log page size should be a multiple of 8 bytes.");
+        }
+
+        if (m_numMemoryPages == 0U || m_numMemoryPages > c_pageTableSize || m_numPagesPerSegment == 0U)
+        {
+            throw RuntimeException("Invalid number of log pages.");
+        }
+
+        for (std::uint32_t i = 0U; i < c_pageTableSize; ++i)
+        {
+            m_pageTable[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        AllocatePage(0U);
+    }
+
+    ~Log()
+    {
+        for (std::uint32_t i = 0U; i < c_pageTableSize; ++i)
+        {
+            delete m_pageTable[i].load(std::memory_order_relaxed);
+        }
+
+        for (auto& segment : m_segments)
+        {
+            segment.second.reset();
+            std::remove(GetSegmentFilePath(segment.first).c_str());
+        }
+    }
+
+    // Appends the given record to the tail and returns its address. The appends are serialized,
+    // and the append that fills the tail page flushes it synchronously (see FlushPage()).
+    Address Append(const Key& key, const Value& value)
+    {
+        const auto recordSize = GetRecordSize(key, value);
+        if (recordSize > m_pageSize)
+        {
+            throw RuntimeException("Record is larger than the log page size.");
+        }
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+
+        auto address = m_tailAddress.load(std::memory_order_relaxed);
+        if (GetOffset(address) + recordSize > m_pageSize)
+        {
+            // The rest of the page is zero, which marks the end of the page.
+            address = MoveToNextPage(GetPageIndex(address));
+        }
+
+        auto* buffer = GetPage(GetPageIndex(address))->m_data.get() + GetOffset(address);
+
+        const RecordHeader header{ value.m_size, key.m_size, RecordHeader::c_validFlag };
+        memcpy(buffer, &header, sizeof(header));
+        memcpy(buffer + sizeof(header), key.m_data, key.m_size);
+        memcpy(buffer + sizeof(header) + key.m_size, value.m_data, value.m_size);
+
+        m_tailAddress.store(address + recordSize, std::memory_order_release);
+
+        if (GetOffset(address + recordSize) == 0U)
+        {
+            MoveToNextPage(GetPageIndex(address));
+        }
+
+        return address;
+    }
+
+    // Reads the record at the given address if its page is in memory, where the record points to the page.
+    // The caller should hold an epoch so that the page is not released while the record is used.
+    bool TryRead(Address address, Record& record) const
+    {
+        const auto pageIndex = GetPageIndex(address);
+        const auto* page = m_pageTable[pageIndex % c_pageTableSize].load(std::memory_order_acquire);
+
+        if (page == nullptr || page->m_index != pageIndex)
+        {
+            return false;
+        }
+
+        return Parse(page->m_data.get() + GetOffset(address), m_pageSize - GetOffset(address), record);
+    }
+
+    // Reads the record at the given address into the given buffer, where the record points to the buffer.
+    // Unlike TryRead(), this doesn't require an epoch. Returns false if the address is truncated.
+    bool Read(Address address, std::vector<std::uint8_t>& buffer, Record& record)
+    {
+        {
+            // Pages are evicted under the lock, thus it is safe to copy from an in-memory page.
+            std::lock_guard<std::mutex> lock{ m_mutex };
+
+            Record recordInPage;
+            if (address >= m_beginAddress.load(std::memory_order_relaxed) && TryRead(address, recordInPage))
+            {
+                buffer.assign(recordInPage.m_key.m_data, recordInPage.m_key.m_data + recordInPage.m_key.m_size);
+                buffer.insert(buffer.end(), recordInPage.m_value.m_data, recordInPage.m_value.m_data + recordInPage.m_value.m_size);
+                record = Record{ Key{ buffer.data(), recordInPage.m_key.m_size }, Value{ buffer.data() + recordInPage.m_key.m_size, recordInPage.m_value.m_size } };
+                return true;
+            }
+        }
+
+        return ReadFromFile(address, buffer, record);
+    }
+
+    // Reads the record at the given address from the file into the given buffer.
+    bool ReadFromFile(Address address, std::vector<std::uint8_t>& buffer, Record& record)
+    {
+        std::lock_guard<std::mutex> lock{ m_fileMutex };
+
+        if (address < m_beginAddress.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        auto* file = GetSegmentFile(GetSegmentIndex(address), false);
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        RecordHeader header;
+        file->seekg(GetSegmentOffset(address));
+        file->read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        if (!*file || header.m_flags != RecordHeader::c_validFlag)
+        {
+            file->clear();
+            return false;
+        }
+
+        buffer.resize(header.m_keySize + header.m_valueSize);
+        file->read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+
+        if (!*file)
+        {
+            file->clear();
+            return false;
+        }
+
+        record = Record{ Key{ buffer.data(), header.m_keySize }, Value{ buffer.data() + header.m_keySize, header.m_valueSize } };
+        return true;
+    }
+
+    // Visits the records in [begin address, untilAddress) in the address order, where
+    // "untilAddress" should not be greater than the read-only address (all the pages are flushed).
+    // The records passed to "func" point to a buffer that is valid only during the call.
+    template <typename Func>
+    void ForEachRecord(Address untilAddress, Func func)
+    {
+        assert(untilAddress <= GetReadOnlyAddress());
+
+        std::vector<std::uint8_t> page(m_pageSize);
+
+        for (auto pageIndex = GetPageIndex(GetBeginAddress()); pageIndex * m_pageSize < untilAddress; ++pageIndex)
+        {
+            {
+                std::lock_guard<std::mutex> lock{ m_fileMutex };
+
+                auto* file = GetSegmentFile(GetSegmentIndex(pageIndex * m_pageSize), false);
+                if (file == nullptr)
+                {
+                    throw RuntimeException("Log segment file is missing.");
+                }
+
+                file->seekg(GetSegmentOffset(pageIndex * m_pageSize));
+                file->read(reinterpret_cast<char*>(page.data()), page.size());
+
+                if (!*file)
+                {
+                    file->clear();
+                    throw RuntimeException("Failed to read the log page.");
+                }
+            }
+
+            std::uint32_t offset = 0U;
+            Record record;
+            while (Parse(page.data() + offset, m_pageSize - offset, record))
+            {
+                func(pageIndex * m_pageSize + offset, record);
+                offset += GetRecordSize(record.m_key, record.m_value);
+            }
+        }
+    }
+
+    // Returns the largest segment boundary that is not greater than the given address and the read-only address.
+    Address GetTruncatableAddress(Address address) const
+    {
+        const auto segmentSize = GetSegmentSize();
+        return ((std::min)(address, GetReadOnlyAddress()) / segmentSize) * segmentSize;
+    }
+
+    // Removes the records below the given address, which should be returned by GetTruncatableAddress().
+    // The in-memory pages below the address are evicted and the segment files are removed.
+    void Truncate(Address untilAddress)
+    {
+        assert(untilAddress == GetTruncatableAddress(untilAddress));
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+
+        if (untilAddress <= m_beginAddress.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        while (m_headAddress.load(std::memory_order_relaxed) < untilAddress)
+        {
+            EvictHeadPage();
+        }
+
+        std::lock_guard<std::mutex> fileLock{ m_fileMutex };
+
+        m_beginAddress.store(untilAddress, std::memory_order_release);
+
+        for (auto it = m_segments.begin();
+            it != m_segments.end() && (it->first + 1U) * GetSegmentSize() <= untilAddress;)
+        {
+            it->second.reset();
+            std::remove(GetSegmentFilePath(it->first).c_str());
+            it = m_segments.erase(it);
+        }
+    }
+
+    // Returns the lowest valid address.
+    Address GetBeginAddress() const
+    {
+        return m_beginAddress.load(std::memory_order_acquire);
+    }
+
+    // Returns the lowest address in memory.
+    Address GetHeadAddress() const
+    {
+        return m_headAddress.load(std::memory_order_acquire);
+    }
+
+    // Returns the start address of the tail page. All the pages below are read-only and flushed.
+    Address GetReadOnlyAddress() const
+    {
+        return (GetTailAddress() / m_pageSize) * m_pageSize;
+    }
+
+    // Returns the address where the next record is appended.
+    Address GetTailAddress() const
+    {
+        return m_tailAddress.load(std::memory_order_acquire);
+    }
+
+    std::uint64_t GetSegmentSize() const
+    {
+        return static_cast<std::uint64_t>(m_pageSize) * m_numPagesPerSegment;
+    }
+
+    Log(const Log&) = delete;
+    Log& operator=(const Log&) = delete;
+
+private:
+    struct RecordHeader
+    {
+        // The pages are zero initialized, thus a zero flag marks the end of the records in a page.
+        static constexpr std::uint16_t c_validFlag = 1U;
+
+        std::uint32_t m_valueSize;
+        std::uint16_t m_keySize;
+        std::uint16_t m_flags;
+    };
+
+    static_assert(sizeof(RecordHeader) == 8U, "RecordHeader should be 8 bytes.");
+
+    // Records are aligned so that the headers are aligned.
+    static constexpr std::uint32_t c_alignment = sizeof(RecordHeader);
+
+    struct Page
+    {
+        explicit Page(std::uint64_t index, std::uint32_t pageSize)
+            : m_index{ index }
+            , m_data{ new std::uint8_t[pageSize]() }
+        {}
+
+        const std::uint64_t m_index;
+        const std::unique_ptr<std::uint8_t[]> m_data;
+    };
+
+    static std::uint64_t GetRecordSize(const Key& key, const Value& value)
+    {
+        return (sizeof(RecordHeader) + key.m_size + static_cast<std::uint64_t>(value.m_size) + c_alignment - 1U)
+            & ~static_cast<std::uint64_t>(c_alignment - 1U);
+    }
+
+    static bool Parse(const std::uint8_t* buffer, std::uint64_t bufferSize, Record& record)
+    {
+        if (bufferSize < sizeof(RecordHeader))
+        {
+            return false;
+        }
+
+        RecordHeader header;
+        memcpy(&header, buffer, sizeof(header));
+
+        if (header.m_flags != RecordHeader::c_validFlag)
+        {
+            return false;
+        }
+
+        record = Record{
+            Key{ buffer + sizeof(header), header.m_keySize },
+            Value{ buffer + sizeof(header) + header.m_keySize, header.m_valueSize } };
+
+        return true;
+    }
+
+    std::uint64_t GetPageIndex(Address address) const
+    {
+        return address / m_pageSize;
+    }
+
+    std::uint32_t GetOffset(Address address) const
+    {
+        return static_cast<std::uint32_t>(address % m_pageSize);
+    }
+
+    std::uint64_t GetSegmentIndex(Address address) const
+    {
+        return address / GetSegmentSize();
+    }
+
+    std::uint64_t GetSegmentOffset(Address address) const
+    {
+        return address % GetSegmentSize();
+    }
+
+    std::string GetSegmentFilePath(std::uint64_t segmentIndex) const
+    {
+        return m_filePath + "." + std::to_string(segmentIndex);
+    }
+
+    Page* GetPage(std::uint64_t pageIndex) const
+    {
+        auto* page = m_pageTable[pageIndex % c_pageTableSize].load(std::memory_order_relaxed);
+        assert(page != nullptr && page->m_index == pageIndex);
+        return page;
+    }
+
+    // Flushes the given tail page and moves the tail to the beginning of the next page.
+    // Called under the lock.
+    Address MoveToNextPage(std::uint64_t pageIndex)
+    {
+        FlushPage(*GetPage(pageIndex));
+
+        AllocatePage(pageIndex + 1U);
+
+        const auto address = (pageIndex + 1U) * m_pageSize;
+        m_tailAddress.store(address, std::memory_order_release);
+
+        return address;
+    }
+
+    // Called under the lock.
+    void AllocatePage(std::uint64_t pageIndex)
+    {
+        while (pageIndex - GetPageIndex(m_headAddress.load(std::memory_order_relaxed)) >= m_numMemoryPages)
+        {
+            EvictHeadPage();
+        }
+
+        m_pageTable[pageIndex % c_pageTableSize].store(new Page(pageIndex, m_pageSize), std::memory_order_release);
+    }
+
+    // Called under the lock.
+    void EvictHeadPage()
+    {
+        const auto pageIndex = GetPageIndex(m_headAddress.load(std::memory_order_relaxed));
+
+        auto* page = m_pageTable[pageIndex % c_pageTableSize].exchange(nullptr, std::memory_order_acq_rel);
+        if (page != nullptr)
+        {
+            m_epochManager.RegisterAction(
+                [page]()
+            {
+                delete page;
+            });
+        }
+
+        m_headAddress.store((pageIndex + 1U) * m_pageSize, std::memory_order_release);
+    }
+
+    // Writes the given page to its segment file synchronously, which is called under the lock,
+    // thus the appends wait for the file write.
+    void FlushPage(const Page& page)
+    {
+        std::lock_guard<std::mutex> lock{ m_fileMutex };
+
+        const auto address = page.m_index * m_pageSize;
+
+        auto* file = GetSegmentFile(GetSegmentIndex(address), true);
+
+        file->seekp(GetSegmentOffset(address));
+        file->write(reinterpret_cast<const char*>(page.m_data.get()), m_pageSize);
+        file->flush();
+
+        if (!*file)
+        {
+            file->clear();
+            throw RuntimeException("Failed to write the log page.");
+        }
+    }
+
+    // Called under the file lock.
+    std::fstream* GetSegmentFile(std::uint64_t segmentIndex, bool create)
+    {
+        auto it = m_segments.find(segmentIndex);
+        if (it != m_segments.end())
+        {
+            return it->second.get();
+        }
+
+        if (!create)
+        {
+            return nullptr;
+        }
+
+        auto file = std::make_unique<std::fstream>(
+            GetSegmentFilePath(segmentIndex),
+            std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!file->is_open())
+        {
+            throw RuntimeException("Failed to create the log segment file.");
+        }
+
+        return m_segments.emplace(segmentIndex, std::move(file)).first->second.get();
+    }
+
+    const std::string m_filePath;
+
+    const std::uint32_t m_pageSize;
+
+    const std::uint32_t m_numMemoryPages;
+
+    const std::uint32_t m_numPagesPerSegment;
+
+    IEpochActionManager& m_epochManager;
+
+    // Page table indexed by (page index % c_pageTableSize).
+    const std::unique_ptr<std::atomic<Page*>[]> m_pageTable;
+
+    std::atomic<Address> m_beginAddress;
+
+    std::atomic<Address> m_headAddress;
+
+    std::atomic<Address> m_tailAddress;
+
+    // Serializes appends and page evictions.
+    std::mutex m_mutex;
+
+    // Serializes the file accesses.
+    std::mutex m_fileMutex;
+
+    std::map<std::uint64_t, std::unique_ptr<std::fstream>> m_segments;
+};
+
+} // namespace HybridLog
+} // namespace HashTable
+} // namespace L4
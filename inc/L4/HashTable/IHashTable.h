@@ -1,7 +1,11 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
+#include <utility>
+#include <vector>
 #include "Log/PerfCounter.h"
 #include "Utils/Properties.h"
 
@@ -43,9 +47,13 @@ struct IReadOnlyHashTable
     using Value = Blob<std::uint32_t>;
 
     struct IIterator;
+    struct ScanCursor;
 
     using IIteratorPtr = std::unique_ptr<IIterator>;
 
+    // Called with each record scanned, where the key and the value are valid only during the call.
+    using ScanVisitor = std::function<void(const Key&, const Value&)>;
+
     virtual ~IReadOnlyHashTable() = default;
 
     virtual bool Get(const Key& key, Value& value) const = 0;
@@ -53,6 +61,42 @@ struct IReadOnlyHashTable
     virtual IIteratorPtr GetIterator() const = 0;
 
     virtual const HashTablePerfData& GetPerfData() const = 0;
+
+    // Calls the visitor with up to "maxRecords" records starting at the given cursor,
+    // and returns the cursor to resume from. Unlike IIterator, a scan doesn't need to stay in
+    // one Context, so that a long scan reads a page per short-lived Context and doesn't hold
+    // back the memory reclamation. See ScanCursor for the semantics under concurrent writes.
+    virtual ScanCursor Scan(const ScanCursor& cursor, std::uint32_t maxRecords, const ScanVisitor& visitor) const = 0;
+
+    // Calls the visitor with "numRecords" records chosen uniformly at random with replacement,
+    // in expected time proportional to "numRecords" unless the hash table is mostly empty.
+    // Returns the number of records visited, which can be less than "numRecords" if random
+    // probes keep hitting empty slots (e.g., the hash table is empty or very sparse).
+    virtual std::uint32_t Sample(std::uint32_t numRecords, const ScanVisitor& visitor) const = 0;
+};
+
+// IReadOnlyHashTable::ScanCursor struct is the position of a scan, which is plain data so that
+// it can be stored and passed around between the pages. A default constructed cursor starts
+// a scan. Since the records don't move between the slots of the buckets, a record that exists
+// and is not removed during the whole scan is visited exactly once (with any value it had
+// during the scan), whereas a record added or removed during the scan may or may not be visited.
+// A cursor can't be used with a hash table that has a different number of buckets.
+struct IReadOnlyHashTable::ScanCursor
+{
+    bool IsEnd() const
+    {
+        return m_numBuckets != 0U && m_bucketIndex >= m_numBuckets;
+    }
+
+    // The number of buckets of the hash table being scanned (zero if the scan is not started).
+    std::uint32_t m_numBuckets = 0U;
+
+    // The bucket to resume from.
+    std::uint32_t m_bucketIndex = 0U;
+
+    // The slot to resume from in the chain of the bucket, where the slots of the i-th entry
+    // in the chain are numbered from i * (the number of slots per entry).
+    std::uint32_t m_slotIndex = 0U;
 };
 
 // IReadOnlyHashTable::IIterator interface for the hash table iterator.
@@ -74,13 +118,320 @@ struct IWritableHashTable : public virtual IReadOnlyHashTable
 {
     struct ISerializer;
 
+    struct MergePolicy;
+
+    struct RemovePolicy;
+
+    struct RelocationPolicy;
+
+    struct RelocationResult;
+
     using ISerializerPtr = std::unique_ptr<ISerializer>;
 
     virtual void Add(const Key& key, const Value& value) = 0;
 
+    // The following conditional writes return true if the record is written. The condition is
+    // checked before the record is created, so that no memory is allocated if nothing is written.
+
+    // Adds the record only if the key doesn't exist.
+    virtual bool AddIfAbsent(const Key& key, const Value& value) = 0;
+
+    // Replaces the value only if the key exists.
+    virtual bool ReplaceIfPresent(const Key& key, const Value& value) = 0;
+
+    // Replaces the value only if the key exists with the expected value.
+    virtual bool ReplaceIfEqual(const Key& key, const Value& expectedValue, const Value& value) = 0;
+
     virtual bool Remove(const Key& key) = 0;
 
     virtual ISerializerPtr GetSerializer() const = 0;
+
+    // Adds all the records in the given hash table to this hash table in parallel,
+    // where the given policy decides how to resolve keys that exist in both.
+    virtual void MergeFrom(IWritableHashTable& source, const MergePolicy& policy) = 0;
+
+    // Removes all the records for which the predicate of the given policy returns true by
+    // sweeping the buckets in parallel, and returns the number of records removed.
+    // It can run while the hash table is being served, throttled by the given policy.
+    virtual std::uint64_t RemoveIf(const RemovePolicy& policy) = 0;
+
+    // Copies the records into newly allocated memory in bucket order, so that the records
+    // scattered across the heap by updates are packed together again (see RelocationPolicy).
+    // It can run while the hash table is being served.
+    virtual RelocationResult Relocate(const RelocationPolicy& policy) = 0;
+
+    // Pre-allocates and pre-faults the memory for the given number of records whose keys and
+    // values total "numBytes" bytes, so that adding them allocates from the reserved memory
+    // instead of the allocator. It should be called once before the hash table is written
+    // concurrently, e.g., before a bulk load. Note that the reserved memory is released only
+    // with the hash table, and the allocator is used once the reserved memory runs out.
+    virtual void Reserve(std::uint64_t numRecords, std::uint64_t numBytes) = 0;
+};
+
+// ICacheHashTable interface for refreshing the expiration of cache records.
+struct ICacheHashTable
+{
+    using Key = IReadOnlyHashTable::Key;
+    using Keys = std::vector<Key>;
+
+    struct WriteBackPolicy;
+
+    virtual ~ICacheHashTable() = default;
+
+    // Refreshes the record for the given key so that it expires after the time-to-live
+    // of the hash table from now. Returns false if the record does not exist or is expired.
+    virtual bool Touch(const Key& key) = 0;
+
+    // Refreshes the record for the given key so that it expires after the given time-to-live from now.
+    virtual bool Touch(const Key& key, std::chrono::seconds timeToLive) = 0;
+
+    // Refreshes the records for the given keys and returns the number of records refreshed.
+    virtual std::size_t TouchMany(const Keys& keys) = 0;
+
+    virtual std::size_t TouchMany(const Keys& keys, std::chrono::seconds timeToLive) = 0;
+
+    // Hands all the dirty records of a write-back cache (see WriteBackPolicy) to the flusher,
+    // and returns the number of records flushed. It should be called before the hash table
+    // is destroyed so that the last writes are not lost.
+    virtual std::uint64_t Flush() = 0;
+
+    // The following are used to share a memory budget among cache hash tables
+    // (see LocalMemory::MemoryGovernor).
+    virtual std::uint64_t GetMaxCacheSizeInBytes() const = 0;
+
+    // Lowering the max cache size evicts the records over the new size.
+    virtual void SetMaxCacheSizeInBytes(std::uint64_t maxCacheSizeInBytes) = 0;
+
+    // Starts counting HashTablePerfCounter::GhostHitCount, which costs a hash of the key per
+    // miss and per eviction.
+    virtual void EnableGhostTracking() = 0;
+};
+
+// ICacheHashTable::WriteBackPolicy struct turns a cache hash table into a write-back cache,
+// where a write marks the record dirty instead of requiring the caller to write through to
+// the backing store. The dirty records are handed to the flusher in batches periodically
+// and when they are evicted, and repeated writes to a key before a flush are coalesced.
+// Note that Remove() drops a dirty record without flushing it.
+struct ICacheHashTable::WriteBackPolicy
+{
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+    using Records = std::vector<std::pair<Key, Value>>;
+
+    // Called with a batch of dirty records, whose keys and values are valid only during the call.
+    // It is called one batch at a time, from the flushing thread or from a writer evicting records.
+    using Flusher = std::function<void(const Records&)>;
+
+    // If "flushInterval" is zero, the dirty records are flushed only by eviction and Flush().
+    explicit WriteBackPolicy(
+        Flusher flusher,
+        std::chrono::milliseconds flushInterval = std::chrono::milliseconds{ 1000U },
+        std::uint32_t maxBatchSize = 1024U)
+        : m_flusher{ std::move(flusher) }
+        , m_flushInterval{ flushInterval }
+        , m_maxBatchSize{ maxBatchSize }
+    {}
+
+    Flusher m_flusher;
+    std::chrono::milliseconds m_flushInterval;
+    std::uint32_t m_maxBatchSize;
+};
+
+// IWritableHashTable::MergePolicy struct for IWritableHashTable::MergeFrom().
+struct IWritableHashTable::MergePolicy
+{
+    enum class Conflict : std::uint8_t
+    {
+        // The record in the source replaces the existing record.
+        Overwrite = 0U,
+
+        // The existing record is kept.
+        Keep,
+
+        // The value produced by m_mergeCallback replaces the existing record.
+        Merge
+    };
+
+    // Called for each key that exists in both hash tables when m_conflict is Merge.
+    // The merged value should be written to "mergedValue". Note that it is called
+    // under the bucket lock of this hash table, so it should not access the hash table.
+    using MergeCallback = std::function<void(
+        const Key& key,
+        const Value& existingValue,
+        const Value& newValue,
+        std::vector<std::uint8_t>& mergedValue)>;
+
+    explicit MergePolicy(
+        Conflict conflict = Conflict::Overwrite,
+        MergeCallback mergeCallback = {},
+        bool moveRecords = false,
+        std::uint16_t numThreads = 0U)
+        : m_conflict{ conflict }
+        , m_mergeCallback{ std::move(mergeCallback) }
+        , m_moveRecords{ moveRecords }
+        , m_numThreads{ numThreads }
+    {}
+
+    Conflict m_conflict;
+    MergeCallback m_mergeCallback;
+
+    // If true, the records are moved (not copied) from the source when both hash tables
+    // share the same allocator and record layout. The moved records are removed from the
+    // source, while the records that are not moved (Keep and Merge) remain in the source.
+    bool m_moveRecords;
+
+    // The number of threads that the source buckets are partitioned across.
+    // If 0, std::thread::hardware_concurrency() is used.
+    std::uint16_t m_numThreads;
+};
+
+// IOrderedHashTable interface for scanning the records of the hash table in key order.
+// It is implemented by the hash tables created with an ordered index
+// (see HashTableConfig::m_hasOrderedIndex), thus IWritableHashTable returned for such
+// hash tables can be cast to IOrderedHashTable. Keys are ordered lexicographically by bytes.
+struct IOrderedHashTable
+{
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    // Visitor is called for each record in order. Returning false stops the scan.
+    using Visitor = std::function<bool(const Key&, const Value&)>;
+
+    virtual ~IOrderedHashTable() = default;
+
+    // Visits the records whose keys are in [from, to).
+    // An empty "to" key means there is no upper bound.
+    virtual void Scan(const Key& from, const Key& to, const Visitor& visitor) const = 0;
+
+    // Visits the records whose keys start with the given prefix.
+    virtual void PrefixScan(const Key& prefix, const Visitor& visitor) const = 0;
+};
+
+// IColumnHashTable interface for the records that hold multiple named values (columns)
+// per key, so that the columns of a key are looked up with one probe. It is implemented
+// by the hash tables created with columns (see HashTableConfig::m_columns), where the values
+// of Get()/Add() are encoded with all the columns (see HashTable::ColumnSchema).
+struct IColumnHashTable
+{
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+    using Values = std::vector<Value>;
+    using ColumnIndex = std::uint8_t;
+
+    // Bit i selects the column i.
+    using ColumnMask = std::uint64_t;
+
+    virtual ~IColumnHashTable() = default;
+
+    virtual ColumnIndex GetColumnIndex(const char* columnName) const = 0;
+
+    // Gets the selected columns in the order of the column indices, where a column that
+    // is not set is empty. The values point to the record, thus are valid in the epoch.
+    virtual bool GetColumns(const Key& key, ColumnMask columnMask, Values& values) const = 0;
+
+    // Adds a record with the given columns in the order of the column indices.
+    virtual void AddColumns(const Key& key, const Values& values) = 0;
+
+    // Replaces the given column of the record, where the other columns are copied to the
+    // new record and the old record is released via the epoch. If the key doesn't exist,
+    // a record with only the given column is added.
+    virtual void UpdateColumn(const Key& key, ColumnIndex column, const Value& value) = 0;
+};
+
+// IAsyncHashTable interface for the look ups that may need to read from a storage device.
+// It is implemented by the hash tables backed by a hybrid log (see HashTableConfig::m_hybridLog).
+struct IAsyncHashTable
+{
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    // Called with the result of the look up, where the value is valid only during the call.
+    using Callback = std::function<void(bool found, const Value& value)>;
+
+    virtual ~IAsyncHashTable() = default;
+
+    // Calls the callback inline if the record is in memory (or does not exist). Otherwise,
+    // the callback is called from an I/O thread once the record is read from the storage.
+    virtual void GetAsync(const Key& key, Callback callback) const = 0;
+};
+
+struct IWritableHashTable::RemovePolicy
+{
+    // Called for each record under the bucket lock, thus it should not access the hash table.
+    using Predicate = std::function<bool(const Key& key, const Value& value)>;
+
+    struct Progress
+    {
+        std::uint64_t m_numBucketsSwept;
+        std::uint64_t m_numBuckets;
+        std::uint64_t m_numRecordsRemoved;
+    };
+
+    // Called after each batch of buckets is swept. The calls are serialized across the threads.
+    using ProgressCallback = std::function<void(const Progress& progress)>;
+
+    explicit RemovePolicy(
+        Predicate predicate,
+        std::uint16_t numThreads = 0U,
+        std::uint32_t numBucketsPerBatch = 1024U,
+        std::chrono::microseconds pauseBetweenBatches = std::chrono::microseconds{ 0 },
+        ProgressCallback progressCallback = {})
+        : m_predicate{ std::move(predicate) }
+        , m_numThreads{ numThreads }
+        , m_numBucketsPerBatch{ numBucketsPerBatch }
+        , m_pauseBetweenBatches{ pauseBetweenBatches }
+        , m_progressCallback{ std::move(progressCallback) }
+    {}
+
+    Predicate m_predicate;
+
+    // The number of threads that the buckets are partitioned across.
+    // If 0, std::thread::hardware_concurrency() is used.
+    std::uint16_t m_numThreads;
+
+    // Each thread sleeps for m_pauseBetweenBatches after sweeping m_numBucketsPerBatch buckets,
+    // which throttles the sweep when it runs online.
+    std::uint32_t m_numBucketsPerBatch;
+    std::chrono::microseconds m_pauseBetweenBatches;
+
+    ProgressCallback m_progressCallback;
+};
+
+// The buckets are relocated in batches, where a batch is relocated only if its fragmentation
+// estimate is at least m_minFragmentation. The estimate of a batch is the number of memory
+// pages visited while reading its records in bucket order divided by the number of pages
+// that the records would occupy if packed, thus 1 means that the records are packed.
+struct IWritableHashTable::RelocationPolicy
+{
+    explicit RelocationPolicy(
+        double minFragmentation = 2.0,
+        std::uint16_t numThreads = 1U,
+        std::uint32_t numBucketsPerBatch = 1024U,
+        std::chrono::microseconds pauseBetweenBatches = std::chrono::microseconds{ 0 })
+        : m_minFragmentation{ minFragmentation }
+        , m_numThreads{ numThreads }
+        , m_numBucketsPerBatch{ numBucketsPerBatch }
+        , m_pauseBetweenBatches{ pauseBetweenBatches }
+    {}
+
+    double m_minFragmentation;
+
+    // The number of threads that the buckets are partitioned across.
+    // If 0, std::thread::hardware_concurrency() is used.
+    std::uint16_t m_numThreads;
+
+    // Each thread sleeps for m_pauseBetweenBatches after each batch of m_numBucketsPerBatch buckets.
+    std::uint32_t m_numBucketsPerBatch;
+    std::chrono::microseconds m_pauseBetweenBatches;
+};
+
+struct IWritableHashTable::RelocationResult
+{
+    std::uint64_t m_numBucketsRelocated = 0U;
+    std::uint64_t m_numRecordsRelocated = 0U;
+
+    // The fragmentation estimate of all the records before the relocation.
+    double m_fragmentation = 1.0;
 };
 
 // IWritableHashTable::ISerializer interface for serializing hash table.
@@ -0,0 +1,482 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "Epoch/IEpochActionManager.h"
+#include "HashTable/IHashTable.h"
+#include "HashTable/ReadWrite/HashTable.h"
+#include "Log/PerfCounter.h"
+#include "Utils/Exception.h"
+
+namespace L4
+{
+namespace HashTable
+{
+namespace ReadWrite
+{
+
+// Builder populates a hash table from raw key/value input using all the cores, which is
+// intended for producing a snapshot offline (see the L4.Builder tool) rather than for serving.
+//
+// Each batch given to Add() is processed in two phases:
+//   1. The batch is split at record boundaries and each thread parses its part, routing every
+//      record to the partition that owns its bucket (one contiguous bucket range per thread).
+//   2. Each thread inserts the records of its partition in the input order, so that no two
+//      threads touch the same bucket and duplicate keys are resolved deterministically.
+// The parsed keys and values point into the batch, thus records are copied only once.
+//
+// Supported input formats:
+//   Tsv:    "<key>\t<value>\n" per line. A trailing '\r' is removed and empty lines are skipped.
+//   Binary: <uint32 key size><key><uint32 value size><value> per record in the native byte order.
+template <typename Allocator>
+class Builder
+{
+public:
+    using HashTable = typename WritableHashTable<Allocator>::HashTable;
+
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    enum class Format : std::uint8_t
+    {
+        Tsv = 0U,
+        Binary
+    };
+
+    // Decides which record is kept when the same key appears more than once in the input.
+    enum class DuplicatePolicy : std::uint8_t
+    {
+        // The last record in the input order is kept.
+        Overwrite = 0U,
+
+        // The first record in the input order is kept.
+        Keep,
+
+        // Add() throws.
+        Fail
+    };
+
+    // Report struct summarizes the hash table built so far.
+    struct Report
+    {
+        std::uint64_t m_numRecords = 0U;
+        std::uint64_t m_numDuplicates = 0U;
+        std::uint64_t m_totalKeySize = 0U;
+        std::uint64_t m_totalValueSize = 0U;
+        std::uint64_t m_totalIndexSize = 0U;
+        std::uint64_t m_numBuckets = 0U;
+        std::uint64_t m_numEmptyBuckets = 0U;
+
+        // The number of entries chained after the buckets and the longest chain (in entries).
+        std::uint64_t m_numChainingEntries = 0U;
+        std::uint64_t m_maxChainLength = 0U;
+    };
+
+    // If "numThreads" is 0, std::thread::hardware_concurrency() is used.
+    Builder(
+        HashTable& hashTable,
+        IEpochActionManager& epochManager,
+        DuplicatePolicy duplicatePolicy = DuplicatePolicy::Overwrite,
+        std::uint16_t numThreads = 0U)
+        : m_hashTable{ hashTable }
+        , m_table{ hashTable, epochManager }
+        , m_duplicatePolicy{ duplicatePolicy }
+        , m_numThreads{
+            (std::min)(
+                (std::max)(
+                    (numThreads != 0U) ? static_cast<std::uint32_t>(numThreads) : std::thread::hardware_concurrency(),
+                    1U),
+                static_cast<std::uint32_t>(hashTable.m_buckets.size())) }
+        , m_numDuplicates{ 0U }
+    {}
+
+    // Parses the given batch, which should contain only complete records
+    // (see GetCompleteSize()), and adds the records to the hash table.
+    void Add(const char* data, std::size_t size, Format format)
+    {
+        const auto boundaries = Split(data, size, format);
+
+        // partitions[i][j] holds the records parsed by the thread i for the partition j.
+        std::vector<std::vector<std::vector<Record>>> partitions(
+            m_numThreads,
+            std::vector<std::vector<Record>>(m_numThreads));
+
+        RunInParallel(
+            [&](std::uint32_t threadIndex)
+        {
+            std::vector<Key> keys;
+            std::vector<Value> values;
+
+            Parse(
+                data + boundaries[threadIndex],
+                boundaries[threadIndex + 1] - boundaries[threadIndex],
+                format,
+                [&keys, &values](const Key& key, const Value& value)
+            {
+                keys.push_back(key);
+                values.push_back(value);
+            });
+
+            // The keys are hashed together, and the hashes are reused for the insertion.
+            std::vector<Hash> hashes(keys.size());
+            Table::GetHashes(keys.data(), keys.size(), hashes.data());
+
+            for (std::size_t i = 0U; i < keys.size(); ++i)
+            {
+                partitions[threadIndex][GetPartition(hashes[i])].emplace_back(Record{ keys[i], values[i], hashes[i] });
+            }
+        });
+
+        RunInParallel(
+            [&](std::uint32_t partitionIndex)
+        {
+            std::uint64_t numDuplicates = 0U;
+
+            for (const auto& records : partitions)
+            {
+                for (const auto& record : records[partitionIndex])
+                {
+                    numDuplicates += Insert(record) ? 0U : 1U;
+                }
+            }
+
+            m_numDuplicates.fetch_add(numDuplicates);
+        });
+    }
+
+    // Returns the size of the longest prefix of the given data that has only complete records.
+    // If "isEnd" is true, the data is the end of the input, thus a TSV line doesn't need
+    // a newline, whereas a partial binary record throws.
+    static std::size_t GetCompleteSize(const char* data, std::size_t size, Format format, bool isEnd)
+    {
+        if (format == Format::Tsv)
+        {
+            if (isEnd)
+            {
+                return size;
+            }
+
+            for (auto i = size; i > 0U; --i)
+            {
+                if (data[i - 1] == '\n')
+                {
+                    return i;
+                }
+            }
+
+            return 0U;
+        }
+
+        std::size_t offset = 0U;
+        std::size_t recordSize = 0U;
+
+        while ((recordSize = GetBinaryRecordSize(data + offset, size - offset)) != 0U)
+        {
+            offset += recordSize;
+        }
+
+        if (isEnd && offset != size)
+        {
+            throw RuntimeException("The input ends with an incomplete record.");
+        }
+
+        return offset;
+    }
+
+    // Returns the hash table being built.
+    IWritableHashTable& GetHashTable()
+    {
+        return m_table;
+    }
+
+    // Walks the buckets, thus it should not be called while Add() is in progress.
+    Report GetReport() const
+    {
+        const auto& perfData = m_table.GetPerfData();
+
+        Report report;
+        report.m_numRecords = perfData.Get(HashTablePerfCounter::RecordsCount);
+        report.m_numDuplicates = m_numDuplicates.load();
+        report.m_totalKeySize = perfData.Get(HashTablePerfCounter::TotalKeySize);
+        report.m_totalValueSize = perfData.Get(HashTablePerfCounter::TotalValueSize);
+        report.m_totalIndexSize = perfData.Get(HashTablePerfCounter::TotalIndexSize);
+        report.m_numBuckets = m_hashTable.m_buckets.size();
+
+        for (const auto& bucket : m_hashTable.m_buckets)
+        {
+            std::uint64_t chainLength = 0U;
+            bool isEmpty = true;
+
+            for (const auto* entry = &bucket; entry != nullptr; entry = entry->m_next.Load())
+            {
+                ++chainLength;
+
+                for (const auto& data : entry->m_dataList)
+                {
+                    isEmpty = isEmpty && (data.Load() == nullptr);
+                }
+            }
+
+            report.m_numEmptyBuckets += isEmpty ? 1U : 0U;
+            report.m_numChainingEntries += chainLength - 1U;
+            report.m_maxChainLength = (std::max)(report.m_maxChainLength, chainLength);
+        }
+
+        return report;
+    }
+
+    Builder(const Builder&) = delete;
+    Builder& operator=(const Builder&) = delete;
+
+private:
+    // Table exposes the hashing and the bucket look up of WritableHashTable for partitioning.
+    class Table : public WritableHashTable<Allocator>
+    {
+    public:
+        Table(HashTable& hashTable, IEpochActionManager& epochManager)
+            : ReadOnlyHashTable<Allocator>(hashTable)
+            , WritableHashTable<Allocator>(hashTable, epochManager)
+        {}
+
+        using typename WritableHashTable<Allocator>::Hash;
+        using WritableHashTable<Allocator>::Add;
+        using WritableHashTable<Allocator>::Find;
+        using WritableHashTable<Allocator>::GetBucketInfo;
+        using WritableHashTable<Allocator>::GetHashes;
+    };
+
+    using Hash = typename Table::Hash;
+
+    struct Record
+    {
+        Key m_key;
+        Value m_value;
+        Hash m_hash;
+    };
+
+    using RecordSize = std::uint32_t;
+
+    // Returns the size of the binary record at the beginning of the given data,
+    // or 0 if the data doesn't have a complete record.
+    static std::size_t GetBinaryRecordSize(const char* data, std::size_t size)
+    {
+        RecordSize keySize;
+        RecordSize valueSize;
+
+        if (size < sizeof(keySize))
+        {
+            return 0U;
+        }
+
+        memcpy(&keySize, data, sizeof(keySize));
+
+        const std::size_t valueOffset = sizeof(keySize) + static_cast<std::size_t>(keySize);
+        if (size < valueOffset + sizeof(valueSize))
+        {
+            return 0U;
+        }
+
+        memcpy(&valueSize, data + valueOffset, sizeof(valueSize));
+
+        const std::size_t recordSize = valueOffset + sizeof(valueSize) + static_cast<std::size_t>(valueSize);
+        return (size < recordSize) ? 0U : recordSize;
+    }
+
+    // Returns the offsets that split the given data into m_numThreads parts at record boundaries.
+    std::vector<std::size_t> Split(const char* data, std::size_t size, Format format) const
+    {
+        std::vector<std::size_t> boundaries(m_numThreads + 1U, size);
+        boundaries[0] = 0U;
+
+        if (format == Format::Tsv)
+        {
+            for (std::uint32_t i = 1U; i < m_numThreads; ++i)
+            {
+                auto offset = (std::max)(boundaries[i - 1], (size / m_numThreads) * i);
+                while (offset < size && offset > 0U && data[offset - 1] != '\n')
+                {
+                    ++offset;
+                }
+
+                boundaries[i] = offset;
+            }
+        }
+        else
+        {
+            // Binary records can only be delimited from the beginning, which reads just the sizes.
+            std::size_t offset = 0U;
+            std::uint32_t i = 1U;
+
+            while (offset < size)
+            {
+                const auto recordSize = GetBinaryRecordSize(data + offset, size - offset);
+                if (recordSize == 0U)
+                {
+                    throw RuntimeException("The input has an incomplete record.");
+                }
+
+                offset += recordSize;
+
+                while (i < m_numThreads && offset >= (size / m_numThreads) * i)
+                {
+                    boundaries[i++] = offset;
+                }
+            }
+        }
+
+        return boundaries;
+    }
+
+    template <typename Func>
+    static void Parse(const char* data, std::size_t size, Format format, Func func)
+    {
+        const auto* end = data + size;
+
+        while (data < end)
+        {
+            const char* keyBegin;
+            std::size_t keySize;
+            const char* valueBegin;
+            std::size_t valueSize;
+
+            if (format == Format::Tsv)
+            {
+                const auto* lineEnd = static_cast<const char*>(memchr(data, '\n', end - data));
+                const auto* next = (lineEnd != nullptr) ? lineEnd + 1 : end;
+                lineEnd = (lineEnd != nullptr) ? lineEnd : end;
+
+                if (lineEnd > data && lineEnd[-1] == '\r')
+                {
+                    --lineEnd;
+                }
+
+                if (lineEnd == data)
+                {
+                    data = next;
+                    continue;
+                }
+
+                const auto* tab = static_cast<const char*>(memchr(data, '\t', lineEnd - data));
+                if (tab == nullptr)
+                {
+                    throw RuntimeException("The TSV input has a line without a tab.");
+                }
+
+                keyBegin = data;
+                keySize = tab - data;
+                valueBegin = tab + 1;
+                valueSize = lineEnd - valueBegin;
+                data = next;
+            }
+            else
+            {
+                // Split() has already validated the records.
+                RecordSize recordSize;
+
+                memcpy(&recordSize, data, sizeof(recordSize));
+                keyBegin = data + sizeof(recordSize);
+                keySize = recordSize;
+
+                memcpy(&recordSize, keyBegin + keySize, sizeof(recordSize));
+                valueBegin = keyBegin + keySize + sizeof(recordSize);
+                valueSize = recordSize;
+                data = valueBegin + valueSize;
+            }
+
+            if (keySize > (std::numeric_limits<Key::size_type>::max)())
+            {
+                throw RuntimeException("The input has a key that is too large.");
+            }
+
+            func(
+                Key{ reinterpret_cast<const std::uint8_t*>(keyBegin), static_cast<Key::size_type>(keySize) },
+                Value{ reinterpret_cast<const std::uint8_t*>(valueBegin), static_cast<Value::size_type>(valueSize) });
+        }
+    }
+
+    std::uint32_t GetPartition(const Hash& hash) const
+    {
+        return static_cast<std::uint32_t>(
+            (static_cast<std::uint64_t>(m_table.GetBucketInfo(hash).first) * m_numThreads) / m_hashTable.m_buckets.size());
+    }
+
+    // Returns false if the key already exists. Only the thread that owns the partition
+    // of the key updates its bucket, thus checking and adding don't need to be atomic.
+    bool Insert(const Record& record)
+    {
+        const bool exists = (m_table.Find(record.m_key, m_table.GetBucketInfo(record.m_hash)) != nullptr);
+
+        if (exists)
+        {
+            if (m_duplicatePolicy == DuplicatePolicy::Fail)
+            {
+                throw RuntimeException("The input has a duplicate key.");
+            }
+
+            if (m_duplicatePolicy == DuplicatePolicy::Keep)
+            {
+                return false;
+            }
+        }
+
+        m_table.Add(record.m_key, record.m_value, record.m_hash);
+
+        return !exists;
+    }
+
+    template <typename Func>
+    void RunInParallel(Func func)
+    {
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> exceptions(m_numThreads);
+
+        for (std::uint32_t i = 0U; i < m_numThreads; ++i)
+        {
+            threads.emplace_back(
+                [&func, &exceptions, i]()
+            {
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    exceptions[i] = std::current_exception();
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (const auto& exception : exceptions)
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+    }
+
+    HashTable& m_hashTable;
+
+    Table m_table;
+
+    const DuplicatePolicy m_duplicatePolicy;
+
+    const std::uint32_t m_numThreads;
+
+    std::atomic<std::uint64_t> m_numDuplicates;
+};
+
+} // namespace ReadWrite
+} // namespace HashTable
+} // namespace L4
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Epoch/IEpochActionManager.h"
+#include "HashTable/Common/ColumnSchema.h"
+#include "HashTable/IHashTable.h"
+#include "HashTable/ReadWrite/HashTable.h"
+#include "Utils/Exception.h"
+
+namespace L4
+{
+namespace HashTable
+{
+namespace ReadWrite
+{
+
+// The following warning is from the virtual inheritance and safe to disable in this case.
+// https://msdn.microsoft.com/en-us/library/6b3sy7ae.aspx
+#pragma warning(push)
+#pragma warning(disable:4250)
+
+// ColumnWritableHashTable is a WritableHashTable whose values hold the columns defined by
+// a ColumnSchema (IColumnHashTable), so that the columns of a key that would otherwise be
+// kept in separate hash tables are looked up with one hash and one chain walk.
+// Records are never updated in place; UpdateColumn() rewrites the whole record under
+// the bucket lock and the old record is released via the epoch as in Add().
+template <typename Allocator>
+class ColumnWritableHashTable
+    : public WritableHashTable<Allocator>
+    , public IColumnHashTable
+{
+public:
+    using Base = WritableHashTable<Allocator>;
+    using HashTable = typename Base::HashTable;
+
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+    using Values = IColumnHashTable::Values;
+
+    ColumnWritableHashTable(
+        HashTable& hashTable,
+        IEpochActionManager& epochManager,
+        ColumnSchema schema)
+        : ReadOnlyHashTable<Allocator>(hashTable)
+        , Base(hashTable, epochManager)
+        , m_schema{ std::move(schema) }
+    {}
+
+    // The values given to the following are encoded with all the columns.
+    virtual void Add(const Key& key, const Value& value) override
+    {
+        Validate(value);
+        Base::Add(key, value);
+    }
+
+    virtual bool AddIfAbsent(const Key& key, const Value& value) override
+    {
+        Validate(value);
+        return Base::AddIfAbsent(key, value);
+    }
+
+    virtual bool ReplaceIfPresent(const Key& key, const Value& value) override
+    {
+        Validate(value);
+        return Base::ReplaceIfPresent(key, value);
+    }
+
+    virtual bool ReplaceIfEqual(const Key& key, const Value& expectedValue, const Value& value) override
+    {
+        Validate(value);
+        return Base::ReplaceIfEqual(key, expectedValue, value);
+    }
+
+    virtual ColumnIndex GetColumnIndex(const char* columnName) const override
+    {
+        return m_schema.GetColumnIndex(columnName);
+    }
+
+    virtual bool GetColumns(const Key& key, ColumnMask columnMask, Values& values) const override
+    {
+        Value value;
+        if (!this->Get(key, value))
+        {
+            return false;
+        }
+
+        values.clear();
+
+        for (std::uint32_t i = 0U; i < m_schema.GetNumColumns(); ++i)
+        {
+            if ((columnMask & (static_cast<ColumnMask>(1U) << i)) != 0U)
+            {
+                values.emplace_back(m_schema.GetColumn(value, static_cast<ColumnIndex>(i)));
+            }
+        }
+
+        return true;
+    }
+
+    virtual void AddColumns(const Key& key, const Values& values) override
+    {
+        std::vector<std::uint8_t> buffer;
+        m_schema.Encode(values, buffer);
+
+        Base::Add(key, Value{ buffer.data(), static_cast<Value::size_type>(buffer.size()) });
+    }
+
+    virtual void UpdateColumn(const Key& key, ColumnIndex column, const Value& value) override
+    {
+        if (column >= m_schema.GetNumColumns())
+        {
+            throw RuntimeException("Column does not exist.");
+        }
+
+        // The predicate is called last under the bucket lock right before the record is created,
+        // thus the existing value captured is not released while the new record is encoded.
+        const auto hash = this->GetHash(key);
+
+        Value existingValue;
+        std::vector<std::uint8_t> buffer;
+
+        // Admitted before the bucket lock is taken by the size of the value encoded from the current one,
+        // which is encoded again under the lock below.
+        if (this->HasMemoryBudget())
+        {
+            if (!this->GetValue(key, hash, existingValue))
+            {
+                existingValue = Value{};
+            }
+
+            m_schema.Encode(existingValue, column, value, buffer);
+            this->Admit(key.m_size + buffer.size());
+        }
+
+        this->AddRecordIf(
+            key,
+            hash,
+            [&existingValue](const Value* currentValue)
+            {
+                existingValue = (currentValue != nullptr) ? *currentValue : Value{};
+                return true;
+            },
+            [this, &key, column, &value, &existingValue, &buffer]()
+            {
+                m_schema.Encode(existingValue, column, value, buffer);
+                return this->CreateRecordBuffer(
+                    key,
+                    Value{ buffer.data(), static_cast<Value::size_type>(buffer.size()) });
+            });
+
+        // Recorded as a write of the whole encoded value, which is what a replay can reproduce.
+        this->RecordOperation(OperationType::Add, key, hash, static_cast<std::uint32_t>(buffer.size()), true);
+    }
+
+    const ColumnSchema& GetSchema() const
+    {
+        return m_schema;
+    }
+
+private:
+    void Validate(const Value& value) const
+    {
+        if (!m_schema.IsValid(value))
+        {
+            throw RuntimeException("The value is not encoded with the column schema.");
+        }
+    }
+
+    const ColumnSchema m_schema;
+};
+
+#pragma warning(pop)
+
+} // namespace ReadWrite
+} // namespace HashTable
+} // namespace L4
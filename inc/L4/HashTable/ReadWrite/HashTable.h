@@ -1,17 +1,31 @@
 #pragma once
 
 #include <boost/optional.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
 #include "detail/ToRawPointer.h"
 #include "Epoch/IEpochActionManager.h"
+#include "HashTable/Common/MemoryBudget.h"
+#include "HashTable/Common/NearCache.h"
 #include "HashTable/Common/SharedHashTable.h"
 #include "HashTable/Common/Record.h"
 #include "HashTable/IHashTable.h"
 #include "HashTable/ReadWrite/Serializer.h"
+#include "Log/OperationRecorder.h"
 #include "Log/PerfCounter.h"
 #include "Utils/Exception.h"
 #include "Utils/MurmurHash3.h"
+#include "Utils/MurmurHash3Batch.h"
 #include "Utils/Properties.h"
 
 namespace L4
@@ -47,36 +61,12 @@ public:
 
     virtual bool Get(const Key& key, Value& value) const override
     {
-        const auto bucketInfo = GetBucketInfo(key);
-        const auto* entry = &m_hashTable.m_buckets[bucketInfo.first];
-
-        while (entry != nullptr)
-        {
-            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
-            {
-                if (bucketInfo.second == entry->m_tags[i])
-                {
-                    // There could be a race condition where m_dataList[i] is updated during access.
-                    // Therefore, load it once and save it (it's safe to store it b/c the memory
-                    // will not be deleted until ref count becomes 0).
-                    const auto data = entry->m_dataList[i].Load(std::memory_order_acquire);
-
-                    if (data != nullptr)
-                    {
-                        const auto record = m_recordSerializer.Deserialize(*data);
-                        if (record.m_key == key)
-                        {
-                            value = record.m_value;
-                            return true;
-                        }
-                    }
-                }
-            }
+        const auto hash = GetHash(key);
+        const auto isFound = GetValue(key, hash, value);
 
-            entry = entry->m_next.Load(std::memory_order_acquire);
-        }
+        RecordOperation(OperationType::Get, key, hash, isFound ? value.m_size : 0U, isFound);
 
-        return false;
+        return isFound;
     }
 
     virtual IIteratorPtr GetIterator() const override
@@ -84,6 +74,24 @@ public:
         return std::make_unique<Iterator>(m_hashTable, m_recordSerializer);
     }
 
+    virtual ScanCursor Scan(const ScanCursor& cursor, std::uint32_t maxRecords, const ScanVisitor& visitor) const override
+    {
+        return ScanRecords(cursor, maxRecords, [&visitor](const Record& record)
+        {
+            visitor(record.m_key, record.m_value);
+            return true;
+        });
+    }
+
+    virtual std::uint32_t Sample(std::uint32_t numRecords, const ScanVisitor& visitor) const override
+    {
+        return SampleRecords(numRecords, [&visitor](const Record& record)
+        {
+            visitor(record.m_key, record.m_value);
+            return true;
+        });
+    }
+
     virtual const HashTablePerfData& GetPerfData() const override
     {
         // Synchronizes with any std::memory_order_release if there exists, so that
@@ -92,10 +100,101 @@ public:
         return m_hashTable.m_perfData;
     }
 
+    // Enables the per-thread near cache (see HashTable::NearCache) in front of Get() so that
+    // the look up of a hot key skips the bucket chain while the bucket is not updated.
+    // This should be called before the hash table is accessed concurrently.
+    void EnableNearCache()
+    {
+        m_hashTable.EnableVersions();
+        m_nearCacheTableId = NearCache<RecordBuffer>::GetNewTableId();
+    }
+
+    // Records the operations on this hash table with the given recorder (nullptr to stop),
+    // which should outlive the hash table.
+    void SetOperationRecorder(OperationRecorder* recorder, std::uint16_t hashTableIndex)
+    {
+        m_hashTableIndex = hashTableIndex;
+        m_operationRecorder.store(recorder, std::memory_order_release);
+    }
+
     ReadOnlyHashTable(const ReadOnlyHashTable&) = delete;
     ReadOnlyHashTable& operator=(const ReadOnlyHashTable&) = delete;
 
 protected:
+    using Hash = std::array<std::uint64_t, 2>;
+
+    // Same as Get() but the operation is not recorded, which is used by the derived classes
+    // to look up a record as a part of another operation.
+    bool GetValue(const Key& key, Value& value) const
+    {
+        return GetValue(key, GetHash(key), value);
+    }
+
+    // Same as above, but the hash of the key is given.
+    bool GetValue(const Key& key, const Hash& hash, Value& value) const
+    {
+        if (m_nearCacheTableId != 0U)
+        {
+            return GetWithNearCache(key, hash, value);
+        }
+
+        const auto data = Find(key, GetBucketInfo(hash));
+        if (data == nullptr)
+        {
+            return false;
+        }
+
+        value = m_recordSerializer.Deserialize(*data).m_value;
+        return true;
+    }
+
+    // The hash of the key is the one used for the look up, which the recorder reuses.
+    void RecordOperation(
+        OperationType type,
+        const Key& key,
+        const Hash& hash,
+        std::uint32_t valueSize,
+        bool succeeded) const
+    {
+        if (auto* recorder = m_operationRecorder.load(std::memory_order_acquire))
+        {
+            recorder->Record(type, m_hashTableIndex, key, hash, valueSize, succeeded);
+        }
+    }
+
+    static Hash GetHash(const Key& key)
+    {
+        Hash hash;
+        MurmurHash3_x64_128(key.m_data, key.m_size, 0U, hash.data());
+
+        return hash;
+    }
+
+    // Computes GetHash() of the given keys with the multi-key kernel, which is
+    // used by the code paths that handle a batch of records (e.g., Builder, Deserializer).
+    static void GetHashes(const Key* keys, std::size_t numKeys, Hash* hashes)
+    {
+        static_assert(sizeof(Hash) == 2U * sizeof(std::uint64_t), "Hash should not have a padding.");
+
+        constexpr std::size_t c_batchSize = 64U;
+
+        std::array<const void*, c_batchSize> data;
+        std::array<int, c_batchSize> sizes;
+
+        for (std::size_t begin = 0U; begin < numKeys; begin += c_batchSize)
+        {
+            const auto batchSize = (std::min)(c_batchSize, numKeys - begin);
+
+            for (std::size_t i = 0U; i < batchSize; ++i)
+            {
+                data[i] = keys[begin + i].m_data;
+                sizes[i] = keys[begin + i].m_size;
+            }
+
+            Utils::MurmurHash3_x64_128_Batch(data.data(), sizes.data(), 0U, batchSize, hashes[begin].data());
+        }
+    }
+
     // GetBucketInfo returns a pair, where the first is the index to the bucket
     // and the second is the tag value for the given key.
     // In this hash table, we treat tag value of 0 as empty (see WritableHashTable::Remove()),
@@ -105,17 +204,220 @@ protected:
     // CPU cache, the extra overhead should be minimal.
     std::pair<std::uint32_t, std::uint8_t> GetBucketInfo(const Key& key) const
     {
-        std::array<std::uint64_t, 2> hash;
-        MurmurHash3_x64_128(key.m_data, key.m_size, 0U, hash.data());
+        return GetBucketInfo(GetHash(key));
+    }
 
+    std::pair<std::uint32_t, std::uint8_t> GetBucketInfo(const Hash& hash) const
+    {
         return {
             static_cast<std::uint32_t>(hash[0] % m_hashTable.m_buckets.size()),
             static_cast<std::uint8_t>(hash[1]) };
     }
 
+    // Returns the record with the given key in the given bucket, nullptr if not found.
+    const RecordBuffer* Find(
+        const Key& key,
+        const std::pair<std::uint32_t, std::uint8_t>& bucketInfo) const
+    {
+        std::uint8_t slotIndex;
+        return Find(key, bucketInfo, slotIndex);
+    }
+
+    // Same as above, but "slotIndex" is set to the index of the record in the bucket entry,
+    // or Entry::c_numDataPerEntry if the record is in a chained entry or not found.
+    const RecordBuffer* Find(
+        const Key& key,
+        const std::pair<std::uint32_t, std::uint8_t>& bucketInfo,
+        std::uint8_t& slotIndex) const
+    {
+        const auto* entry = &m_hashTable.m_buckets[bucketInfo.first];
+        const auto* bucket = entry;
+
+        while (entry != nullptr)
+        {
+            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+            {
+                if (bucketInfo.second == entry->m_tags[i])
+                {
+                    // There could be a race condition where m_dataList[i] is updated during access.
+                    // Therefore, load it once and save it (it's safe to store it b/c the memory
+                    // will not be deleted until ref count becomes 0).
+                    const auto data = entry->m_dataList[i].Load(std::memory_order_acquire);
+
+                    if (data != nullptr
+                        && m_recordSerializer.Deserialize(*data).m_key == key)
+                    {
+                        slotIndex = (entry == bucket) ? i : HashTable::Entry::c_numDataPerEntry;
+                        return data;
+                    }
+                }
+            }
+
+            entry = entry->m_next.Load(std::memory_order_acquire);
+        }
+
+        slotIndex = HashTable::Entry::c_numDataPerEntry;
+        return nullptr;
+    }
+
+    // Calls the given function with the records from the given cursor until it returns true
+    // for "maxRecords" records, and returns the cursor to resume from. The chains are walked
+    // lock-free as in Find(), thus the caller should hold an epoch.
+    template <typename Func>
+    ScanCursor ScanRecords(const ScanCursor& cursor, std::uint32_t maxRecords, Func func) const
+    {
+        const auto numBuckets = static_cast<std::uint32_t>(m_hashTable.m_buckets.size());
+        if (cursor.m_numBuckets != 0U && cursor.m_numBuckets != numBuckets)
+        {
+            throw RuntimeException("The scan cursor belongs to a hash table with a different number of buckets.");
+        }
+
+        ScanCursor next = cursor;
+        next.m_numBuckets = numBuckets;
+
+        std::uint32_t numRecords = 0U;
+
+        for (; next.m_bucketIndex < numBuckets; ++next.m_bucketIndex, next.m_slotIndex = 0U)
+        {
+            const auto* entry = &m_hashTable.m_buckets[next.m_bucketIndex];
+            std::uint32_t slotIndex = 0U;
+
+            // Entries are never removed from a chain, thus the slot to resume from doesn't move.
+            while (entry != nullptr && slotIndex + HashTable::Entry::c_numDataPerEntry <= next.m_slotIndex)
+            {
+                entry = entry->m_next.Load(std::memory_order_acquire);
+                slotIndex += HashTable::Entry::c_numDataPerEntry;
+            }
+
+            for (; entry != nullptr; entry = entry->m_next.Load(std::memory_order_acquire))
+            {
+                for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i, ++slotIndex)
+                {
+                    if (slotIndex < next.m_slotIndex)
+                    {
+                        continue;
+                    }
+
+                    if (numRecords == maxRecords)
+                    {
+                        next.m_slotIndex = slotIndex;
+                        return next;
+                    }
+
+                    const auto data = entry->m_dataList[i].Load(std::memory_order_acquire);
+
+                    if (data != nullptr && func(m_recordSerializer.Deserialize(*data)))
+                    {
+                        ++numRecords;
+                    }
+                }
+            }
+        }
+
+        return next;
+    }
+
+    // Calls the given function with random records until it returns true for "numRecords"
+    // records, and returns the number of such records. A probe picks a random bucket and a random
+    // slot among the slots of the longest chain; since every slot is picked with the same
+    // probability, rejecting the empty slots corrects the bias towards the records in short chains.
+    // The chains are walked lock-free, thus the caller should hold an epoch.
+    template <typename Func>
+    std::uint32_t SampleRecords(std::uint32_t numRecords, Func func) const
+    {
+        static thread_local std::mt19937_64 s_random{ std::random_device{}() };
+
+        const auto numBuckets = m_hashTable.m_buckets.size();
+
+        // The max chain length is never decreased, thus it bounds the current chains.
+        const auto numSlotsPerBucket = static_cast<std::uint64_t>(
+            (std::max)(m_hashTable.m_perfData.Get(HashTablePerfCounter::MaxBucketChainLength), HashTablePerfData::TValue{ 1 }))
+            * HashTable::Entry::c_numDataPerEntry;
+
+        std::uniform_int_distribution<std::uint64_t> distribution{ 0U, numBuckets * numSlotsPerBucket - 1U };
+
+        std::uint32_t numSampled = 0U;
+
+        for (std::uint64_t numProbes = 0U;
+            numSampled < numRecords && numProbes < static_cast<std::uint64_t>(numRecords) * c_maxProbesPerSample;
+            ++numProbes)
+        {
+            const auto probe = distribution(s_random);
+            const auto slotIndex = probe % numSlotsPerBucket;
+
+            const auto* entry = &m_hashTable.m_buckets[static_cast<std::size_t>(probe / numSlotsPerBucket)];
+            for (auto i = slotIndex / HashTable::Entry::c_numDataPerEntry; entry != nullptr && i > 0U; --i)
+            {
+                entry = entry->m_next.Load(std::memory_order_acquire);
+            }
+
+            if (entry == nullptr)
+            {
+                continue;
+            }
+
+            const auto data = entry->m_dataList[slotIndex % HashTable::Entry::c_numDataPerEntry].Load(std::memory_order_acquire);
+
+            if (data != nullptr && func(m_recordSerializer.Deserialize(*data)))
+            {
+                ++numSampled;
+            }
+        }
+
+        return numSampled;
+    }
+
+    // The number of probes per record to sample before giving up.
+    static constexpr std::uint32_t c_maxProbesPerSample = 1024U;
+
     HashTable& m_hashTable;
 
     RecordSerializer m_recordSerializer;
+
+private:
+    bool GetWithNearCache(const Key& key, const Hash& hash, Value& value) const
+    {
+        const auto bucketInfo = GetBucketInfo(hash);
+
+        // The version is loaded before the bucket is looked up, so that a record cached with
+        // this version is never older than the version (writers bump it after the update).
+        const auto version = m_hashTable.GetVersion(bucketInfo.first).load(std::memory_order_acquire);
+
+        auto& cached = NearCache<RecordBuffer>::GetEntry(m_nearCacheTableId, hash[0]);
+
+        if (cached.m_tableId == m_nearCacheTableId
+            && cached.m_hash == hash[0]
+            && cached.m_version == version)
+        {
+            const auto record = m_recordSerializer.Deserialize(*cached.m_data);
+            if (record.m_key == key)
+            {
+                value = record.m_value;
+                return true;
+            }
+        }
+
+        const auto data = Find(key, bucketInfo);
+        if (data == nullptr)
+        {
+            // Misses are not cached since there is no record to verify the key against.
+            return false;
+        }
+
+        cached.m_tableId = m_nearCacheTableId;
+        cached.m_hash = hash[0];
+        cached.m_version = version;
+        cached.m_data = data;
+
+        value = m_recordSerializer.Deserialize(*data).m_value;
+        return true;
+    }
+
+    // Zero if the near cache is not enabled.
+    std::uint64_t m_nearCacheTableId = 0U;
+
+    std::atomic<OperationRecorder*> m_operationRecorder{ nullptr };
+    std::uint16_t m_hashTableIndex = 0U;
 };
 
 
@@ -272,18 +574,51 @@ public:
         , m_epochManager{ epochManager }
     {}
 
+    ~WritableHashTable()
+    {
+        if (m_memoryBudget)
+        {
+            m_memoryBudget->Unregister(this->m_hashTable.m_perfData);
+        }
+    }
+
     virtual void Add(const Key& key, const Value& value) override
     {
-        Add(CreateRecordBuffer(key, value));
+        Add(key, value, this->GetHash(key));
+    }
+
+    virtual bool AddIfAbsent(const Key& key, const Value& value) override
+    {
+        return AddIf(key, value, [](const Value* existingValue)
+        {
+            return existingValue == nullptr;
+        });
+    }
+
+    virtual bool ReplaceIfPresent(const Key& key, const Value& value) override
+    {
+        return AddIf(key, value, [](const Value* existingValue)
+        {
+            return existingValue != nullptr;
+        });
+    }
+
+    virtual bool ReplaceIfEqual(const Key& key, const Value& expectedValue, const Value& value) override
+    {
+        return AddIf(key, value, [&expectedValue](const Value* existingValue)
+        {
+            return existingValue != nullptr && *existingValue == expectedValue;
+        });
     }
 
     virtual bool Remove(const Key& key) override
     {
-        const auto bucketInfo = this->GetBucketInfo(key);
+        const auto hash = this->GetHash(key);
+        const auto bucketInfo = this->GetBucketInfo(hash);
 
         auto* entry = &(this->m_hashTable.m_buckets[bucketInfo.first]);
 
-        typename HashTable::Lock lock{ this->m_hashTable.GetMutex(bucketInfo.first) };
+        typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(bucketInfo.first) };
 
         // Note that similar to Add(), the following block is performed inside a critical section,
         // therefore, it is safe to do "Load"s with memory_order_relaxed.
@@ -300,7 +635,10 @@ public:
                         const auto record = this->m_recordSerializer.Deserialize(*data);
                         if (record.m_key == key)
                         {
-                            Remove(*entry, i);
+                            Remove(bucketInfo.first, *entry, i);
+                            lock.unlock();
+
+                            this->RecordOperation(OperationType::Remove, key, hash, 0U, true);
                             return true;
                         }
                     }
@@ -310,83 +648,303 @@ public:
             entry = entry->m_next.Load(std::memory_order_relaxed);
         }
 
+        lock.unlock();
+
+        this->RecordOperation(OperationType::Remove, key, hash, 0U, false);
         return false;
     }
 
+    // Caps the memory of this hash table by the given budget, which may be shared with
+    // other hash tables. This should be called before the hash table is accessed concurrently.
+    void SetMemoryBudget(std::shared_ptr<MemoryBudget> memoryBudget)
+    {
+        memoryBudget->Register(this->m_hashTable.m_perfData);
+        m_memoryBudget = std::move(memoryBudget);
+    }
+
     virtual ISerializerPtr GetSerializer() const override
     {
         return std::make_unique<WritableHashTable::Serializer>(this->m_hashTable);
     }
 
-protected:
-    void Add(RecordBuffer* recordToAdd)
+    // The source buckets are partitioned across the threads, and each source bucket is
+    // exclusively locked while its records are merged. Since records are copied (or moved)
+    // as serialized buffers, the source should have the same record layout.
+    // The records of a source bucket are admitted by the memory budget of this hash table,
+    // if any, before the bucket is locked for the merge.
+    // Note that merging two hash tables into each other concurrently can deadlock.
+    virtual void MergeFrom(IWritableHashTable& source, const MergePolicy& policy) override
     {
-        assert(recordToAdd != nullptr);
+        auto* sourceHashTable = dynamic_cast<WritableHashTable*>(&source);
 
-        const auto newRecord = this->m_recordSerializer.Deserialize(*recordToAdd);
-        const auto& newKey = newRecord.m_key;
-        const auto& newValue = newRecord.m_value;
+        if (sourceHashTable == nullptr
+            || !this->m_recordSerializer.IsCompatible(sourceHashTable->m_recordSerializer))
+        {
+            throw RuntimeException("Merging from a hash table with a different record layout is not supported.");
+        }
 
-        Stat stat{ newKey.m_size, newValue.m_size };
+        if (sourceHashTable == this)
+        {
+            throw RuntimeException("Merging a hash table into itself is not allowed.");
+        }
 
-        const auto bucketInfo = this->GetBucketInfo(newKey);
+        if (policy.m_conflict == MergePolicy::Conflict::Merge && !policy.m_mergeCallback)
+        {
+            throw RuntimeException("Merge callback is not set.");
+        }
 
-        auto* curEntry = &(this->m_hashTable.m_buckets[bucketInfo.first]);
+        // Records in a memory image or a reservation cannot be released individually, and
+        // the records moved are released in the epoch domain of this hash table, where the readers
+        // of the source are not tracked. Thus, the records are copied in those cases.
+        const bool moveRecords = policy.m_moveRecords
+            && (&m_epochManager == &sourceHashTable->m_epochManager)
+            && (this->m_hashTable.m_allocator == sourceHashTable->m_hashTable.m_allocator)
+            && (sourceHashTable->m_hashTable.m_image.m_buffer == nullptr)
+            && (sourceHashTable->m_hashTable.m_reservation.m_buffer == nullptr);
+
+        RunInParallel(
+            policy.m_numThreads,
+            static_cast<std::uint32_t>(sourceHashTable->m_hashTable.m_buckets.size()),
+            [this, sourceHashTable, &policy, moveRecords](std::uint32_t beginBucket, std::uint32_t endBucket)
+        {
+            std::vector<std::uint8_t> mergedValue;
 
-        typename HashTable::Entry* entryToUpdate = nullptr;
-        std::uint8_t curDataIndex = 0U;
+            for (auto bucketIndex = beginBucket; bucketIndex < endBucket; ++bucketIndex)
+            {
+                sourceHashTable->MergeBucketInto(*this, bucketIndex, policy, moveRecords, mergedValue);
+            }
+        });
+    }
 
-        typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(bucketInfo.first) };
+    virtual std::uint64_t RemoveIf(const RemovePolicy& policy) override
+    {
+        return RemoveRecordsIf(policy, [&policy](const Record& record)
+        {
+            return policy.m_predicate(record.m_key, record.m_value);
+        });
+    }
 
-        // Note that the following block is performed inside a critical section, therefore,
-        // it is safe to do "Load"s with memory_order_relaxed.
-        while (curEntry != nullptr)
+    // The records in a batch are copied before any of the old records is released, so that
+    // the allocator doesn't hand out the memory of the old records for the copies.
+    // Note that the records loaded from a memory image or carved out of the reservation are
+    // already packed and not relocated.
+    virtual RelocationResult Relocate(const RelocationPolicy& policy) override
+    {
+        const auto numBuckets = static_cast<std::uint32_t>(this->m_hashTable.m_buckets.size());
+        const auto numBucketsPerBatch = (std::max)(policy.m_numBucketsPerBatch, 1U);
+
+        std::atomic<std::uint64_t> numBucketsRelocated{ 0U };
+        std::atomic<std::uint64_t> numRecordsRelocated{ 0U };
+        std::atomic<std::uint64_t> numPagesVisited{ 0U };
+        std::atomic<std::uint64_t> numPagesPacked{ 0U };
+
+        RunInParallel(
+            policy.m_numThreads,
+            numBuckets,
+            [&](std::uint32_t beginBucket, std::uint32_t endBucket)
         {
-            ++stat.m_chainIndex;
+            std::vector<RecordBuffer*> recordsToRelease;
 
-            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+            for (auto batchBegin = beginBucket; batchBegin < endBucket; )
             {
-                const auto data = curEntry->m_dataList[i].Load(std::memory_order_relaxed);
+                const auto batchEnd = batchBegin + (std::min)(numBucketsPerBatch, endBucket - batchBegin);
 
-                if (data == nullptr)
+                const auto fragmentation = EstimateFragmentation(batchBegin, batchEnd);
+                numPagesVisited += fragmentation.first;
+                numPagesPacked += fragmentation.second;
+
+                if (fragmentation.first >= policy.m_minFragmentation * fragmentation.second)
                 {
-                    if (entryToUpdate == nullptr)
+                    for (auto bucketIndex = batchBegin; bucketIndex < batchEnd; ++bucketIndex)
                     {
-                        // Found an entry with no data set, but still need to go through the end of
-                        // the list to see if an entry with the given key exists.
-                        entryToUpdate = curEntry;
-                        curDataIndex = i;
+                        RelocateBucket(bucketIndex, recordsToRelease);
                     }
-                }
-                else if (curEntry->m_tags[i] == bucketInfo.second)
-                {
-                    const auto oldRecord = this->m_recordSerializer.Deserialize(*data);
-                    if (newKey == oldRecord.m_key)
+
+                    numBucketsRelocated += (batchEnd - batchBegin);
+                    numRecordsRelocated += recordsToRelease.size();
+
+                    for (auto* record : recordsToRelease)
                     {
-                        // Will overwrite this entry data.
-                        entryToUpdate = curEntry;
-                        curDataIndex = i;
-                        stat.m_oldValueSize = oldRecord.m_value.m_size;
-                        break;
+                        ReleaseRecord(record);
                     }
+
+                    recordsToRelease.clear();
                 }
-            }
 
-            // Found the entry data to replaces.
-            if (stat.m_oldValueSize != 0U)
-            {
-                break;
-            }
+                batchBegin = batchEnd;
 
-            // Check if this is the end of the chaining. If so, create a new entry if we haven't found
+                if (batchBegin < endBucket && policy.m_pauseBetweenBatches.count() > 0)
+                {
+                    std::this_thread::sleep_for(policy.m_pauseBetweenBatches);
+                }
+            }
+        });
+
+        RelocationResult result;
+        result.m_numBucketsRelocated = numBucketsRelocated;
+        result.m_numRecordsRelocated = numRecordsRelocated;
+        result.m_fragmentation = (numPagesPacked != 0U)
+            ? static_cast<double>(numPagesVisited) / numPagesPacked
+            : 1.0;
+
+        return result;
+    }
+
+    // The chained entries are estimated from the number of records per bucket, and the record
+    // sizes from the given bytes and the layout of the records. The region is pre-faulted by
+    // touching a byte per page in parallel.
+    virtual void Reserve(std::uint64_t numRecords, std::uint64_t numBytes) override
+    {
+        const auto& setting = this->m_hashTable.m_setting;
+        constexpr std::uint64_t c_recordPadding = HashTable::c_recordAlignment - 1U;
+
+        // The sizes and the metadata of a record in addition to the key and the value.
+        const std::uint64_t recordOverhead = this->m_recordSerializer.CalculateBufferSize(Key{}, Value{})
+            - setting.m_fixedKeySize
+            - setting.m_fixedValueSize;
+
+        const auto entriesSize =
+            EstimateNumChainedEntries(numRecords, this->m_hashTable.m_buckets.size()) * sizeof(typename HashTable::Entry);
+        const auto recordsSize = numBytes + (numRecords * (recordOverhead + c_recordPadding));
+
+        if (entriesSize + recordsSize > (std::numeric_limits<std::size_t>::max)())
+        {
+            throw RuntimeException("The capacity to reserve is too large.");
+        }
+
+        const auto& reservation = this->m_hashTable.Reserve(
+            static_cast<std::size_t>(entriesSize),
+            static_cast<std::size_t>(recordsSize));
+
+        // The pages are touched in chunks, so that the number of chunks fits in 32 bits.
+        constexpr std::size_t c_numPagesPerChunk = 256U;
+        const auto chunkSize = c_numPagesPerChunk * c_pageSize;
+
+        RunInParallel(
+            0U,
+            static_cast<std::uint32_t>((reservation.m_size + chunkSize - 1U) / chunkSize),
+            [&reservation, chunkSize](std::uint32_t beginChunk, std::uint32_t endChunk)
+        {
+            const auto end = (std::min)(endChunk * chunkSize, reservation.m_size);
+
+            for (auto offset = beginChunk * chunkSize; offset < end; offset += c_pageSize)
+            {
+                reservation.m_buffer[offset] = 0U;
+            }
+        });
+    }
+
+protected:
+    using typename Base::Hash;
+
+    struct Stat;
+
+    // Same as Add(key, value) but the hash of the key is given, e.g., by GetHashes().
+    void Add(const Key& key, const Value& value, const Hash& hash)
+    {
+        Admit(key.m_size + value.m_size);
+
+        Add(CreateRecordBuffer(key, value), hash);
+
+        this->RecordOperation(OperationType::Add, key, hash, value.m_size, true);
+    }
+
+    void Add(RecordBuffer* recordToAdd)
+    {
+        assert(recordToAdd != nullptr);
+
+        Add(recordToAdd, this->GetHash(this->m_recordSerializer.Deserialize(*recordToAdd).m_key));
+    }
+
+    void Add(RecordBuffer* recordToAdd, const Hash& hash)
+    {
+        assert(recordToAdd != nullptr);
+
+        const auto newRecord = this->m_recordSerializer.Deserialize(*recordToAdd);
+        const auto& newKey = newRecord.m_key;
+        const auto& newValue = newRecord.m_value;
+
+        Stat stat{ newKey.m_size, newValue.m_size };
+
+        const auto bucketInfo = this->GetBucketInfo(hash);
+
+        typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(bucketInfo.first) };
+
+        const auto slot = FindSlot(newKey, bucketInfo, stat);
+
+        auto recordToDelete = UpdateRecord(bucketInfo.first, *slot.m_entry, slot.m_index, recordToAdd, bucketInfo.second);
+
+        lock.unlock();
+
+        UpdatePerfDataForAdd(stat);
+
+        ReleaseRecord(recordToDelete);
+    }
+
+    // Slot represents a location in the chained bucket list.
+    struct Slot
+    {
+        typename HashTable::Entry* m_entry;
+        std::uint8_t m_index;
+
+        // The record with the given key if it exists, nullptr otherwise.
+        RecordBuffer* m_record;
+    };
+
+    // Returns the slot that holds the record with the given key if it exists. Otherwise,
+    // returns the first empty slot in the chain, where a new entry is chained at the end
+    // if there is no empty slot (or the slot with a null entry if "chainNewEntry" is false).
+    // The given stat is updated accordingly.
+    // It is assumed that this function is called under a lock.
+    Slot FindSlot(
+        const Key& key,
+        const std::pair<std::uint32_t, std::uint8_t>& bucketInfo,
+        Stat& stat,
+        bool chainNewEntry = true)
+    {
+        auto* curEntry = &(this->m_hashTable.m_buckets[bucketInfo.first]);
+
+        Slot slot{ nullptr, 0U, nullptr };
+
+        // Note that the following block is performed inside a critical section, therefore,
+        // it is safe to do "Load"s with memory_order_relaxed.
+        while (curEntry != nullptr)
+        {
+            ++stat.m_chainIndex;
+
+            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+            {
+                const auto data = curEntry->m_dataList[i].Load(std::memory_order_relaxed);
+
+                if (data == nullptr)
+                {
+                    if (slot.m_entry == nullptr)
+                    {
+                        // Found an entry with no data set, but still need to go through the end of
+                        // the list to see if an entry with the given key exists.
+                        slot.m_entry = curEntry;
+                        slot.m_index = i;
+                    }
+                }
+                else if (curEntry->m_tags[i] == bucketInfo.second)
+                {
+                    const auto oldRecord = this->m_recordSerializer.Deserialize(*data);
+                    if (key == oldRecord.m_key)
+                    {
+                        // Will overwrite this entry data.
+                        stat.m_oldValueSize = oldRecord.m_value.m_size;
+                        return Slot{ curEntry, i, data };
+                    }
+                }
+            }
+
+            // Check if this is the end of the chaining. If so, create a new entry if we haven't found
             // any entry to update along the way.
-            if (entryToUpdate == nullptr && curEntry->m_next.Load(std::memory_order_relaxed) == nullptr)
+            if (chainNewEntry
+                && slot.m_entry == nullptr
+                && curEntry->m_next.Load(std::memory_order_relaxed) == nullptr)
             {
-                curEntry->m_next.Store(
-                    new (Detail::to_raw_pointer(
-                        this->m_hashTable.template GetAllocator<typename HashTable::Entry>().allocate(1U)))
-                    typename HashTable::Entry(),
-                    std::memory_order_release);
+                curEntry->m_next.Store(this->m_hashTable.AllocateEntry(), std::memory_order_release);
 
                 stat.m_isNewEntryAdded = true;
             }
@@ -394,22 +952,212 @@ protected:
             curEntry = curEntry->m_next.Load(std::memory_order_relaxed);
         }
 
-        assert(entryToUpdate != nullptr);
+        assert(!chainNewEntry || slot.m_entry != nullptr);
 
-        auto recordToDelete = UpdateRecord(*entryToUpdate, curDataIndex, recordToAdd, bucketInfo.second);
+        return slot;
+    }
+
+    // Adds or replaces the record with the given key only if the given predicate returns true
+    // for the existing value (nullptr if the key doesn't exist). The predicate is checked
+    // lock-free first, so that the caller's epoch should be held, and then under the bucket
+    // lock. The record is created by the given factory only when it is written, thus a write
+    // that is not needed allocates no memory and takes no lock in the common case.
+    // Note that the value passed to the predicate is the stored value, i.e., it includes any
+    // prefix that the derived class adds (e.g., Cache::Metadata).
+    template <typename Predicate, typename RecordFactory>
+    bool AddRecordIf(const Key& key, Predicate predicate, RecordFactory createRecord)
+    {
+        return AddRecordIf(key, this->GetHash(key), predicate, createRecord);
+    }
+
+    // Same as above, but the hash of the key is given.
+    template <typename Predicate, typename RecordFactory>
+    bool AddRecordIf(const Key& key, const Hash& hash, Predicate predicate, RecordFactory createRecord)
+    {
+        if (!CallPredicate(this->Find(key, this->GetBucketInfo(hash)), predicate))
+        {
+            return false;
+        }
+
+        return AddRecordIfLocked(key, hash, predicate, createRecord);
+    }
+
+    // Same as AddRecordIf(), but the predicate is checked only under the bucket lock,
+    // thus it can be called without an epoch.
+    template <typename Predicate, typename RecordFactory>
+    bool AddRecordIfLocked(const Key& key, const Hash& hash, Predicate predicate, RecordFactory createRecord)
+    {
+        const auto bucketInfo = this->GetBucketInfo(hash);
+
+        typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(bucketInfo.first) };
+
+        Stat stat;
+        auto slot = FindSlot(key, bucketInfo, stat, false);
+
+        if (!CallPredicate(slot.m_record, predicate))
+        {
+            return false;
+        }
+
+        if (slot.m_entry == nullptr)
+        {
+            // The key doesn't exist and the chain is full, thus chain a new entry.
+            stat = Stat{};
+            slot = FindSlot(key, bucketInfo, stat);
+        }
+
+        auto recordToAdd = createRecord();
+
+        stat.m_keySize = key.m_size;
+        stat.m_valueSize = this->m_recordSerializer.Deserialize(*recordToAdd).m_value.m_size;
+
+        auto recordToDelete = UpdateRecord(bucketInfo.first, *slot.m_entry, slot.m_index, recordToAdd, bucketInfo.second);
 
         lock.unlock();
 
         UpdatePerfDataForAdd(stat);
 
         ReleaseRecord(recordToDelete);
+
+        return true;
+    }
+
+    RecordBuffer* CreateRecordBuffer(const Key& key, const Value& value)
+    {
+        const auto bufferSize = this->m_recordSerializer.CalculateBufferSize(key, value);
+        auto buffer = this->m_hashTable.AllocateRecordBuffer(bufferSize);
+            
+        return this->m_recordSerializer.Serialize(key, value, buffer, bufferSize);
+    }
+
+    // Sweeps the buckets in parallel as described by the given policy and removes the records
+    // for which the given function returns true. Each bucket is locked while it is swept, so
+    // that the records are checked in place and removed by slot without re-hashing the keys.
+    template <typename ShouldRemove>
+    std::uint64_t RemoveRecordsIf(const RemovePolicy& policy, ShouldRemove shouldRemove)
+    {
+        if (!policy.m_predicate)
+        {
+            throw RuntimeException("Remove predicate is not set.");
+        }
+
+        const auto numBuckets = static_cast<std::uint32_t>(this->m_hashTable.m_buckets.size());
+        const auto numBucketsPerBatch = (std::max)(policy.m_numBucketsPerBatch, 1U);
+
+        std::atomic<std::uint64_t> numBucketsSwept{ 0U };
+        std::atomic<std::uint64_t> numRecordsRemoved{ 0U };
+        std::mutex progressMutex;
+
+        RunInParallel(
+            policy.m_numThreads,
+            numBuckets,
+            [&](std::uint32_t beginBucket, std::uint32_t endBucket)
+        {
+            for (auto batchBegin = beginBucket; batchBegin < endBucket; )
+            {
+                const auto batchEnd = batchBegin + (std::min)(numBucketsPerBatch, endBucket - batchBegin);
+
+                std::uint64_t numRemovedInBatch = 0U;
+
+                for (auto bucketIndex = batchBegin; bucketIndex < batchEnd; ++bucketIndex)
+                {
+                    typename HashTable::Lock lock{ this->m_hashTable.GetMutex(bucketIndex) };
+
+                    for (auto* entry = &this->m_hashTable.m_buckets[bucketIndex];
+                        entry != nullptr;
+                        entry = entry->m_next.Load(std::memory_order_relaxed))
+                    {
+                        for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+                        {
+                            const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+
+                            if (data != nullptr
+                                && shouldRemove(this->m_recordSerializer.Deserialize(*data)))
+                            {
+                                Remove(bucketIndex, *entry, i);
+                                ++numRemovedInBatch;
+                            }
+                        }
+                    }
+                }
+
+                const auto progress = RemovePolicy::Progress{
+                    numBucketsSwept += (batchEnd - batchBegin),
+                    numBuckets,
+                    numRecordsRemoved += numRemovedInBatch };
+
+                if (policy.m_progressCallback)
+                {
+                    std::lock_guard<std::mutex> lock{ progressMutex };
+                    policy.m_progressCallback(progress);
+                }
+
+                batchBegin = batchEnd;
+
+                if (batchBegin < endBucket && policy.m_pauseBetweenBatches.count() > 0)
+                {
+                    std::this_thread::sleep_for(policy.m_pauseBetweenBatches);
+                }
+            }
+        });
+
+        return numRecordsRemoved;
+    }
+
+    // Same as AddRecordIf(), where the record is created from the given key and value.
+    template <typename Predicate>
+    bool AddIf(const Key& key, const Value& value, Predicate predicate)
+    {
+        const auto hash = this->GetHash(key);
+
+        // Admitted only if the write is needed so that a write that is not needed never throws or blocks.
+        if (m_memoryBudget
+            && CallPredicate(this->Find(key, this->GetBucketInfo(hash)), predicate))
+        {
+            Admit(key.m_size + value.m_size);
+        }
+
+        const auto isAdded = AddRecordIf(key, hash, predicate, [this, &key, &value]()
+        {
+            return CreateRecordBuffer(key, value);
+        });
+
+        this->RecordOperation(OperationType::ConditionalAdd, key, hash, value.m_size, isAdded);
+
+        return isAdded;
+    }
+
+    // Replaces the value of the record with the given key only if the record exists and
+    // the given predicate returns true for its current value.
+    template <typename Predicate>
+    bool ReplaceIf(const Key& key, const Value& value, Predicate predicate)
+    {
+        return AddIf(key, value, [&predicate](const Value* existingValue)
+        {
+            return existingValue != nullptr && predicate(*existingValue);
+        });
+    }
+
+    // Throws if the record of the given size is not admitted by the memory budget, if any.
+    // It should not be called under a bucket lock since the budget may block.
+    void Admit(std::uint64_t recordSize) const
+    {
+        if (m_memoryBudget)
+        {
+            m_memoryBudget->Admit(recordSize);
+        }
+    }
+
+    bool HasMemoryBudget() const
+    {
+        return static_cast<bool>(m_memoryBudget);
     }
 
-    // The chainIndex is the 1-based index for the given entry in the chained bucket list.
+    // Removes the record at the given index of the entry chained in the given bucket.
     // It is assumed that this function is called under a lock.
-    void Remove(typename HashTable::Entry& entry, std::uint8_t index)
+    void Remove(std::uint32_t bucketIndex, typename HashTable::Entry& entry, std::uint8_t index)
     {
-        auto recordToDelete = UpdateRecord(entry, index, nullptr, 0U);
+        auto recordToDelete = UpdateRecord(bucketIndex, entry, index, nullptr, 0U);
 
         assert(recordToDelete != nullptr);
 
@@ -425,21 +1173,348 @@ protected:
         ReleaseRecord(recordToDelete);
     }
 
-private:
-    struct Stat;
+    // Called under the bucket lock whenever a record is added, replaced (both records are
+    // set) or removed (newRecord is nullptr) at the given slot. Derived classes that maintain
+    // additional structures over the same records (e.g., OrderedWritableHashTable) override
+    // this so that the structures observe updates in the same order as the hash table.
+    virtual void OnRecordUpdated(
+        std::uint32_t /* bucketIndex */,
+        const typename HashTable::Entry& /* entry */,
+        std::uint8_t /* index */,
+        const RecordBuffer* /* oldRecord */,
+        RecordBuffer* /* newRecord */)
+    {}
 
+private:
     class Serializer;
 
-    RecordBuffer* CreateRecordBuffer(const Key& key, const Value& value)
+    // Returns the expected number of chained entries for the given number of records, where the
+    // number of records in a bucket follows the Poisson distribution, and a bucket with n records
+    // chains ceil(n / c_numDataPerEntry) - 1 entries.
+    static std::uint64_t EstimateNumChainedEntries(std::uint64_t numRecords, std::uint64_t numBuckets)
     {
-        const auto bufferSize = this->m_recordSerializer.CalculateBufferSize(key, value);
-        auto buffer = Detail::to_raw_pointer(
-            this->m_hashTable.template GetAllocator<std::uint8_t>().allocate(bufferSize));
-            
-        return this->m_recordSerializer.Serialize(key, value, buffer, bufferSize);
+        constexpr std::uint64_t c_numDataPerEntry = HashTable::Entry::c_numDataPerEntry;
+
+        const auto mean = static_cast<double>(numRecords) / (std::max)(numBuckets, std::uint64_t{ 1U });
+
+        if (mean > 256.0)
+        {
+            // Almost every bucket is chained, where half of the last entry is empty on average.
+            return (numRecords + c_numDataPerEntry - 1U) / c_numDataPerEntry;
+        }
+
+        const auto maxRecordsPerBucket = static_cast<std::uint64_t>(mean + (10.0 * std::sqrt(mean))) + c_numDataPerEntry;
+
+        double numEntriesPerBucket = 0.0;
+
+        for (auto n = c_numDataPerEntry + 1U; n <= maxRecordsPerBucket; ++n)
+        {
+            const auto probability = std::exp((n * std::log(mean)) - mean - std::lgamma(n + 1.0));
+            numEntriesPerBucket += probability * static_cast<double>(((n + c_numDataPerEntry - 1U) / c_numDataPerEntry) - 1U);
+        }
+
+        return static_cast<std::uint64_t>(std::ceil(numEntriesPerBucket * numBuckets));
+    }
+
+    // Partitions [0, numBuckets) across the threads and calls the given function with each
+    // partition. The first exception thrown by the function is rethrown after all threads join.
+    // A hash table with the single-threaded policy is not locked, thus it runs on one thread.
+    template <typename Func>
+    static void RunInParallel(std::uint16_t numThreadsRequested, std::uint32_t numBuckets, Func func)
+    {
+        const std::uint32_t numThreads = HashTable::Policy::c_isSynchronized
+            ? (std::min)(
+                (std::max)(
+                    (numThreadsRequested != 0U)
+                        ? static_cast<std::uint32_t>(numThreadsRequested)
+                        : std::thread::hardware_concurrency(),
+                    1U),
+                (std::max)(numBuckets, 1U))
+            : 1U;
+
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> exceptions(numThreads);
+
+        for (std::uint32_t i = 0U; i < numThreads; ++i)
+        {
+            threads.emplace_back(
+                [&func, &exceptions, i, numThreads, numBuckets]()
+            {
+                try
+                {
+                    const auto beginBucket = static_cast<std::uint32_t>((static_cast<std::uint64_t>(numBuckets) * i) / numThreads);
+                    const auto endBucket = static_cast<std::uint32_t>((static_cast<std::uint64_t>(numBuckets) * (i + 1)) / numThreads);
+
+                    func(beginBucket, endBucket);
+                }
+                catch (...)
+                {
+                    exceptions[i] = std::current_exception();
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (const auto& exception : exceptions)
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+    }
+
+    template <typename Predicate>
+    bool CallPredicate(const RecordBuffer* record, Predicate& predicate) const
+    {
+        if (record == nullptr)
+        {
+            return predicate(static_cast<const Value*>(nullptr));
+        }
+
+        const auto value = this->m_recordSerializer.Deserialize(*record).m_value;
+        return predicate(&value);
+    }
+
+    static constexpr std::uintptr_t c_pageSize = 4096U;
+
+    // Returns the number of pages visited while reading the records in the given buckets
+    // in order, and the number of pages that the records would occupy if packed.
+    std::pair<std::uint64_t, std::uint64_t> EstimateFragmentation(std::uint32_t beginBucket, std::uint32_t endBucket)
+    {
+        std::uint64_t numPagesVisited = 0U;
+        std::uint64_t totalSize = 0U;
+        auto lastPage = (std::numeric_limits<std::uintptr_t>::max)();
+
+        for (auto bucketIndex = beginBucket; bucketIndex < endBucket; ++bucketIndex)
+        {
+            typename HashTable::Lock lock{ this->m_hashTable.GetMutex(bucketIndex) };
+
+            for (auto* entry = &this->m_hashTable.m_buckets[bucketIndex];
+                entry != nullptr;
+                entry = entry->m_next.Load(std::memory_order_relaxed))
+            {
+                for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+                {
+                    const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+                    if (data == nullptr)
+                    {
+                        continue;
+                    }
+
+                    const auto record = this->m_recordSerializer.Deserialize(*data);
+                    const auto size = this->m_recordSerializer.CalculateBufferSize(record.m_key, record.m_value);
+
+                    const auto address = reinterpret_cast<std::uintptr_t>(data);
+                    const auto firstPage = address / c_pageSize;
+                    const auto endPage = (address + size - 1U) / c_pageSize;
+
+                    numPagesVisited += endPage - firstPage + ((firstPage == lastPage) ? 0U : 1U);
+                    totalSize += size;
+                    lastPage = endPage;
+                }
+            }
+        }
+
+        return { numPagesVisited, (totalSize + c_pageSize - 1U) / c_pageSize };
+    }
+
+    // Replaces the records in the given bucket with their copies, and appends the old records
+    // to the given vector to be released by the caller.
+    void RelocateBucket(std::uint32_t bucketIndex, std::vector<RecordBuffer*>& recordsToRelease)
+    {
+        typename HashTable::Lock lock{ this->m_hashTable.GetMutex(bucketIndex) };
+
+        for (auto* entry = &this->m_hashTable.m_buckets[bucketIndex];
+            entry != nullptr;
+            entry = entry->m_next.Load(std::memory_order_relaxed))
+        {
+            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+            {
+                const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+
+                if (data != nullptr && !this->m_hashTable.IsInRegion(data))
+                {
+                    const auto copy = CopyRecordBuffer(this->m_recordSerializer.Deserialize(*data));
+                    recordsToRelease.push_back(UpdateRecord(bucketIndex, *entry, i, copy, entry->m_tags[i]));
+                }
+            }
+        }
+    }
+
+    // Merges the records in the given bucket of this hash table into the target hash table.
+    // Records moved to the target are removed from this hash table without being released.
+    void MergeBucketInto(
+        WritableHashTable& target,
+        std::uint32_t bucketIndex,
+        const MergePolicy& policy,
+        bool moveRecords,
+        std::vector<std::uint8_t>& mergedValue)
+    {
+        typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(bucketIndex) };
+
+        // The records are admitted by the memory budget of the target without holding the lock
+        // since the budget may block or call back. The bucket is re-checked after the lock
+        // is taken again, and any records added in the meantime are admitted in turn.
+        if (target.m_memoryBudget)
+        {
+            std::uint64_t admittedSize = 0U;
+
+            for (auto sizeToMerge = GetSizeToMerge(target, bucketIndex, policy);
+                sizeToMerge > admittedSize;
+                sizeToMerge = GetSizeToMerge(target, bucketIndex, policy))
+            {
+                lock.unlock();
+
+                target.Admit(sizeToMerge - admittedSize);
+                admittedSize = sizeToMerge;
+
+                lock.lock();
+            }
+        }
+
+        for (auto* entry = &this->m_hashTable.m_buckets[bucketIndex];
+            entry != nullptr;
+            entry = entry->m_next.Load(std::memory_order_relaxed))
+        {
+            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+            {
+                const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+
+                if (data != nullptr
+                    && target.MergeRecord(*data, policy, moveRecords, mergedValue))
+                {
+                    const auto record = this->m_recordSerializer.Deserialize(*data);
+
+                    UpdateRecord(bucketIndex, *entry, i, nullptr, 0U);
+                    UpdatePerfDataForRemove(Stat{ record.m_key.m_size, record.m_value.m_size });
+                }
+            }
+        }
+    }
+
+    // Returns the size of the records in the given bucket of this hash table that are written
+    // to the target hash table when merged. Since a merged value is known only when it is merged,
+    // it is counted by the size of the record being merged. It is assumed that this function
+    // is called under a lock.
+    std::uint64_t GetSizeToMerge(
+        const WritableHashTable& target,
+        std::uint32_t bucketIndex,
+        const MergePolicy& policy) const
+    {
+        std::uint64_t size = 0U;
+
+        for (auto* entry = &this->m_hashTable.m_buckets[bucketIndex];
+            entry != nullptr;
+            entry = entry->m_next.Load(std::memory_order_relaxed))
+        {
+            for (std::uint8_t i = 0; i < HashTable::Entry::c_numDataPerEntry; ++i)
+            {
+                const auto data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+
+                if (data != nullptr)
+                {
+                    const auto record = this->m_recordSerializer.Deserialize(*data);
+
+                    if (!(policy.m_conflict == MergePolicy::Conflict::Keep
+                        && target.Find(record.m_key, target.GetBucketInfo(record.m_key)) != nullptr))
+                    {
+                        size += record.m_key.m_size + record.m_value.m_size;
+                    }
+                }
+            }
+        }
+
+        return size;
+    }
+
+    // Adds the given record that belongs to another hash table based on the given policy.
+    // Returns true if the given record itself is stored in this hash table (ownership is moved).
+    bool MergeRecord(
+        RecordBuffer& sourceRecord,
+        const MergePolicy& policy,
+        bool moveRecords,
+        std::vector<std::uint8_t>& mergedValue)
+    {
+        const auto record = this->m_recordSerializer.Deserialize(sourceRecord);
+        const auto& key = record.m_key;
+
+        Stat stat{ key.m_size, record.m_value.m_size };
+
+        const auto bucketInfo = this->GetBucketInfo(key);
+
+        typename HashTable::UniqueLock lock{ this->m_hashTable.GetMutex(bucketInfo.first) };
+
+        const auto slot = FindSlot(key, bucketInfo, stat);
+
+        RecordBuffer* recordToAdd = nullptr;
+
+        if (slot.m_record != nullptr)
+        {
+            switch (policy.m_conflict)
+            {
+            case MergePolicy::Conflict::Keep:
+                return false;
+            case MergePolicy::Conflict::Merge:
+            {
+                mergedValue.clear();
+                policy.m_mergeCallback(
+                    key,
+                    this->m_recordSerializer.Deserialize(*slot.m_record).m_value,
+                    record.m_value,
+                    mergedValue);
+
+                const Value value{ mergedValue.data(), static_cast<Value::size_type>(mergedValue.size()) };
+                recordToAdd = CreateRecordBuffer(key, value);
+                stat.m_valueSize = value.m_size;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        const bool isMoved = (recordToAdd == nullptr) && moveRecords;
+
+        if (recordToAdd == nullptr)
+        {
+            recordToAdd = isMoved ? &sourceRecord : CopyRecordBuffer(record);
+        }
+
+        auto recordToDelete = UpdateRecord(bucketInfo.first, *slot.m_entry, slot.m_index, recordToAdd, bucketInfo.second);
+
+        lock.unlock();
+
+        UpdatePerfDataForAdd(stat);
+
+        ReleaseRecord(recordToDelete);
+
+        return isMoved;
+    }
+
+    // Copies the serialized buffer of the given record as is.
+    RecordBuffer* CopyRecordBuffer(const Record& record)
+    {
+        const auto bufferSize = this->m_recordSerializer.CalculateBufferSize(record.m_key, record.m_value);
+        auto buffer = this->m_hashTable.AllocateRecordBuffer(bufferSize);
+
+        // The key data starts right after the serialized sizes.
+        const auto* source = record.m_key.m_data - this->m_recordSerializer.CalculateRecordOverhead();
+
+#if defined(_MSC_VER)
+        memcpy_s(buffer, bufferSize, source, bufferSize);
+#else
+        memcpy(buffer, source, bufferSize);
+#endif
+        return reinterpret_cast<RecordBuffer*>(buffer);
     }
 
     RecordBuffer* UpdateRecord(
+        std::uint32_t bucketIndex,
         typename HashTable::Entry& entry,
         std::uint8_t index,
         RecordBuffer* newRecord,
@@ -452,6 +1527,14 @@ private:
         recordHolder.Store(newRecord, std::memory_order_release);
         entry.m_tags[index] = newTag;
 
+        if (this->m_hashTable.HasVersions())
+        {
+            // Invalidates the near cache entries of this bucket after the record is updated.
+            this->m_hashTable.GetVersion(bucketIndex).fetch_add(1U, std::memory_order_release);
+        }
+
+        OnRecordUpdated(bucketIndex, entry, index, oldRecord, newRecord);
+
         return oldRecord;
     }
 
@@ -466,7 +1549,13 @@ private:
             [this, record]()
         {
             record->~RecordBuffer();
-            this->m_hashTable.template GetAllocator<RecordBuffer>().deallocate(record, 1U);
+
+            // Records loaded from a memory image or carved out of the reservation
+            // are released with the hash table.
+            if (!this->m_hashTable.IsInRegion(record))
+            {
+                this->m_hashTable.template GetAllocator<RecordBuffer>().deallocate(record, 1U);
+            }
         });
     }
 
@@ -522,6 +1611,8 @@ private:
     }
 
     IEpochActionManager& m_epochManager;
+
+    std::shared_ptr<MemoryBudget> m_memoryBudget;
 };
 
 #pragma warning(pop)
@@ -570,10 +1661,10 @@ public:
 
     void Serialize(
         std::ostream& stream,
-        const Utils::Properties& /* properties */) override
+        const Utils::Properties& properties) override
     {
         ReadWrite::Serializer<
-            HashTable, ReadWrite::ReadOnlyHashTable>{}.Serialize(m_hashTable, stream);
+            HashTable, ReadWrite::ReadOnlyHashTable>{ properties }.Serialize(m_hashTable, stream);
     }
 
 private:
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include "Epoch/IEpochActionManager.h"
+#include "HashTable/Common/OrderedIndex.h"
+#include "HashTable/IHashTable.h"
+#include "HashTable/ReadWrite/HashTable.h"
+
+namespace L4
+{
+namespace HashTable
+{
+namespace ReadWrite
+{
+
+// The following warning is from the virtual inheritance and safe to disable in this case.
+// https://msdn.microsoft.com/en-us/library/6b3sy7ae.aspx
+#pragma warning(push)
+#pragma warning(disable:4250)
+
+// OrderedWritableHashTable is a WritableHashTable that maintains an OrderedIndex over
+// its records for range and prefix scans (IOrderedHashTable). Point look ups (Get())
+// still go through the hash table; only Add()/Remove() pay for the index update.
+template <typename Allocator>
+class OrderedWritableHashTable
+    : public WritableHashTable<Allocator>
+    , public IOrderedHashTable
+{
+public:
+    using Base = WritableHashTable<Allocator>;
+    using HashTable = typename Base::HashTable;
+
+    using Key = IReadOnlyHashTable::Key;
+    using Value = IReadOnlyHashTable::Value;
+
+    // Records that already exist in the given hash table (e.g., loaded by the deserializer)
+    // are added to the index, thus the hash table should not be updated concurrently.
+    OrderedWritableHashTable(
+        HashTable& hashTable,
+        IEpochActionManager& epochManager)
+        : ReadOnlyHashTable<Allocator>(hashTable)
+        , Base(hashTable, epochManager)
+        , m_orderedIndex{
+            this->m_recordSerializer,
+            epochManager,
+            hashTable.m_perfData,
+            hashTable.m_allocator }
+    {
+        for (auto& bucket : hashTable.m_buckets)
+        {
+            for (auto* entry = &bucket; entry != nullptr; entry = entry->m_next.Load())
+            {
+                for (auto& data : entry->m_dataList)
+                {
+                    if (auto* record = data.Load())
+                    {
+                        m_orderedIndex.Upsert(record);
+                    }
+                }
+            }
+        }
+    }
+
+    // The cursor based scan of the hash table is not hidden by the range scan below.
+    using Base::Scan;
+
+    virtual void Scan(const Key& from, const Key& to, const Visitor& visitor) const override
+    {
+        m_orderedIndex.Scan(from, to, visitor);
+    }
+
+    virtual void PrefixScan(const Key& prefix, const Visitor& visitor) const override
+    {
+        m_orderedIndex.PrefixScan(prefix, visitor);
+    }
+
+protected:
+    virtual void OnRecordUpdated(
+        std::uint32_t /* bucketIndex */,
+        const typename HashTable::Entry& /* entry */,
+        std::uint8_t /* index */,
+        const RecordBuffer* oldRecord,
+        RecordBuffer* newRecord) override
+    {
+        if (newRecord != nullptr)
+        {
+            m_orderedIndex.Upsert(newRecord);
+        }
+        else
+        {
+            assert(oldRecord != nullptr);
+            m_orderedIndex.Remove(this->m_recordSerializer.Deserialize(*oldRecord).m_key);
+        }
+    }
+
+private:
+    OrderedIndex<Allocator> m_orderedIndex;
+};
+
+#pragma warning(pop)
+
+} // namespace ReadWrite
+} // namespace HashTable
+} // namespace L4
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <boost/format.hpp>
 #include <iosfwd>
+#include <istream>
+#include <string>
+#include <vector>
+#include "detail/ToRawPointer.h"
 #include "Epoch/IEpochActionManager.h"
+#include "HashTable/Common/Record.h"
 #include "Log/PerfCounter.h"
 #include "Serialization/SerializerHelper.h"
 #include "Utils/Exception.h"
@@ -112,38 +118,61 @@ public:
 
         EpochActionManager epochActionManager;
 
-        WritableHashTable<typename HashTable::Allocator> writableHashTable(
+        Table writableHashTable(
             *hashTable,
             epochActionManager);
 
         auto& perfData = hashTable->m_perfData;
 
-        std::vector<std::uint8_t> keyBuffer;
-        std::vector<std::uint8_t> valueBuffer;
+        // Records are read in batches so that their keys are hashed together.
+        std::vector<std::uint8_t> buffer;
+        std::vector<IReadOnlyHashTable::Key> keys(c_batchSize);
+        std::vector<IReadOnlyHashTable::Value> values(c_batchSize);
+        std::vector<std::size_t> offsets(c_batchSize);
+        std::vector<typename Table::Hash> hashes(c_batchSize);
 
         bool hasMoreData = false;
         helper.Deserialize(hasMoreData);
 
         while (hasMoreData)
         {
-            IReadOnlyHashTable::Key key;
-            IReadOnlyHashTable::Value value;
+            buffer.clear();
 
-            helper.Deserialize(key.m_size);
-            keyBuffer.resize(key.m_size);
-            helper.Deserialize(keyBuffer.data(), key.m_size);
-            key.m_data = keyBuffer.data();
+            std::size_t numRecords = 0U;
 
-            helper.Deserialize(value.m_size);
-            valueBuffer.resize(value.m_size);
-            helper.Deserialize(valueBuffer.data(), value.m_size);
-            value.m_data = valueBuffer.data();
+            for (; hasMoreData && numRecords < c_batchSize; ++numRecords)
+            {
+                auto& key = keys[numRecords];
+                auto& value = values[numRecords];
 
-            writableHashTable.Add(key, value);
+                // The keys and the values are stored back to back in the buffer.
+                offsets[numRecords] = buffer.size();
 
-            helper.Deserialize(hasMoreData);
+                helper.Deserialize(key.m_size);
+                buffer.resize(buffer.size() + key.m_size);
+                helper.Deserialize(buffer.data() + buffer.size() - key.m_size, key.m_size);
 
-            perfData.Increment(HashTablePerfCounter::RecordsCountLoadedFromSerializer);
+                helper.Deserialize(value.m_size);
+                buffer.resize(buffer.size() + value.m_size);
+                helper.Deserialize(buffer.data() + buffer.size() - value.m_size, value.m_size);
+
+                helper.Deserialize(hasMoreData);
+            }
+
+            for (std::size_t i = 0U; i < numRecords; ++i)
+            {
+                keys[i].m_data = buffer.data() + offsets[i];
+                values[i].m_data = keys[i].m_data + keys[i].m_size;
+            }
+
+            Table::GetHashes(keys.data(), numRecords, hashes.data());
+
+            for (std::size_t i = 0U; i < numRecords; ++i)
+            {
+                writableHashTable.Add(keys[i], values[i], hashes[i]);
+
+                perfData.Increment(HashTablePerfCounter::RecordsCountLoadedFromSerializer);
+            }
         }
 
         // Flush perf counter so that the values are up to date when GetPerfData() is called.
@@ -153,6 +182,24 @@ public:
     }
 
 private:
+    // Table exposes the batch hashing of WritableHashTable.
+    class Table : public WritableHashTable<typename HashTable::Allocator>
+    {
+    public:
+        using WritableBase = WritableHashTable<typename HashTable::Allocator>;
+
+        Table(HashTable& hashTable, IEpochActionManager& epochManager)
+            : WritableBase::Base(hashTable)
+            , WritableBase(hashTable, epochManager)
+        {}
+
+        using typename WritableBase::Hash;
+        using WritableBase::Add;
+        using WritableBase::GetHashes;
+    };
+
+    static constexpr std::size_t c_batchSize = 64U;
+
     // Deserializer internally uses WritableHashTable for deserialization, therefore
     // an implementation of IEpochActionManager is needed. Since all the keys in the hash table
     // are expected to be unique, no RegisterAction() should be called.
@@ -172,20 +219,491 @@ private:
 } // namespace Current
 
 
+// Image serializer writes the memory image of a hash table so that it can be loaded with
+// a few bulk reads instead of re-inserting every record. It is selected by passing
+// { c_formatPropertyName, c_formatPropertyValue } to ISerializer::Serialize().
+namespace Image
+{
+
+constexpr std::uint8_t c_version = 3U;
+
+constexpr const char* c_formatPropertyName = "SerializerFormat";
+constexpr const char* c_formatPropertyValue = "Image";
+
+// LayoutDescriptor describes the in-memory layout that the image depends on.
+// An image can be loaded only if the layout of the loading hash table is identical.
+struct LayoutDescriptor
+{
+    // Pointers are stored as offsets from the pointer itself (Utils::AtomicOffsetPtr).
+    static constexpr std::uint8_t c_offsetPointerEncoding = 1U;
+
+    // MurmurHash3_x64_128 with seed 0, see ReadOnlyHashTable::GetBucketInfo().
+    // This should be bumped if the bucket or the tag computation changes.
+    static constexpr std::uint8_t c_murmurHash3HashFunction = 1U;
+
+    template <typename HashTable>
+    static LayoutDescriptor Create()
+    {
+        LayoutDescriptor layout;
+        layout.m_entrySize = sizeof(typename HashTable::Entry);
+        layout.m_numDataPerEntry = HashTable::Entry::c_numDataPerEntry;
+        layout.m_settingSize = sizeof(typename HashTable::Setting);
+        layout.m_recordAlignment = alignof(typename HashTable::Entry);
+        return layout;
+    }
+
+    bool operator==(const LayoutDescriptor& other) const
+    {
+        return (m_byteOrderMark == other.m_byteOrderMark)
+            && (m_entrySize == other.m_entrySize)
+            && (m_numDataPerEntry == other.m_numDataPerEntry)
+            && (m_settingSize == other.m_settingSize)
+            && (m_recordAlignment == other.m_recordAlignment)
+            && (m_pointerEncoding == other.m_pointerEncoding)
+            && (m_hashFunction == other.m_hashFunction);
+    }
+
+    std::uint32_t m_byteOrderMark = 0x01020304U;
+    std::uint16_t m_entrySize = 0U;
+    std::uint16_t m_numDataPerEntry = 0U;
+    std::uint16_t m_settingSize = 0U;
+    std::uint16_t m_recordAlignment = 0U;
+    std::uint8_t m_pointerEncoding = c_offsetPointerEncoding;
+    std::uint8_t m_hashFunction = c_murmurHash3HashFunction;
+    std::uint16_t m_reserved = 0U;
+};
+
+static_assert(sizeof(LayoutDescriptor) == 16U, "LayoutDescriptor should not have a padding.");
+
+// Perf counters of the records and the entries in the image, which are counted as they are
+// written and restored on load. TotalIndexSize is derived from them on load.
+constexpr std::array<HashTablePerfCounter, 9U> c_savedPerfCounters =
+{
+    HashTablePerfCounter::RecordsCount,
+    HashTablePerfCounter::TotalKeySize,
+    HashTablePerfCounter::TotalValueSize,
+    HashTablePerfCounter::ChainingEntriesCount,
+    HashTablePerfCounter::MinKeySize,
+    HashTablePerfCounter::MaxKeySize,
+    HashTablePerfCounter::MinValueSize,
+    HashTablePerfCounter::MaxValueSize,
+    HashTablePerfCounter::MaxBucketChainLength
+};
+
+// Bulk reads/writes are split since the helpers take 32-bit sizes.
+constexpr std::uint32_t c_maxChunkSize = 1U << 30;
+
+// The image is laid out in the following "image address space":
+//     <Bucket array> <Region>
+// where the region holds, in the bucket order, each chained entry followed by the records
+// of the entry (records of a bucket entry directly follow the records of the previous entry).
+// Every pointer is stored as an offset in this address space, thus the pointers in the region
+// stay valid as long as the region is loaded into one contiguous buffer, and only the pointers
+// in the bucket array need to be adjusted by a constant on load.
+template <typename HashTable>
+class ImageLayout
+{
+public:
+    using Entry = typename HashTable::Entry;
+
+    explicit ImageLayout(const HashTable& hashTable)
+        : m_hashTable{ hashTable }
+        , m_recordSerializer{ hashTable.m_setting.m_fixedKeySize, hashTable.m_setting.m_fixedValueSize }
+    {}
+
+    // Returns the offset of the region in the image address space.
+    std::uint64_t GetRegionOffset() const
+    {
+        return static_cast<std::uint64_t>(m_hashTable.m_buckets.size()) * sizeof(Entry);
+    }
+
+    // Visits every entry of the given bucket in the image order, where "cursor" is the end offset
+    // of the region before the bucket and is advanced past the entries and records of the bucket.
+    // "func" is called with the entry, the entry's image (the entry with the pointers relocated
+    // to the image address space), and whether the entry is in the region.
+    // The bucket should not be updated during the call.
+    template <typename Func>
+    void ForEachEntry(std::size_t bucketIndex, std::uint64_t& cursor, Func func) const
+    {
+        const Entry* entry = &m_hashTable.m_buckets[bucketIndex];
+        auto entryOffset = static_cast<std::uint64_t>(bucketIndex) * sizeof(Entry);
+        bool isInRegion = false;
+
+        while (entry != nullptr)
+        {
+            Entry image;
+            image.m_tags = entry->m_tags;
+
+            if (isInRegion)
+            {
+                cursor += sizeof(Entry);
+            }
+
+            for (std::uint8_t i = 0U; i < Entry::c_numDataPerEntry; ++i)
+            {
+                const auto* data = entry->m_dataList[i].Load(std::memory_order_relaxed);
+                if (data != nullptr)
+                {
+                    Relocate(image, image.m_dataList[i], entryOffset, cursor);
+                    cursor += GetAlignedSize(*data);
+                }
+            }
+
+            const auto* next = entry->m_next.Load(std::memory_order_relaxed);
+            if (next != nullptr)
+            {
+                Relocate(image, image.m_next, entryOffset, cursor);
+            }
+
+            func(*entry, image, isInRegion);
+
+            entryOffset = cursor;
+            isInRegion = true;
+            entry = next;
+        }
+    }
+
+    // Returns the size of the given record including the padding.
+    std::size_t GetAlignedSize(const RecordBuffer& record) const
+    {
+        return (GetSize(record) + c_alignment - 1U) & ~(c_alignment - 1U);
+    }
+
+    std::size_t GetSize(const RecordBuffer& record) const
+    {
+        const auto deserialized = m_recordSerializer.Deserialize(record);
+        return m_recordSerializer.CalculateBufferSize(deserialized.m_key, deserialized.m_value);
+    }
+
+    // Records are padded so that the chained entries in the region stay aligned.
+    static constexpr std::size_t c_alignment = alignof(Entry);
+
+private:
+    template <typename T>
+    static void Relocate(
+        const Entry& image,
+        Utils::AtomicOffsetPtr<T>& ptr,
+        std::uint64_t entryOffset,
+        std::uint64_t targetOffset)
+    {
+        const auto ptrOffset = entryOffset
+            + (reinterpret_cast<const std::uint8_t*>(&ptr) - reinterpret_cast<const std::uint8_t*>(&image));
+
+        ptr.SetOffset(targetOffset - ptrOffset, std::memory_order_relaxed);
+    }
+
+    const HashTable& m_hashTable;
+
+    const RecordSerializer m_recordSerializer;
+};
+
+
+// Image serializer used for writing a memory image of hash tables.
+// The serialization format of Serializer is:
+// <Version Id = 3> <LayoutDescriptor> <Hash table settings>
+// <Bucket array> <Region size> <Region> <Saved perf counters>
+// Each bucket is visited once under its lock, so that the hash table can be updated while it is
+// being serialized. Thus, the saved perf counters are counted from the records and the entries
+// written instead of being read from the hash table. The bucket array is written as the buckets are visited, while the region is
+// built in memory and written after its size, thus the serialization needs as much memory as
+// the chained entries and the records of the hash table.
+template <typename HashTable>
+class Serializer
+{
+public:
+    Serializer() = default;
+
+    Serializer(const Serializer&) = delete;
+    Serializer& operator=(const Serializer&) = delete;
+
+    void Serialize(
+        HashTable& hashTable,
+        std::ostream& stream) const
+    {
+        auto& perfData = hashTable.m_perfData;
+        perfData.Set(HashTablePerfCounter::RecordsCountSavedFromSerializer, 0);
+
+        SerializerHelper helper(stream);
+
+        helper.Serialize(c_version);
+        helper.Serialize(LayoutDescriptor::Create<HashTable>());
+        helper.Serialize(&hashTable.m_setting, sizeof(hashTable.m_setting));
+
+        const ImageLayout<HashTable> layout{ hashTable };
+        const RecordSerializer recordSerializer{ hashTable.m_setting.m_fixedKeySize, hashTable.m_setting.m_fixedValueSize };
+
+        // Only this thread updates the counters of the image.
+        SingleThreadedHashTablePerfData imagePerfData;
+
+        std::vector<std::uint8_t> region;
+        auto cursor = layout.GetRegionOffset();
+
+        const auto append = [&region](const void* data, std::size_t size, std::size_t alignedSize)
+        {
+            const auto* bytes = static_cast<const std::uint8_t*>(data);
+            region.insert(region.end(), bytes, bytes + size);
+            region.resize(region.size() + (alignedSize - size), 0U);
+        };
+
+        for (std::size_t bucketIndex = 0U; bucketIndex < hashTable.m_buckets.size(); ++bucketIndex)
+        {
+            typename HashTable::Lock lock{ hashTable.GetMutex(bucketIndex) };
+
+            HashTablePerfData::TValue chainLength = 0;
+
+            layout.ForEachEntry(
+                bucketIndex,
+                cursor,
+                [&helper, &layout, &append, &perfData, &imagePerfData, &recordSerializer, &chainLength](
+                    const auto& entry, const auto& image, bool isInRegion)
+            {
+                if (isInRegion)
+                {
+                    append(&image, sizeof(image), sizeof(image));
+
+                    imagePerfData.Increment(HashTablePerfCounter::ChainingEntriesCount);
+                }
+                else
+                {
+                    helper.Serialize(&image, sizeof(image));
+                }
+
+                ++chainLength;
+
+                for (const auto& dataPtr : entry.m_dataList)
+                {
+                    const auto* data = dataPtr.Load(std::memory_order_relaxed);
+                    if (data != nullptr)
+                    {
+                        append(data, layout.GetSize(*data), layout.GetAlignedSize(*data));
+
+                        const auto record = recordSerializer.Deserialize(*data);
+
+                        imagePerfData.Increment(HashTablePerfCounter::RecordsCount);
+                        imagePerfData.Add(HashTablePerfCounter::TotalKeySize, record.m_key.m_size);
+                        imagePerfData.Add(HashTablePerfCounter::TotalValueSize, record.m_value.m_size);
+                        imagePerfData.Min(HashTablePerfCounter::MinKeySize, record.m_key.m_size);
+                        imagePerfData.Max(HashTablePerfCounter::MaxKeySize, record.m_key.m_size);
+                        imagePerfData.Min(HashTablePerfCounter::MinValueSize, record.m_value.m_size);
+                        imagePerfData.Max(HashTablePerfCounter::MaxValueSize, record.m_value.m_size);
+
+                        perfData.Increment(HashTablePerfCounter::RecordsCountSavedFromSerializer);
+                    }
+                }
+            });
+
+            imagePerfData.Max(HashTablePerfCounter::MaxBucketChainLength, chainLength);
+        }
+
+        if (region.size() != cursor - layout.GetRegionOffset())
+        {
+            throw RuntimeException("The memory image region doesn't match the bucket array.");
+        }
+
+        helper.Serialize(static_cast<std::uint64_t>(region.size()));
+        WriteBytes(helper, region.data(), region.size());
+
+        for (const auto counter : c_savedPerfCounters)
+        {
+            helper.Serialize(imagePerfData.Get(counter));
+        }
+
+        // Flush perf counter so that the values are up to date when GetPerfData() is called.
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+private:
+    static void WriteBytes(SerializerHelper& helper, const void* data, std::uint64_t size)
+    {
+        const auto* buffer = static_cast<const std::uint8_t*>(data);
+        while (size > 0U)
+        {
+            const auto chunkSize = static_cast<std::uint32_t>((std::min)(size, static_cast<std::uint64_t>(c_maxChunkSize)));
+            helper.Serialize(buffer, chunkSize);
+            buffer += chunkSize;
+            size -= chunkSize;
+        }
+    }
+};
+
+
+// Image Deserializer used for loading a memory image of hash tables.
+// The bucket array and the region are read in bulk, and the region is owned by
+// the hash table (see SharedHashTable::Image) until the hash table is destroyed.
+template <typename Memory, typename HashTable>
+class Deserializer
+{
+public:
+    explicit Deserializer(const Utils::Properties& /* properties */)
+    {}
+
+    Deserializer(const Deserializer&) = delete;
+    Deserializer& operator=(const Deserializer&) = delete;
+
+    typename Memory::template UniquePtr<HashTable> Deserialize(
+        Memory& memory,
+        std::istream& stream) const
+    {
+        using Entry = typename HashTable::Entry;
+
+        DeserializerHelper helper(stream);
+
+        LayoutDescriptor layout;
+        helper.Deserialize(layout);
+
+        if (!stream || !(layout == LayoutDescriptor::Create<HashTable>()))
+        {
+            throw RuntimeException("The memory image layout is not compatible with the hash table.");
+        }
+
+        typename HashTable::Setting setting;
+        helper.Deserialize(setting);
+
+        if (!stream)
+        {
+            throw RuntimeException("Failed to read the memory image.");
+        }
+
+        auto hashTable{ memory.template MakeUnique<HashTable>(
+            setting,
+            memory.GetAllocator()) };
+
+        auto& buckets = hashTable->m_buckets;
+        const auto bucketsSize = static_cast<std::uint64_t>(buckets.size()) * sizeof(Entry);
+
+        ReadBytes(helper, &buckets[0], bucketsSize);
+
+        std::uint64_t regionSize = 0U;
+        helper.Deserialize(regionSize);
+
+        if (stream && regionSize > 0U)
+        {
+            auto& image = hashTable->m_image;
+            image.m_buffer = Detail::to_raw_pointer(
+                hashTable->template GetAllocator<std::uint8_t>().allocate(regionSize));
+            image.m_size = regionSize;
+
+            ReadBytes(helper, image.m_buffer, regionSize);
+        }
+
+        std::array<HashTablePerfData::TValue, c_savedPerfCounters.size()> counterValues;
+        for (auto& value : counterValues)
+        {
+            helper.Deserialize(value);
+        }
+
+        if (!stream)
+        {
+            // The bucket array may reference the memory that is not loaded.
+            for (auto& bucket : buckets)
+            {
+                new (&bucket) Entry();
+            }
+
+            throw RuntimeException("Failed to read the memory image.");
+        }
+
+        // Relocate the pointers in the bucket array to the loaded region.
+        const auto delta =
+            reinterpret_cast<std::uint64_t>(hashTable->m_image.m_buffer)
+            - reinterpret_cast<std::uint64_t>(&buckets[0])
+            - bucketsSize;
+
+        for (auto& bucket : buckets)
+        {
+            for (auto& data : bucket.m_dataList)
+            {
+                Relocate(data, delta);
+            }
+
+            Relocate(bucket.m_next, delta);
+        }
+
+        auto& perfData = hashTable->m_perfData;
+        for (std::size_t i = 0U; i < c_savedPerfCounters.size(); ++i)
+        {
+            perfData.Set(c_savedPerfCounters[i], counterValues[i]);
+        }
+
+        // The hash table already counts its bucket array, thus the records and the chained entries are added.
+        const RecordSerializer recordSerializer{ setting.m_fixedKeySize, setting.m_fixedValueSize };
+        perfData.Add(
+            HashTablePerfCounter::TotalIndexSize,
+            (perfData.Get(HashTablePerfCounter::RecordsCount)
+                * static_cast<HashTablePerfData::TValue>(recordSerializer.CalculateRecordOverhead()))
+            + (perfData.Get(HashTablePerfCounter::ChainingEntriesCount)
+                * static_cast<HashTablePerfData::TValue>(sizeof(Entry))));
+
+        perfData.Set(
+            HashTablePerfCounter::RecordsCountLoadedFromSerializer,
+            perfData.Get(HashTablePerfCounter::RecordsCount));
+
+        // Flush perf counter so that the values are up to date when GetPerfData() is called.
+        std::atomic_thread_fence(std::memory_order_release);
+
+        return hashTable;
+    }
+
+private:
+    template <typename T>
+    static void Relocate(Utils::AtomicOffsetPtr<T>& ptr, std::uint64_t delta)
+    {
+        const auto offset = ptr.GetOffset(std::memory_order_relaxed);
+        if (offset != Utils::AtomicOffsetPtr<T>::c_nullOffset)
+        {
+            ptr.SetOffset(offset + delta, std::memory_order_relaxed);
+        }
+    }
+
+    static void ReadBytes(DeserializerHelper& helper, void* data, std::uint64_t size)
+    {
+        auto* buffer = static_cast<std::uint8_t*>(data);
+        while (size > 0U)
+        {
+            const auto chunkSize = static_cast<std::uint32_t>((std::min)(size, static_cast<std::uint64_t>(c_maxChunkSize)));
+            helper.Deserialize(buffer, chunkSize);
+            buffer += chunkSize;
+            size -= chunkSize;
+        }
+    }
+};
+
+} // namespace Image
+
+
 // Serializer is the main driver for serializing a hash table.
-// It always uses the Current::Serializer for serializing a hash table.
+// It uses the Current::Serializer for serializing a hash table unless
+// the Image format is requested through the properties.
 template <typename HashTable, template <typename> class ReadOnlyHashTable>
 class Serializer
 {
 public:
     Serializer() = default;
+
+    explicit Serializer(const Utils::Properties& properties)
+    {
+        std::string format;
+        m_useImage = properties.TryGet(Image::c_formatPropertyName, format)
+            && (format == Image::c_formatPropertyValue);
+    }
+
     Serializer(const Serializer&) = delete;
     Serializer& operator=(const Serializer&) = delete;
 
     void Serialize(HashTable& hashTable, std::ostream& stream) const
     {
-        Current::Serializer<HashTable, ReadOnlyHashTable>{}.Serialize(hashTable, stream);
+        if (m_useImage)
+        {
+            Image::Serializer<HashTable>{}.Serialize(hashTable, stream);
+        }
+        else
+        {
+            Current::Serializer<HashTable, ReadOnlyHashTable>{}.Serialize(hashTable, stream);
+        }
     }
+
+private:
+    bool m_useImage = false;
 };
 
 // Deserializer is the main driver for deserializing the input stream to create a hash table.
@@ -211,6 +729,8 @@ public:
         {
         case Current::c_version:
             return Current::Deserializer<Memory, HashTable, WritableHashTable>{ m_properties }.Deserialize(memory, stream);
+        case Image::c_version:
+            return Image::Deserializer<Memory, HashTable>{ m_properties }.Deserialize(memory, stream);
         default:
             boost::format err("Unsupported version '%1%' is given.");
             err % version;
@@ -1,54 +1,105 @@
 #pragma once
 
+#include <array>
+#include <boost/optional.hpp>
 #include "Epoch/EpochRefPolicy.h"
+#include "EpochDomains.h"
 #include "EpochManager.h"
 #include "HashTableManager.h"
+#include "PinnedValue.h"
 
 namespace L4
 {
 namespace LocalMemory
 {
 
-class Context : private EpochRefPolicy<EpochManager::TheEpochRefManager>
+// Context references the epoch domain of a hash table when the hash table is accessed
+// for the first time, so that it doesn't delay the memory reclamation of other domains.
+class Context
 {
 public:
     Context(
         HashTableManager& hashTableManager,
-        EpochManager::TheEpochRefManager& epochRefManager)
-        : EpochRefPolicy<EpochManager::TheEpochRefManager>(epochRefManager)
-        , m_hashTableManager{ hashTableManager }
+        EpochDomains& epochDomains)
+        : m_hashTableManager{ hashTableManager }
+        , m_epochDomains{ epochDomains }
     {}
 
     Context(Context&& context)
-        : EpochRefPolicy<EpochManager::TheEpochRefManager>(std::move(context))
-        , m_hashTableManager{ context.m_hashTableManager }
+        : m_hashTableManager{ context.m_hashTableManager }
+        , m_epochDomains{ context.m_epochDomains }
+        , m_epochRefPolicies(std::move(context.m_epochRefPolicies))
     {}
 
     const IReadOnlyHashTable& operator[](const char* name) const
     {
-        return m_hashTableManager.GetHashTable(name);
+        return (*this)[m_hashTableManager.GetIndex(name)];
     }
 
     IWritableHashTable& operator[](const char* name)
     {
-        return m_hashTableManager.GetHashTable(name);
+        return (*this)[m_hashTableManager.GetIndex(name)];
     }
 
     const IReadOnlyHashTable& operator[](std::size_t index) const
     {
+        AddEpochRef(index);
         return m_hashTableManager.GetHashTable(index);
     }
 
     IWritableHashTable& operator[](std::size_t index)
     {
+        AddEpochRef(index);
         return m_hashTableManager.GetHashTable(index);
     }
 
+    // Looks up the given key, and returns a handle that keeps the value valid after this
+    // context is destroyed (see PinnedValue), or an empty handle if the key is not found.
+    // For a single-threaded hash table, the value is valid until the next update as for Get().
+    PinnedValue GetPinned(const char* name, const IReadOnlyHashTable::Key& key) const
+    {
+        return GetPinned(m_hashTableManager.GetIndex(name), key);
+    }
+
+    PinnedValue GetPinned(std::size_t index, const IReadOnlyHashTable::Key& key) const
+    {
+        // The epoch is referenced before the lookup, so that the record found is not released
+        // before the reference is taken.
+        PinnedValue::TheEpochRefPolicy epochRefPolicy{
+            m_epochDomains.GetEpochManager(m_hashTableManager.GetEpochDomainIndex(index)).GetEpochRefManager() };
+
+        IReadOnlyHashTable::Value value;
+        if (!m_hashTableManager.GetHashTable(index).Get(key, value))
+        {
+            return PinnedValue{};
+        }
+
+        return PinnedValue{ value, std::move(epochRefPolicy) };
+    }
+
     Context(const Context&) = delete;
     Context& operator=(const Context&) = delete;
 
 private:
+    using TheEpochRefPolicy = EpochRefPolicy<EpochManager::TheEpochRefManager>;
+
+    void AddEpochRef(std::size_t index) const
+    {
+        const auto epochDomainIndex = m_hashTableManager.GetEpochDomainIndex(index);
+
+        auto& epochRefPolicy = m_epochRefPolicies[epochDomainIndex];
+        if (!epochRefPolicy)
+        {
+            epochRefPolicy.emplace(m_epochDomains.GetEpochManager(epochDomainIndex).GetEpochRefManager());
+        }
+    }
+
     HashTableManager& m_hashTableManager;
+
+    EpochDomains& m_epochDomains;
+
+    // Epoch references of the domains accessed by this context, indexed by the domain index.
+    mutable std::array<boost::optional<TheEpochRefPolicy>, EpochDomains::c_maxNumDomains> m_epochRefPolicies;
 };
 
 } // namespace LocalMemory
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "EpochManager.h"
+#include "Epoch/Config.h"
+#include "Log/PerfCounter.h"
+#include "Utils/Containers.h"
+#include "Utils/Exception.h"
+
+namespace L4
+{
+namespace LocalMemory
+{
+
+// EpochDomains manages independent epoch domains, where each domain has its own
+// EpochManager (thus its own epoch queue, action manager and processing thread).
+// Since a context only references the domains of the hash tables it accesses,
+// slow readers in one domain do not delay the memory reclamation of another domain.
+class EpochDomains
+{
+public:
+    // The domain name of the hash tables that do not specify a domain.
+    static constexpr const char* c_defaultDomainName = "";
+
+    static constexpr std::size_t c_maxNumDomains = 16U;
+
+    explicit EpochDomains(const EpochManagerConfig& config)
+        : m_config{ config }
+    {
+        GetOrAdd(c_defaultDomainName);
+    }
+
+    // Returns the index of the domain with the given name, adding the domain if it doesn't exist.
+    std::size_t GetOrAdd(const std::string& name)
+    {
+        const auto it = m_domainNameToIndex.find(name);
+        if (it != m_domainNameToIndex.end())
+        {
+            return it->second;
+        }
+
+        if (m_domains.size() == c_maxNumDomains)
+        {
+            throw RuntimeException("The number of epoch domains exceeds the max.");
+        }
+
+        m_domains.emplace_back(std::make_unique<Domain>(m_config));
+        m_domainNames.emplace_back(name);
+
+        const auto newIndex = m_domains.size() - 1;
+
+        m_domainNameToIndex.emplace(name, newIndex);
+
+        return newIndex;
+    }
+
+    EpochManager& GetEpochManager(std::size_t index)
+    {
+        assert(index < m_domains.size());
+        return m_domains[index]->m_epochManager;
+    }
+
+    std::size_t GetNumDomains() const
+    {
+        return m_domains.size();
+    }
+
+    const std::string& GetDomainName(std::size_t index) const
+    {
+        assert(index < m_domainNames.size());
+        return m_domainNames[index];
+    }
+
+    const ServerPerfData& GetPerfData(std::size_t index) const
+    {
+        assert(index < m_domains.size());
+        return m_domains[index]->m_perfData;
+    }
+
+    const ServerPerfData& GetPerfData(const std::string& name) const
+    {
+        const auto it = m_domainNameToIndex.find(name);
+        if (it == m_domainNameToIndex.end())
+        {
+            throw RuntimeException("Epoch domain does not exist.");
+        }
+
+        return m_domains[it->second]->m_perfData;
+    }
+
+    EpochDomains(const EpochDomains&) = delete;
+    EpochDomains& operator=(const EpochDomains&) = delete;
+
+private:
+    struct Domain
+    {
+        explicit Domain(const EpochManagerConfig& config)
+            : m_perfData{}
+            , m_epochManager{ config, m_perfData }
+        {}
+
+        ServerPerfData m_perfData;
+
+        EpochManager m_epochManager;
+    };
+
+    EpochManagerConfig m_config;
+
+    Utils::StdStringKeyMap<std::size_t> m_domainNameToIndex;
+
+    std::vector<std::unique_ptr<Domain>> m_domains;
+
+    std::vector<std::string> m_domainNames;
+};
+
+} // namespace LocalMemory
+} // namespace L4
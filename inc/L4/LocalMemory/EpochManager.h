@@ -37,7 +37,7 @@ public:
             m_config.m_epochQueueSize }
         , m_epochRefManager{ m_epochQueue }
         , m_epochCounterManager{ m_epochQueue }
-        , m_epochActionManager{ config.m_numActionQueues }
+        , m_epochActionManager{ config.m_numActionQueues, config.m_maxNumActionQueues }
         , m_processingThread{
             m_config.m_epochProcessingInterval,
             [this]
@@ -54,10 +54,31 @@ public:
 
     void RegisterAction(Action&& action) override
     {
-        m_epochActionManager.RegisterAction(m_currentEpochCounter, std::move(action));
+        if (m_epochActionManager.RegisterAction(m_currentEpochCounter, std::move(action)))
+        {
+            m_perfData.Increment(ServerPerfCounter::ActionQueueContentionCount);
+        }
+
         m_perfData.Increment(ServerPerfCounter::PendingActionsCount);
     }
 
+    // The following tunables can be changed while the hash tables are accessed.
+
+    std::chrono::milliseconds GetEpochProcessingInterval() const
+    {
+        return m_processingThread.GetInterval();
+    }
+
+    void SetEpochProcessingInterval(std::chrono::milliseconds interval)
+    {
+        m_processingThread.SetInterval(interval);
+    }
+
+    EpochActionManager& GetEpochActionManager()
+    {
+        return m_epochActionManager;
+    }
+
     EpochManager(const EpochManager&) = delete;
     EpochManager& operator=(const EpochManager&) = delete;
 
@@ -1,14 +1,20 @@
 #pragma once
 
 #include <boost/any.hpp>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 #include "LocalMemory/Memory.h"
 #include "Epoch/IEpochActionManager.h"
 #include "HashTable/Config.h"
+#include "HashTable/HybridLog/HashTable.h"
+#include "HashTable/ReadWrite/ColumnHashTable.h"
 #include "HashTable/ReadWrite/HashTable.h"
+#include "HashTable/ReadWrite/OrderedHashTable.h"
 #include "HashTable/ReadWrite/Serializer.h"
 #include "HashTable/Cache/HashTable.h"
+#include "Log/OperationRecorder.h"
 #include "Utils/Containers.h"
 #include "Utils/Exception.h"
 
@@ -24,7 +30,8 @@ public:
     std::size_t Add(
         const HashTableConfig& config,
         IEpochActionManager& epochActionManager,
-        Allocator allocator)
+        Allocator allocator,
+        std::size_t epochDomainIndex = 0U)
     {
         if (m_hashTableNameToIndex.find(config.m_name) != m_hashTableNameToIndex.end())
         {
@@ -40,6 +47,36 @@ public:
                 "Constructing cache hash table via serializer is not supported.");
         }
 
+        if (cacheConfig && config.m_hasOrderedIndex)
+        {
+            throw RuntimeException(
+                "Ordered index on cache hash table is not supported.");
+        }
+
+        if (config.m_hybridLog && (cacheConfig || serializerConfig || config.m_hasOrderedIndex))
+        {
+            throw RuntimeException(
+                "Hybrid log hash table does not support cache, serializer or ordered index.");
+        }
+
+        if (!config.m_columns.empty() && (cacheConfig || config.m_hasOrderedIndex || config.m_hybridLog))
+        {
+            throw RuntimeException(
+                "Column hash table does not support cache, ordered index or hybrid log.");
+        }
+
+        if (config.m_hybridLog && config.m_hasNearCache)
+        {
+            throw RuntimeException(
+                "Hybrid log hash table does not support near cache.");
+        }
+
+        if (config.m_memoryBudget && (cacheConfig || config.m_hybridLog))
+        {
+            throw RuntimeException(
+                "Memory budget is not supported for cache or hybrid log hash tables.");
+        }
+
         using namespace HashTable;
 
         using InternalHashTable = typename ReadWrite::WritableHashTable<Allocator>::HashTable;
@@ -61,20 +98,99 @@ public:
                     config.m_setting.m_fixedValueSize.get_value_or(0U) },
                 memory.GetAllocator());
 
-        auto hashTable = 
-            cacheConfig
-            ? std::make_unique<Cache::WritableHashTable<Allocator>>(
+        // The hash tables confined to a thread release the memory immediately
+        // since there is no concurrent reader to wait for.
+        const bool isSynchronized = InternalHashTable::Policy::c_isSynchronized;
+
+        if (!isSynchronized && config.m_hybridLog)
+        {
+            throw RuntimeException(
+                "Hybrid log hash table does not support the single-threaded policy.");
+        }
+
+        // The write-back cache flushes the dirty records on its own thread.
+        if (!isSynchronized && cacheConfig && cacheConfig->m_writeBack)
+        {
+            throw RuntimeException(
+                "Write-back cache hash table does not support the single-threaded policy.");
+        }
+
+        auto& hashTableEpochManager = isSynchronized
+            ? epochActionManager
+            : static_cast<IEpochActionManager&>(m_immediateEpochActionManager);
+
+        std::unique_ptr<IWritableHashTable> hashTable;
+
+        if (cacheConfig)
+        {
+            hashTable = std::make_unique<Cache::WritableHashTable<Allocator>>(
                 *internalHashTable,
-                epochActionManager,
+                hashTableEpochManager,
                 cacheConfig->m_maxCacheSizeInBytes,
                 cacheConfig->m_recordTimeToLive,
-                cacheConfig->m_forceTimeBasedEviction)
-            : std::make_unique<ReadWrite::WritableHashTable<Allocator>>(
+                cacheConfig->m_forceTimeBasedEviction,
+                cacheConfig->m_writeBack,
+                cacheConfig->m_useMetadataArray);
+        }
+        else if (config.m_hybridLog)
+        {
+            const auto& hybridLogConfig = *config.m_hybridLog;
+
+            hashTable = std::make_unique<HybridLog::WritableHashTable<Allocator>>(
                 *internalHashTable,
-                epochActionManager);
+                hashTableEpochManager,
+                hybridLogConfig.m_filePath,
+                hybridLogConfig.m_pageSize,
+                hybridLogConfig.m_numMemoryPages,
+                hybridLogConfig.m_numPagesPerSegment,
+                hybridLogConfig.m_maxNumSegments,
+                hybridLogConfig.m_compactionInterval);
+        }
+        else if (!config.m_columns.empty())
+        {
+            hashTable = std::make_unique<ReadWrite::ColumnWritableHashTable<Allocator>>(
+                *internalHashTable,
+                hashTableEpochManager,
+                ColumnSchema{ config.m_columns });
+        }
+        else if (config.m_hasOrderedIndex)
+        {
+            hashTable = std::make_unique<ReadWrite::OrderedWritableHashTable<Allocator>>(
+                *internalHashTable,
+                hashTableEpochManager);
+        }
+        else
+        {
+            hashTable = std::make_unique<ReadWrite::WritableHashTable<Allocator>>(
+                *internalHashTable,
+                hashTableEpochManager);
+        }
+
+        if (config.m_hasNearCache)
+        {
+            dynamic_cast<ReadWrite::ReadOnlyHashTable<Allocator>&>(*hashTable).EnableNearCache();
+        }
+
+        if (config.m_memoryBudget)
+        {
+            dynamic_cast<ReadWrite::WritableHashTable<Allocator>&>(*hashTable).SetMemoryBudget(config.m_memoryBudget);
+        }
+
+        // The hybrid log hash tables are not recorded, for which the function is empty.
+        SetOperationRecorderFunc setOperationRecorder;
+        if (auto* readOnlyHashTable = dynamic_cast<ReadWrite::ReadOnlyHashTable<Allocator>*>(hashTable.get()))
+        {
+            setOperationRecorder = [readOnlyHashTable](OperationRecorder* recorder, std::uint16_t index)
+            {
+                readOnlyHashTable->SetOperationRecorder(recorder, index);
+            };
+        }
 
         m_internalHashTables.emplace_back(std::move(internalHashTable));
         m_hashTables.emplace_back(std::move(hashTable));
+        m_epochDomainIndices.emplace_back(epochDomainIndex);
+        m_isSynchronized.emplace_back(isSynchronized);
+        m_setOperationRecorders.emplace_back(std::move(setOperationRecorder));
 
         const auto newIndex = m_hashTables.size() - 1;
 
@@ -84,9 +200,29 @@ public:
     }
 
     IWritableHashTable& GetHashTable(const char* name)
+    {
+        return GetHashTable(GetIndex(name));
+    }
+
+    std::size_t GetIndex(const char* name) const
     {
         assert(m_hashTableNameToIndex.find(name) != m_hashTableNameToIndex.cend());
-        return GetHashTable(m_hashTableNameToIndex.find(name)->second);
+        return m_hashTableNameToIndex.find(name)->second;
+    }
+
+    // Returns the index of the epoch domain that the hash table belongs to.
+    std::size_t GetEpochDomainIndex(std::size_t index) const
+    {
+        assert(index < m_epochDomainIndices.size());
+        return m_epochDomainIndices[index];
+    }
+
+    // Returns false if the hash table has the single-threaded policy, in which case
+    // it should not be accessed by any thread other than the one owning it.
+    bool IsSynchronized(std::size_t index) const
+    {
+        assert(index < m_isSynchronized.size());
+        return m_isSynchronized[index];
     }
 
     IWritableHashTable& GetHashTable(std::size_t index)
@@ -95,11 +231,48 @@ public:
         return *m_hashTables[index];
     }
 
+    std::size_t GetNumHashTables() const
+    {
+        return m_hashTables.size();
+    }
+
+    // Returns the hash table names in the order of their indices.
+    std::vector<std::string> GetHashTableNames() const
+    {
+        std::vector<std::string> names(m_hashTables.size());
+        for (const auto& nameToIndex : m_hashTableNameToIndex)
+        {
+            names[nameToIndex.second] = nameToIndex.first;
+        }
+
+        return names;
+    }
+
+    // Records the operations on all the hash tables except the hybrid log ones with the given
+    // recorder (nullptr to stop), where the hash table index is recorded as the table.
+    void SetOperationRecorder(OperationRecorder* recorder)
+    {
+        for (std::size_t i = 0U; i < m_setOperationRecorders.size(); ++i)
+        {
+            if (m_setOperationRecorders[i])
+            {
+                m_setOperationRecorders[i](recorder, static_cast<std::uint16_t>(i));
+            }
+        }
+    }
+
 private:
+    using SetOperationRecorderFunc = std::function<void(OperationRecorder*, std::uint16_t)>;
+
     Utils::StdStringKeyMap<std::size_t> m_hashTableNameToIndex;
 
     std::vector<boost::any> m_internalHashTables;
     std::vector<std::unique_ptr<IWritableHashTable>> m_hashTables;
+    std::vector<std::size_t> m_epochDomainIndices;
+    std::vector<bool> m_isSynchronized;
+    std::vector<SetOperationRecorderFunc> m_setOperationRecorders;
+
+    ImmediateEpochActionManager m_immediateEpochActionManager;
 };
 
 } // namespace LocalMemory
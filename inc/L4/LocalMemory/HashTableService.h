@@ -1,8 +1,14 @@
 #pragma once
 
+#include <memory>
+#include <vector>
 #include "Context.h"
-#include "EpochManager.h"
+#include "EpochDomains.h"
+#include "MemoryGovernor.h"
+#include "SelfTuner.h"
+#include "HashTable/Common/ConcurrencyPolicy.h"
 #include "HashTable/Config.h"
+#include "Log/OperationRecorder.h"
 #include "Log/PerfCounter.h"
 
 namespace L4
@@ -15,32 +21,132 @@ class HashTableService
 public:
     explicit HashTableService(
         const EpochManagerConfig& epochManagerConfig = EpochManagerConfig())
-        : m_epochManager{ epochManagerConfig, m_serverPerfData }
+        : m_epochDomains{ epochManagerConfig }
     {}
 
+    // The hash table is added to the epoch domain given by HashTableConfig::m_epochDomain,
+    // which is created with the EpochManagerConfig of this service if it doesn't exist.
     template <typename Allocator = std::allocator<void>>
     std::size_t AddHashTable(
         const HashTableConfig& config,
         Allocator allocator = Allocator())
     {
-        return m_hashTableManager.Add(config, m_epochManager, allocator);
+        const auto epochDomainIndex = m_epochDomains.GetOrAdd(config.m_epochDomain);
+
+        return m_hashTableManager.Add(
+            config,
+            m_epochDomains.GetEpochManager(epochDomainIndex),
+            allocator,
+            epochDomainIndex);
+    }
+
+    // Adds a hash table with HashTable::SingleThreadedPolicy, which skips the bucket locks,
+    // the atomic perf counter updates and the deferred memory release. The hash table should be
+    // accessed by one thread at a time, and a value from Get() is valid until the next update.
+    std::size_t AddSingleThreadedHashTable(const HashTableConfig& config)
+    {
+        return AddHashTable(config, HashTable::SingleThreadedAllocator<std::allocator<void>>());
+    }
+
+    // Starts a memory governor that shares the given budget among the cache hash tables
+    // added so far (see MemoryGovernor), replacing their configured max cache sizes.
+    // The single-threaded hash tables are not governed.
+    MemoryGovernor& EnableMemoryGovernor(const MemoryGovernorConfig& config)
+    {
+        if (m_memoryGovernor)
+        {
+            throw RuntimeException("Memory governor is already enabled.");
+        }
+
+        std::vector<MemoryGovernor::Table> tables;
+
+        for (std::size_t i = 0U; i < m_hashTableManager.GetNumHashTables(); ++i)
+        {
+            // The governor resizes the caches on its own thread.
+            if (!m_hashTableManager.IsSynchronized(i))
+            {
+                continue;
+            }
+
+            auto& hashTable = m_hashTableManager.GetHashTable(i);
+
+            if (auto* cacheHashTable = dynamic_cast<ICacheHashTable*>(&hashTable))
+            {
+                tables.push_back(MemoryGovernor::Table{ &hashTable, cacheHashTable });
+            }
+        }
+
+        m_memoryGovernor = std::make_unique<MemoryGovernor>(config, std::move(tables));
+
+        return *m_memoryGovernor;
+    }
+
+    // Starts recording the operations on the hash tables added so far into a trace file
+    // (see OperationRecorder). The hybrid log hash tables are not recorded. The recording
+    // stops when the service is destroyed.
+    OperationRecorder& EnableOperationRecorder(const OperationRecorderConfig& config)
+    {
+        if (m_operationRecorder)
+        {
+            throw RuntimeException("Operation recorder is already enabled.");
+        }
+
+        m_operationRecorder = std::make_unique<OperationRecorder>(config, m_hashTableManager.GetHashTableNames());
+        m_hashTableManager.SetOperationRecorder(m_operationRecorder.get());
+
+        return *m_operationRecorder;
+    }
+
+    // Starts a self-tuner that adjusts the tunables of the epoch domains added so far
+    // (see SelfTuner), logging each change to the given logger, which should outlive the service.
+    SelfTuner& EnableSelfTuner(const SelfTunerConfig& config, IPerfLogger& perfLogger)
+    {
+        if (m_selfTuner)
+        {
+            throw RuntimeException("Self-tuner is already enabled.");
+        }
+
+        std::vector<SelfTuner::Domain> domains;
+
+        for (std::size_t i = 0U; i < m_epochDomains.GetNumDomains(); ++i)
+        {
+            domains.push_back(
+                SelfTuner::Domain{
+                    m_epochDomains.GetDomainName(i),
+                    &m_epochDomains.GetEpochManager(i),
+                    &m_epochDomains.GetPerfData(i) });
+        }
+
+        m_selfTuner = std::make_unique<SelfTuner>(config, std::move(domains), perfLogger);
+
+        return *m_selfTuner;
     }
 
     Context GetContext()
     {
-        return Context(m_hashTableManager, m_epochManager.GetEpochRefManager());
+        return Context(m_hashTableManager, m_epochDomains);
+    }
+
+    const ServerPerfData& GetServerPerfData(const std::string& epochDomain = EpochDomains::c_defaultDomainName) const
+    {
+        return m_epochDomains.GetPerfData(epochDomain);
     }
 
 private:
-    ServerPerfData m_serverPerfData;
+    // Declared first so that the recorder outlives the hash tables recording into it.
+    std::unique_ptr<OperationRecorder> m_operationRecorder;
 
     HashTableManager m_hashTableManager;
 
     // Make sure HashTableManager is destroyed before EpochManager b/c
     // it is possible that EpochManager could be processing Epoch Actions
     // on hash tables.
-    EpochManager m_epochManager;
+    EpochDomains m_epochDomains;
+
+    // Declared last so that the governor and the tuner stop before the hash tables are destroyed.
+    std::unique_ptr<MemoryGovernor> m_memoryGovernor;
+    std::unique_ptr<SelfTuner> m_selfTuner;
 };
 
 } // namespace LocalMemory
-} // namespace L4
\ No newline at end of file
+} // namespace L4
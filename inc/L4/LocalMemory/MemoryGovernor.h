@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "HashTable/IHashTable.h"
+#include "Log/PerfCounter.h"
+#include "Utils/Exception.h"
+#include "Utils/RunningThread.h"
+
+namespace L4
+{
+namespace LocalMemory
+{
+
+// MemoryGovernorConfig struct.
+struct MemoryGovernorConfig
+{
+    // If "rebalanceInterval" is zero, the budget is rebalanced only by MemoryGovernor::Rebalance().
+    explicit MemoryGovernorConfig(
+        std::uint64_t totalCacheSizeInBytes,
+        std::chrono::milliseconds rebalanceInterval = std::chrono::milliseconds{ 1000U },
+        double stepRatio = 0.05,
+        double minRatio = 0.05)
+        : m_totalCacheSizeInBytes{ totalCacheSizeInBytes }
+        , m_rebalanceInterval{ rebalanceInterval }
+        , m_stepRatio{ stepRatio }
+        , m_minRatio{ minRatio }
+    {}
+
+    std::uint64_t m_totalCacheSizeInBytes;
+    std::chrono::milliseconds m_rebalanceInterval;
+
+    // The ratio of the total budget moved from one hash table to another per rebalance.
+    double m_stepRatio;
+
+    // The ratio of the total budget that each hash table keeps at least.
+    double m_minRatio;
+};
+
+
+// MemoryGovernor class shares a total budget among cache hash tables. The budget is first
+// split in proportion to the configured max cache sizes, and then a step of the budget is
+// moved periodically from the hash table with the lowest marginal utility to the one with
+// the highest. The marginal utility is estimated as the ghost hits (the misses on the keys
+// evicted recently, see ICacheHashTable::EnableGhostTracking()) since the last rebalance
+// per byte of an average record, i.e., the hits that a record's worth of memory would gain.
+// Shrinking a hash table evicts its records over the new size right away.
+class MemoryGovernor
+{
+public:
+    // Table struct references a governed cache hash table.
+    struct Table
+    {
+        const IReadOnlyHashTable* m_readOnlyHashTable;
+        ICacheHashTable* m_cacheHashTable;
+    };
+
+    MemoryGovernor(const MemoryGovernorConfig& config, std::vector<Table> tables)
+        : m_config{ config }
+    {
+        if (tables.empty())
+        {
+            throw RuntimeException("There is no cache hash table to govern.");
+        }
+
+        std::uint64_t totalConfiguredSize = 0U;
+        for (const auto& table : tables)
+        {
+            totalConfiguredSize += table.m_cacheHashTable->GetMaxCacheSizeInBytes();
+        }
+
+        for (const auto& table : tables)
+        {
+            const auto share = (totalConfiguredSize != 0U)
+                ? static_cast<double>(table.m_cacheHashTable->GetMaxCacheSizeInBytes()) / totalConfiguredSize
+                : 1.0 / tables.size();
+
+            table.m_cacheHashTable->EnableGhostTracking();
+            table.m_cacheHashTable->SetMaxCacheSizeInBytes(
+                static_cast<std::uint64_t>(share * m_config.m_totalCacheSizeInBytes));
+
+            m_tables.push_back(
+                TableState{
+                    table,
+                    table.m_readOnlyHashTable->GetPerfData().Get(HashTablePerfCounter::GhostHitCount) });
+        }
+
+        if (m_config.m_rebalanceInterval.count() != 0)
+        {
+            m_rebalanceThread = std::make_unique<RebalanceThread>(
+                m_config.m_rebalanceInterval,
+                [this]()
+                {
+                    Rebalance();
+                });
+        }
+    }
+
+    // Moves a step of the budget between two hash tables if their marginal utilities differ.
+    // Returns true if the budget is moved.
+    bool Rebalance()
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+
+        TableState* donor = nullptr;
+        TableState* receiver = nullptr;
+
+        const auto minSize = static_cast<std::uint64_t>(m_config.m_minRatio * m_config.m_totalCacheSizeInBytes);
+
+        for (auto& table : m_tables)
+        {
+            const auto& perfData = table.m_table.m_readOnlyHashTable->GetPerfData();
+
+            const auto ghostHitCount = perfData.Get(HashTablePerfCounter::GhostHitCount);
+            table.m_utility = GetMarginalUtility(perfData, ghostHitCount - table.m_lastGhostHitCount);
+            table.m_lastGhostHitCount = ghostHitCount;
+
+            if (table.m_table.m_cacheHashTable->GetMaxCacheSizeInBytes() > minSize
+                && (donor == nullptr || table.m_utility < donor->m_utility))
+            {
+                donor = &table;
+            }
+
+            if (receiver == nullptr || table.m_utility > receiver->m_utility)
+            {
+                receiver = &table;
+            }
+        }
+
+        if (donor == nullptr || donor == receiver || !(receiver->m_utility > donor->m_utility))
+        {
+            return false;
+        }
+
+        auto* donorTable = donor->m_table.m_cacheHashTable;
+        auto* receiverTable = receiver->m_table.m_cacheHashTable;
+
+        const auto donorSize = donorTable->GetMaxCacheSizeInBytes();
+        const auto step = (std::min)(
+            static_cast<std::uint64_t>(m_config.m_stepRatio * m_config.m_totalCacheSizeInBytes),
+            donorSize - minSize);
+
+        // The donor shrinks first so that the total stays within the budget.
+        donorTable->SetMaxCacheSizeInBytes(donorSize - step);
+        receiverTable->SetMaxCacheSizeInBytes(receiverTable->GetMaxCacheSizeInBytes() + step);
+
+        return true;
+    }
+
+    MemoryGovernor(const MemoryGovernor&) = delete;
+    MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+private:
+    using RebalanceThread = Utils::RunningThread<std::function<void()>>;
+
+    struct TableState
+    {
+        Table m_table;
+        HashTablePerfData::TValue m_lastGhostHitCount;
+        double m_utility = 0.0;
+    };
+
+    static double GetMarginalUtility(const HashTablePerfData& perfData, HashTablePerfData::TValue numGhostHits)
+    {
+        const auto recordsCount = perfData.Get(HashTablePerfCounter::RecordsCount);
+        if (numGhostHits <= 0 || recordsCount <= 0)
+        {
+            return 0.0;
+        }
+
+        const auto totalSize =
+            perfData.Get(HashTablePerfCounter::TotalKeySize)
+            + perfData.Get(HashTablePerfCounter::TotalValueSize)
+            + perfData.Get(HashTablePerfCounter::TotalIndexSize);
+
+        return static_cast<double>(numGhostHits) * recordsCount / (std::max)(totalSize, HashTablePerfData::TValue{ 1 });
+    }
+
+    const MemoryGovernorConfig m_config;
+
+    std::mutex m_mutex;
+    std::vector<TableState> m_tables;
+
+    // Declared last so that the thread stops before the other members are destroyed.
+    std::unique_ptr<RebalanceThread> m_rebalanceThread;
+};
+
+} // namespace LocalMemory
+} // namespace L4
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cassert>
+#include "Epoch/EpochRefPolicy.h"
+#include "EpochManager.h"
+#include "HashTable/IHashTable.h"
+
+namespace L4
+{
+namespace LocalMemory
+{
+
+// PinnedValue class is a move-only handle to a value returned by Context::GetPinned().
+// It holds its own reference to the epoch in which the value was looked up, so that
+// the record (and any record released after it in the same epoch domain) is not freed
+// until the handle is destroyed, even after the Context is gone. Thus the value can be
+// written out directly from the hash table memory without copying.
+// Note that a handle delays the memory reclamation of its whole epoch domain, so it should
+// be short-lived, and it should not outlive the HashTableService.
+class PinnedValue
+{
+public:
+    using Value = IReadOnlyHashTable::Value;
+    using TheEpochRefPolicy = EpochRefPolicy<EpochManager::TheEpochRefManager>;
+
+    // Constructs an empty handle.
+    PinnedValue() = default;
+
+    PinnedValue(const Value& value, TheEpochRefPolicy&& epochRefPolicy)
+        : m_value{ value }
+    {
+        m_epochRefPolicy.emplace(std::move(epochRefPolicy));
+    }
+
+    PinnedValue(PinnedValue&& other)
+        : m_value{ other.m_value }
+    {
+        MoveEpochRef(other);
+    }
+
+    PinnedValue& operator=(PinnedValue&& other)
+    {
+        if (this != &other)
+        {
+            m_value = other.m_value;
+            MoveEpochRef(other);
+        }
+
+        return *this;
+    }
+
+    // Returns true if the handle holds a value.
+    explicit operator bool() const
+    {
+        return m_epochRefPolicy.is_initialized();
+    }
+
+    const Value& Get() const
+    {
+        assert(*this);
+        return m_value;
+    }
+
+    const Value& operator*() const
+    {
+        return Get();
+    }
+
+    const Value* operator->() const
+    {
+        return &Get();
+    }
+
+    // Releases the epoch reference, after which the value should not be accessed.
+    void Reset()
+    {
+        m_value = Value{};
+        m_epochRefPolicy.reset();
+    }
+
+    PinnedValue(const PinnedValue&) = delete;
+    PinnedValue& operator=(const PinnedValue&) = delete;
+
+private:
+    // EpochRefPolicy is not assignable, thus the reference is moved by reconstructing it.
+    void MoveEpochRef(PinnedValue& other)
+    {
+        m_epochRefPolicy.reset();
+
+        if (other.m_epochRefPolicy)
+        {
+            m_epochRefPolicy.emplace(std::move(*other.m_epochRefPolicy));
+            other.m_epochRefPolicy.reset();
+        }
+
+        other.m_value = Value{};
+    }
+
+    Value m_value;
+
+    boost::optional<TheEpochRefPolicy> m_epochRefPolicy;
+};
+
+} // namespace LocalMemory
+} // namespace L4
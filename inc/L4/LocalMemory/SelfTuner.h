@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "EpochManager.h"
+#include "Log/IPerfLogger.h"
+#include "Log/PerfCounter.h"
+#include "Utils/Exception.h"
+#include "Utils/RunningThread.h"
+
+namespace L4
+{
+namespace LocalMemory
+{
+
+// SelfTunerConfig struct.
+struct SelfTunerConfig
+{
+    // If "tuningInterval" is zero, the tunables are adjusted only by SelfTuner::Tune().
+    explicit SelfTunerConfig(
+        std::chrono::milliseconds tuningInterval = std::chrono::milliseconds{ 1000U },
+        std::chrono::milliseconds minEpochProcessingInterval = std::chrono::milliseconds{ 10U },
+        std::chrono::milliseconds maxEpochProcessingInterval = std::chrono::milliseconds{ 1000U },
+        std::uint64_t maxPendingActions = 10000U,
+        std::uint64_t maxReclamationLag = 2U,
+        std::uint64_t maxContentionsPerTuning = 100U)
+        : m_tuningInterval{ tuningInterval }
+        , m_minEpochProcessingInterval{ minEpochProcessingInterval }
+        , m_maxEpochProcessingInterval{ maxEpochProcessingInterval }
+        , m_maxPendingActions{ maxPendingActions }
+        , m_maxReclamationLag{ maxReclamationLag }
+        , m_maxContentionsPerTuning{ maxContentionsPerTuning }
+    {}
+
+    std::chrono::milliseconds m_tuningInterval;
+
+    // The bounds of EpochManagerConfig::m_epochProcessingInterval.
+    std::chrono::milliseconds m_minEpochProcessingInterval;
+    std::chrono::milliseconds m_maxEpochProcessingInterval;
+
+    // The epochs are processed more often while more actions than this are pending.
+    std::uint64_t m_maxPendingActions;
+
+    // The number of epochs between the oldest and the latest in the queue, over which
+    // the pending actions are held by the readers rather than by the processing interval.
+    std::uint64_t m_maxReclamationLag;
+
+    // More action queues are used while more registrations than this wait for a queue per tuning.
+    std::uint64_t m_maxContentionsPerTuning;
+};
+
+
+// SelfTuner class periodically observes the server perf counters of the epoch domains and
+// adjusts the tunables that can change while the hash tables are accessed:
+// 1. The epoch processing interval is halved while the pending actions exceed the max and
+//    the reclamation lag is small, i.e., the memory is held by the interval rather than by
+//    the readers, and doubled while the pending actions are under a quarter of the max.
+// 2. The number of action queues in use is doubled while the registrations contend for the
+//    queues, up to EpochManagerConfig::m_maxNumActionQueues.
+// Each change is logged by IPerfLogger::LogTuningDecision(). Note that the lock stripes
+// (HashTableConfig::Setting::m_numBucketsPerMutex) are fixed when the hash table is created.
+class SelfTuner
+{
+public:
+    // Domain struct references a tuned epoch domain.
+    struct Domain
+    {
+        std::string m_name;
+        EpochManager* m_epochManager;
+        const ServerPerfData* m_perfData;
+    };
+
+    SelfTuner(
+        const SelfTunerConfig& config,
+        std::vector<Domain> domains,
+        IPerfLogger& perfLogger)
+        : m_config{ config }
+        , m_perfLogger{ perfLogger }
+    {
+        if (m_config.m_minEpochProcessingInterval.count() <= 0
+            || m_config.m_minEpochProcessingInterval > m_config.m_maxEpochProcessingInterval)
+        {
+            throw RuntimeException("Epoch processing interval bounds of the self-tuner are invalid.");
+        }
+
+        for (auto& domain : domains)
+        {
+            const auto contentionCount = domain.m_perfData->Get(ServerPerfCounter::ActionQueueContentionCount);
+            m_domains.push_back(DomainState{ std::move(domain), contentionCount });
+        }
+
+        if (m_config.m_tuningInterval.count() != 0)
+        {
+            m_tuningThread = std::make_unique<TuningThread>(
+                m_config.m_tuningInterval,
+                [this]()
+                {
+                    Tune();
+                });
+        }
+    }
+
+    // Adjusts the tunables once and returns the number of changes made.
+    std::uint32_t Tune()
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+
+        std::uint32_t numDecisions = 0U;
+
+        for (auto& domain : m_domains)
+        {
+            numDecisions += TuneEpochProcessingInterval(domain) ? 1U : 0U;
+            numDecisions += TuneNumActionQueues(domain) ? 1U : 0U;
+        }
+
+        return numDecisions;
+    }
+
+    SelfTuner(const SelfTuner&) = delete;
+    SelfTuner& operator=(const SelfTuner&) = delete;
+
+private:
+    using TuningThread = Utils::RunningThread<std::function<void()>>;
+
+    struct DomainState
+    {
+        Domain m_domain;
+        ServerPerfData::TValue m_lastContentionCount;
+    };
+
+    bool TuneEpochProcessingInterval(DomainState& state)
+    {
+        const auto& perfData = *state.m_domain.m_perfData;
+        auto& epochManager = *state.m_domain.m_epochManager;
+
+        const auto numPendingActions = static_cast<std::uint64_t>(
+            (std::max)(perfData.Get(ServerPerfCounter::PendingActionsCount), ServerPerfData::TValue{ 0 }));
+        const auto reclamationLag = static_cast<std::uint64_t>(
+            (std::max)(
+                perfData.Get(ServerPerfCounter::LatestEpochCounterInQueue)
+                    - perfData.Get(ServerPerfCounter::OldestEpochCounterInQueue),
+                ServerPerfData::TValue{ 0 }));
+
+        const auto interval = epochManager.GetEpochProcessingInterval();
+        auto newInterval = interval;
+        std::string reason;
+
+        if (numPendingActions > m_config.m_maxPendingActions
+            && reclamationLag <= m_config.m_maxReclamationLag)
+        {
+            newInterval = (std::max)(interval / 2, m_config.m_minEpochProcessingInterval);
+            reason = std::to_string(numPendingActions) + " pending actions exceed "
+                + std::to_string(m_config.m_maxPendingActions) + " with reclamation lag of "
+                + std::to_string(reclamationLag) + " epochs.";
+        }
+        else if (numPendingActions <= m_config.m_maxPendingActions / 4U)
+        {
+            newInterval = (std::min)(interval * 2, m_config.m_maxEpochProcessingInterval);
+            reason = std::to_string(numPendingActions) + " pending actions are under a quarter of "
+                + std::to_string(m_config.m_maxPendingActions) + ".";
+        }
+
+        if (newInterval == interval)
+        {
+            return false;
+        }
+
+        epochManager.SetEpochProcessingInterval(newInterval);
+        Log(state, "EpochProcessingIntervalInMilliseconds", interval.count(), newInterval.count(), reason);
+
+        return true;
+    }
+
+    bool TuneNumActionQueues(DomainState& state)
+    {
+        auto& actionManager = state.m_domain.m_epochManager->GetEpochActionManager();
+
+        const auto contentionCount = state.m_domain.m_perfData->Get(ServerPerfCounter::ActionQueueContentionCount);
+        const auto numContentions = static_cast<std::uint64_t>(contentionCount - state.m_lastContentionCount);
+        state.m_lastContentionCount = contentionCount;
+
+        const auto numActionQueues = actionManager.GetNumActionQueues();
+
+        if (numContentions <= m_config.m_maxContentionsPerTuning
+            || numActionQueues == actionManager.GetMaxNumActionQueues())
+        {
+            return false;
+        }
+
+        actionManager.SetNumActionQueues(numActionQueues * 2U);
+        Log(
+            state,
+            "NumActionQueues",
+            numActionQueues,
+            actionManager.GetNumActionQueues(),
+            std::to_string(numContentions) + " action registrations waited for a queue, exceeding "
+                + std::to_string(m_config.m_maxContentionsPerTuning) + ".");
+
+        return true;
+    }
+
+    void Log(
+        const DomainState& state,
+        const char* tunable,
+        std::int64_t oldValue,
+        std::int64_t newValue,
+        std::string reason)
+    {
+        m_perfLogger.LogTuningDecision(
+            TuningDecision{ state.m_domain.m_name, tunable, oldValue, newValue, std::move(reason) });
+    }
+
+    const SelfTunerConfig m_config;
+
+    IPerfLogger& m_perfLogger;
+
+    std::mutex m_mutex;
+    std::vector<DomainState> m_domains;
+
+    // Declared last so that the thread stops before the other members are destroyed.
+    std::unique_ptr<TuningThread> m_tuningThread;
+};
+
+} // namespace LocalMemory
+} // namespace L4
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
+#include <string>
 #include "PerfCounter.h"
 
 
@@ -8,6 +10,21 @@ namespace L4
 {
 
 
+// TuningDecision struct describes a change of a tunable made at runtime (see LocalMemory::SelfTuner).
+struct TuningDecision
+{
+    // What the tunable belongs to, e.g., the name of an epoch domain.
+    std::string m_scope;
+
+    const char* m_tunable;
+    std::int64_t m_oldValue;
+    std::int64_t m_newValue;
+
+    // The observation that led to the change.
+    std::string m_reason;
+};
+
+
 // IPerfLogger interface.
 struct IPerfLogger
 {
@@ -16,6 +33,10 @@ struct IPerfLogger
     virtual ~IPerfLogger() = default;
 
     virtual void Log(const IData& data) = 0;
+
+    // Logs a change made by the self-tuner so that the changes can be audited.
+    // The default implementation ignores it.
+    virtual void LogTuningDecision(const TuningDecision& /* decision */) {}
 };
 
 // IPerfLogger::IData interface that provides access to ServerPerfData and the aggregated HashTablePerfData.
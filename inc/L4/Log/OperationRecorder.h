@@ -0,0 +1,438 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HashTable/IHashTable.h"
+#include "Utils/Exception.h"
+#include "Utils/RunningThread.h"
+
+namespace L4
+{
+
+enum class OperationType : std::uint8_t
+{
+    Get,
+    Add,
+    ConditionalAdd,
+    Remove
+};
+
+
+// OperationRecord struct is the fixed-size part of a record in an operation trace.
+// It is followed by m_keySize bytes of the key if c_hasKey is set in m_flags.
+struct OperationRecord
+{
+    // Set if Get() or Remove() found the key, or if the conditional write was performed.
+    static constexpr std::uint8_t c_succeeded = 1U;
+
+    // Set if the key bytes follow the record.
+    static constexpr std::uint8_t c_hasKey = 2U;
+
+    // Nanoseconds since the recorder was started.
+    std::uint64_t m_timestamp = 0U;
+
+    // The first half of the 128-bit Murmur hash of the key.
+    std::uint64_t m_keyHash = 0U;
+
+    std::uint32_t m_valueSize = 0U;
+    std::uint32_t m_threadIndex = 0U;
+    std::uint16_t m_hashTableIndex = 0U;
+    std::uint16_t m_keySize = 0U;
+    OperationType m_type = OperationType::Get;
+    std::uint8_t m_flags = 0U;
+
+    // Makes the padding explicit so that no uninitialized byte is written out.
+    std::uint16_t m_reserved = 0U;
+};
+
+static_assert(sizeof(OperationRecord) == 32U, "OperationRecord should have no implicit padding.");
+
+
+// OperationRecorderConfig struct.
+struct OperationRecorderConfig
+{
+    // If "flushInterval" is zero, the records are written only by OperationRecorder::Flush().
+    explicit OperationRecorderConfig(
+        std::string filePath,
+        std::uint32_t samplingRate = 1U,
+        bool recordKeys = false,
+        std::chrono::milliseconds flushInterval = std::chrono::milliseconds{ 100U },
+        std::uint32_t bufferSizePerThread = 1U << 20)
+        : m_filePath{ std::move(filePath) }
+        , m_samplingRate{ samplingRate }
+        , m_recordKeys{ recordKeys }
+        , m_flushInterval{ flushInterval }
+        , m_bufferSizePerThread{ bufferSizePerThread }
+    {}
+
+    std::string m_filePath;
+
+    // One in every "samplingRate" keys is recorded. The keys are chosen by their hash, so that
+    // all the operations on a sampled key are recorded; 1 records every operation.
+    std::uint32_t m_samplingRate;
+
+    // If false, only the key hashes are recorded.
+    bool m_recordKeys;
+
+    std::chrono::milliseconds m_flushInterval;
+
+    std::uint32_t m_bufferSizePerThread;
+};
+
+
+// OperationRecorder class captures the operations on the hash tables into a trace file
+// for offline replay. Each thread writes its records lock-free into its own ring buffer,
+// and a background thread periodically appends the buffered records to the file. If a buffer
+// is full, the record is dropped rather than blocking the caller (see GetNumDroppedRecords()).
+// The file starts with c_magic and the hash table names (each prefixed by its 16-bit size),
+// followed by the records (see OperationRecord) in the native byte order. The records of
+// each thread are in order, but the records of different threads are interleaved by flush,
+// thus a replay should order them by m_timestamp.
+class OperationRecorder
+{
+public:
+    // Identifies the format of the trace file, which is to be bumped on any change.
+    static constexpr std::uint64_t c_magic = 0x4C344F5053303031ULL;
+
+    OperationRecorder(
+        const OperationRecorderConfig& config,
+        const std::vector<std::string>& hashTableNames)
+        : m_config{ config }
+        , m_id{ GetNewId() }
+        , m_startTime{ std::chrono::steady_clock::now() }
+    {
+        if (m_config.m_samplingRate == 0U)
+        {
+            throw RuntimeException("Sampling rate of the operation recorder should be positive.");
+        }
+
+        if (m_config.m_bufferSizePerThread < sizeof(OperationRecord) + (std::numeric_limits<std::uint16_t>::max)())
+        {
+            throw RuntimeException("Buffer of the operation recorder is too small to hold a record.");
+        }
+
+        m_file.open(m_config.m_filePath, std::ios::binary | std::ios::trunc);
+        if (!m_file)
+        {
+            throw RuntimeException("Failed to open the operation trace file.");
+        }
+
+        const auto magic = c_magic;
+        m_file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+        WriteSize(static_cast<std::uint16_t>(hashTableNames.size()));
+
+        for (const auto& name : hashTableNames)
+        {
+            WriteSize(static_cast<std::uint16_t>(name.size()));
+            m_file.write(name.data(), name.size());
+        }
+
+        if (m_config.m_flushInterval.count() != 0)
+        {
+            m_flushThread = std::make_unique<FlushThread>(
+                m_config.m_flushInterval,
+                [this]()
+                {
+                    Flush();
+                });
+        }
+    }
+
+    ~OperationRecorder()
+    {
+        m_flushThread.reset();
+        Flush();
+    }
+
+    // 128-bit MurmurHash3 of the key with seed 0, which the hash tables already compute
+    // for the look up, so recording an operation doesn't hash the key again.
+    using KeyHash = std::array<std::uint64_t, 2>;
+
+    // The key is sampled before anything else, so an operation on a key that is not sampled
+    // costs only a modulo.
+    void Record(
+        OperationType type,
+        std::uint16_t hashTableIndex,
+        const IReadOnlyHashTable::Key& key,
+        const KeyHash& hash,
+        std::uint32_t valueSize,
+        bool succeeded)
+    {
+        // The second half is used so that the sampling is independent of the bucket index.
+        if (m_config.m_samplingRate != 1U && hash[1] % m_config.m_samplingRate != 0U)
+        {
+            return;
+        }
+
+        auto& buffer = GetThreadBuffer();
+
+        OperationRecord record;
+        record.m_timestamp = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_startTime).count());
+        record.m_keyHash = hash[0];
+        record.m_valueSize = valueSize;
+        record.m_threadIndex = buffer.GetThreadIndex();
+        record.m_hashTableIndex = hashTableIndex;
+        record.m_keySize = key.m_size;
+        record.m_type = type;
+        record.m_flags = static_cast<std::uint8_t>(
+            (succeeded ? OperationRecord::c_succeeded : 0U)
+            | (m_config.m_recordKeys ? OperationRecord::c_hasKey : 0U));
+
+        if (!buffer.TryWrite(record, m_config.m_recordKeys ? key.m_data : nullptr))
+        {
+            m_numDroppedRecords.fetch_add(1U, std::memory_order_relaxed);
+        }
+    }
+
+    // Appends the buffered records to the trace file.
+    void Flush()
+    {
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock{ m_threadBuffersMutex };
+            for (const auto& buffer : m_threadBuffers)
+            {
+                buffers.push_back(buffer.second.get());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{ m_fileMutex };
+
+        for (auto* buffer : buffers)
+        {
+            buffer->Drain(m_file);
+        }
+
+        m_file.flush();
+    }
+
+    std::uint64_t GetNumDroppedRecords() const
+    {
+        return m_numDroppedRecords.load(std::memory_order_relaxed);
+    }
+
+    OperationRecorder(const OperationRecorder&) = delete;
+    OperationRecorder& operator=(const OperationRecorder&) = delete;
+
+private:
+    using FlushThread = Utils::RunningThread<std::function<void()>>;
+
+    // ThreadBuffer class is a single-producer single-consumer ring buffer of the records,
+    // where the producer is the owning thread and the consumer is Flush().
+    class ThreadBuffer
+    {
+    public:
+        ThreadBuffer(std::uint32_t threadIndex, std::uint32_t size)
+            : m_threadIndex{ threadIndex }
+            , m_buffer(size)
+        {}
+
+        std::uint32_t GetThreadIndex() const
+        {
+            return m_threadIndex;
+        }
+
+        // Returns false if there is not enough space for the record.
+        bool TryWrite(const OperationRecord& record, const std::uint8_t* key)
+        {
+            const auto keySize = (key != nullptr) ? record.m_keySize : 0U;
+            const auto head = m_head.load(std::memory_order_relaxed);
+
+            if (m_buffer.size() - (head - m_tail.load(std::memory_order_acquire)) < sizeof(record) + keySize)
+            {
+                return false;
+            }
+
+            CopyIn(head, reinterpret_cast<const std::uint8_t*>(&record), sizeof(record));
+            CopyIn(head + sizeof(record), key, keySize);
+
+            m_head.store(head + sizeof(record) + keySize, std::memory_order_release);
+
+            return true;
+        }
+
+        // Writes out the records that are written so far.
+        void Drain(std::ostream& stream)
+        {
+            const auto tail = m_tail.load(std::memory_order_relaxed);
+            const auto head = m_head.load(std::memory_order_acquire);
+
+            const auto offset = static_cast<std::size_t>(tail % m_buffer.size());
+            const auto size = static_cast<std::size_t>(head - tail);
+            const auto firstSize = (std::min)(size, m_buffer.size() - offset);
+
+            stream.write(reinterpret_cast<const char*>(m_buffer.data() + offset), firstSize);
+            stream.write(reinterpret_cast<const char*>(m_buffer.data()), size - firstSize);
+
+            m_tail.store(head, std::memory_order_release);
+        }
+
+    private:
+        void CopyIn(std::uint64_t position, const std::uint8_t* data, std::size_t size)
+        {
+            const auto offset = static_cast<std::size_t>(position % m_buffer.size());
+            const auto firstSize = (std::min)(size, m_buffer.size() - offset);
+
+            std::memcpy(m_buffer.data() + offset, data, firstSize);
+            std::memcpy(m_buffer.data(), data + firstSize, size - firstSize);
+        }
+
+        const std::uint32_t m_threadIndex;
+
+        std::vector<std::uint8_t> m_buffer;
+
+        // The total bytes written and read, which only increase.
+        std::atomic<std::uint64_t> m_head{ 0U };
+        std::atomic<std::uint64_t> m_tail{ 0U };
+    };
+
+    // Returns a new id that is unique in the process so that a buffer cached by a thread
+    // for a destroyed recorder is never used by another recorder created at the same address.
+    static std::uint64_t GetNewId()
+    {
+        static std::atomic<std::uint64_t> s_lastId{ 0U };
+        return ++s_lastId;
+    }
+
+    ThreadBuffer& GetThreadBuffer()
+    {
+        struct CachedBuffer
+        {
+            std::uint64_t m_recorderId = 0U;
+            ThreadBuffer* m_buffer = nullptr;
+        };
+
+        thread_local CachedBuffer s_cachedBuffer;
+
+        if (s_cachedBuffer.m_recorderId != m_id)
+        {
+            s_cachedBuffer = CachedBuffer{ m_id, &RegisterThread() };
+        }
+
+        return *s_cachedBuffer.m_buffer;
+    }
+
+    ThreadBuffer& RegisterThread()
+    {
+        std::lock_guard<std::mutex> lock{ m_threadBuffersMutex };
+
+        auto& buffer = m_threadBuffers[std::this_thread::get_id()];
+        if (!buffer)
+        {
+            buffer = std::make_unique<ThreadBuffer>(
+                static_cast<std::uint32_t>(m_threadBuffers.size() - 1U),
+                m_config.m_bufferSizePerThread);
+        }
+
+        return *buffer;
+    }
+
+    void WriteSize(std::uint16_t size)
+    {
+        m_file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+
+    const OperationRecorderConfig m_config;
+
+    const std::uint64_t m_id;
+
+    const std::chrono::steady_clock::time_point m_startTime;
+
+    std::mutex m_fileMutex;
+    std::ofstream m_file;
+
+    // The buffers are kept until the recorder is destroyed since a thread may exit any time.
+    std::mutex m_threadBuffersMutex;
+    std::map<std::thread::id, std::unique_ptr<ThreadBuffer>> m_threadBuffers;
+
+    std::atomic<std::uint64_t> m_numDroppedRecords{ 0U };
+
+    // Declared last so that the thread stops before the other members are destroyed.
+    std::unique_ptr<FlushThread> m_flushThread;
+};
+
+
+// OperationTraceReader class reads a trace file written by OperationRecorder.
+class OperationTraceReader
+{
+public:
+    explicit OperationTraceReader(std::istream& stream)
+        : m_stream{ stream }
+    {
+        std::uint64_t magic = 0U;
+        if (!m_stream.read(reinterpret_cast<char*>(&magic), sizeof(magic))
+            || magic != OperationRecorder::c_magic)
+        {
+            throw RuntimeException("Invalid operation trace.");
+        }
+
+        const auto numHashTables = ReadSize();
+        for (std::uint16_t i = 0U; i < numHashTables; ++i)
+        {
+            std::string name(ReadSize(), '\0');
+            m_stream.read(&name[0], name.size());
+            m_hashTableNames.emplace_back(std::move(name));
+        }
+
+        if (!m_stream)
+        {
+            throw RuntimeException("Invalid operation trace.");
+        }
+    }
+
+    // The index of a name is OperationRecord::m_hashTableIndex.
+    const std::vector<std::string>& GetHashTableNames() const
+    {
+        return m_hashTableNames;
+    }
+
+    // Reads the next record and its key, which is empty if the key is not recorded.
+    // Returns false at the end of the trace.
+    bool Read(OperationRecord& record, std::string& key)
+    {
+        if (!m_stream.read(reinterpret_cast<char*>(&record), sizeof(record)))
+        {
+            return false;
+        }
+
+        key.assign((record.m_flags & OperationRecord::c_hasKey) ? record.m_keySize : 0U, '\0');
+        if (!key.empty() && !m_stream.read(&key[0], key.size()))
+        {
+            throw RuntimeException("Invalid operation trace.");
+        }
+
+        return true;
+    }
+
+    OperationTraceReader(const OperationTraceReader&) = delete;
+    OperationTraceReader& operator=(const OperationTraceReader&) = delete;
+
+private:
+    std::uint16_t ReadSize()
+    {
+        std::uint16_t size = 0U;
+        m_stream.read(reinterpret_cast<char*>(&size), sizeof(size));
+        return size;
+    }
+
+    std::istream& m_stream;
+    std::vector<std::string> m_hashTableNames;
+};
+
+} // namespace L4
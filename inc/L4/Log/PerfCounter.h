@@ -20,6 +20,9 @@ enum class ServerPerfCounter : std::uint16_t
     PendingActionsCount,
     LastPerformedActionsCount,
 
+    // The action registrations that waited for the action queue locked by another thread.
+    ActionQueueContentionCount,
+
     Count
 };
 
@@ -34,7 +37,8 @@ const std::array<
     "OldestEpochCounterInQueue",
     "LatestEpochCounterInQueue",
     "PendingActionsCount",
-    "LastPerformedActionsCount"
+    "LastPerformedActionsCount",
+    "ActionQueueContentionCount"
 };
 
 enum class HashTablePerfCounter : std::uint16_t
@@ -62,6 +66,17 @@ enum class HashTablePerfCounter : std::uint16_t
     CacheMissCount,
     EvictedRecordsCount,
 
+    // The misses on the keys evicted recently, which a larger cache would have hit.
+    // It is counted only when the cache is governed (see LocalMemory::MemoryGovernor).
+    GhostHitCount,
+
+    // Write-back cache specific counters.
+    DirtyBytes,
+    FlushedRecordsCount,
+
+    // The max age of the records in the last batch flushed.
+    FlushLagInSeconds,
+
     Count
 };
 
@@ -84,7 +99,11 @@ const std::array<
     "RecordsCountSavedFromSerializer",
     "CacheHitCount",
     "CacheMissCount",
-    "EvictedRecordsCount"
+    "EvictedRecordsCount",
+    "GhostHitCount",
+    "DirtyBytes",
+    "FlushedRecordsCount",
+    "FlushLagInSeconds"
 };
 
 
@@ -220,4 +239,57 @@ struct HashTablePerfData : public PerfCounters<HashTablePerfCounter>
     }
 };
 
+
+// SingleThreadedPerfCounters updates the counters of TPerfCounters without atomic
+// read-modify-write operations, thus they should be updated by one thread at a time.
+// The update functions hide the ones of TPerfCounters, so the mode is selected at compile
+// time by the static type of the counters, whereas they are read through TPerfCounters.
+template <typename TCounterEnum, typename TPerfCounters = PerfCounters<TCounterEnum>>
+class SingleThreadedPerfCounters : public TPerfCounters
+{
+public:
+    using typename TPerfCounters::TValue;
+
+    void Increment(TCounterEnum counterEnum)
+    {
+        Add(counterEnum, 1);
+    }
+
+    void Decrement(TCounterEnum counterEnum)
+    {
+        Add(counterEnum, -1);
+    }
+
+    void Add(TCounterEnum counterEnum, TValue value)
+    {
+        if (value != 0)
+        {
+            this->Set(counterEnum, this->Get(counterEnum) + value);
+        }
+    }
+
+    void Subtract(TCounterEnum counterEnum, TValue value)
+    {
+        Add(counterEnum, -value);
+    }
+
+    void Max(TCounterEnum counterEnum, TValue value)
+    {
+        if (this->Get(counterEnum) < value)
+        {
+            this->Set(counterEnum, value);
+        }
+    }
+
+    void Min(TCounterEnum counterEnum, TValue value)
+    {
+        if (this->Get(counterEnum) > value)
+        {
+            this->Set(counterEnum, value);
+        }
+    }
+};
+
+typedef SingleThreadedPerfCounters<HashTablePerfCounter, HashTablePerfData> SingleThreadedHashTablePerfData;
+
 } // namespace L4
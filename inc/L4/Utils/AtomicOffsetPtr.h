@@ -24,7 +24,7 @@ class AtomicOffsetPtr
 {
 public:
     AtomicOffsetPtr()
-        : m_offset(1)
+        : m_offset(c_nullOffset)
     {}
 
     AtomicOffsetPtr(const AtomicOffsetPtr&) = delete;
@@ -47,6 +47,56 @@ public:
 #endif
     }
 
+    // Returns the raw offset from this object to the pointee (c_nullOffset for nullptr).
+    // This is used for relocating pointers, e.g., writing a memory image of a hash table.
+    std::uint64_t GetOffset(std::memory_order memoryOrder = std::memory_order_seq_cst) const
+    {
+        return m_offset.load(memoryOrder);
+    }
+
+    // Sets the raw offset from this object to the pointee (c_nullOffset for nullptr).
+    void SetOffset(std::uint64_t offset, std::memory_order memoryOrder = std::memory_order_seq_cst)
+    {
+        m_offset.store(offset, memoryOrder);
+    }
+
+    // Replaces the raw offset with "desired" only if it is "expected"; otherwise, "expected"
+    // is set to the current offset. Together with FetchOrOffset(), this allows a flag to be kept
+    // in a bit of the offset that is always zero for an aligned pointee (e.g., OrderedIndex).
+    bool CompareExchangeOffset(
+        std::uint64_t& expected,
+        std::uint64_t desired,
+        std::memory_order memoryOrder = std::memory_order_seq_cst)
+    {
+        return m_offset.compare_exchange_strong(expected, desired, memoryOrder);
+    }
+
+    // Sets the given bits of the raw offset and returns the previous offset.
+    std::uint64_t FetchOrOffset(std::uint64_t bits, std::memory_order memoryOrder = std::memory_order_seq_cst)
+    {
+        return m_offset.fetch_or(bits, memoryOrder);
+    }
+
+    // Returns the raw offset of the given pointer from this object.
+    std::uint64_t ToOffset(T* ptr) const
+    {
+#if defined(_MSC_VER)
+        return boost::interprocess::ipcdetail::offset_ptr_to_offset(ptr, this);
+#else
+        return boost::interprocess::ipcdetail::offset_ptr_to_offset<std::uintptr_t>(ptr, this);
+#endif
+    }
+
+    // Returns the pointer of the given raw offset from this object.
+    T* ToPointer(std::uint64_t offset) const
+    {
+        return static_cast<T*>(
+            boost::interprocess::ipcdetail::offset_ptr_to_raw_pointer(this, offset));
+    }
+
+    // Offset value that represents nullptr (same as boost::interprocess::offset_ptr).
+    static constexpr std::uint64_t c_nullOffset = 1U;
+
 private:
 #if defined(_MSC_VER)
     std::atomic_uint64_t m_offset;
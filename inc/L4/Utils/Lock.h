@@ -45,6 +45,12 @@ public:
         ::EnterCriticalSection(this);
     }
 
+    // Takes the ownership of the critical section only if it is not owned by another thread.
+    bool try_lock()
+    {
+        return ::TryEnterCriticalSection(this) != FALSE;
+    }
+
     // Releases ownership of the critical section.
     void unlock()
     {
@@ -114,6 +120,11 @@ public:
         pthread_mutex_lock(&m_mutex);
     }
 
+    bool try_lock()
+    {
+        return pthread_mutex_trylock(&m_mutex) == 0;
+    }
+
     void unlock()
     {
         pthread_mutex_unlock(&m_mutex);
@@ -157,5 +168,23 @@ private:
 #endif
 #endif
 
+// NullMutex satisfies the mutex requirements without synchronizing, which is
+// for the data structures that are accessed by one thread at a time.
+class NullMutex
+{
+public:
+    NullMutex() = default;
+    NullMutex(const NullMutex& other) = delete;
+    NullMutex& operator=(const NullMutex& other) = delete;
+
+    void lock_shared() {}
+
+    void lock() {}
+
+    void unlock_shared() {}
+
+    void unlock() {}
+};
+
 } // namespace Utils
 } // namespace L4
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace L4
+{
+namespace Utils
+{
+
+// HashKernel identifies the implementation of MurmurHash3_x64_128_Batch().
+// All the kernels produce the same hashes as MurmurHash3_x64_128(), thus the bucket
+// placement doesn't depend on the kernel used.
+enum class HashKernel : std::uint8_t
+{
+    // One key at a time.
+    Scalar = 0U,
+
+    // 4 keys at a time.
+    Avx2,
+
+    // 8 keys at a time (requires AVX-512F and AVX-512DQ).
+    Avx512
+};
+
+// Returns true if the given kernel is compiled in and supported by the CPU.
+bool IsHashKernelSupported(HashKernel kernel);
+
+// Returns the fastest kernel supported by the CPU, which is detected once.
+HashKernel GetBestHashKernel();
+
+// Hashes "numKeys" keys of the same length "len" with MurmurHash3_x64_128, where
+// "out" receives 16 bytes per key in the key order. The keys are hashed in groups of
+// the lanes of the given kernel, and the remaining keys are hashed one at a time.
+void MurmurHash3_x64_128_Batch(
+    const void* const* keys,
+    int len,
+    std::uint32_t seed,
+    std::size_t numKeys,
+    void* out,
+    HashKernel kernel = GetBestHashKernel());
+
+// Same as above, but the keys can have different lengths given by "lens".
+// Keys of the same length within a window of keys are hashed together.
+void MurmurHash3_x64_128_Batch(
+    const void* const* keys,
+    const int* lens,
+    std::uint32_t seed,
+    std::size_t numKeys,
+    void* out,
+    HashKernel kernel = GetBestHashKernel());
+
+} // namespace Utils
+} // namespace L4
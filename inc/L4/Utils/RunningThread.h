@@ -19,7 +19,8 @@ struct NoOp
 };
 
 // RunningThread wraps around std::thread and repeatedly runs a given function after yielding
-// for the given interval. Note that the destructor waits for the thread to stop.
+// for the given interval, which can be changed while running (see SetInterval()).
+// Note that the destructor waits for the thread to stop.
 template <typename CoreFunc, typename PrepFunc = NoOp>
 class RunningThread
 {
@@ -28,11 +29,11 @@ public:
         std::chrono::milliseconds interval,
         CoreFunc coreFunc,
         PrepFunc prepFunc = PrepFunc())
-        : m_isRunning(),
+        : m_isRunning(true),
+          m_intervalInMilliseconds(interval.count()),
           m_thread(
             &RunningThread::Start,
             this,
-            interval,
             coreFunc,
             prepFunc)
     {
@@ -48,29 +49,39 @@ public:
         }
     }
 
+    std::chrono::milliseconds GetInterval() const
+    {
+        return std::chrono::milliseconds{ m_intervalInMilliseconds.load() };
+    }
+
+    // The new interval takes effect after the current one elapses.
+    void SetInterval(std::chrono::milliseconds interval)
+    {
+        m_intervalInMilliseconds.store(interval.count());
+    }
+
     RunningThread(const RunningThread&) = delete;
     RunningThread& operator=(const RunningThread&) = delete;
 
 private:
     void Start(
-        std::chrono::milliseconds interval,
         CoreFunc coreFunc,
         PrepFunc prepFunc)
     {
-        m_isRunning.store(true);
-
         prepFunc();
 
         while (m_isRunning.load())
         {
             coreFunc();
 
-            std::this_thread::sleep_for(interval);
+            std::this_thread::sleep_for(GetInterval());
         }
     }
 
     std::atomic_bool m_isRunning;
 
+    std::atomic<std::chrono::milliseconds::rep> m_intervalInMilliseconds;
+
     std::thread m_thread;
 };
 
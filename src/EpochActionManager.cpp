@@ -1,6 +1,7 @@
 #include "Epoch/EpochActionManager.h"
 #include "Utils/Math.h"
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <thread>
@@ -10,9 +11,10 @@ namespace L4
 
 // EpochActionManager class implementation.
 
-EpochActionManager::EpochActionManager(std::uint8_t numActionQueues)
+EpochActionManager::EpochActionManager(std::uint8_t numActionQueues, std::uint8_t maxNumActionQueues)
     : m_epochToActionsList{}
     , m_counter{}
+    , m_queueIndexMask{}
 {
     // Calculate numActionQueues as the next highest power of two.
     std::uint16_t newNumActionQueues = numActionQueues;
@@ -24,8 +26,14 @@ EpochActionManager::EpochActionManager(std::uint8_t numActionQueues)
 
     assert(newNumActionQueues != 0U && Utils::Math::IsPowerOfTwo(newNumActionQueues));
 
+    const auto newMaxNumActionQueues = (std::max)(
+        newNumActionQueues,
+        static_cast<std::uint16_t>(Utils::Math::NextHighestPowerOfTwo(maxNumActionQueues)));
+
+    m_queueIndexMask = newNumActionQueues - 1U;
+
     // Initialize m_epochToActionsList.
-    m_epochToActionsList.resize(newNumActionQueues);
+    m_epochToActionsList.resize(newMaxNumActionQueues);
     for (auto& epochToActions : m_epochToActionsList)
     {
         std::get<0>(epochToActions) = std::make_unique<Mutex>();
@@ -33,13 +41,22 @@ EpochActionManager::EpochActionManager(std::uint8_t numActionQueues)
 }
 
 
-void EpochActionManager::RegisterAction(std::uint64_t epochCounter, IEpochActionManager::Action&& action)
+bool EpochActionManager::RegisterAction(std::uint64_t epochCounter, IEpochActionManager::Action&& action)
 {
-    std::uint32_t index = ++m_counter & (m_epochToActionsList.size() - 1);
+    std::uint32_t index = ++m_counter & m_queueIndexMask.load(std::memory_order_relaxed);
     auto& epochToActions = m_epochToActionsList[index];
 
-    Lock lock(*std::get<0>(epochToActions));
+    auto& mutex = *std::get<0>(epochToActions);
+    const bool isContended = !mutex.try_lock();
+    if (isContended)
+    {
+        mutex.lock();
+    }
+
+    Lock lock(mutex, std::adopt_lock);
     std::get<1>(epochToActions)[epochCounter].emplace_back(std::move(action));
+
+    return isContended;
 }
 
 
@@ -76,6 +93,34 @@ std::uint64_t EpochActionManager::PerformActions(std::uint64_t epochCounter)
 }
 
 
+std::uint32_t EpochActionManager::GetNumActionQueues() const
+{
+    return m_queueIndexMask.load(std::memory_order_relaxed) + 1U;
+}
+
+
+std::uint32_t EpochActionManager::GetMaxNumActionQueues() const
+{
+    return static_cast<std::uint32_t>(m_epochToActionsList.size());
+}
+
+
+void EpochActionManager::SetNumActionQueues(std::uint32_t numActionQueues)
+{
+    // PerformActions() goes through all the queues, thus the actions registered to the queues
+    // no longer in use are still performed.
+    numActionQueues = (std::min)((std::max)(numActionQueues, 1U), GetMaxNumActionQueues());
+
+    std::uint32_t numQueuesInUse = 1U;
+    while (numQueuesInUse * 2U <= numActionQueues)
+    {
+        numQueuesInUse *= 2U;
+    }
+
+    m_queueIndexMask.store(numQueuesInUse - 1U, std::memory_order_relaxed);
+}
+
+
 void EpochActionManager::ApplyActions(Actions& actions)
 {
     for (auto& action : actions)
@@ -0,0 +1,464 @@
+#include "Utils/MurmurHash3Batch.h"
+#include "Utils/MurmurHash3.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// The vectorized kernels are compiled for x86 only. GCC and Clang compile them with
+// the target attribute and select them at runtime, whereas MSVC compiles only the
+// kernels enabled by the /arch option.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+#define L4_HASH_KERNEL_AVX2
+#define L4_HASH_KERNEL_AVX512
+
+#define L4_TARGET_AVX2 __attribute__((target("avx2")))
+#define L4_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512dq")))
+#define L4_INLINE_AVX2 inline __attribute__((target("avx2"), always_inline))
+#define L4_INLINE_AVX512 inline __attribute__((target("avx2,avx512f,avx512dq"), always_inline))
+
+#elif defined(_MSC_VER) && defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define L4_HASH_KERNEL_AVX2
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+#define L4_HASH_KERNEL_AVX512
+#endif
+
+#define L4_TARGET_AVX2
+#define L4_TARGET_AVX512
+#define L4_INLINE_AVX2 __forceinline
+#define L4_INLINE_AVX512 __forceinline
+
+#endif
+
+namespace L4
+{
+namespace Utils
+{
+namespace
+{
+
+// The constants of MurmurHash3_x64_128, see src/MurmurHash3.cpp.
+constexpr std::uint64_t c_c1 = 0x87c37b91114253d5ULL;
+constexpr std::uint64_t c_c2 = 0x4cf5ad432745937fULL;
+constexpr std::uint64_t c_h1Increment = 0x52dce729ULL;
+constexpr std::uint64_t c_h2Increment = 0x38495ab5ULL;
+constexpr std::uint64_t c_fmix1 = 0xff51afd7ed558ccdULL;
+constexpr std::uint64_t c_fmix2 = 0xc4ceb9fe1a85ec53ULL;
+
+// The number of keys whose lengths are grouped together for the variable length batch.
+constexpr std::size_t c_windowSize = 64U;
+
+// Reads the tail (the last len % 16 bytes) of the given key as the two words mixed by
+// MurmurHash3_x64_128. The missing bytes are zero, which makes mixing them a no-op.
+inline void GetTail(const void* key, int len, std::uint64_t& k1, std::uint64_t& k2)
+{
+    std::uint8_t tail[16] = {};
+    if ((len & 15) != 0)
+    {
+        memcpy(tail, static_cast<const std::uint8_t*>(key) + (len & ~15), static_cast<std::size_t>(len & 15));
+    }
+
+    memcpy(&k1, tail, sizeof(k1));
+    memcpy(&k2, tail + sizeof(k1), sizeof(k2));
+}
+
+
+#if defined(L4_HASH_KERNEL_AVX2)
+
+constexpr std::size_t c_numAvx2Lanes = 4U;
+
+// AVX2 has no 64-bit multiply, thus it is composed of the 32-bit multiplies.
+L4_INLINE_AVX2 __m256i Mul64Avx2(__m256i a, __m256i b)
+{
+    const auto low = _mm256_mul_epu32(a, b);
+    const auto cross = _mm256_add_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+        _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+template <int r>
+L4_INLINE_AVX2 __m256i Rotl64Avx2(__m256i x)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, r), _mm256_srli_epi64(x, 64 - r));
+}
+
+L4_INLINE_AVX2 __m256i FmixAvx2(__m256i k)
+{
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = Mul64Avx2(k, _mm256_set1_epi64x(static_cast<long long>(c_fmix1)));
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = Mul64Avx2(k, _mm256_set1_epi64x(static_cast<long long>(c_fmix2)));
+    return _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+}
+
+L4_INLINE_AVX2 __m256i MixK1Avx2(__m256i k1, __m256i c1, __m256i c2)
+{
+    return Mul64Avx2(Rotl64Avx2<31>(Mul64Avx2(k1, c1)), c2);
+}
+
+L4_INLINE_AVX2 __m256i MixK2Avx2(__m256i k2, __m256i c1, __m256i c2)
+{
+    return Mul64Avx2(Rotl64Avx2<33>(Mul64Avx2(k2, c2)), c1);
+}
+
+// Returns x * 5 + increment.
+L4_INLINE_AVX2 __m256i Mul5AddAvx2(__m256i x, __m256i increment)
+{
+    return _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(x, 2), x), increment);
+}
+
+// Hashes 4 keys of the same length.
+L4_TARGET_AVX2 void HashAvx2(const void* const* keys, int len, std::uint32_t seed, std::uint64_t* out)
+{
+    const auto c1 = _mm256_set1_epi64x(static_cast<long long>(c_c1));
+    const auto c2 = _mm256_set1_epi64x(static_cast<long long>(c_c2));
+    const auto h1Increment = _mm256_set1_epi64x(static_cast<long long>(c_h1Increment));
+    const auto h2Increment = _mm256_set1_epi64x(static_cast<long long>(c_h2Increment));
+
+    auto h1 = _mm256_set1_epi64x(static_cast<long long>(seed));
+    auto h2 = h1;
+
+    const auto* data0 = static_cast<const std::uint8_t*>(keys[0]);
+    const auto* data1 = static_cast<const std::uint8_t*>(keys[1]);
+    const auto* data2 = static_cast<const std::uint8_t*>(keys[2]);
+    const auto* data3 = static_cast<const std::uint8_t*>(keys[3]);
+
+    const int nblocks = len / 16;
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        const auto offset = i * 16;
+
+        // Each block is loaded as (k1, k2), and the blocks are transposed so that
+        // k1 and k2 of the lane j are in the j-th 64-bit element of each vector.
+        const auto b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data0 + offset));
+        const auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data1 + offset));
+        const auto b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data2 + offset));
+        const auto b3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data3 + offset));
+
+        const auto b02 = _mm256_inserti128_si256(_mm256_castsi128_si256(b0), b2, 1);
+        const auto b13 = _mm256_inserti128_si256(_mm256_castsi128_si256(b1), b3, 1);
+
+        h1 = _mm256_xor_si256(h1, MixK1Avx2(_mm256_unpacklo_epi64(b02, b13), c1, c2));
+        h1 = Mul5AddAvx2(_mm256_add_epi64(Rotl64Avx2<27>(h1), h2), h1Increment);
+
+        h2 = _mm256_xor_si256(h2, MixK2Avx2(_mm256_unpackhi_epi64(b02, b13), c1, c2));
+        h2 = Mul5AddAvx2(_mm256_add_epi64(Rotl64Avx2<31>(h2), h1), h2Increment);
+    }
+
+    std::array<std::uint64_t, c_numAvx2Lanes> k1;
+    std::array<std::uint64_t, c_numAvx2Lanes> k2;
+
+    for (std::size_t lane = 0U; lane < c_numAvx2Lanes; ++lane)
+    {
+        GetTail(keys[lane], len, k1[lane], k2[lane]);
+    }
+
+    h1 = _mm256_xor_si256(h1, MixK1Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(k1.data())), c1, c2));
+    h2 = _mm256_xor_si256(h2, MixK2Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(k2.data())), c1, c2));
+
+    const auto length = _mm256_set1_epi64x(len);
+    h1 = _mm256_xor_si256(h1, length);
+    h2 = _mm256_xor_si256(h2, length);
+
+    h1 = _mm256_add_epi64(h1, h2);
+    h2 = _mm256_add_epi64(h2, h1);
+
+    h1 = FmixAvx2(h1);
+    h2 = FmixAvx2(h2);
+
+    h1 = _mm256_add_epi64(h1, h2);
+    h2 = _mm256_add_epi64(h2, h1);
+
+    // Interleave to (h1, h2) per key.
+    const auto lo = _mm256_unpacklo_epi64(h1, h2);
+    const auto hi = _mm256_unpackhi_epi64(h1, h2);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+#endif // defined(L4_HASH_KERNEL_AVX2)
+
+
+#if defined(L4_HASH_KERNEL_AVX512)
+
+constexpr std::size_t c_numAvx512Lanes = 8U;
+
+L4_INLINE_AVX512 __m512i FmixAvx512(__m512i k)
+{
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(static_cast<long long>(c_fmix1)));
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(static_cast<long long>(c_fmix2)));
+    return _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+}
+
+L4_INLINE_AVX512 __m512i MixK1Avx512(__m512i k1, __m512i c1, __m512i c2)
+{
+    return _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(k1, c1), 31), c2);
+}
+
+L4_INLINE_AVX512 __m512i MixK2Avx512(__m512i k2, __m512i c1, __m512i c2)
+{
+    return _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(k2, c2), 33), c1);
+}
+
+// Returns x * 5 + increment.
+L4_INLINE_AVX512 __m512i Mul5AddAvx512(__m512i x, __m512i increment)
+{
+    return _mm512_add_epi64(_mm512_add_epi64(_mm512_slli_epi64(x, 2), x), increment);
+}
+
+// Loads the 16-byte blocks at the given offset of the keys 0, 2, 4 and 6 (or 1, 3, 5 and 7).
+L4_INLINE_AVX512 __m512i LoadBlocksAvx512(const std::uint8_t* const* data, int offset)
+{
+    auto blocks = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data[0] + offset)));
+    blocks = _mm512_inserti32x4(blocks, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[2] + offset)), 1);
+    blocks = _mm512_inserti32x4(blocks, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[4] + offset)), 2);
+    return _mm512_inserti32x4(blocks, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[6] + offset)), 3);
+}
+
+// Hashes 8 keys of the same length.
+L4_TARGET_AVX512 void HashAvx512(const void* const* keys, int len, std::uint32_t seed, std::uint64_t* out)
+{
+    const auto c1 = _mm512_set1_epi64(static_cast<long long>(c_c1));
+    const auto c2 = _mm512_set1_epi64(static_cast<long long>(c_c2));
+    const auto h1Increment = _mm512_set1_epi64(static_cast<long long>(c_h1Increment));
+    const auto h2Increment = _mm512_set1_epi64(static_cast<long long>(c_h2Increment));
+
+    auto h1 = _mm512_set1_epi64(static_cast<long long>(seed));
+    auto h2 = h1;
+
+    std::array<const std::uint8_t*, c_numAvx512Lanes> data;
+    for (std::size_t lane = 0U; lane < c_numAvx512Lanes; ++lane)
+    {
+        data[lane] = static_cast<const std::uint8_t*>(keys[lane]);
+    }
+
+    const int nblocks = len / 16;
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        // See HashAvx2() for the transposition.
+        const auto evenBlocks = LoadBlocksAvx512(data.data(), i * 16);
+        const auto oddBlocks = LoadBlocksAvx512(data.data() + 1, i * 16);
+
+        h1 = _mm512_xor_si512(h1, MixK1Avx512(_mm512_unpacklo_epi64(evenBlocks, oddBlocks), c1, c2));
+        h1 = Mul5AddAvx512(_mm512_add_epi64(_mm512_rol_epi64(h1, 27), h2), h1Increment);
+
+        h2 = _mm512_xor_si512(h2, MixK2Avx512(_mm512_unpackhi_epi64(evenBlocks, oddBlocks), c1, c2));
+        h2 = Mul5AddAvx512(_mm512_add_epi64(_mm512_rol_epi64(h2, 31), h1), h2Increment);
+    }
+
+    std::array<std::uint64_t, c_numAvx512Lanes> k1;
+    std::array<std::uint64_t, c_numAvx512Lanes> k2;
+
+    for (std::size_t lane = 0U; lane < c_numAvx512Lanes; ++lane)
+    {
+        GetTail(keys[lane], len, k1[lane], k2[lane]);
+    }
+
+    h1 = _mm512_xor_si512(h1, MixK1Avx512(_mm512_loadu_si512(k1.data()), c1, c2));
+    h2 = _mm512_xor_si512(h2, MixK2Avx512(_mm512_loadu_si512(k2.data()), c1, c2));
+
+    const auto length = _mm512_set1_epi64(len);
+    h1 = _mm512_xor_si512(h1, length);
+    h2 = _mm512_xor_si512(h2, length);
+
+    h1 = _mm512_add_epi64(h1, h2);
+    h2 = _mm512_add_epi64(h2, h1);
+
+    h1 = FmixAvx512(h1);
+    h2 = FmixAvx512(h2);
+
+    h1 = _mm512_add_epi64(h1, h2);
+    h2 = _mm512_add_epi64(h2, h1);
+
+    // Interleave to (h1, h2) per key.
+    const auto first = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0);
+    const auto second = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);
+
+    _mm512_storeu_si512(out, _mm512_permutex2var_epi64(h1, first, h2));
+    _mm512_storeu_si512(out + 8, _mm512_permutex2var_epi64(h1, second, h2));
+}
+
+#endif // defined(L4_HASH_KERNEL_AVX512)
+
+
+HashKernel DetectBestHashKernel()
+{
+    if (IsHashKernelSupported(HashKernel::Avx512))
+    {
+        return HashKernel::Avx512;
+    }
+
+    if (IsHashKernelSupported(HashKernel::Avx2))
+    {
+        return HashKernel::Avx2;
+    }
+
+    return HashKernel::Scalar;
+}
+
+} // anonymous namespace
+
+
+bool IsHashKernelSupported(HashKernel kernel)
+{
+    switch (kernel)
+    {
+    case HashKernel::Scalar:
+        return true;
+
+#if defined(L4_HASH_KERNEL_AVX2)
+    case HashKernel::Avx2:
+#if defined(__GNUC__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#else
+        return true;
+#endif
+#endif
+
+#if defined(L4_HASH_KERNEL_AVX512)
+    case HashKernel::Avx512:
+#if defined(__GNUC__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0
+            && __builtin_cpu_supports("avx512f") != 0
+            && __builtin_cpu_supports("avx512dq") != 0;
+#else
+        return true;
+#endif
+#endif
+
+    default:
+        return false;
+    }
+}
+
+
+HashKernel GetBestHashKernel()
+{
+    static const HashKernel s_kernel = DetectBestHashKernel();
+
+    return s_kernel;
+}
+
+
+void MurmurHash3_x64_128_Batch(
+    const void* const* keys,
+    int len,
+    std::uint32_t seed,
+    std::size_t numKeys,
+    void* out,
+    HashKernel kernel)
+{
+    auto* hashes = static_cast<std::uint64_t*>(out);
+    std::size_t i = 0U;
+
+#if defined(L4_HASH_KERNEL_AVX512)
+    if (kernel == HashKernel::Avx512)
+    {
+        for (; i + c_numAvx512Lanes <= numKeys; i += c_numAvx512Lanes)
+        {
+            HashAvx512(keys + i, len, seed, hashes + 2U * i);
+        }
+    }
+#endif
+
+#if defined(L4_HASH_KERNEL_AVX2)
+    // The keys left by the AVX-512 kernel are also hashed 4 at a time.
+    if (kernel == HashKernel::Avx2 || kernel == HashKernel::Avx512)
+    {
+        for (; i + c_numAvx2Lanes <= numKeys; i += c_numAvx2Lanes)
+        {
+            HashAvx2(keys + i, len, seed, hashes + 2U * i);
+        }
+    }
+#else
+    (void)kernel;
+#endif
+
+    for (; i < numKeys; ++i)
+    {
+        MurmurHash3_x64_128(keys[i], len, seed, hashes + 2U * i);
+    }
+}
+
+
+void MurmurHash3_x64_128_Batch(
+    const void* const* keys,
+    const int* lens,
+    std::uint32_t seed,
+    std::size_t numKeys,
+    void* out,
+    HashKernel kernel)
+{
+    auto* hashes = static_cast<std::uint64_t*>(out);
+
+    std::array<std::uint32_t, c_windowSize> order;
+    std::array<const void*, c_windowSize> groupKeys;
+    std::array<std::uint64_t, 2U * c_windowSize> groupHashes;
+
+    for (std::size_t begin = 0U; begin < numKeys; begin += c_windowSize)
+    {
+        const auto size = (std::min)(c_windowSize, numKeys - begin);
+        const auto* windowLens = lens + begin;
+
+        // Fixed size keys are the common case, which doesn't need to be grouped.
+        if (std::all_of(windowLens, windowLens + size, [windowLens](int len) { return len == windowLens[0]; }))
+        {
+            MurmurHash3_x64_128_Batch(keys + begin, windowLens[0], seed, size, hashes + 2U * begin, kernel);
+            continue;
+        }
+
+        for (std::uint32_t i = 0U; i < size; ++i)
+        {
+            order[i] = i;
+        }
+
+        std::sort(order.begin(), order.begin() + size, [windowLens](std::uint32_t left, std::uint32_t right)
+        {
+            return windowLens[left] < windowLens[right];
+        });
+
+        for (std::size_t groupBegin = 0U; groupBegin < size; )
+        {
+            const auto len = windowLens[order[groupBegin]];
+
+            std::size_t groupSize = 0U;
+            while (groupBegin + groupSize < size && windowLens[order[groupBegin + groupSize]] == len)
+            {
+                groupKeys[groupSize] = keys[begin + order[groupBegin + groupSize]];
+                ++groupSize;
+            }
+
+            MurmurHash3_x64_128_Batch(groupKeys.data(), len, seed, groupSize, groupHashes.data(), kernel);
+
+            for (std::size_t i = 0U; i < groupSize; ++i)
+            {
+                const auto index = begin + order[groupBegin + i];
+                hashes[2U * index] = groupHashes[2U * i];
+                hashes[2U * index + 1U] = groupHashes[2U * i + 1U];
+            }
+
+            groupBegin += groupSize;
+        }
+    }
+}
+
+} // namespace Utils
+} // namespace L4